@@ -62,6 +62,7 @@ CommandLineParser::CommandLineParser(Reactor& reactor_)
 	registerOption("-v",          versionOption, PHASE_BEFORE_INIT, 1);
 	registerOption("--version",   versionOption, PHASE_BEFORE_INIT, 1);
 	registerOption("-bash",       bashOption,    PHASE_BEFORE_INIT, 1);
+	registerOption("-runfor",     runForOption,  PHASE_BEFORE_INIT);
 
 	registerOption("-setting",    settingOption, PHASE_BEFORE_SETTINGS);
 	registerOption("-control",    controlOption, PHASE_BEFORE_SETTINGS, 1);
@@ -171,7 +172,7 @@ void CommandLineParser::parse(int argc, char** argv)
 	     phase = static_cast<ParsePhase>(phase + 1)) {
 		switch (phase) {
 		case PHASE_INIT:
-			reactor.init();
+			reactor.init(getRunForTime() > 0.0);
 			getInterpreter().init(argv[0]);
 			break;
 		case PHASE_LOAD_SETTINGS:
@@ -278,7 +279,8 @@ void CommandLineParser::parse(int argc, char** argv)
 
 bool CommandLineParser::isHiddenStartup() const
 {
-	return (parseStatus == CONTROL) || (parseStatus == TEST);
+	return (parseStatus == CONTROL) || (parseStatus == TEST) ||
+	       (runForOption.seconds > 0.0);
 }
 
 CommandLineParser::ParseStatus CommandLineParser::getParseStatus() const
@@ -575,6 +577,24 @@ string_view CommandLineParser::TestConfigOption::optionHelp() const
 	return "Test if the specified config works and exit";
 }
 
+// class RunForOption
+
+void CommandLineParser::RunForOption::parseOption(
+	const string& option, array_ref<string>& cmdLine)
+{
+	string arg = getArgument(option, cmdLine);
+	if (!StringOp::stringToDouble(arg, seconds) || (seconds <= 0.0)) {
+		throw FatalError("Invalid number of seconds for ", option,
+		                 ": '", arg, '\'');
+	}
+}
+
+string_view CommandLineParser::RunForOption::optionHelp() const
+{
+	return "Run <seconds> of emulated time as fast as possible without "
+	       "video and sound output, print the speed and exit";
+}
+
 // class BashOption
 
 void CommandLineParser::BashOption::parseOption(
@@ -61,6 +61,11 @@ public:
 	  */
 	bool isHiddenStartup() const;
 
+	/** Emulated time (in seconds) requested with '-runfor', or zero when
+	  * openMSX should run normally (interactive, in real time).
+	  */
+	double getRunForTime() const { return runForOption.seconds; }
+
 private:
 	struct OptionData {
 		CLIOption* option;
@@ -126,6 +131,12 @@ private:
 		string_view optionHelp() const override;
 	} testConfigOption;
 
+	struct RunForOption final : CLIOption {
+		void parseOption(const std::string& option, array_ref<std::string>& cmdLine) override;
+		string_view optionHelp() const override;
+		double seconds = 0.0;
+	} runForOption;
+
 	struct BashOption final : CLIOption {
 		void parseOption(const std::string& option, array_ref<std::string>& cmdLine) override;
 		string_view optionHelp() const override;
@@ -29,6 +29,7 @@
 #include "StateChangeDistributor.hh"
 #include "EventDelay.hh"
 #include "RealTime.hh"
+#include "Profiler.hh"
 #include "DeviceFactory.hh"
 #include "BooleanSetting.hh"
 #include "GlobalSettings.hh"
@@ -496,6 +497,9 @@ bool MSXMotherBoard::execute()
 	}
 	assert(getMachineConfig()); // otherwise powered cannot be true
 
+	// Exclusive time is the CPU emulation itself, inclusive also contains
+	// all devices that are synchronized from within the CPU loop.
+	ProfileScope scope("CPU");
 	getCPU().execute(false);
 	return true;
 }
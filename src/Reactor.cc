@@ -16,6 +16,7 @@
 #include "StateChangeDistributor.hh"
 #include "Command.hh"
 #include "AfterCommand.hh"
+#include "ProfileCommand.hh"
 #include "MessageCommand.hh"
 #include "CommandException.hh"
 #include "GlobalCliComm.hh"
@@ -196,7 +197,7 @@ Reactor::Reactor()
 #endif
 }
 
-void Reactor::init()
+void Reactor::init(bool headless)
 {
 	rtScheduler = make_unique<RTScheduler>();
 	eventDistributor = make_unique<EventDistributor>(*this);
@@ -208,7 +209,7 @@ void Reactor::init()
 	inputEventGenerator = make_unique<InputEventGenerator>(
 		*globalCommandController, *eventDistributor, *globalSettings);
 	mixer = make_unique<Mixer>(
-		*this, *globalCommandController);
+		*this, *globalCommandController, headless);
 	diskFactory = make_unique<DiskFactory>(
 		*this);
 	diskManipulator = make_unique<DiskManipulator>(
@@ -220,6 +221,8 @@ void Reactor::init()
 		*globalCommandController);
 	afterCommand = make_unique<AfterCommand>(
 		*this, *eventDistributor, *globalCommandController);
+	profileCommand = make_unique<ProfileCommand>(
+		*globalCommandController, *eventDistributor);
 	quitCommand = make_unique<QuitCommand>(
 		*globalCommandController, *eventDistributor);
 	messageCommand = make_unique<MessageCommand>(
@@ -545,6 +548,11 @@ void Reactor::run(CommandLineParser& parser)
 		}
 	}
 
+	if (parser.getRunForTime() > 0.0) {
+		runFor(EmuDuration(parser.getRunForTime()));
+		return;
+	}
+
 	while (running) {
 		eventDistributor->deliverEvents();
 		assert(garbageBoards.empty());
@@ -562,6 +570,40 @@ void Reactor::run(CommandLineParser& parser)
 	}
 }
 
+void Reactor::runFor(EmuDuration::param duration)
+{
+	assert(Thread::isMainThread());
+
+	// Deliver events (e.g. 'after time' callbacks) once per frame. Like
+	// in the main loop, this also deletes the boards that were replaced
+	// (see deleteBoard()).
+	const auto step = EmuDuration::msec(20);
+	EmuDuration emulated;
+	auto start = Timer::getTime();
+	eventDistributor->deliverQueuedEvents();
+	assert(garbageBoards.empty());
+	while (running && (emulated < duration)) {
+		// Re-fetch the board each time, the events can switch machine.
+		if (!activeBoard || !activeBoard->isPowered()) {
+			getCliComm().printWarning(
+				"Machine is powered off, stopped running.");
+			break;
+		}
+		auto left = EmuDuration(duration.length() - emulated.length());
+		auto begin = activeBoard->getCurrentTime();
+		activeBoard->fastForward(begin + std::min(step, left), true);
+		emulated = emulated + (activeBoard->getCurrentTime() - begin);
+		eventDistributor->deliverQueuedEvents();
+		assert(garbageBoards.empty());
+	}
+	double hostSecs = (Timer::getTime() - start) / 1000000.0;
+	double emuSecs = emulated.toDouble();
+	getCliComm().printInfo(
+		"Emulated ", emuSecs, "s in ", hostSecs, "s host time: ",
+		(hostSecs > 0.0) ? (emuSecs / hostSecs) : 0.0,
+		" emulated seconds per host second.");
+}
+
 void Reactor::unpause()
 {
 	if (paused) {
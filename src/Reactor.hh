@@ -4,6 +4,7 @@
 #include "Observer.hh"
 #include "EventListener.hh"
 #include "string_view.hh"
+#include "EmuDuration.hh"
 #include "openmsx.hh"
 #include <string>
 #include <memory>
@@ -37,6 +38,7 @@ class MSXMotherBoard;
 class Setting;
 class CommandLineParser;
 class AfterCommand;
+class ProfileCommand;
 class QuitCommand;
 class MessageCommand;
 class MachineCommand;
@@ -65,7 +67,9 @@ class Reactor final : private Observer<Setting>, private EventListener
 {
 public:
 	Reactor();
-	void init();
+	/** @param headless Prepare for runFor(): never open a sound device.
+	  */
+	void init(bool headless);
 	~Reactor();
 
 	/**
@@ -73,6 +77,17 @@ public:
 	 */
 	void run(CommandLineParser& parser);
 
+	/**
+	 * Headless main loop: run the active machine for the given amount
+	 * of emulated time as fast as possible. There's no synchronization
+	 * with the host clock, no sound output and no polling for host
+	 * (input) events. Events generated by the emulation itself (e.g.
+	 * 'after time' callbacks) are still delivered, once per emulated
+	 * frame. At the end the achieved speed is printed. Must be called
+	 * from the main thread.
+	 */
+	void runFor(EmuDuration::param duration);
+
 	void enterMainLoop();
 
 	RTScheduler& getRTScheduler() { return *rtScheduler; }
@@ -154,6 +169,7 @@ private:
 	std::unique_ptr<RomDatabase> softwareDatabase;
 
 	std::unique_ptr<AfterCommand> afterCommand;
+	std::unique_ptr<ProfileCommand> profileCommand;
 	std::unique_ptr<QuitCommand> quitCommand;
 	std::unique_ptr<MessageCommand> messageCommand;
 	std::unique_ptr<MachineCommand> machineCommand;
@@ -10,7 +10,16 @@
 #include "IntegerSetting.hh"
 #include "BooleanSetting.hh"
 #include "ThrottleManager.hh"
+#include "Mixer.hh"
+#include "TclObject.hh"
 #include "checked_cast.hh"
+#include "outer.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using std::string;
+using std::vector;
 
 namespace openmsx {
 
@@ -18,6 +27,14 @@ const double   SYNC_INTERVAL = 0.08;  // s
 const int64_t  MAX_LAG       = 200000; // us
 const uint64_t ALLOWED_LAG   =  20000; // us
 
+const double MIN_SPIN_MARGIN     =   50.0; // us
+const double MAX_SPIN_MARGIN     = 1000.0; // us
+const double INITIAL_SPIN_MARGIN =  500.0; // us
+
+const double AUDIO_FILL_ALPHA     =   0.1;
+const double AUDIO_GAIN           =   0.05;
+const double MAX_AUDIO_CORRECTION = 1000.0; // us per sync
+
 RealTime::RealTime(
 		MSXMotherBoard& motherBoard_, GlobalSettings& globalSettings,
 		EventDelay& eventDelay_)
@@ -29,7 +46,15 @@ RealTime::RealTime(
 	, speedSetting   (globalSettings.getSpeedSetting())
 	, pauseSetting   (globalSettings.getPauseSetting())
 	, powerSetting   (globalSettings.getPowerSetting())
+	, jitterInfo(motherBoard.getMachineInfoCommand())
 	, emuTime(EmuTime::zero)
+	, spinMargin(INITIAL_SPIN_MARGIN)
+	, oversleepAvg(0.0)
+	, oversleepDev(INITIAL_SPIN_MARGIN / 3)
+	, audioFill(0.0)
+	, audioFillRef(-1.0)
+	, latenessIdx(0)
+	, latenessCount(0)
 	, enabled(true)
 {
 	speedSetting.attach(*this);
@@ -90,19 +115,16 @@ void RealTime::internalSync(EmuTime::param time, bool allowSleep)
 		auto realDuration = static_cast<uint64_t>(
 		        getRealDuration(emuTime, time) * 1000000ULL);
 		idealRealTime += realDuration;
+		if (allowSleep) followAudioClock();
 		auto currentRealTime = Timer::getTime();
 		int64_t sleep = idealRealTime - currentRealTime;
 		if (allowSleep) {
-			// want to sleep for 'sleep' us
-			sleep += static_cast<int64_t>(sleepAdjust);
-			int64_t delta = 0;
-			if (sleep > 0) {
-				Timer::sleep(sleep); // request to sleep for 'sleep+sleepAdjust'
-				int64_t slept = Timer::getTime() - currentRealTime;
-				delta = sleep - slept; // actually slept for 'slept' us
-			}
-			const double ALPHA = 0.2;
-			sleepAdjust = sleepAdjust * (1 - ALPHA) + delta * ALPHA;
+			auto now = (sleep > 0) ? waitUntil(idealRealTime)
+			                       : currentRealTime;
+			lateness[latenessIdx] = uint32_t(std::min<uint64_t>(
+				now - std::min(now, idealRealTime), UINT32_MAX));
+			latenessIdx = (latenessIdx + 1) % JITTER_SAMPLES;
+			if (latenessCount < JITTER_SAMPLES) ++latenessCount;
 		}
 		if (-sleep > MAX_LAG) {
 			idealRealTime = currentRealTime - MAX_LAG / 2;
@@ -115,6 +137,59 @@ void RealTime::internalSync(EmuTime::param time, bool allowSleep)
 	emuTime = time;
 }
 
+uint64_t RealTime::waitUntil(uint64_t deadline)
+{
+	auto now = Timer::getTime();
+	auto margin = static_cast<uint64_t>(spinMargin);
+	if (deadline > (now + margin)) {
+		auto wakeup = deadline - margin;
+		Timer::sleepUntil(wakeup);
+		now = Timer::getTime();
+
+		// Keep the margin just above the typical oversleep (average plus
+		// a few times the mean deviation), so that we (almost) never
+		// wake up too late, but also don't spin longer than needed.
+		double oversleep = double(int64_t(now - wakeup));
+		const double ALPHA = 0.1;
+		oversleepDev = oversleepDev * (1 - ALPHA) +
+		               std::abs(oversleep - oversleepAvg) * ALPHA;
+		oversleepAvg = oversleepAvg * (1 - ALPHA) + oversleep * ALPHA;
+		spinMargin = std::min(std::max(oversleepAvg + 3 * oversleepDev,
+		                               MIN_SPIN_MARGIN),
+		                      MAX_SPIN_MARGIN);
+	}
+	while (now < deadline) {
+		now = Timer::getTime();
+	}
+	return now;
+}
+
+void RealTime::followAudioClock()
+{
+	// When the emulation runs faster than the sound card plays, the
+	// number of buffered samples grows (and vice versa). So we steer the
+	// ideal time to keep that number at the level it had when we
+	// started. This is only a small correction on top of the host clock,
+	// but it prevents that both clocks slowly drift apart (which would
+	// otherwise result in buffer under- or overruns).
+	auto& mixer = motherBoard.getReactor().getMixer();
+	int fill = mixer.getBufferedSamples();
+	if (fill < 0) {
+		audioFillRef = -1.0;
+		return;
+	}
+	if (audioFillRef < 0.0) {
+		audioFill = audioFillRef = fill;
+		return;
+	}
+	audioFill = audioFill * (1 - AUDIO_FILL_ALPHA) + fill * AUDIO_FILL_ALPHA;
+	double error = (audioFill - audioFillRef) * 1000000.0 / mixer.getFrequency();
+	double correction = std::min(std::max(error * AUDIO_GAIN,
+	                                      -MAX_AUDIO_CORRECTION),
+	                             MAX_AUDIO_CORRECTION);
+	idealRealTime += static_cast<int64_t>(correction);
+}
+
 void RealTime::executeUntil(EmuTime::param time)
 {
 	internalSync(time, true);
@@ -156,7 +231,7 @@ void RealTime::resync()
 	if (!enabled) return;
 
 	idealRealTime = Timer::getTime();
-	sleepAdjust = 0.0;
+	audioFillRef = -1.0;
 	removeSyncPoint();
 	emuTime = getCurrentTime();
 	setSyncPoint(emuTime + getEmuDuration(SYNC_INTERVAL));
@@ -174,4 +249,48 @@ void RealTime::disable()
 	removeSyncPoint();
 }
 
+
+// class JitterInfo
+
+RealTime::JitterInfo::JitterInfo(InfoCommand& machineInfoCommand)
+	: InfoTopic(machineInfoCommand, "sync_jitter")
+{
+}
+
+void RealTime::JitterInfo::execute(
+	array_ref<TclObject> /*tokens*/, TclObject& result) const
+{
+	auto& rt = OUTER(RealTime, jitterInfo);
+	vector<uint32_t> sorted(rt.lateness, rt.lateness + rt.latenessCount);
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&](unsigned p) {
+		if (sorted.empty()) return 0;
+		return int(sorted[(sorted.size() - 1) * p / 100]);
+	};
+	result.addListElement("samples");
+	result.addListElement(int(sorted.size()));
+	result.addListElement("p50");
+	result.addListElement(percentile(50));
+	result.addListElement("p90");
+	result.addListElement(percentile(90));
+	result.addListElement("p99");
+	result.addListElement(percentile(99));
+	result.addListElement("max");
+	result.addListElement(percentile(100));
+	result.addListElement("spin_margin");
+	result.addListElement(int(rt.spinMargin));
+	result.addListElement("oversleep");
+	result.addListElement(int(rt.oversleepAvg));
+}
+
+string RealTime::JitterInfo::help(const vector<string>& /*tokens*/) const
+{
+	return "Statistics about how precisely the emulation is synchronized "
+	       "with real time, over the last 1024 synchronization points. "
+	       "Returns a dictionary with the percentiles (p50, p90, p99 and "
+	       "max) of the lateness in microseconds, the current spin margin "
+	       "(busy-wait time before a deadline) and the average time the "
+	       "host OS sleeps longer than requested.";
+}
+
 } // namespace openmsx
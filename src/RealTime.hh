@@ -5,6 +5,7 @@
 #include "EventListener.hh"
 #include "Observer.hh"
 #include "EmuTime.hh"
+#include "InfoTopic.hh"
 #include <cstdint>
 
 namespace openmsx {
@@ -68,6 +69,8 @@ private:
 	void update(const ThrottleManager& throttleManager) override;
 
 	void internalSync(EmuTime::param time, bool allowSleep);
+	void followAudioClock();
+	uint64_t waitUntil(uint64_t deadline);
 
 	MSXMotherBoard& motherBoard;
 	EventDistributor& eventDistributor;
@@ -77,9 +80,33 @@ private:
 	BooleanSetting& pauseSetting;
 	BooleanSetting& powerSetting;
 
+	struct JitterInfo final : InfoTopic {
+		explicit JitterInfo(InfoCommand& machineInfoCommand);
+		void execute(array_ref<TclObject> tokens,
+		             TclObject& result) const override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+	} jitterInfo;
+
 	uint64_t idealRealTime;
 	EmuTime emuTime;
-	double sleepAdjust;
+
+	// We sleep till 'spinMargin' us before the deadline, and busy-wait
+	// the remaining time. The margin follows the measured oversleep.
+	double spinMargin;
+	double oversleepAvg;
+	double oversleepDev;
+
+	// Average number of buffered audio samples, and the value at the
+	// moment we (re)started following the sound card clock.
+	double audioFill;
+	double audioFillRef; // negative when not following
+
+	// Lateness (in us) of the last JITTER_SAMPLES synchronization points.
+	static const unsigned JITTER_SAMPLES = 1024;
+	uint32_t lateness[JITTER_SAMPLES];
+	unsigned latenessIdx;
+	unsigned latenessCount;
+
 	bool enabled;
 };
 
@@ -15,6 +15,7 @@
 #include "Timer.hh"
 #include "CliComm.hh"
 #include "Display.hh"
+#include "Profiler.hh"
 #include "Reactor.hh"
 #include "CommandException.hh"
 #include "MemBuffer.hh"
@@ -899,6 +900,8 @@ unsigned ReverseManager::ReverseHistory::getNextSeqNum(EmuTime::param time) cons
 
 void ReverseManager::takeSnapshot(EmuTime::param time)
 {
+	ProfileScope scope("reverse snapshot");
+
 	// (possibly) drop old snapshots
 	// TODO does snapshot pruning still happen correctly (often enough)
 	//      when going back/forward in time?
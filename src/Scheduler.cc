@@ -2,6 +2,7 @@
 #include "Schedulable.hh"
 #include "Thread.hh"
 #include "MSXCPU.hh"
+#include "Profiler.hh"
 #include "serialize.hh"
 #include <cassert>
 #include <algorithm>
@@ -109,7 +110,12 @@ void Scheduler::scheduleHelper(EmuTime::param limit, EmuTime next)
 
 		queue.remove_front();
 
-		device->executeUntil(next);
+		if (unlikely(Profiler::isEnabled())) {
+			ProfileScope scope(typeid(*device));
+			device->executeUntil(next);
+		} else {
+			device->executeUntil(next);
+		}
 
 		next = getNext();
 		if (likely(next > limit)) break;
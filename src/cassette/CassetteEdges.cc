@@ -0,0 +1,157 @@
+#include "CassetteEdges.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace openmsx {
+
+const uint16_t CassetteEdges::CONTINUE;
+const unsigned CassetteEdges::INDEX_STEP;
+
+CassetteEdges::Builder::Builder()
+	: count(0)
+	, prev(0)
+	, level(true)
+{
+}
+
+void CassetteEdges::Builder::addSamples(const int16_t* samples, size_t num)
+{
+	if (num == 0) return;
+	size_t i = 0;
+	if (count == 0) {
+		level = samples[0] >= 0;
+		edges = CassetteEdges(level);
+		prev = samples[0];
+		count = 1;
+		i = 1;
+	}
+	for (/**/; i < num; ++i) {
+		addSegment(prev, samples[i]);
+		prev = samples[i];
+		++count;
+	}
+}
+
+// The signal in between the last two samples: sample 'count - 1' is 's0',
+// the one after it is 's1'.
+void CassetteEdges::Builder::addSegment(int s0, int s1)
+{
+	uint64_t pos = uint64_t(count - 1) << SUB_BITS;
+	bool l0 = s0 >= 0;
+	if (l0 != level) {
+		edges.addEdge(pos);
+		level = l0;
+	}
+	if (l0 != (s1 >= 0)) {
+		// The interpolated signal crosses zero (at most once) somewhere
+		// in between these two samples.
+		for (unsigned f = 1; f < SUB_SAMPLES; ++f) {
+			if (getLevel(s0, s1, f) != level) {
+				edges.addEdge(pos + f);
+				level = !level;
+				break;
+			}
+		}
+	}
+}
+
+CassetteEdges CassetteEdges::Builder::finish()
+{
+	if (count != 0) {
+		addSegment(prev, 0);
+		// Beyond the end, the samples are 0.
+		if (!level) edges.addEdge(uint64_t(count) << SUB_BITS);
+	}
+	edges.runs.shrink_to_fit();
+	edges.index.shrink_to_fit();
+	return std::move(edges);
+}
+
+CassetteEdges CassetteEdges::fromSamples(
+	const int16_t* samples, size_t num, const std::atomic<bool>& abort)
+{
+	Builder builder;
+	const size_t CHUNK = 0x10000;
+	for (size_t i = 0; (i < num) && !abort; i += CHUNK) {
+		builder.addSamples(samples + i, std::min(CHUNK, num - i));
+	}
+	return builder.finish();
+}
+
+CassetteEdges::CassetteEdges(bool initialLevel_)
+	: endPos(0)
+	, nbEdges(0)
+	, initialLevel(initialLevel_)
+	, endLevel(initialLevel_)
+	, cursorRun(0)
+	, cursorPos(0)
+	, cursorLevel(initialLevel_)
+{
+}
+
+void CassetteEdges::addEdge(uint64_t pos)
+{
+	assert(pos > endPos);
+	uint64_t len = pos - endPos;
+	while (len >= CONTINUE) {
+		pushRun(CONTINUE);
+		len -= CONTINUE;
+	}
+	pushRun(uint16_t(len)); // possibly 0 after a CONTINUE run
+}
+
+void CassetteEdges::pushRun(uint16_t run)
+{
+	if ((runs.size() % INDEX_STEP) == 0) {
+		index.push_back({endPos, endLevel});
+	}
+	runs.push_back(run);
+	endPos += run;
+	if (run != CONTINUE) {
+		endLevel = !endLevel;
+		++nbEdges;
+	}
+}
+
+bool CassetteEdges::getLevel(uint64_t pos)
+{
+	size_t nextIndex = (cursorRun / INDEX_STEP) + 1;
+	if ((pos < cursorPos) ||
+	    ((nextIndex < index.size()) && (index[nextIndex].pos <= pos))) {
+		seek(pos);
+	}
+	while (cursorRun < runs.size()) {
+		auto run = runs[cursorRun];
+		uint64_t next = cursorPos + run;
+		if (next > pos) break;
+		cursorPos = next;
+		if (run != CONTINUE) cursorLevel = !cursorLevel;
+		++cursorRun;
+	}
+	return cursorLevel;
+}
+
+// Move the cursor to the last index entry at or before 'pos'.
+void CassetteEdges::seek(uint64_t pos)
+{
+	auto it = std::upper_bound(index.begin(), index.end(), pos,
+		[](uint64_t p, const IndexEntry& e) { return p < e.pos; });
+	if (it == index.begin()) {
+		cursorRun = 0;
+		cursorPos = 0;
+		cursorLevel = initialLevel;
+	} else {
+		--it;
+		cursorRun = (it - index.begin()) * INDEX_STEP;
+		cursorPos = it->pos;
+		cursorLevel = it->level;
+	}
+}
+
+size_t CassetteEdges::getMemoryUsage() const
+{
+	return runs.capacity() * sizeof(uint16_t) +
+	       index.capacity() * sizeof(IndexEntry);
+}
+
+} // namespace openmsx
@@ -0,0 +1,112 @@
+#ifndef CASSETTEEDGES_HH
+#define CASSETTEEDGES_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace openmsx {
+
+/** The sign of a tape signal, stored as the positions where it changes.
+  *
+  * The MSX only looks at the sign of the cassette input (see the comparator
+  * in CassettePort). So for the MSX, the list of edges contains everything
+  * there is to know about a recording, in a fraction of the memory of the
+  * samples: a typical tape signal has an edge every 10 to 40 samples, each
+  * edge takes 2 bytes.
+  *
+  * Positions are expressed in sub-samples: 1/SUB_SAMPLES of a sample. The
+  * signal between two samples is linearly interpolated (see getLevel()), so
+  * edges can lie in between two samples.
+  *
+  * Edges are stored as run lengths, plus an index with the absolute position
+  * of every INDEX_STEP-th run. Lookups remember the last position, so
+  * (mostly) increasing positions are handled in constant time.
+  */
+class CassetteEdges
+{
+public:
+	static const unsigned SUB_BITS = 4;
+	static const unsigned SUB_SAMPLES = 1 << SUB_BITS;
+
+	/** The level of the signal at sub-sample 'frac' between samples 's0'
+	  * and 's1' (the MSX sees 'true' for samples >= 0).
+	  */
+	static bool getLevel(int s0, int s1, unsigned frac) {
+		return (int(SUB_SAMPLES - frac) * s0 + int(frac) * s1) >= 0;
+	}
+
+	/** Builds an edge list from samples, see below. */
+	class Builder;
+
+	/** Build the edge list of 'num' samples. Samples beyond the end are
+	  * 0. 'abort' is regularly checked, when it's set the result is
+	  * incomplete (and shouldn't be used).
+	  */
+	static CassetteEdges fromSamples(const int16_t* samples, size_t num,
+	                                 const std::atomic<bool>& abort);
+
+	/** Create an empty list, the level is 'initialLevel' everywhere. */
+	explicit CassetteEdges(bool initialLevel = true);
+
+	/** Add an edge: from position 'pos' on, the level is inverted.
+	  * Positions must be strictly increasing, and non-zero.
+	  */
+	void addEdge(uint64_t pos);
+
+	/** Get the level at the given position (in sub-samples). */
+	bool getLevel(uint64_t pos);
+
+	size_t getNbEdges() const { return nbEdges; }
+	/** Approximate memory usage in bytes. */
+	size_t getMemoryUsage() const;
+
+private:
+	// A run with this length doesn't end in an edge, it only advances the
+	// position (for runs that don't fit in 16 bits).
+	static const uint16_t CONTINUE = 0xFFFF;
+	static const unsigned INDEX_STEP = 1024;
+	struct IndexEntry {
+		uint64_t pos; // position at the start of run 'i * INDEX_STEP'
+		bool level;   // level at that position
+	};
+	void pushRun(uint16_t run);
+	void seek(uint64_t pos);
+
+	std::vector<uint16_t> runs;
+	std::vector<IndexEntry> index;
+	uint64_t endPos; // end of the last run
+	size_t nbEdges;
+	bool initialLevel;
+	bool endLevel;   // level after the last run
+
+	// lookup cursor: run 'cursorRun' starts at 'cursorPos'
+	size_t cursorRun;
+	uint64_t cursorPos;
+	bool cursorLevel;
+};
+
+/** Builds an edge list from samples, that are passed in one or more parts.
+  * The result is the same as for fromSamples() on all samples at once.
+  */
+class CassetteEdges::Builder
+{
+public:
+	Builder();
+	void addSamples(const int16_t* samples, size_t num);
+	/** Samples beyond the end are 0. */
+	CassetteEdges finish();
+
+private:
+	void addSegment(int s0, int s1);
+
+	CassetteEdges edges;
+	size_t count; // number of samples so far
+	int prev;     // the last sample
+	bool level;   // the level after the last edge
+};
+
+} // namespace openmsx
+
+#endif
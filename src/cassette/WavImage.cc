@@ -1,67 +1,66 @@
 #include "WavImage.hh"
-#include "LocalFileReference.hh"
 #include "File.hh"
 #include "FilePool.hh"
-#include "Math.hh"
 #include "xrange.hh"
+#include <vector>
 
 namespace openmsx {
 
-// DC-removal filter
-//   y(n) = x(n) - x(n-1) + R * y(n-1)
-// see comments in MSXMixer.cc for more details
-static void filter(float sampleFreq, int16_t* begin, int16_t* end)
+// Note: type detection not implemented yet for WAV images
+WavImage::WavImage(const Filename& filename, FilePool& filePool)
+	: stream(filename)
+	, clock(EmuTime::zero)
+	, edgesReady(false)
+	, abortEdges(false)
 {
-	const float cuttOffFreq = 800.0f; // trial-and-error
-	float R = 1.0f - ((float(2 * M_PI) * cuttOffFreq) / sampleFreq);
+	File file(filename);
+	setSha1Sum(filePool.getSha1Sum(file));
+	clock.setFreq(stream.getFreq());
 
-	float t0 = 0.0f;
-	for (auto it = begin; it != end; ++it) {
-		float t1 = R * t0 + *it;
-		*it = Math::clipIntToShort(t1 - t0);
-		t0 = t1;
-	}
+	edgeThread = std::thread([this]() { buildEdges(); });
 }
 
-// Note: type detection not implemented yet for WAV images
-WavImage::WavImage(const Filename& filename, FilePool& filePool)
-	: clock(EmuTime::zero)
+WavImage::~WavImage()
 {
-	LocalFileReference localFile;
-	{
-		// File object must be destroyed before localFile is actually
-		// used by an external API (see comments in LocalFileReference
-		// for details).
-		File file(filename);
-		setSha1Sum(filePool.getSha1Sum(file));
-		localFile = LocalFileReference(file);
-	}
-	wav = WavData(localFile.getFilename(), 16, 0);
-	clock.setFreq(wav.getFreq());
-
-	auto* buf = static_cast<int16_t*>(wav.getData());
-	auto* end = buf + wav.getSize();
-	filter(wav.getFreq(), buf, end);
+	abortEdges = true;
+	edgeThread.join();
 }
 
-int16_t WavImage::getSample(unsigned pos) const
+void WavImage::buildEdges()
 {
-	if (pos < wav.getSize()) {
-		auto* buf = static_cast<const int16_t*>(wav.getData());
-		return buf[pos];
+	// One pass over the whole file, one block at a time.
+	std::vector<int16_t> buf(WavStream::BLOCK_SIZE);
+	CassetteEdges::Builder builder;
+	for (auto b : xrange(stream.getNbBlocks())) {
+		if (abortEdges) return;
+		size_t num = stream.convertBlock(b, buf.data());
+		builder.addSamples(buf.data(), num);
 	}
-	return 0;
+	edges = builder.finish();
+	edgesReady = true;
 }
 
 int16_t WavImage::getSampleAt(EmuTime::param time)
 {
-	return getSample(clock.getTicksTill(time));
+	// position in sub-samples
+	uint64_t pos = (time - EmuTime::zero).length() * CassetteEdges::SUB_SAMPLES /
+	               clock.getPeriod().length();
+	if (edgesReady) {
+		return edges.getLevel(pos) ? 32767 : -32768;
+	}
+	auto sample = size_t(pos >> CassetteEdges::SUB_BITS);
+	auto frac = unsigned(pos & (CassetteEdges::SUB_SAMPLES - 1));
+	int s0 = stream.getSample(sample);
+	int s1 = stream.getSample(sample + 1);
+	// (rounds down, so the sign is the same as in CassetteEdges::getLevel())
+	int v = int(CassetteEdges::SUB_SAMPLES - frac) * s0 + int(frac) * s1;
+	return int16_t(v >> CassetteEdges::SUB_BITS);
 }
 
 EmuTime WavImage::getEndTime() const
 {
 	DynamicClock clk(clock);
-	clk += wav.getSize();
+	clk += stream.getSize();
 	return clk.getTime();
 }
 
@@ -72,10 +71,8 @@ unsigned WavImage::getFrequency() const
 
 void WavImage::fillBuffer(unsigned pos, int** bufs, unsigned num) const
 {
-	if (pos < wav.getSize()) {
-		for (auto i : xrange(num)) {
-			bufs[0][i] = getSample(pos + i);
-		}
+	if (pos < stream.getSize()) {
+		stream.getSamples(pos, num, bufs[0]);
 	} else {
 		bufs[0] = nullptr;
 	}
@@ -2,9 +2,12 @@
 #define WAVIMAGE_HH
 
 #include "CassetteImage.hh"
-#include "WavData.hh"
+#include "CassetteEdges.hh"
+#include "WavStream.hh"
 #include "DynamicClock.hh"
+#include <atomic>
 #include <cstdint>
+#include <thread>
 
 namespace openmsx {
 
@@ -15,6 +18,7 @@ class WavImage final : public CassetteImage
 {
 public:
 	explicit WavImage(const Filename& filename, FilePool& filePool);
+	~WavImage();
 
 	int16_t getSampleAt(EmuTime::param time) override;
 	EmuTime getEndTime() const override;
@@ -22,10 +26,18 @@ public:
 	void fillBuffer(unsigned pos, int** bufs, unsigned num) const override;
 
 private:
-	int16_t getSample(unsigned pos) const;
+	void buildEdges();
 
-	WavData wav;
+	WavStream stream;
 	DynamicClock clock;
+
+	// The edge list is built by a background thread. Until it's ready,
+	// getSampleAt() interpolates the samples directly (with the same
+	// result, so emulation doesn't depend on when the thread finishes).
+	CassetteEdges edges;
+	std::atomic<bool> edgesReady;
+	std::atomic<bool> abortEdges;
+	std::thread edgeThread;
 };
 
 } // namespace openmsx
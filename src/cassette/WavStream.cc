@@ -0,0 +1,285 @@
+#include "WavStream.hh"
+#include "FileException.hh"
+#include "Filename.hh"
+#include "LocalFileReference.hh"
+#include "MSXException.hh"
+#include "Math.hh"
+#include "endian.hh"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace openmsx {
+
+const size_t WavStream::BLOCK_SIZE;
+const size_t WavStream::FILTER_WARMUP;
+const unsigned WavStream::NUM_BLOCKS;
+const unsigned WavStream::PREFETCH;
+
+static const size_t NONE = size_t(-1);
+
+WavStream::WavStream(const Filename& filename)
+	: data(nullptr)
+	, nbSamples(0)
+	, freq(0)
+	, channels(1)
+	, bytesPerSample(2)
+	, format(INT)
+	, streaming(false)
+	, useCounter(0)
+	, prefetchFirst(0)
+	, exitThread(false)
+{
+	file = File(filename);
+	try {
+		size_t size;
+		auto* buf = file.mmap(size);
+		streaming = buf && parseHeader(buf, size);
+	} catch (FileException&) {
+		// e.g. not enough address space, let SDL load it
+	}
+	if (!streaming) {
+		file.close();
+		LocalFileReference localFile(filename);
+		wav = WavData(localFile.getFilename(), 16, 0);
+		data = static_cast<const uint8_t*>(wav.getData());
+		nbSamples = wav.getSize();
+		freq = wav.getFreq();
+		channels = 1;
+		bytesPerSample = 2;
+		format = INT;
+	}
+
+	// DC-removal filter
+	//   y(n) = x(n) - x(n-1) + R * y(n-1)
+	// see comments in MSXMixer.cc for more details
+	const float cutOffFreq = 800.0f; // trial-and-error
+	filterR = 1.0f - ((float(2 * M_PI) * cutOffFreq) / freq);
+
+	for (auto& b : blocks) {
+		b.samples.resize(BLOCK_SIZE);
+		b.block = NONE;
+		b.lastUse = 0;
+		b.converting = false;
+	}
+	thread = std::thread([this]() { run(); });
+}
+
+WavStream::~WavStream()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		exitThread = true;
+	}
+	prefetchWanted.notify_one();
+	thread.join();
+}
+
+// Returns false for files that are not supported here (then SDL gets a try).
+bool WavStream::parseHeader(const uint8_t* buf, size_t size)
+{
+	if ((size < 12) || (memcmp(buf, "RIFF", 4) != 0) ||
+	    (memcmp(buf + 8, "WAVE", 4) != 0)) {
+		return false;
+	}
+	bool haveFmt = false;
+	size_t pos = 12;
+	while ((pos + 8) <= size) {
+		const uint8_t* chunk = buf + pos;
+		uint32_t len = Endian::read_UA_L32(chunk + 4);
+		if (memcmp(chunk, "fmt ", 4) == 0) {
+			if ((len < 16) || ((pos + 8 + len) > size)) return false;
+			unsigned tag = Endian::read_UA_L16(chunk + 8);
+			channels     = Endian::read_UA_L16(chunk + 10);
+			freq         = Endian::read_UA_L32(chunk + 12);
+			unsigned blockAlign = Endian::read_UA_L16(chunk + 20);
+			unsigned bits       = Endian::read_UA_L16(chunk + 22);
+			if ((tag == 0xFFFE) && (len >= 40)) {
+				// WAVE_FORMAT_EXTENSIBLE: first 2 bytes of
+				// the sub-format GUID
+				tag = Endian::read_UA_L16(chunk + 8 + 24);
+			}
+			if ((tag == 1) &&
+			    ((bits == 8) || (bits == 16) || (bits == 24) || (bits == 32))) {
+				format = INT;
+			} else if ((tag == 3) && (bits == 32)) {
+				format = FLOAT;
+			} else {
+				return false;
+			}
+			bytesPerSample = bits / 8;
+			if ((channels == 0) || (freq == 0) ||
+			    (blockAlign != (channels * bytesPerSample))) {
+				return false;
+			}
+			haveFmt = true;
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			if (!haveFmt) return false;
+			// (a truncated file has less data than announced)
+			size_t avail = std::min<size_t>(len, size - (pos + 8));
+			data = chunk + 8;
+			nbSamples = avail / (channels * bytesPerSample);
+			return true;
+		}
+		pos += 8 + size_t(len) + (len & 1);
+	}
+	return false;
+}
+
+// Returns one (mono) frame as a 16-bit value.
+int WavStream::getRaw(const uint8_t* frame) const
+{
+	int sum = 0;
+	for (unsigned ch = 0; ch < channels; ++ch) {
+		const uint8_t* p = frame + ch * bytesPerSample;
+		if (format == FLOAT) {
+			uint32_t u = Endian::read_UA_L32(p);
+			float f;
+			memcpy(&f, &u, sizeof(f));
+			if (std::isnan(f)) f = 0.0f; // int(NaN) is undefined
+			f = std::min(std::max(f, -1.0f), 1.0f);
+			sum += Math::clipIntToShort(int(f * 32768.0f));
+		} else {
+			switch (bytesPerSample) {
+			case 1: sum += (int(p[0]) - 128) * 256; break;
+			case 2: sum += int16_t(Endian::read_UA_L16(p)); break;
+			// only use the most significant 16 bits
+			case 3: sum += int16_t(Endian::read_UA_L16(p + 1)); break;
+			case 4: sum += int16_t(Endian::read_UA_L16(p + 2)); break;
+			}
+		}
+	}
+	return sum / int(channels);
+}
+
+size_t WavStream::convertBlock(size_t block, int16_t* out) const
+{
+	size_t first = block * BLOCK_SIZE;
+	assert(first < nbSamples);
+	size_t num = std::min(BLOCK_SIZE, nbSamples - first);
+	size_t start = (first >= FILTER_WARMUP) ? (first - FILTER_WARMUP) : 0;
+	size_t frameSize = channels * bytesPerSample;
+
+	float t0 = 0.0f;
+	for (size_t i = start; i < (first + num); ++i) {
+		float t1 = filterR * t0 + getRaw(data + i * frameSize);
+		if (i >= first) {
+			out[i - first] = Math::clipIntToShort(t1 - t0);
+		}
+		t0 = t1;
+	}
+	return num;
+}
+
+int16_t WavStream::getSample(size_t pos) const
+{
+	if (pos >= nbSamples) return 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	return getBlock(lock, pos / BLOCK_SIZE).samples[pos % BLOCK_SIZE];
+}
+
+void WavStream::getSamples(size_t pos, size_t num, int* out) const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (num) {
+		if (pos >= nbSamples) {
+			std::fill_n(out, num, 0);
+			return;
+		}
+		size_t offset = pos % BLOCK_SIZE;
+		size_t n = std::min({num, BLOCK_SIZE - offset, nbSamples - pos});
+		auto& b = getBlock(lock, pos / BLOCK_SIZE);
+		std::copy_n(&b.samples[offset], n, out);
+		pos += n;
+		out += n;
+		num -= n;
+	}
+}
+
+WavStream::Block* WavStream::findBlock(size_t block) const
+{
+	for (auto& b : blocks) {
+		if (b.block == block) return &b;
+	}
+	return nullptr;
+}
+
+// Least recently used block, preferably not one in the range [first, last).
+WavStream::Block& WavStream::getFreeBlock(size_t first, size_t last) const
+{
+	Block* result = nullptr;
+	Block* fallback = nullptr;
+	for (auto& b : blocks) {
+		if (b.converting) continue;
+		if (!fallback || (b.lastUse < fallback->lastUse)) fallback = &b;
+		if ((first <= b.block) && (b.block < last)) continue;
+		if (!result || (b.lastUse < result->lastUse)) result = &b;
+	}
+	if (!result) result = fallback;
+	assert(result); // at most one block is being converted
+	return *result;
+}
+
+// Called from the main thread.
+const WavStream::Block& WavStream::getBlock(
+	std::unique_lock<std::mutex>& lock, size_t block) const
+{
+	Block* result;
+	while (true) {
+		result = findBlock(block);
+		if (result && result->converting) {
+			// The background thread is converting it right now.
+			blockConverted.wait(lock);
+			continue;
+		}
+		if (!result) {
+			result = &getFreeBlock(block, block + 1 + PREFETCH);
+			result->block = block;
+			convertBlock(block, result->samples.data());
+		}
+		break;
+	}
+	result->lastUse = ++useCounter;
+
+	if (prefetchFirst != (block + 1)) {
+		prefetchFirst = block + 1;
+		prefetchWanted.notify_one();
+	}
+	return *result;
+}
+
+void WavStream::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!exitThread) {
+		size_t end = std::min<size_t>(prefetchFirst + PREFETCH, getNbBlocks());
+		size_t todo = NONE;
+		for (size_t b = prefetchFirst; b < end; ++b) {
+			if (!findBlock(b)) {
+				todo = b;
+				break;
+			}
+		}
+		if (todo == NONE) {
+			prefetchWanted.wait(lock);
+			continue;
+		}
+
+		// Don't evict the block the main thread is using.
+		size_t keep = prefetchFirst ? (prefetchFirst - 1) : 0;
+		auto& b = getFreeBlock(keep, end);
+		b.block = todo;
+		b.converting = true;
+		b.lastUse = ++useCounter;
+
+		lock.unlock();
+		convertBlock(todo, b.samples.data());
+		lock.lock();
+
+		b.converting = false;
+		blockConverted.notify_all();
+	}
+}
+
+} // namespace openmsx
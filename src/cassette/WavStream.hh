@@ -0,0 +1,112 @@
+#ifndef WAVSTREAM_HH
+#define WAVSTREAM_HH
+
+#include "File.hh"
+#include "WavData.hh"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openmsx {
+
+class Filename;
+
+/** Read access to the samples of a .wav file, without loading (and
+  * converting) the whole file in memory.
+  *
+  * PCM files (8, 16, 24 or 32 bit integer, or 32 bit float, any number of
+  * channels) are memory mapped. Their samples are converted to 16-bit mono
+  * (with DC removal, see below) in blocks of BLOCK_SIZE samples, only when
+  * they are needed. Only the last few blocks are kept. After each access, a
+  * background thread converts the following blocks in advance, so that page
+  * faults on (slow) storage don't stall the emulation.
+  *
+  * Other formats (e.g. ADPCM) are still completely converted by SDL when the
+  * file is loaded (see WavData), and then handled the same way.
+  *
+  * The DC-removal filter is restarted for each block, FILTER_WARMUP samples
+  * before the start of the block. Its response dies out much faster than
+  * that, so the result is practically the same as when filtering the whole
+  * file in one go. But this way each sample only depends on nearby samples:
+  * any block can be converted on its own, and the result doesn't depend on
+  * the order in which blocks are accessed.
+  */
+class WavStream
+{
+public:
+	static const size_t BLOCK_SIZE = 8192;
+	static const size_t FILTER_WARMUP = 1024;
+	static const unsigned NUM_BLOCKS = 8;
+	static const unsigned PREFETCH = 3;
+
+	/** Throws MSXException if the file isn't a valid .wav file. */
+	explicit WavStream(const Filename& filename);
+	~WavStream();
+
+	unsigned getFreq() const { return freq; }
+	/** Number of samples (per channel). */
+	size_t getSize() const { return nbSamples; }
+	size_t getNbBlocks() const {
+		return (nbSamples + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+	/** Get a single sample, 0 beyond the end. */
+	int16_t getSample(size_t pos) const;
+	/** Get 'num' consecutive samples, 0 beyond the end. */
+	void getSamples(size_t pos, size_t num, int* out) const;
+
+	/** Convert a single block, without caching. Returns the number of
+	  * samples in that block (less than BLOCK_SIZE for the last block).
+	  * Can be called from any thread.
+	  */
+	size_t convertBlock(size_t block, int16_t* out) const;
+
+	/** Is the file memory mapped (instead of converted by SDL)? */
+	bool isStreaming() const { return streaming; }
+
+private:
+	enum Format { INT, FLOAT };
+	bool parseHeader(const uint8_t* buf, size_t size);
+	int getRaw(const uint8_t* frame) const;
+
+	struct Block {
+		std::vector<int16_t> samples;
+		size_t block;     // NONE if unused
+		uint64_t lastUse;
+		bool converting;  // by the background thread
+	};
+	const Block& getBlock(std::unique_lock<std::mutex>& lock,
+	                      size_t block) const;
+	Block* findBlock(size_t block) const;
+	Block& getFreeBlock(size_t first, size_t last) const;
+
+	// background thread
+	void run();
+
+	File file;    // only used for PCM files
+	WavData wav;  // only used for other files
+	const uint8_t* data; // the samples (either from 'file' or 'wav')
+	size_t nbSamples;
+	unsigned freq;
+	unsigned channels;
+	unsigned bytesPerSample; // for one channel
+	Format format;
+	float filterR;
+	bool streaming;
+
+	// Converted blocks, LRU, shared with the background thread.
+	mutable std::mutex mutex;
+	mutable std::condition_variable prefetchWanted;
+	mutable std::condition_variable blockConverted;
+	mutable Block blocks[NUM_BLOCKS];
+	mutable uint64_t useCounter;
+	mutable size_t prefetchFirst; // prefetch blocks [first, first + PREFETCH)
+	bool exitThread;
+	std::thread thread;
+};
+
+} // namespace openmsx
+
+#endif
@@ -88,6 +88,7 @@ public:
 	SettingsConfig& getSettingsConfig() { return settingsConfig; }
 	SettingsManager& getSettingsManager() { return settingsConfig.getSettingsManager(); }
 	CliConnection* getConnection() const { return connection; }
+	Reactor& getReactor() const { return reactor; }
 
 private:
 	void split(string_view str,
@@ -9,6 +9,7 @@
 #include "InterpreterOutput.hh"
 #include "MSXCPUInterface.hh"
 #include "FileOperations.hh"
+#include "Profiler.hh"
 #include "array_ref.hh"
 #include "stl.hh"
 #include "unreachable.hh"
@@ -168,6 +169,7 @@ int Interpreter::commandProc(ClientData clientData, Tcl_Interp* interp,
 					}
 				}
 			}
+			ProfileScope scope("Tcl: ", command.getName());
 			command.execute(tokens, result);
 		} catch (MSXException& e) {
 			result.setString(e.getMessage());
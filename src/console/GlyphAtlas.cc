@@ -0,0 +1,158 @@
+#include "GlyphAtlas.hh"
+#include "MSXException.hh"
+#include "utf8_checked.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace openmsx {
+
+GlyphAtlas::GlyphAtlas(unsigned lineHeight_, Rasterizer rasterizer_)
+	: rasterizer(std::move(rasterizer_))
+	, atlasHeight(0)
+	, atlasCapacity(0)
+	, shelfX(0)
+	, shelfY(0)
+	, shelfHeight(0)
+	, lineHeight(lineHeight_)
+{
+	std::fill(std::begin(ascii), std::end(ascii), -1);
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(uint32_t codePoint)
+{
+	unsigned idx;
+	if (codePoint < 128) {
+		int& a = ascii[codePoint];
+		if (a < 0) a = addGlyph(codePoint);
+		idx = a;
+	} else {
+		auto it = nonAscii.find(codePoint);
+		if (it != nonAscii.end()) {
+			idx = it->second;
+		} else {
+			idx = addGlyph(codePoint);
+			nonAscii.emplace(codePoint, idx);
+		}
+	}
+	return glyphs[idx];
+}
+
+unsigned GlyphAtlas::addGlyph(uint32_t codePoint)
+{
+	bitmap.coverage.clear();
+	bitmap.width = bitmap.height = 0;
+	bitmap.left = bitmap.advance = 0;
+	rasterizer(codePoint, bitmap);
+	assert(bitmap.coverage.size() >= size_t(bitmap.width) * bitmap.height);
+
+	// Glyphs wider than the atlas only happen for absurd point sizes,
+	// simply crop those.
+	Glyph glyph;
+	glyph.width  = std::min(bitmap.width, ATLAS_WIDTH);
+	glyph.height = std::min(bitmap.height, lineHeight);
+	glyph.left = bitmap.left;
+	glyph.advance = bitmap.advance;
+
+	// Find a place in the atlas: on the current shelf, or else start a
+	// new shelf below it.
+	if ((shelfX + glyph.width) > ATLAS_WIDTH) {
+		shelfY += shelfHeight;
+		shelfX = 0;
+		shelfHeight = 0;
+	}
+	glyph.x = shelfX;
+	glyph.y = shelfY;
+	shelfX += glyph.width;
+	shelfHeight = std::max(shelfHeight, glyph.height);
+	atlasHeight = std::max(atlasHeight, shelfY + shelfHeight);
+	if (atlasHeight > atlasCapacity) {
+		atlasCapacity = std::max(2 * atlasCapacity, atlasHeight);
+		atlas.resize(size_t(atlasCapacity) * ATLAS_WIDTH);
+	}
+
+	for (unsigned y = 0; y < glyph.height; ++y) {
+		memcpy(&atlas[(glyph.y + y) * ATLAS_WIDTH + glyph.x],
+		       &bitmap.coverage[y * bitmap.width], glyph.width);
+	}
+	glyphs.push_back(glyph);
+	return unsigned(glyphs.size() - 1);
+}
+
+void GlyphAtlas::decode(string_view text)
+{
+	codePoints.clear();
+	try {
+		auto it = text.begin();
+		auto end = text.end();
+		while (it != end) {
+			codePoints.push_back(utf8::next(it, end));
+		}
+	} catch (std::exception&) {
+		throw MSXException("Invalid UTF-8 text");
+	}
+}
+
+// Place the glyphs for 'codePoints' next to each other, starting with the pen
+// at x=0. Returns the final pen position and the horizontal extent of the
+// glyph bitmaps (which may lie left of 0 or right of the final pen).
+unsigned GlyphAtlas::layout(int& minX, int& maxX)
+{
+	lineGlyphs.clear();
+	int pen = 0;
+	minX = 0;
+	maxX = 0;
+	for (auto cp : codePoints) {
+		auto& g = getGlyph(cp);
+		lineGlyphs.push_back(unsigned(&g - glyphs.data()));
+		minX = std::min(minX, pen + g.left);
+		maxX = std::max(maxX, pen + g.left + int(g.width));
+		pen += g.advance;
+	}
+	maxX = std::max(maxX, pen);
+	return pen;
+}
+
+void GlyphAtlas::getSize(string_view text, unsigned& width, unsigned& height)
+{
+	decode(text);
+	int minX, maxX;
+	layout(minX, maxX);
+	width = maxX - minX;
+	height = lineHeight;
+}
+
+void GlyphAtlas::render(string_view text, uint32_t rgb, uint32_t* pixels,
+                        unsigned pitch)
+{
+	decode(text);
+	int minX, maxX;
+	layout(minX, maxX);
+	unsigned width = maxX - minX;
+
+	rgb &= 0x00FFFFFF;
+	for (unsigned y = 0; y < lineHeight; ++y) {
+		std::fill_n(pixels + y * pitch, width, rgb);
+	}
+
+	int pen = -minX;
+	for (auto idx : lineGlyphs) {
+		auto& g = glyphs[idx];
+		int x0 = pen + g.left;
+		assert(x0 >= 0);
+		assert(unsigned(x0) + g.width <= width);
+		for (unsigned y = 0; y < g.height; ++y) {
+			const uint8_t* src = &atlas[(g.y + y) * ATLAS_WIDTH + g.x];
+			uint32_t* dst = pixels + y * pitch + x0;
+			for (unsigned x = 0; x < g.width; ++x) {
+				// Glyphs can overlap (e.g. italic fonts), keep
+				// the maximum coverage.
+				uint32_t a = uint32_t(src[x]) << 24;
+				if (a > (dst[x] & 0xFF000000)) dst[x] = rgb | a;
+			}
+		}
+		pen += g.advance;
+	}
+}
+
+} // namespace openmsx
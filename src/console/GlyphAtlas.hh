@@ -0,0 +1,112 @@
+#ifndef GLYPHATLAS_HH
+#define GLYPHATLAS_HH
+
+#include "MemBuffer.hh"
+#include "hash_map.hh"
+#include "string_view.hh"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace openmsx {
+
+/** Cache of rasterized glyphs for one font (at one point size).
+  *
+  * Rasterizing text with FreeType is relatively expensive, and on-screen
+  * text that is updated every frame (FPS counters, debugger overlays, ...)
+  * would otherwise rasterize the same characters over and over again. This
+  * class rasterizes each glyph only once (as an 8-bit coverage bitmap) and
+  * stores it in an atlas, strings are then composed by copying glyphs out
+  * of that atlas.
+  *
+  * There's no shaping (no ligatures, no kerning, no right-to-left text):
+  * each code point maps to exactly one glyph and glyphs are simply placed
+  * next to each other.
+  *
+  * The glyphs themselves are produced by a rasterizer callback (see
+  * TTFFont), so this class doesn't depend on SDL_ttf.
+  */
+class GlyphAtlas
+{
+public:
+	/** The result of rasterizing a single glyph. */
+	struct Bitmap {
+		std::vector<uint8_t> coverage; // width x height, row by row
+		unsigned width = 0;
+		unsigned height = 0;
+		int left = 0;    // x-offset of the bitmap relative to the pen
+		int advance = 0; // distance between this and the next pen position
+	};
+	using Rasterizer = std::function<void(uint32_t codePoint, Bitmap& bitmap)>;
+
+	struct Glyph {
+		unsigned x, y; // position in the atlas
+		unsigned width, height;
+		int left;
+		int advance;
+	};
+
+	static const unsigned ATLAS_WIDTH = 512;
+
+	/** @param lineHeight Height of a rendered line of text, glyph bitmaps
+	  *                   are cropped to this height.
+	  * @param rasterizer Called (once) for each glyph that's not yet in
+	  *                   the atlas.
+	  */
+	GlyphAtlas(unsigned lineHeight, Rasterizer rasterizer);
+
+	/** Lookup a glyph, rasterizes it on first use. */
+	const Glyph& getGlyph(uint32_t codePoint);
+
+	/** Return the size in pixels of the given single line of text.
+	  * The text must be UTF-8 encoded, throws MSXException if it isn't.
+	  */
+	void getSize(string_view text, unsigned& width, unsigned& height);
+
+	/** Render a single line of text in a 32bpp buffer. The result has
+	  * color 'rgb' (0x00RRGGBB) everywhere and the glyph coverage in the
+	  * upper 8 bits (alpha).
+	  * @param text UTF-8 encoded text, see getSize().
+	  * @param rgb The text color.
+	  * @param pixels The destination, must be at least as big as the size
+	  *               returned by getSize(). The whole area is written.
+	  * @param pitch Distance between two lines in the destination (in
+	  *              pixels, not bytes).
+	  */
+	void render(string_view text, uint32_t rgb, uint32_t* pixels, unsigned pitch);
+
+	unsigned getLineHeight() const { return lineHeight; }
+	unsigned getNumGlyphs() const { return unsigned(glyphs.size()); }
+	/** Height of the used part of the atlas (the width is ATLAS_WIDTH). */
+	unsigned getAtlasHeight() const { return atlasHeight; }
+	const uint8_t* getAtlasPixels() const { return atlas.data(); }
+
+private:
+	void decode(string_view text);
+	unsigned layout(int& minX, int& maxX);
+	unsigned addGlyph(uint32_t codePoint);
+
+	Rasterizer rasterizer;
+	std::vector<Glyph> glyphs;
+	hash_map<uint32_t, unsigned> nonAscii; // code point -> index in 'glyphs'
+	int ascii[128]; // -1 if not yet rasterized
+
+	// The atlas, filled with glyphs row by row ('shelves').
+	MemBuffer<uint8_t> atlas;
+	unsigned atlasHeight;
+	unsigned atlasCapacity; // in lines
+	unsigned shelfX;
+	unsigned shelfY;
+	unsigned shelfHeight;
+
+	const unsigned lineHeight;
+
+	// Scratch buffers, only used during a single getSize() or render().
+	std::vector<uint32_t> codePoints;
+	std::vector<unsigned> lineGlyphs; // glyph index per code point
+	Bitmap bitmap;
+};
+
+} // namespace openmsx
+
+#endif
@@ -1,12 +1,15 @@
 #include "TTFFont.hh"
+#include "GlyphAtlas.hh"
 #include "LocalFileReference.hh"
 #include "MSXException.hh"
 #include "StringOp.hh"
 #include "stl.hh"
+#include "utf8_unchecked.hh"
 #include "xrange.hh"
 #include <SDL_ttf.h>
 #include <algorithm>
 #include <cassert>
+#include <memory>
 #include <vector>
 
 using std::string;
@@ -27,7 +30,7 @@ class TTFFontPool
 {
 public:
 	static TTFFontPool& instance();
-	TTF_Font* get(const string& filename, int ptSize);
+	TTF_Font* get(const string& filename, int ptSize, GlyphAtlas*& atlas);
 	void release(TTF_Font* font);
 
 private:
@@ -50,6 +53,7 @@ private:
 	// crashes between step 3 and 4 the temp file is still left behind.
 	struct FontInfo {
 		LocalFileReference file;
+		std::unique_ptr<GlyphAtlas> atlas;
 		TTF_Font* font;
 		std::string name;
 		int size;
@@ -93,13 +97,58 @@ TTFFontPool& TTFFontPool::instance()
 	return oneInstance;
 }
 
-TTF_Font* TTFFontPool::get(const string& filename, int ptSize)
+// Rasterize a single glyph by rendering a one character string. Compared to
+// TTF_RenderGlyph_Blended() this has the advantage that the bitmap is already
+// positioned (vertically) exactly like it would be in a full string.
+static void rasterizeGlyph(TTF_Font* font, uint32_t codePoint,
+                           GlyphAtlas::Bitmap& bitmap)
+{
+	char text[8];
+	*utf8::unchecked::append(codePoint, text) = '\0';
+	SDL_Color white = { 255, 255, 255, 0 };
+	SDLSurfacePtr surface(TTF_RenderUTF8_Blended(font, text, white));
+	if (!surface) return; // e.g. no glyph for this code point: empty
+
+	int minx, advance;
+	if ((codePoint <= 0xFFFF) &&
+	    (TTF_GlyphMetrics(font, Uint16(codePoint), &minx, nullptr,
+	                      nullptr, nullptr, &advance) == 0)) {
+		// A glyph that extends left of the pen is shifted right in
+		// the surface.
+		bitmap.left = std::min(minx, 0);
+		bitmap.advance = advance;
+	} else {
+		bitmap.left = 0;
+		bitmap.advance = surface->w;
+	}
+
+	// The surface is 32bpp RGBA, only keep the alpha channel.
+	SDL_Surface* s = surface.get();
+	assert(s->format->BytesPerPixel == 4);
+	bitmap.width  = s->w;
+	bitmap.height = s->h;
+	bitmap.coverage.resize(size_t(s->w) * s->h);
+	if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+	for (auto y : xrange(s->h)) {
+		auto* line = reinterpret_cast<const Uint32*>(
+			static_cast<const Uint8*>(s->pixels) + y * s->pitch);
+		for (auto x : xrange(s->w)) {
+			bitmap.coverage[y * s->w + x] =
+				(line[x] & s->format->Amask) >> s->format->Ashift;
+		}
+	}
+	if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
+}
+
+TTF_Font* TTFFontPool::get(const string& filename, int ptSize,
+                           GlyphAtlas*& atlas)
 {
 	auto it = find_if(begin(pool), end(pool),
 		[&](const FontInfo& i) {
 			return (i.name == filename) && (i.size == ptSize); });
 	if (it != end(pool)) {
 		++it->count;
+		atlas = it->atlas.get();
 		return it->font;
 	}
 
@@ -110,6 +159,12 @@ TTF_Font* TTFFontPool::get(const string& filename, int ptSize)
 	if (!result) {
 		throw MSXException(TTF_GetError());
 	}
+	info.atlas = std::make_unique<GlyphAtlas>(
+		TTF_FontHeight(result),
+		[result](uint32_t codePoint, GlyphAtlas::Bitmap& bitmap) {
+			rasterizeGlyph(result, codePoint, bitmap);
+		});
+	atlas = info.atlas.get();
 	info.font = result;
 	info.name = filename;
 	info.size = ptSize;
@@ -134,7 +189,7 @@ void TTFFontPool::release(TTF_Font* font)
 
 TTFFont::TTFFont(const std::string& filename, int ptSize)
 {
-	font = TTFFontPool::instance().get(filename, ptSize);
+	font = TTFFontPool::instance().get(filename, ptSize, atlas);
 }
 
 TTFFont::~TTFFont()
@@ -145,8 +200,6 @@ TTFFont::~TTFFont()
 
 SDLSurfacePtr TTFFont::render(std::string text, byte r, byte g, byte b) const
 {
-	SDL_Color color = { r, g, b, 0 };
-
 	// Optimization: remove trailing empty lines
 	StringOp::trimRight(text, " \n");
 	if (text.empty()) return SDLSurfacePtr(nullptr);
@@ -155,25 +208,12 @@ SDLSurfacePtr TTFFont::render(std::string text, byte r, byte g, byte b) const
 	auto lines = StringOp::split(text, '\n');
 	assert(!lines.empty());
 
-	if (lines.size() == 1) {
-		// Special case for a single line: we can avoid the
-		// copy to an extra SDL_Surface
-		assert(!text.empty());
-		SDLSurfacePtr surface(
-			TTF_RenderUTF8_Blended(static_cast<TTF_Font*>(font),
-			                       text.c_str(), color));
-		if (!surface) {
-			throw MSXException(TTF_GetError());
-		}
-		return surface;
-	}
-
 	// Determine maximum width and lineHeight
 	unsigned width = 0;
 	unsigned lineHeight = 0; // initialize to avoid warning
 	for (auto& s : lines) {
 		unsigned w;
-		getSize(s.str(), w, lineHeight);
+		atlas->getSize(s, w, lineHeight);
 		width = std::max(width, w);
 	}
 	// There might be extra space between two successive lines
@@ -182,36 +222,27 @@ SDLSurfacePtr TTFFont::render(std::string text, byte r, byte g, byte b) const
 	// We assume that height is the same for all lines.
 	// For the last line we don't include spacing between two lines.
 	auto height = unsigned((lines.size() - 1) * lineSkip + lineHeight);
+	if (width == 0) return SDLSurfacePtr(nullptr);
 
 	// Create destination surface (initial surface is fully transparent)
 	SDLSurfacePtr destination(SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
 			32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000));
 	if (!destination) {
-		throw MSXException("Couldn't allocate surface for multiline text.");
+		throw MSXException("Couldn't allocate surface for text.");
 	}
 
-	// Actually render the text:
+	// Actually render the text, compose each line from the glyph atlas.
+	// (On lines that are less wide than the surface, the remaining
+	// pixels stay fully transparent.)
+	uint32_t rgb = (r << 16) | (g << 8) | (b << 0);
+	SDL_Surface* dst = destination.get();
+	if (SDL_MUSTLOCK(dst)) SDL_LockSurface(dst);
 	for (auto i : xrange(lines.size())) {
-		// Render single line
-		if (lines[i].empty()) {
-			// SDL_TTF gives an error on empty lines, but we can
-			// simply skip such lines
-			continue;
-		}
-		SDLSurfacePtr line(TTF_RenderUTF8_Blended(
-			static_cast<TTF_Font*>(font),
-			lines[i].str().c_str(), color));
-		if (!line) {
-			throw MSXException(TTF_GetError());
-		}
-
-		// Copy line to destination surface
-		SDL_Rect rect;
-		rect.x = 0;
-		rect.y = Sint16(i * lineSkip);
-		SDL_SetAlpha(line.get(), 0, 0); // no blending during copy
-		SDL_BlitSurface(line.get(), nullptr, destination.get(), &rect);
+		auto* pixels = reinterpret_cast<uint32_t*>(
+			static_cast<Uint8*>(dst->pixels) + i * lineSkip * dst->pitch);
+		atlas->render(lines[i], rgb, pixels, dst->pitch / 4);
 	}
+	if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
 	return destination;
 }
 
@@ -241,11 +272,8 @@ unsigned TTFFont::getWidth() const
 void TTFFont::getSize(const std::string& text,
                       unsigned& width, unsigned& height) const
 {
-	if (TTF_SizeUTF8(static_cast<TTF_Font*>(font), text.c_str(),
-	                 reinterpret_cast<int*>(&width),
-	                 reinterpret_cast<int*>(&height))) {
-		throw MSXException(TTF_GetError());
-	}
+	// Use the same (atlas based) layout as render().
+	atlas->getSize(text, width, height);
 }
 
 } // namespace openmsx
@@ -8,6 +8,15 @@
 
 namespace openmsx {
 
+class GlyphAtlas;
+
+/** A TrueType font at a specific point size.
+  *
+  * Font objects are shared: all TTFFont objects for the same file and size
+  * use the same underlying SDL_ttf font and the same GlyphAtlas. Text is
+  * rendered by composing glyphs from that atlas, so each glyph is only
+  * rasterized once.
+  */
 class TTFFont
 {
 public:
@@ -20,7 +29,7 @@ public:
 	  *  - destruct the object
 	  * post-condition: empty()
 	  */
-	TTFFont() : font(nullptr) {}
+	TTFFont() : font(nullptr), atlas(nullptr) {}
 
 	/** Construct new TTFFont object.
 	  * @param filename Filename of font (.fft file, possibly (g)zipped).
@@ -31,15 +40,17 @@ public:
 
 	/** Move construct. */
 	TTFFont(TTFFont&& other) noexcept
-		: font(other.font)
+		: font(other.font), atlas(other.atlas)
 	{
 		other.font = nullptr;
+		other.atlas = nullptr;
 	}
 
 	/** Move assignment. */
 	TTFFont& operator=(TTFFont&& other) noexcept
 	{
 		std::swap(font, other.font);
+		std::swap(atlas, other.atlas);
 		return *this;
 	}
 
@@ -69,11 +80,13 @@ public:
 	unsigned getWidth() const;
 
 	/** Return the size in pixels of the text if it would be rendered.
-	 */
+	  * This only works for a single line of text.
+	  */
 	void getSize(const std::string& text, unsigned& width, unsigned& height) const;
 
 private:
 	void* font;  // TTF_Font*
+	GlyphAtlas* atlas; // owned by the font pool
 };
 
 } // namespace openmsx
@@ -160,6 +160,7 @@
 
 #include "CPUCore.hh"
 #include "MSXCPUInterface.hh"
+#include "CPUTraceWriter.hh"
 #include "Scheduler.hh"
 #include "MSXMotherBoard.hh"
 #include "CliComm.hh"
@@ -328,6 +329,7 @@ template<class T> CPUCore<T>::CPUCore(
 	, NMIStatus(0)
 	, nmiEdge(false)
 	, exitLoop(false)
+	, binaryTrace(nullptr)
 	, tracingEnabled(traceSetting.getBoolean())
 	, isTurboR(motherboard.isTurboR())
 {
@@ -560,10 +562,18 @@ template<class T> void CPUCore<T>::update(const Setting& setting)
 	} else if (&setting == &freqValue) {
 		doSetFreq();
 	} else if (&setting == &traceSetting) {
-		tracingEnabled = traceSetting.getBoolean();
+		tracingEnabled = traceSetting.getBoolean() || binaryTrace;
 	}
 }
 
+template<class T> void CPUCore<T>::setBinaryTrace(CPUTraceWriter* writer)
+{
+	binaryTrace = writer;
+	tracingEnabled = traceSetting.getBoolean() || binaryTrace;
+	// switch between the fast and the tracing cpu loop
+	exitCPULoopSync();
+}
+
 template<class T> void CPUCore<T>::setFreq(unsigned freq_)
 {
 	freq = freq_;
@@ -2472,6 +2482,10 @@ template<class T> inline void CPUCore<T>::cpuTracePost()
 }
 template<class T> void CPUCore<T>::cpuTracePost_slow()
 {
+	if (binaryTrace) {
+		cpuTraceBinary();
+		if (!traceSetting.getBoolean()) return;
+	}
 	byte opbuf[4];
 	string dasmOutput;
 	dasm(*interface, start_pc, opbuf, dasmOutput, T::getTimeFast());
@@ -2486,6 +2500,33 @@ template<class T> void CPUCore<T>::cpuTracePost_slow()
 	     << " SP=" << std::setw(4) << getSP()
 	     << std::endl << std::dec;
 }
+template<class T> void CPUCore<T>::cpuTraceBinary()
+{
+	auto time = T::getTimeFast();
+	int page = start_pc >> 14;
+	CPUTraceRecord rec;
+	rec.time = (time - EmuTime::zero).length();
+	rec.pc = start_pc;
+	for (unsigned i = 0; i < 4; ++i) {
+		rec.opcode[i] = interface->peekMem(start_pc + i, time);
+	}
+	rec.af  = getAF();  rec.bc  = getBC();
+	rec.de  = getDE();  rec.hl  = getHL();
+	rec.af2 = getAF2(); rec.bc2 = getBC2();
+	rec.de2 = getDE2(); rec.hl2 = getHL2();
+	rec.ix  = getIX();  rec.iy  = getIY();
+	rec.sp  = getSP();
+	rec.i   = getI();   rec.r   = getR();
+	byte ps = interface->getPrimarySlot(page);
+	rec.slot = ps | (interface->getSecondarySlot(page) << 2) |
+	           (interface->isExpanded(ps) ? 0x80 : 0);
+	rec.segment = interface->peekIO(0xFC + page, time);
+	if (!binaryTrace->add(rec)) {
+		// Stop condition reached. The writer itself is deleted later
+		// (by MSXCPU), for now it finishes writing the file.
+		setBinaryTrace(nullptr);
+	}
+}
 
 template<class T> void CPUCore<T>::executeSlow()
 {
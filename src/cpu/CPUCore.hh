@@ -17,6 +17,7 @@
 namespace openmsx {
 
 class MSXCPUInterface;
+class CPUTraceWriter;
 class Scheduler;
 class MSXMotherBoard;
 class TclCallback;
@@ -50,6 +51,9 @@ public:
 
 	void setInterface(MSXCPUInterface* interf) { interface = interf; }
 
+	/** Start (non-null) or stop (nullptr) writing a binary trace. */
+	void setBinaryTrace(CPUTraceWriter* writer);
+
 	/**
 	 * Reset the CPU.
 	 */
@@ -156,7 +160,10 @@ private:
 
 	std::atomic<bool> exitLoop;
 
-	/** In sync with traceSetting.getBoolean(). */
+	/** Non-null while a binary trace is being written. */
+	CPUTraceWriter* binaryTrace;
+
+	/** In sync with traceSetting.getBoolean() || binaryTrace. */
 	bool tracingEnabled;
 
 	/** 'normal' Z80 and Z80 in a turboR behave slightly different */
@@ -166,6 +173,7 @@ private:
 	inline void cpuTracePre();
 	inline void cpuTracePost();
 	void cpuTracePost_slow();
+	void cpuTraceBinary();
 
 	inline byte READ_PORT(unsigned port, unsigned cc);
 	inline void WRITE_PORT(unsigned port, byte value, unsigned cc);
@@ -0,0 +1,146 @@
+#include "CPUTraceWriter.hh"
+#include "Dasm.hh"
+#include "FileException.hh"
+#include "strCat.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using std::string;
+
+namespace openmsx {
+
+struct CPUTraceHeader
+{
+	char magic[8]; // "CPUTRACE"
+	uint32_t version;
+	uint32_t recordSize;
+};
+static const char TRACE_MAGIC[8] = { 'C','P','U','T','R','A','C','E' };
+static const uint32_t TRACE_VERSION = 1;
+
+
+CPUTraceWriter::CPUTraceWriter(const string& filename_,
+                               uint64_t maxCount_, unsigned stopAddress_)
+	: filename(filename_)
+	, file(filename, File::TRUNCATE)
+	, ring(new CPUTraceRecord[RING_SIZE])
+	, head(0)
+	, tail(0)
+	, maxCount(maxCount_)
+	, stopAddress(stopAddress_)
+	, finished(false)
+	, error(false)
+	, exitLoop(false)
+{
+	CPUTraceHeader header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.recordSize = sizeof(CPUTraceRecord);
+	file.write(&header, sizeof(header));
+
+	thread = std::thread([this]() { run(); });
+}
+
+CPUTraceWriter::~CPUTraceWriter()
+{
+	exitLoop = true;
+	thread.join();
+}
+
+string CPUTraceWriter::getError() const
+{
+	return error ? errorMessage : string{};
+}
+
+void CPUTraceWriter::run()
+{
+	while (true) {
+		auto t = tail.load(std::memory_order_relaxed);
+		auto h = head.load(std::memory_order_acquire);
+		if (t == h) {
+			if (exitLoop || finished) {
+				// Records may have been added right before.
+				if (head.load(std::memory_order_acquire) == t) break;
+				continue;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		// Write the (contiguous) part up to the end of the ring buffer.
+		auto begin = size_t(t & (RING_SIZE - 1));
+		auto num = std::min<size_t>(h - t, RING_SIZE - begin);
+		if (!error) {
+			try {
+				file.write(&ring[begin], num * sizeof(CPUTraceRecord));
+			} catch (FileException& e) {
+				// Keep on draining the ring buffer, so that the
+				// emulation thread doesn't block.
+				errorMessage = e.getMessage();
+				error = true;
+			}
+		}
+		tail.store(t + num, std::memory_order_release);
+	}
+	file.close();
+}
+
+uint64_t CPUTraceWriter::decode(const string& input, const string& output)
+{
+	File in(input);
+	CPUTraceHeader header;
+	if ((in.getSize() < sizeof(header)) ||
+	    (in.read(&header, sizeof(header)),
+	     memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0)) {
+		throw MSXException("Not a CPU trace file: ", input);
+	}
+	if ((header.version != TRACE_VERSION) ||
+	    (header.recordSize != sizeof(CPUTraceRecord))) {
+		throw MSXException("Unsupported CPU trace file version");
+	}
+	File out(output, File::TRUNCATE);
+
+	static const size_t BLOCK = 4096;
+	std::unique_ptr<CPUTraceRecord[]> records(new CPUTraceRecord[BLOCK]);
+	uint64_t remaining = (in.getSize() - sizeof(header)) / sizeof(CPUTraceRecord);
+	uint64_t count = 0;
+	string text, mnemonic;
+	while (remaining) {
+		auto num = size_t(std::min<uint64_t>(remaining, BLOCK));
+		in.read(records.get(), num * sizeof(CPUTraceRecord));
+		remaining -= num;
+		count += num;
+
+		text.clear();
+		for (size_t n = 0; n < num; ++n) {
+			const auto& rec = records[n];
+			byte buf[4];
+			mnemonic.clear();
+			dasm(rec.opcode, rec.pc, buf, mnemonic);
+			strAppend(text, hex_string<4>(rec.pc), " : ", mnemonic,
+			          " AF=", hex_string<4>(rec.af),
+			          " BC=", hex_string<4>(rec.bc),
+			          " DE=", hex_string<4>(rec.de),
+			          " HL=", hex_string<4>(rec.hl),
+			          " IX=", hex_string<4>(rec.ix),
+			          " IY=", hex_string<4>(rec.iy),
+			          " SP=", hex_string<4>(rec.sp),
+			          " AF'=", hex_string<4>(rec.af2),
+			          " BC'=", hex_string<4>(rec.bc2),
+			          " DE'=", hex_string<4>(rec.de2),
+			          " HL'=", hex_string<4>(rec.hl2),
+			          " I=", hex_string<2>(rec.i),
+			          " R=", hex_string<2>(rec.r),
+			          " slot=", rec.slot & 3);
+			if (rec.slot & 0x80) {
+				strAppend(text, '-', (rec.slot >> 2) & 3);
+			}
+			strAppend(text, " seg=", hex_string<2>(rec.segment),
+			          " time=", rec.time, '\n');
+		}
+		out.write(text.data(), text.size());
+	}
+	return count;
+}
+
+} // namespace openmsx
@@ -0,0 +1,109 @@
+#ifndef CPUTRACEWRITER_HH
+#define CPUTRACEWRITER_HH
+
+#include "File.hh"
+#include "likely.hh"
+#include "openmsx.hh"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace openmsx {
+
+/** The state of the CPU after executing one instruction. Stored as-is (host
+  * byte order) in a binary trace file.
+  */
+struct CPUTraceRecord
+{
+	uint64_t time;    // EmuTime (in EmuTime::MAIN_FREQ ticks)
+	uint16_t pc;      // address of the instruction
+	byte opcode[4];   // (max) 4 bytes starting at 'pc'
+	uint16_t af, bc, de, hl;
+	uint16_t af2, bc2, de2, hl2;
+	uint16_t ix, iy, sp;
+	byte i, r;
+	byte slot;        // bit 0-1: primary slot, bit 2-3: secondary slot,
+	                  // bit 7: slot is expanded (all for the page of 'pc')
+	byte segment;     // memory mapper segment for the page of 'pc'
+};
+static_assert(sizeof(CPUTraceRecord) == 40, "no padding in trace file");
+
+/** Writes CPU trace records to a binary file.
+  *
+  * The emulation thread adds records to a ring buffer, a separate thread
+  * writes them to the file. The ring buffer is lock-free (single producer,
+  * single consumer). When the ring buffer is full the producer waits, no
+  * records are ever dropped.
+  *
+  * The trace stops after a given number of records or when a given address
+  * is executed.
+  */
+class CPUTraceWriter
+{
+public:
+	static const unsigned NO_STOP_ADDRESS = unsigned(-1);
+
+	/** @throws FileException when the file can't be created. */
+	CPUTraceWriter(const std::string& filename,
+	               uint64_t maxCount, unsigned stopAddress);
+	/** Writes all remaining records and closes the file. */
+	~CPUTraceWriter();
+
+	/** Add a record (called from the emulation thread). Returns false
+	  * when the trace is finished (a stop condition is reached), from
+	  * then on records are ignored.
+	  */
+	bool add(const CPUTraceRecord& record)
+	{
+		if (unlikely(finished)) return false;
+		auto h = head.load(std::memory_order_relaxed);
+		while (unlikely((h - tail.load(std::memory_order_acquire)) == RING_SIZE)) {
+			// full, wait for the writer thread
+			std::this_thread::yield();
+		}
+		ring[h & (RING_SIZE - 1)] = record;
+		head.store(h + 1, std::memory_order_release);
+		if (unlikely(((h + 1) == maxCount) || (record.pc == stopAddress))) {
+			finished = true;
+		}
+		return !finished;
+	}
+
+	const std::string& getFilename() const { return filename; }
+	uint64_t getCount() const { return head.load(std::memory_order_relaxed); }
+	bool isFinished() const { return finished; }
+	/** Error message from the writer thread, empty if none (yet). */
+	std::string getError() const;
+
+	/** Convert a binary trace file to text (one line per instruction, in
+	  * the same format as the 'cputrace' setting, extended with EmuTime,
+	  * slot and segment).
+	  * @return The number of decoded records.
+	  * @throws MSXException
+	  */
+	static uint64_t decode(const std::string& input, const std::string& output);
+
+private:
+	void run();
+
+	static const size_t RING_SIZE = 1 << 16; // must be a power of 2
+
+	const std::string filename;
+	File file;
+	std::unique_ptr<CPUTraceRecord[]> ring;
+	std::atomic<uint64_t> head; // next record to add
+	std::atomic<uint64_t> tail; // next record to write
+	const uint64_t maxCount; // 0 for unlimited
+	const unsigned stopAddress;
+	std::atomic<bool> finished;
+	std::atomic<bool> error;
+	std::string errorMessage; // only valid when 'error' is set
+	std::atomic<bool> exitLoop;
+	std::thread thread;
+};
+
+} // namespace openmsx
+
+#endif
@@ -21,6 +21,11 @@ class MSXCPUInterface;
 unsigned dasm(const MSXCPUInterface& interf, word pc, byte buf[4],
               std::string& dest, EmuTime::param time);
 
+/** Same as above, but disassemble the given (max 4) opcode bytes instead of
+  * reading them from memory.
+  */
+unsigned dasm(const byte opcode[4], word pc, byte buf[4], std::string& dest);
+
 } // namespace openmsx
 
 #endif
@@ -4,13 +4,19 @@
 #include "Scheduler.hh"
 #include "IntegerSetting.hh"
 #include "CPUCore.hh"
+#include "CPUTraceWriter.hh"
+#include "CommandException.hh"
+#include "FileContext.hh"
+#include "FileOperations.hh"
 #include "Z80.hh"
 #include "R800.hh"
 #include "TclObject.hh"
 #include "outer.hh"
 #include "serialize.hh"
 #include "unreachable.hh"
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <memory>
 
 using std::string;
@@ -41,6 +47,7 @@ MSXCPU::MSXCPU(MSXMotherBoard& motherboard_)
 			motherboard.getMachineInfoCommand(), "r800_freq", *r800)
 		: nullptr)
 	, debuggable(motherboard_)
+	, traceCommand(motherboard.getCommandController())
 	, reference(EmuTime::zero)
 {
 	z80Active = true; // setActiveCPU(CPU_Z80);
@@ -60,6 +67,7 @@ MSXCPU::MSXCPU(MSXMotherBoard& motherboard_)
 
 MSXCPU::~MSXCPU()
 {
+	setBinaryTrace(nullptr);
 	traceSetting.detach(*this);
 	z80->freqLocked.detach(*this);
 	z80->freqValue.detach(*this);
@@ -216,6 +224,13 @@ void MSXCPU::update(const Setting& setting)
 	exitCPULoopSync();
 }
 
+void MSXCPU::setBinaryTrace(std::unique_ptr<CPUTraceWriter> writer)
+{
+	          z80 ->setBinaryTrace(writer.get());
+	if (r800) r800->setBinaryTrace(writer.get());
+	traceWriter = std::move(writer); // flushes and closes the old trace
+}
+
 // Command
 
 void MSXCPU::disasmCommand(
@@ -285,6 +300,116 @@ string MSXCPU::CPUFreqInfoTopic::help(const vector<string>& /*tokens*/) const
 }
 
 
+// class TraceCommand
+
+MSXCPU::TraceCommand::TraceCommand(CommandController& commandController_)
+	: Command(commandController_, "cpu_trace")
+{
+}
+
+void MSXCPU::TraceCommand::execute(array_ref<TclObject> tokens, TclObject& result)
+{
+	auto& cpu = OUTER(MSXCPU, traceCommand);
+	if (tokens.size() < 2) throw SyntaxError();
+	string_view subCmd = tokens[1].getString();
+	if (subCmd == "start") {
+		if ((tokens.size() < 3) || ((tokens.size() % 2) == 0)) {
+			throw SyntaxError();
+		}
+		uint64_t maxCount = 0;
+		unsigned stopAddress = CPUTraceWriter::NO_STOP_ADDRESS;
+		for (size_t i = 3; i < tokens.size(); i += 2) {
+			string_view option = tokens[i].getString();
+			if (option == "-count") {
+				int count = tokens[i + 1].getInt(getInterpreter());
+				if (count <= 0) {
+					throw CommandException("count must be positive");
+				}
+				maxCount = count;
+			} else if (option == "-stop_address") {
+				stopAddress = tokens[i + 1].getInt(getInterpreter()) & 0xFFFF;
+			} else {
+				throw CommandException("Unknown option: ", option);
+			}
+		}
+		string filename = FileOperations::expandTilde(tokens[2].getString());
+		try {
+			cpu.setBinaryTrace(std::make_unique<CPUTraceWriter>(
+				filename, maxCount, stopAddress));
+		} catch (MSXException& e) {
+			throw CommandException("Couldn't start CPU trace: ",
+			                       e.getMessage());
+		}
+	} else if (subCmd == "stop") {
+		if (tokens.size() != 2) throw SyntaxError();
+		cpu.setBinaryTrace(nullptr);
+	} else if (subCmd == "status") {
+		if (tokens.size() != 2) throw SyntaxError();
+		if (auto* writer = cpu.traceWriter.get()) {
+			result.addListElement(
+				writer->isFinished() ? "finished" : "running");
+			result.addListElement(writer->getFilename());
+			result.addListElement(
+				int(std::min<uint64_t>(writer->getCount(), INT_MAX)));
+			string error = writer->getError();
+			if (!error.empty()) result.addListElement(error);
+		} else {
+			result.setString("stopped");
+		}
+	} else if (subCmd == "decode") {
+		if (tokens.size() != 4) throw SyntaxError();
+		try {
+			auto count = CPUTraceWriter::decode(
+				FileOperations::expandTilde(tokens[2].getString()),
+				FileOperations::expandTilde(tokens[3].getString()));
+			result.setString(strCat("Decoded ", count, " instructions."));
+		} catch (MSXException& e) {
+			throw CommandException(e.getMessage());
+		}
+	} else {
+		throw SyntaxError();
+	}
+}
+
+string MSXCPU::TraceCommand::help(const vector<string>& /*tokens*/) const
+{
+	return "Write a compact binary trace of all executed CPU instructions.\n"
+	       "This is much faster than the 'cputrace' setting. Per instruction\n"
+	       "it stores the address, opcode bytes, all registers, EmuTime,\n"
+	       "the selected slot and the memory mapper segment.\n"
+	       "  cpu_trace start <filename> [-count <n>] [-stop_address <addr>]\n"
+	       "      start tracing (stops a possibly running trace), optionally\n"
+	       "      stop after <n> instructions or after executing the\n"
+	       "      instruction at <addr>\n"
+	       "  cpu_trace stop      stop tracing, close the file\n"
+	       "  cpu_trace status    returns 'stopped' or a list with\n"
+	       "                      running/finished, filename, #instructions\n"
+	       "  cpu_trace decode <binary-file> <text-file>\n"
+	       "      convert a trace file to text, one line per instruction\n"
+	       "To start tracing on a specific event, execute 'cpu_trace start'\n"
+	       "from a breakpoint, watchpoint or condition. For example:\n"
+	       "  debug set_bp 0x4010 {} {cpu_trace start trace.bin -count 1000000}\n";
+}
+
+void MSXCPU::TraceCommand::tabCompletion(vector<string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static const char* const cmds[] = {
+			"start", "stop", "status", "decode"
+		};
+		completeString(tokens, cmds);
+	} else if ((tokens.size() == 3) ||
+	           ((tokens.size() == 4) && (tokens[1] == "decode"))) {
+		completeFileName(tokens, userFileContext());
+	} else if ((tokens.size() >= 4) && (tokens[1] == "start")) {
+		static const char* const options[] = {
+			"-count", "-stop_address"
+		};
+		completeString(tokens, options);
+	}
+}
+
+
 // class Debuggable
 
 static const char* const CPU_REGS_DESC =
@@ -2,6 +2,7 @@
 #define MSXCPU_HH
 
 #include "InfoTopic.hh"
+#include "Command.hh"
 #include "SimpleDebuggable.hh"
 #include "Observer.hh"
 #include "BooleanSetting.hh"
@@ -18,6 +19,7 @@ class MSXMotherBoard;
 class MSXCPUInterface;
 class CPUClock;
 class CPURegs;
+class CPUTraceWriter;
 class Z80TYPE;
 class R800TYPE;
 template <typename T> class CPUCore;
@@ -133,6 +135,8 @@ private:
 	// Observer<Setting>
 	void update(const Setting& setting) override;
 
+	void setBinaryTrace(std::unique_ptr<CPUTraceWriter> writer);
+
 	MSXMotherBoard& motherboard;
 	BooleanSetting traceSetting;
 	TclCallback diHaltCallback;
@@ -165,6 +169,15 @@ private:
 		void write(unsigned address, byte value) override;
 	} debuggable;
 
+	struct TraceCommand final : Command {
+		explicit TraceCommand(CommandController& commandController);
+		void execute(array_ref<TclObject> tokens,
+		             TclObject& result) override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} traceCommand;
+	std::unique_ptr<CPUTraceWriter> traceWriter; // possibly finished already
+
 	EmuTime reference;
 	bool z80Active;
 	bool newZ80Active;
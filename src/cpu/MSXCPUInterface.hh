@@ -195,6 +195,18 @@ public:
 	 */
 	void setPrimarySlots(byte value);
 
+	/** Currently selected primary/secondary slot in the given page. */
+	byte getPrimarySlot  (int page) const { return primarySlotState  [page]; }
+	byte getSecondarySlot(int page) const { return secondarySlotState[page]; }
+
+	/**
+	 * Peek I/O port
+	 * @see MSXDevice::peekIO()
+	 */
+	byte peekIO(word port, EmuTime::param time) const {
+		return IO_In[port & 0xFF]->peekIO(port, time);
+	}
+
 	/**
 	 * Peek memory location
 	 * @see MSXDevice::peekMem()
@@ -14,6 +14,17 @@ public:
 	virtual byte read(unsigned address) = 0;
 	virtual void write(unsigned address, byte value) = 0;
 
+	/** Read 'num' consecutive bytes starting at 'address'. Subclasses
+	  * that have their data in a contiguous block can override this
+	  * with something faster than repeated read() calls.
+	  */
+	virtual void readBlock(unsigned address, byte* output, unsigned num)
+	{
+		for (unsigned i = 0; i < num; ++i) {
+			output[i] = read(address + i);
+		}
+	}
+
 protected:
 	Debuggable() {}
 	~Debuggable() {}
@@ -3,6 +3,8 @@
 #include "ProbeBreakPoint.hh"
 #include "MSXMotherBoard.hh"
 #include "Reactor.hh"
+#include "GlobalCommandController.hh"
+#include "CliConnection.hh"
 #include "MSXCPU.hh"
 #include "MSXCPUInterface.hh"
 #include "BreakPoint.hh"
@@ -235,6 +237,10 @@ void Debugger::Cmd::execute(
 		write(tokens, result);
 	} else if (subCmd == "write_block") {
 		writeBlock(tokens, result);
+	} else if (subCmd == "subscribe") {
+		subscribe(tokens, result);
+	} else if (subCmd == "unsubscribe") {
+		unsubscribe(tokens, result);
 	} else if (subCmd == "size") {
 		size(tokens, result);
 	} else if (subCmd == "desc") {
@@ -330,12 +336,70 @@ void Debugger::Cmd::readBlock(array_ref<TclObject> tokens, TclObject& result)
 	}
 
 	MemBuffer<byte> buf(num);
-	for (unsigned i = 0; i < num; ++i) {
-		buf[i] = device.read(addr + i);
-	}
+	device.readBlock(addr, buf.data(), num);
 	result.setBinary(buf.data(), num);
 }
 
+CliConnection& Debugger::Cmd::getConnection()
+{
+	auto& controller = debugger().motherBoard.getReactor().getGlobalCommandController();
+	if (auto* c = controller.getConnection()) {
+		return *c;
+	}
+	throw CommandException("This command only makes sense when "
+	                       "it's used from an external application.");
+}
+
+void Debugger::Cmd::subscribe(array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() < 5) {
+		throw SyntaxError();
+	}
+	auto& interp = getInterpreter();
+	Debuggable& device = debugger().getDebuggable(tokens[2].getString());
+	unsigned devSize = device.getSize();
+	unsigned addr = tokens[3].getInt(interp);
+	if (addr >= devSize) {
+		throw CommandException("Invalid address");
+	}
+	unsigned num = tokens[4].getInt(interp);
+	if ((num == 0) || (num > (devSize - addr))) {
+		throw CommandException("Invalid size");
+	}
+	unsigned period = 1;
+	bool onChange = false;
+	for (size_t i = 5; i < tokens.size(); ++i) {
+		if (tokens[i] == "-period") {
+			if (++i == tokens.size()) {
+				throw CommandException("Missing argument for -period");
+			}
+			int p = tokens[i].getInt(interp);
+			if (p < 1) {
+				throw CommandException("Period must be at least 1");
+			}
+			period = p;
+		} else if (tokens[i] == "-onchange") {
+			onChange = true;
+		} else {
+			throw SyntaxError();
+		}
+	}
+	result.setInt(getConnection().subscribeDebuggable(
+		tokens[2].getString().str(), addr, num, period, onChange));
+}
+
+void Debugger::Cmd::unsubscribe(array_ref<TclObject> tokens, TclObject& /*result*/)
+{
+	if (tokens.size() != 3) {
+		throw SyntaxError();
+	}
+	if (!getConnection().unsubscribeDebuggable(
+			tokens[2].getInt(getInterpreter()))) {
+		throw CommandException("No such subscription: ",
+		                       tokens[2].getString());
+	}
+}
+
 void Debugger::Cmd::write(array_ref<TclObject> tokens, TclObject& /*result*/)
 {
 	if (tokens.size() != 5) {
@@ -766,6 +830,8 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"    write             write a byte to a debuggable\n"
 		"    read_block        read a whole block at once\n"
 		"    write_block       write a whole block at once\n"
+		"    subscribe         push a block to an external application\n"
+		"    unsubscribe       stop pushing a block\n"
 		"    set_bp            insert a new breakpoint\n"
 		"    remove_bp         remove a certain breakpoint\n"
 		"    list_bp           list the active breakpoints\n"
@@ -825,6 +891,24 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"  The block has a size and an offset in the debuggable. The "
 		"complete block must fit in the debuggable (see the 'size' "
 		"subcommand).\n";
+	static const string subscribeHelp =
+		"debug subscribe <name> <addr> <size> [-period <frames>] [-onchange]\n"
+		"  Only for external applications (see openmsx-control.html). "
+		"At the end of each frame the given block is sent to the "
+		"application that executed this command, as an update of type "
+		"'debug'. The name attribute of the update is the id returned by "
+		"this command, the offset attribute is the address of the first "
+		"byte and the data itself is base64 encoded. This is a lot "
+		"cheaper than polling with the 'read_block' subcommand.\n"
+		"  With -period the block is only sent every <frames> frames. "
+		"With -onchange only the modified part of the block (from the "
+		"first till the last modified byte) is sent, and nothing at all "
+		"when nothing changed. The first update always contains the "
+		"whole block.\n";
+	static const string unsubscribeHelp =
+		"debug unsubscribe <id>\n"
+		"  Remove a subscription that was created with the 'subscribe' "
+		"subcommand.\n";
 	static const string setBpHelp =
 		"debug set_bp <addr> [<cond>] [<cmd>]\n"
 		"  Insert a new breakpoint at given address. When the CPU is about "
@@ -959,6 +1043,10 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		return readBlockHelp;
 	} else if (tokens[1] == "write_block") {
 		return writeBlockHelp;
+	} else if (tokens[1] == "subscribe") {
+		return subscribeHelp;
+	} else if (tokens[1] == "unsubscribe") {
+		return unsubscribeHelp;
 	} else if (tokens[1] == "set_bp") {
 		return setBpHelp;
 	} else if (tokens[1] == "remove_bp") {
@@ -1030,10 +1118,10 @@ void Debugger::Cmd::tabCompletion(vector<string>& tokens) const
 	};
 	static const char* const debuggableArgCmds[] = {
 		"desc", "size", "read", "read_block",
-		"write", "write_block",
+		"write", "write_block", "subscribe",
 	};
 	static const char* const otherCmds[] = {
-		"disasm", "set_bp", "remove_bp", "set_watchpoint",
+		"disasm", "unsubscribe", "set_bp", "remove_bp", "set_watchpoint",
 		"remove_watchpoint", "set_condition", "remove_condition",
 		"probe",
 	};
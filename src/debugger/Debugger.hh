@@ -18,6 +18,7 @@ class Debuggable;
 class ProbeBase;
 class ProbeBreakPoint;
 class MSXCPU;
+class CliConnection;
 
 class Debugger
 {
@@ -80,6 +81,9 @@ private:
 		void readBlock(array_ref<TclObject> tokens, TclObject& result);
 		void write(array_ref<TclObject> tokens, TclObject& result);
 		void writeBlock(array_ref<TclObject> tokens, TclObject& result);
+		void subscribe(array_ref<TclObject> tokens, TclObject& result);
+		void unsubscribe(array_ref<TclObject> tokens, TclObject& result);
+		CliConnection& getConnection();
 		void setBreakPoint(array_ref<TclObject> tokens, TclObject& result);
 		void removeBreakPoint(array_ref<TclObject> tokens, TclObject& result);
 		void listBreakPoints(array_ref<TclObject> tokens, TclObject& result);
@@ -0,0 +1,172 @@
+#include "ProfileCommand.hh"
+#include "Profiler.hh"
+#include "CommandException.hh"
+#include "EventDistributor.hh"
+#include "FinishFrameEvent.hh"
+#include "FileContext.hh"
+#include "FileOperations.hh"
+#include "TclObject.hh"
+#include "checked_cast.hh"
+#include "strCat.hh"
+#include <climits>
+
+using std::string;
+using std::vector;
+
+namespace openmsx {
+
+ProfileCommand::ProfileCommand(CommandController& commandController_,
+                               EventDistributor& eventDistributor_)
+	: Command(commandController_, "profile")
+	, eventDistributor(eventDistributor_)
+{
+	eventDistributor.registerEventListener(OPENMSX_FINISH_FRAME_EVENT, *this);
+}
+
+ProfileCommand::~ProfileCommand()
+{
+	eventDistributor.unregisterEventListener(OPENMSX_FINISH_FRAME_EVENT, *this);
+	Profiler::instance().stop();
+}
+
+void ProfileCommand::execute(array_ref<TclObject> tokens, TclObject& result)
+{
+	auto& profiler = Profiler::instance();
+	if (tokens.size() < 2) throw SyntaxError();
+	string_view subCmd = tokens[1].getString();
+	if (subCmd == "start") {
+		start(tokens);
+	} else if (subCmd == "stop") {
+		if (tokens.size() != 2) throw SyntaxError();
+		profiler.stop();
+	} else if (subCmd == "reset") {
+		if (tokens.size() != 2) throw SyntaxError();
+		profiler.reset();
+	} else if (subCmd == "status") {
+		if (tokens.size() != 2) throw SyntaxError();
+		result.addListElement(
+			Profiler::isEnabled() ? "running" : "stopped");
+		result.addListElement(
+			int(std::min<uint64_t>(profiler.getNumFrames(), INT_MAX)));
+		result.addListElement(int(profiler.getNumTraceEvents()));
+	} else if (subCmd == "report") {
+		if (tokens.size() != 2) throw SyntaxError();
+		result.setString(profiler.getReport());
+	} else if (subCmd == "histogram") {
+		histogram(tokens, result);
+	} else if (subCmd == "export") {
+		exportTrace(tokens, result);
+	} else {
+		throw SyntaxError();
+	}
+}
+
+void ProfileCommand::start(array_ref<TclObject> tokens)
+{
+	bool trace = false;
+	for (size_t i = 2; i < tokens.size(); ++i) {
+		string_view option = tokens[i].getString();
+		if (option == "-trace") {
+			trace = true;
+		} else {
+			throw CommandException("Unknown option: ", option);
+		}
+	}
+	Profiler::instance().start(trace);
+}
+
+void ProfileCommand::histogram(array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() != 3) throw SyntaxError();
+	string_view section = tokens[2].getString();
+	for (auto& s : Profiler::instance().getSections()) {
+		if (s.name != section) continue;
+		// Drop the empty buckets at the end.
+		unsigned num = Profiler::NUM_BUCKETS;
+		while (num && !s.histogram[num - 1]) --num;
+		for (unsigned i = 0; i < num; ++i) {
+			TclObject bucket;
+			bucket.addListElement(int(1u << i)); // upper bound in us
+			bucket.addListElement(
+				int(std::min<uint64_t>(s.histogram[i], INT_MAX)));
+			result.addListElement(bucket);
+		}
+		return;
+	}
+	throw CommandException("No such section: ", section);
+}
+
+void ProfileCommand::exportTrace(array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() != 3) throw SyntaxError();
+	auto& profiler = Profiler::instance();
+	if (!profiler.isTracing()) {
+		throw CommandException(
+			"No trace available, use 'profile start -trace' first.");
+	}
+	string filename = FileOperations::expandTilde(tokens[2].getString());
+	try {
+		profiler.exportTrace(filename);
+	} catch (MSXException& e) {
+		throw CommandException("Couldn't write trace: ", e.getMessage());
+	}
+	result.setString(strCat("Wrote ", profiler.getNumTraceEvents(),
+	                        " events to ", filename));
+}
+
+string ProfileCommand::help(const vector<string>& /*tokens*/) const
+{
+	return "Measure where the host CPU time goes, per emulated device, per\n"
+	       "sound chip, for rendering, the OSD, Tcl commands and reverse\n"
+	       "snapshots.\n"
+	       "  profile start [-trace]  clear the results and start measuring,\n"
+	       "                          with -trace also keep every single\n"
+	       "                          measurement (for 'profile export')\n"
+	       "  profile stop            stop measuring, keep the results\n"
+	       "  profile reset           clear the results\n"
+	       "  profile status          running/stopped, #frames, #trace events\n"
+	       "  profile report          table with the time per section\n"
+	       "  profile histogram <section>\n"
+	       "      list of {<us> <frames>} pairs: the number of frames in\n"
+	       "      which that section took less than <us> microseconds\n"
+	       "      (and at least half of it)\n"
+	       "  profile export <filename>\n"
+	       "      write the trace in the Chrome trace event format (JSON),\n"
+	       "      it can be viewed with chrome://tracing or Perfetto\n";
+}
+
+void ProfileCommand::tabCompletion(vector<string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static const char* const cmds[] = {
+			"start", "stop", "reset", "status", "report", "histogram",
+			"export",
+		};
+		completeString(tokens, cmds);
+	} else if (tokens.size() == 3) {
+		if (tokens[1] == "start") {
+			static const char* const options[] = { "-trace" };
+			completeString(tokens, options);
+		} else if (tokens[1] == "histogram") {
+			vector<string> names;
+			for (auto& s : Profiler::instance().getSections()) {
+				names.push_back(s.name);
+			}
+			completeString(tokens, names);
+		} else if (tokens[1] == "export") {
+			completeFileName(tokens, userFileContext());
+		}
+	}
+}
+
+int ProfileCommand::signalEvent(const std::shared_ptr<const Event>& event)
+{
+	auto& ffe = checked_cast<const FinishFrameEvent&>(*event);
+	// Only once per frame, also when there are multiple VDPs.
+	if (ffe.getSource() == ffe.getSelectedSource()) {
+		Profiler::instance().endFrame();
+	}
+	return 0;
+}
+
+} // namespace openmsx
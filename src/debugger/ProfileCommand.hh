@@ -0,0 +1,37 @@
+#ifndef PROFILECOMMAND_HH
+#define PROFILECOMMAND_HH
+
+#include "Command.hh"
+#include "EventListener.hh"
+
+namespace openmsx {
+
+class EventDistributor;
+class CommandController;
+
+/** Tcl interface for the host Profiler, see Profiler.hh. */
+class ProfileCommand final : public Command, private EventListener
+{
+public:
+	ProfileCommand(CommandController& commandController,
+	               EventDistributor& eventDistributor);
+	~ProfileCommand();
+
+	void execute(array_ref<TclObject> tokens, TclObject& result) override;
+	std::string help(const std::vector<std::string>& tokens) const override;
+	void tabCompletion(std::vector<std::string>& tokens) const override;
+
+private:
+	void start(array_ref<TclObject> tokens);
+	void histogram(array_ref<TclObject> tokens, TclObject& result);
+	void exportTrace(array_ref<TclObject> tokens, TclObject& result);
+
+	// EventListener
+	int signalEvent(const std::shared_ptr<const Event>& event) override;
+
+	EventDistributor& eventDistributor;
+};
+
+} // namespace openmsx
+
+#endif
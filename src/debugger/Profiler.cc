@@ -0,0 +1,233 @@
+#include "Profiler.hh"
+#include "File.hh"
+#include "FileException.hh"
+#include "StringOp.hh"
+#include "strCat.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+
+using std::string;
+
+namespace openmsx {
+
+bool Profiler::enabled = false;
+Profiler::Clock Profiler::clock = Profiler::steadyClock;
+
+Profiler& Profiler::instance()
+{
+	static Profiler oneInstance;
+	return oneInstance;
+}
+
+Profiler::Profiler()
+	: current(nullptr)
+	, startTime(0)
+	, numFrames(0)
+	, tracing(false)
+{
+}
+
+void Profiler::start(bool trace)
+{
+	// Scopes that are active right now (e.g. the one around the 'profile'
+	// command itself) are still recorded, clipped to the start time.
+	reset();
+	tracing = trace;
+	startTime = now();
+	enabled = true;
+}
+
+void Profiler::stop()
+{
+	enabled = false;
+}
+
+void Profiler::reset()
+{
+	// Keep the section names (and indices), only clear the results.
+	for (auto& s : sections) {
+		string name = std::move(s.name);
+		s = Section();
+		s.name = std::move(name);
+	}
+	traceEvents.clear();
+	numFrames = 0;
+	startTime = now();
+}
+
+void Profiler::endFrame()
+{
+	if (!enabled) return;
+	++numFrames;
+	for (auto& s : sections) {
+		auto us = s.frameNs / 1000;
+		unsigned bucket = 0;
+		while (us && (bucket < (NUM_BUCKETS - 1))) {
+			us >>= 1;
+			++bucket;
+		}
+		++s.histogram[bucket];
+		s.maxFrameNs = std::max(s.maxFrameNs, s.frameNs);
+		s.frameNs = 0;
+	}
+}
+
+unsigned Profiler::getSection(string_view name)
+{
+	tmpName.assign(name.data(), name.size());
+	return lookupTmpName();
+}
+
+unsigned Profiler::getSection(string_view prefix, string_view name)
+{
+	tmpName.assign(prefix.data(), prefix.size());
+	tmpName.append(name.data(), name.size());
+	return lookupTmpName();
+}
+
+unsigned Profiler::lookupTmpName()
+{
+	auto it = sectionIndex.find(tmpName);
+	if (it != sectionIndex.end()) return it->second;
+
+	unsigned result = unsigned(sections.size());
+	sections.emplace_back();
+	sections.back().name = tmpName;
+	sectionIndex.insert_noDuplicateCheck(std::make_pair(tmpName, result));
+	return result;
+}
+
+unsigned Profiler::getSection(const std::type_info& type)
+{
+	auto it = typeIndex.find(&type);
+	if (it != typeIndex.end()) return it->second;
+
+	string name = type.name();
+#ifdef __GNUC__
+	int status;
+	if (char* demangled = abi::__cxa_demangle(
+			name.c_str(), nullptr, nullptr, &status)) {
+		name = demangled;
+		free(demangled);
+	}
+#endif
+	if (StringOp::startsWith(name, "openmsx::")) name.erase(0, 9);
+	auto result = getSection(name);
+	typeIndex.insert_noDuplicateCheck(std::make_pair(&type, result));
+	return result;
+}
+
+void Profiler::record(unsigned section, uint64_t start, uint64_t duration,
+                      uint64_t childDuration)
+{
+	auto& s = sections[section];
+	++s.calls;
+	s.totalNs += duration;
+	s.selfNs  += duration - std::min(duration, childDuration);
+	s.frameNs += duration;
+	if (tracing && (traceEvents.size() < MAX_TRACE_EVENTS)) {
+		traceEvents.push_back(
+			{section, start - std::min(start, startTime), duration});
+	}
+}
+
+string Profiler::getReport() const
+{
+	std::vector<unsigned> order;
+	for (auto i : xrange(sections.size())) {
+		if (sections[i].calls) order.push_back(unsigned(i));
+	}
+	std::sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+		return sections[x].selfNs > sections[y].selfNs;
+	});
+
+	auto frames = std::max<uint64_t>(numFrames, 1);
+	string result = strCat("frames: ", numFrames, '\n',
+		"   self(ms)  total(ms)      calls  total/frame(us)  max/frame(us)  section\n");
+	char buf[100];
+	for (auto i : order) {
+		auto& s = sections[i];
+		snprintf(buf, sizeof(buf), "%11.3f%11.3f%11llu%17.1f%15.1f  ",
+		         s.selfNs * 1e-6, s.totalNs * 1e-6,
+		         static_cast<unsigned long long>(s.calls),
+		         s.totalNs * 1e-3 / frames, s.maxFrameNs * 1e-3);
+		strAppend(result, buf, s.name, '\n');
+	}
+	return result;
+}
+
+static void appendJsonString(string& out, string_view str)
+{
+	out += '"';
+	for (char c : str) {
+		if ((c == '"') || (c == '\\')) {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		} else {
+			out += c;
+		}
+	}
+	out += '"';
+}
+
+void Profiler::exportTrace(const string& filename) const
+{
+	File file(filename, File::TRUNCATE);
+	string out = "{\"traceEvents\":[\n";
+	bool first = true;
+	char buf[100];
+	for (auto& e : traceEvents) {
+		if (!first) out += ",\n";
+		first = false;
+		out += "{\"name\":";
+		appendJsonString(out, sections[e.section].name);
+		// timestamps are in microseconds
+		snprintf(buf, sizeof(buf),
+		         ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+		         e.start * 1e-3, e.duration * 1e-3);
+		out += buf;
+		if (out.size() > 65536) {
+			file.write(out.data(), out.size());
+			out.clear();
+		}
+	}
+	out += "\n]}\n";
+	file.write(out.data(), out.size());
+}
+
+
+void ProfileScope::begin(unsigned section_)
+{
+	auto& profiler = Profiler::instance();
+	section = section_;
+	parent = profiler.current;
+	profiler.current = this;
+	childDuration = 0;
+	start = Profiler::now();
+}
+
+void ProfileScope::end()
+{
+	auto duration = Profiler::now() - start;
+	auto& profiler = Profiler::instance();
+	assert(profiler.current == this);
+	profiler.current = parent;
+	if (parent) parent->childDuration += duration;
+	// Can be stopped or reset while this scope was active (e.g. by the
+	// 'profile' command itself), then the section still exists.
+	if (Profiler::isEnabled()) {
+		profiler.record(section, start, duration, childDuration);
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,159 @@
+#ifndef PROFILER_HH
+#define PROFILER_HH
+
+#include "hash_map.hh"
+#include "string_view.hh"
+#include "xxhash.hh"
+#include "likely.hh"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace openmsx {
+
+/** Measures where the host time goes, per subsystem ('section').
+  *
+  * Code is instrumented with ProfileScope objects. While the profiler is
+  * disabled (the default) such a scope only costs a test of a global flag.
+  * When enabled, the time spent in each section is accumulated, both
+  * inclusive and exclusive the time spent in nested sections. At the end of
+  * each frame the per-section time of that frame is added to a histogram.
+  * Optionally each individual measurement is also stored, so that it can be
+  * exported in the Chrome trace event format (chrome://tracing, Perfetto).
+  *
+  * The profiler is only meant to be used from the main thread.
+  */
+class Profiler
+{
+public:
+	static const unsigned NUM_BUCKETS = 24; // bucket n: [2^(n-1), 2^n) us
+	static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+	struct Section {
+		std::string name;
+		uint64_t calls;
+		uint64_t totalNs; // inclusive nested sections
+		uint64_t selfNs;  // exclusive nested sections
+		uint64_t frameNs; // inclusive, in the current frame
+		uint64_t maxFrameNs;
+		uint64_t histogram[NUM_BUCKETS]; // frames per inclusive time
+	};
+	struct TraceEvent {
+		unsigned section;
+		uint64_t start; // ns since start()
+		uint64_t duration;
+	};
+
+	static Profiler& instance();
+	static bool isEnabled() { return enabled; }
+
+	/** Current time in ns, taken from the active clock. */
+	using Clock = uint64_t (*)();
+	static uint64_t now() { return clock(); }
+	static uint64_t steadyClock() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	/** Replace the clock (the default is steadyClock()). Only meant for
+	  * unittests, so that they don't depend on the real elapsed time. */
+	static void setClock(Clock c) { clock = c; }
+
+	/** Clear all results and start measuring.
+	  * @param trace Also store the individual measurements. */
+	void start(bool trace);
+	void stop();
+	void reset();
+
+	/** Close the current frame, see Section::histogram. */
+	void endFrame();
+
+	unsigned getSection(string_view name);
+	unsigned getSection(string_view prefix, string_view name);
+	unsigned getSection(const std::type_info& type);
+
+	const std::vector<Section>& getSections() const { return sections; }
+	uint64_t getNumFrames() const { return numFrames; }
+	bool isTracing() const { return tracing; }
+	size_t getNumTraceEvents() const { return traceEvents.size(); }
+
+	/** Human readable summary, sorted on (exclusive) time. */
+	std::string getReport() const;
+
+	/** Write the stored measurements as a Chrome trace (JSON) file.
+	  * @throws FileException */
+	void exportTrace(const std::string& filename) const;
+
+private:
+	Profiler();
+	friend class ProfileScope;
+	unsigned lookupTmpName();
+	void record(unsigned section, uint64_t start, uint64_t duration,
+	            uint64_t childDuration);
+
+	static bool enabled;
+	static Clock clock;
+
+	std::vector<Section> sections;
+	hash_map<std::string, unsigned, XXHasher> sectionIndex;
+	hash_map<const std::type_info*, unsigned> typeIndex;
+	std::vector<TraceEvent> traceEvents;
+	std::string tmpName;
+	class ProfileScope* current; // innermost active scope
+	uint64_t startTime;
+	uint64_t numFrames;
+	bool tracing;
+};
+
+/** Measures the time till the end of the enclosing C++ scope. */
+class ProfileScope
+{
+public:
+	explicit ProfileScope(string_view name)
+	{
+		if (likely(!Profiler::isEnabled())) {
+			section = NO_SECTION;
+		} else {
+			begin(Profiler::instance().getSection(name));
+		}
+	}
+	ProfileScope(string_view prefix, string_view name)
+	{
+		if (likely(!Profiler::isEnabled())) {
+			section = NO_SECTION;
+		} else {
+			begin(Profiler::instance().getSection(prefix, name));
+		}
+	}
+	explicit ProfileScope(const std::type_info& type)
+	{
+		if (likely(!Profiler::isEnabled())) {
+			section = NO_SECTION;
+		} else {
+			begin(Profiler::instance().getSection(type));
+		}
+	}
+	~ProfileScope()
+	{
+		if (unlikely(section != NO_SECTION)) end();
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	static const unsigned NO_SECTION = unsigned(-1);
+	void begin(unsigned section);
+	void end();
+
+	friend class Profiler;
+	ProfileScope* parent;
+	uint64_t start;
+	uint64_t childDuration;
+	unsigned section;
+};
+
+} // namespace openmsx
+
+#endif
@@ -10,10 +10,12 @@
 #include "EmuTime.hh"
 #include "CommandException.hh"
 #include "TclObject.hh"
-#include "stl.hh"
-#include "unreachable.hh"
+#include "Timer.hh"
+#include "StringOp.hh"
+#include "checked_cast.hh"
 #include <algorithm>
-#include <iterator>
+#include <cassert>
+#include <cstdint>
 #include <memory>
 #include <sstream>
 
@@ -30,33 +32,29 @@ class AfterCmd
 public:
 	virtual ~AfterCmd() = default;
 	string_view getCommand() const;
-	const string& getId() const;
+	unsigned getId() const { return id; }
+	string getIdString() const;
 	virtual string getType() const = 0;
 	void execute();
 protected:
 	AfterCmd(AfterCommand& afterCommand,
 		 const TclObject& command);
-	unique_ptr<AfterCmd> removeSelf();
 
 	AfterCommand& afterCommand;
 	TclObject command;
-	string id;
+	const unsigned id;
 	static unsigned lastAfterId;
 };
 
-class AfterTimedCmd : public AfterCmd, private Schedulable
+class AfterTimedCmd : public AfterCmd
 {
 public:
 	double getTime() const;
-	void reschedule();
+	void expire() { time = 0.0; }
 protected:
-	AfterTimedCmd(Scheduler& scheduler,
-		      AfterCommand& afterCommand,
+	AfterTimedCmd(AfterCommand& afterCommand,
 		      const TclObject& command, double time);
 private:
-	void executeUntil(EmuTime::param time) override;
-	void schedulerDeleted() override;
-
 	double time; // Zero when expired, otherwise the original duration (to
 	             // be able to reschedule for 'after idle').
 };
@@ -64,8 +62,7 @@ private:
 class AfterTimeCmd final : public AfterTimedCmd
 {
 public:
-	AfterTimeCmd(Scheduler& scheduler,
-		     AfterCommand& afterCommand,
+	AfterTimeCmd(AfterCommand& afterCommand,
 		     const TclObject& command, double time);
 	string getType() const override;
 };
@@ -73,13 +70,12 @@ public:
 class AfterIdleCmd final : public AfterTimedCmd
 {
 public:
-	AfterIdleCmd(Scheduler& scheduler,
-		     AfterCommand& afterCommand,
+	AfterIdleCmd(AfterCommand& afterCommand,
 		     const TclObject& command, double time);
+	~AfterIdleCmd();
 	string getType() const override;
 };
 
-template<EventType T>
 class AfterEventCmd final : public AfterCmd
 {
 public:
@@ -103,15 +99,68 @@ private:
 	AfterCommand::EventPtr event;
 };
 
-class AfterRealTimeCmd final : public AfterCmd, private RTSchedulable
+class AfterRealTimeCmd final : public AfterCmd
 {
 public:
-	AfterRealTimeCmd(RTScheduler& rtScheduler, AfterCommand& afterCommand,
-	                 const TclObject& command, double time);
+	AfterRealTimeCmd(AfterCommand& afterCommand,
+	                 const TclObject& command);
 	string getType() const override;
+};
+
+
+template<typename Time> struct AfterSyncPoint
+{
+	Time time;
+	unsigned id;
+};
+
+// For std::push_heap() and friends: the earliest sync point ends up at the
+// front, sync points with the same time in order of creation.
+struct LaterSyncPoint
+{
+	template<typename SP> bool operator()(const SP& x, const SP& y) const {
+		if (x.time != y.time) return x.time > y.time;
+		return x.id > y.id;
+	}
+};
+
+// All 'time' and 'idle' commands for one Scheduler, ordered on time. Only the
+// earliest of them is registered in the Scheduler, so a large number of
+// pending commands doesn't slow down the emulation.
+class AfterCommand::TimedQueue final : private Schedulable
+{
+public:
+	TimedQueue(Scheduler& scheduler, AfterCommand& afterCommand);
+	using Schedulable::getScheduler;
+	void add(const AfterTimedCmd& cmd);
+	void rescheduleIdle();
+	// Removes canceled commands, returns false when the queue is empty.
+	bool compact();
+
+private:
+	void update();
+	void executeUntil(EmuTime::param time) override;
+	void schedulerDeleted() override;
+
+	AfterCommand& afterCommand;
+	vector<AfterSyncPoint<EmuTime>> heap;
+};
+
+// All 'realtime' commands, ordered on time. Only the earliest of them is
+// registered in the RTScheduler.
+class AfterCommand::RealTimeQueue final : private RTSchedulable
+{
+public:
+	RealTimeQueue(RTScheduler& rtScheduler, AfterCommand& afterCommand);
+	void add(const AfterRealTimeCmd& cmd, double time);
+	void compact();
 
 private:
+	void update();
 	void executeRT() override;
+
+	AfterCommand& afterCommand;
+	vector<AfterSyncPoint<uint64_t>> heap; // in micro seconds
 };
 
 
@@ -119,6 +168,10 @@ AfterCommand::AfterCommand(Reactor& reactor_,
                            EventDistributor& eventDistributor_,
                            CommandController& commandController_)
 	: Command(commandController_, "after")
+	, realTimeQueue(std::make_unique<RealTimeQueue>(
+		reactor_.getRTScheduler(), *this))
+	, numIdle(0)
+	, numStale(0)
 	, reactor(reactor_)
 	, eventDistributor(eventDistributor_)
 {
@@ -158,6 +211,9 @@ AfterCommand::AfterCommand(Reactor& reactor_,
 
 AfterCommand::~AfterCommand()
 {
+	// Commands can still refer to this object while they're destroyed.
+	afterCmds.clear();
+
 	eventDistributor.unregisterEventListener(
 		OPENMSX_AFTER_TIMED_EVENT, *this);
 	eventDistributor.unregisterEventListener(
@@ -203,15 +259,15 @@ void AfterCommand::execute(array_ref<TclObject> tokens, TclObject& result)
 	} else if (subCmd == "idle") {
 		afterIdle(tokens, result);
 	} else if (subCmd == "frame") {
-		afterEvent<OPENMSX_FINISH_FRAME_EVENT>(tokens, result);
+		afterEvent(frameCmds, tokens, result);
 	} else if (subCmd == "break") {
-		afterEvent<OPENMSX_BREAK_EVENT>(tokens, result);
+		afterEvent(breakCmds, tokens, result);
 	} else if (subCmd == "quit") {
-		afterEvent<OPENMSX_QUIT_EVENT>(tokens, result);
+		afterEvent(quitCmds, tokens, result);
 	} else if (subCmd == "boot") {
-		afterEvent<OPENMSX_BOOT_EVENT>(tokens, result);
+		afterEvent(bootCmds, tokens, result);
 	} else if (subCmd == "machine_switch") {
-		afterEvent<OPENMSX_MACHINE_LOADED_EVENT>(tokens, result);
+		afterEvent(machineSwitchCmds, tokens, result);
 	} else if (subCmd == "info") {
 		afterInfo(tokens, result);
 	} else if (subCmd == "cancel") {
@@ -252,10 +308,9 @@ void AfterCommand::afterTime(array_ref<TclObject> tokens, TclObject& result)
 	MSXMotherBoard* motherBoard = reactor.getMotherBoard();
 	if (!motherBoard) return;
 	double time = getTime(getInterpreter(), tokens[2]);
-	auto cmd = std::make_unique<AfterTimeCmd>(
-		motherBoard->getScheduler(), *this, tokens[3], time);
-	result.setString(cmd->getId());
-	afterCmds.push_back(move(cmd));
+	auto cmd = std::make_unique<AfterTimeCmd>(*this, tokens[3], time);
+	getTimedQueue(motherBoard->getScheduler()).add(*cmd);
+	add(move(cmd), result);
 }
 
 void AfterCommand::afterRealTime(array_ref<TclObject> tokens, TclObject& result)
@@ -264,10 +319,9 @@ void AfterCommand::afterRealTime(array_ref<TclObject> tokens, TclObject& result)
 		throw SyntaxError();
 	}
 	double time = getTime(getInterpreter(), tokens[2]);
-	auto cmd = std::make_unique<AfterRealTimeCmd>(
-		reactor.getRTScheduler(), *this, tokens[3], time);
-	result.setString(cmd->getId());
-	afterCmds.push_back(move(cmd));
+	auto cmd = std::make_unique<AfterRealTimeCmd>(*this, tokens[3]);
+	realTimeQueue->add(*cmd, time);
+	add(move(cmd), result);
 }
 
 void AfterCommand::afterTclTime(
@@ -275,22 +329,21 @@ void AfterCommand::afterTclTime(
 {
 	TclObject command;
 	command.addListElements(std::begin(tokens) + 2, std::end(tokens));
-	auto cmd = std::make_unique<AfterRealTimeCmd>(
-		reactor.getRTScheduler(), *this, command, ms / 1000.0);
-	result.setString(cmd->getId());
-	afterCmds.push_back(move(cmd));
+	auto cmd = std::make_unique<AfterRealTimeCmd>(*this, command);
+	realTimeQueue->add(*cmd, ms / 1000.0);
+	add(move(cmd), result);
 }
 
-template<EventType T>
-void AfterCommand::afterEvent(array_ref<TclObject> tokens, TclObject& result)
+void AfterCommand::afterEvent(
+	Queue& queue, array_ref<TclObject> tokens, TclObject& result)
 {
 	if (tokens.size() != 3) {
 		throw SyntaxError();
 	}
-	auto cmd = std::make_unique<AfterEventCmd<T>>(
+	auto cmd = std::make_unique<AfterEventCmd>(
 		*this, tokens[1], tokens[2]);
-	result.setString(cmd->getId());
-	afterCmds.push_back(move(cmd));
+	queue.push_back(cmd->getId());
+	add(move(cmd), result);
 }
 
 void AfterCommand::afterInputEvent(
@@ -301,8 +354,8 @@ void AfterCommand::afterInputEvent(
 	}
 	auto cmd = std::make_unique<AfterInputEventCmd>(
 		*this, event, tokens[2]);
-	result.setString(cmd->getId());
-	afterCmds.push_back(move(cmd));
+	inputEventCmds.push_back(cmd->getId());
+	add(move(cmd), result);
 }
 
 void AfterCommand::afterIdle(array_ref<TclObject> tokens, TclObject& result)
@@ -313,19 +366,27 @@ void AfterCommand::afterIdle(array_ref<TclObject> tokens, TclObject& result)
 	MSXMotherBoard* motherBoard = reactor.getMotherBoard();
 	if (!motherBoard) return;
 	double time = getTime(getInterpreter(), tokens[2]);
-	auto cmd = std::make_unique<AfterIdleCmd>(
-		motherBoard->getScheduler(), *this, tokens[3], time);
-	result.setString(cmd->getId());
-	afterCmds.push_back(move(cmd));
+	auto cmd = std::make_unique<AfterIdleCmd>(*this, tokens[3], time);
+	getTimedQueue(motherBoard->getScheduler()).add(*cmd);
+	add(move(cmd), result);
 }
 
 void AfterCommand::afterInfo(array_ref<TclObject> /*tokens*/, TclObject& result)
 {
+	vector<const AfterCmd*> cmds;
+	cmds.reserve(afterCmds.size());
+	for (auto& p : afterCmds) {
+		cmds.push_back(p.second.get());
+	}
+	std::sort(begin(cmds), end(cmds),
+		[](const AfterCmd* x, const AfterCmd* y) {
+			return x->getId() < y->getId(); });
+
 	ostringstream str;
-	for (auto& cmd : afterCmds) {
-		str << cmd->getId() << ": ";
+	for (auto* cmd : cmds) {
+		str << cmd->getIdString() << ": ";
 		str << cmd->getType() << ' ';
-		if (auto cmd2 = dynamic_cast<const AfterTimedCmd*>(cmd.get())) {
+		if (auto cmd2 = dynamic_cast<const AfterTimedCmd*>(cmd)) {
 			str.precision(3);
 			str << std::fixed << std::showpoint << cmd2->getTime() << ' ';
 		}
@@ -341,26 +402,31 @@ void AfterCommand::afterCancel(array_ref<TclObject> tokens, TclObject& /*result*
 		throw SyntaxError();
 	}
 	if (tokens.size() == 3) {
-		auto id = tokens[2].getString();
-		auto it = find_if(begin(afterCmds), end(afterCmds),
-			[&](std::unique_ptr<AfterCmd>& e) { return e->getId() == id; });
-		if (it != end(afterCmds)) {
-			afterCmds.erase(it);
+		auto idStr = tokens[2].getString();
+		unsigned id;
+		if (StringOp::startsWith(idStr, "after#") &&
+		    StringOp::stringToUint(idStr.substr(6).str(), id) &&
+		    remove(id)) {
+			canceled();
 			return;
 		}
 	}
 	TclObject command;
 	command.addListElements(std::begin(tokens) + 2, std::end(tokens));
 	string_view cmdStr = command.getString();
-	auto it = find_if(begin(afterCmds), end(afterCmds),
-		[&](std::unique_ptr<AfterCmd>& e) { return e->getCommand() == cmdStr; });
-	if (it != end(afterCmds)) {
-		afterCmds.erase(it);
-		// Tcl manual is not clear about this, but it seems
-		// there's only occurence of this command canceled.
-		// It's also not clear which of the (possibly) several
-		// matches is canceled.
-		return;
+	// Tcl manual is not clear about this, but it seems there's only
+	// occurence of this command canceled. It's also not clear which of
+	// the (possibly) several matches is canceled, take the oldest.
+	const AfterCmd* match = nullptr;
+	for (auto& p : afterCmds) {
+		if ((p.second->getCommand() == cmdStr) &&
+		    (!match || (p.second->getId() < match->getId()))) {
+			match = p.second.get();
+		}
+	}
+	if (match) {
+		remove(match->getId());
+		canceled();
 	}
 	// It's not an error if no match is found
 }
@@ -390,72 +456,126 @@ void AfterCommand::tabCompletion(vector<string>& tokens) const
 	// TODO : make more complete
 }
 
-// Execute the cmds for which the predicate returns true, and erase those from afterCmds.
-template<typename PRED> void AfterCommand::executeMatches(PRED pred)
+void AfterCommand::add(unique_ptr<AfterCmd> cmd, TclObject& result)
 {
-	AfterCmds matches;
-	// Usually there are very few matches (typically even 0 or 1), so no
-	// need to reserve() space.
-	auto p = partition_copy_remove(begin(afterCmds), end(afterCmds),
-	                               std::back_inserter(matches), pred);
-	afterCmds.erase(p.second, end(afterCmds));
-	for (auto& c : matches) {
-		c->execute();
-	}
+	result.setString(cmd->getIdString());
+	auto id = cmd->getId();
+	afterCmds.insert_noDuplicateCheck(std::make_pair(id, move(cmd)));
 }
 
-template<EventType T> struct AfterEventPred {
-	bool operator()(const unique_ptr<AfterCmd>& x) const {
-		return dynamic_cast<AfterEventCmd<T>*>(x.get()) != nullptr;
+unique_ptr<AfterCmd> AfterCommand::remove(unsigned id)
+{
+	auto it = afterCmds.find(id);
+	if (it == end(afterCmds)) return nullptr;
+	auto result = move(it->second);
+	afterCmds.erase(it);
+	return result;
+}
+
+void AfterCommand::canceled()
+{
+	// The id of a canceled command stays in its queue. Clean up when
+	// there are (possibly) more of those than there are pending commands,
+	// so that canceling is (amortized) O(1).
+	if (++numStale > (afterCmds.size() + 64)) {
+		compact();
 	}
-};
-template<EventType T> void AfterCommand::executeEvents()
+}
+
+void AfterCommand::compact()
 {
-	executeMatches(AfterEventPred<T>());
+	auto isStale = [&](unsigned id) { return !afterCmds.contains(id); };
+	for (auto* queue : { &frameCmds, &breakCmds, &bootCmds, &quitCmds,
+	                     &machineSwitchCmds, &inputEventCmds, &expiredCmds }) {
+		queue->erase(std::remove_if(begin(*queue), end(*queue), isStale),
+		             end(*queue));
+	}
+	for (size_t i = 0; i < timedQueues.size(); /**/) {
+		if (timedQueues[i]->compact()) {
+			++i;
+		} else {
+			timedQueues.erase(begin(timedQueues) + i);
+		}
+	}
+	realTimeQueue->compact();
+	numStale = 0;
 }
 
-struct AfterEmuTimePred {
-	bool operator()(const unique_ptr<AfterCmd>& x) const {
-		if (auto* cmd = dynamic_cast<AfterTimedCmd*>(x.get())) {
-			if (cmd->getTime() == 0.0) {
-				return true;
-			}
+// Execute (and erase) all the commands in the given queue.
+void AfterCommand::executeQueue(Queue& queue)
+{
+	// Commands added while executing (e.g. an 'after frame' command that
+	// re-registers itself) only get executed on the next event.
+	Queue ids;
+	swap(ids, queue);
+	vector<unique_ptr<AfterCmd>> cmds;
+	for (auto id : ids) {
+		if (auto cmd = remove(id)) { // skip canceled commands
+			cmds.push_back(move(cmd));
 		}
-		return false;
 	}
-};
+	for (auto& c : cmds) {
+		c->execute();
+	}
+}
 
-struct AfterInputEventPred {
-	explicit AfterInputEventPred(AfterCommand::EventPtr event_)
-		: event(std::move(event_)) {}
-	bool operator()(const unique_ptr<AfterCmd>& x) const {
-		if (auto* cmd = dynamic_cast<AfterInputEventCmd*>(x.get())) {
-			if (cmd->getEvent()->matches(*event)) return true;
+void AfterCommand::executeInputEvent(const Event& event)
+{
+	vector<unique_ptr<AfterCmd>> matches;
+	auto out = begin(inputEventCmds);
+	for (auto id : inputEventCmds) {
+		auto it = afterCmds.find(id);
+		if (it == end(afterCmds)) continue; // canceled
+		auto& cmd = checked_cast<AfterInputEventCmd&>(*it->second);
+		if (cmd.getEvent()->matches(event)) {
+			matches.push_back(move(it->second));
+			afterCmds.erase(it);
+		} else {
+			*out++ = id;
 		}
-		return false;
 	}
-	AfterCommand::EventPtr event;
-};
+	inputEventCmds.erase(out, end(inputEventCmds));
+	for (auto& c : matches) {
+		c->execute();
+	}
+}
+
+AfterCommand::TimedQueue& AfterCommand::getTimedQueue(Scheduler& scheduler)
+{
+	for (auto& q : timedQueues) {
+		if (&q->getScheduler() == &scheduler) return *q;
+	}
+	timedQueues.push_back(std::make_unique<TimedQueue>(scheduler, *this));
+	return *timedQueues.back();
+}
+
+void AfterCommand::removeTimedQueue(TimedQueue& queue)
+{
+	auto it = std::find_if(begin(timedQueues), end(timedQueues),
+		[&](const unique_ptr<TimedQueue>& q) { return q.get() == &queue; });
+	assert(it != end(timedQueues));
+	timedQueues.erase(it);
+}
 
 int AfterCommand::signalEvent(const std::shared_ptr<const Event>& event)
 {
 	if (event->getType() == OPENMSX_FINISH_FRAME_EVENT) {
-		executeEvents<OPENMSX_FINISH_FRAME_EVENT>();
+		executeQueue(frameCmds);
 	} else if (event->getType() == OPENMSX_BREAK_EVENT) {
-		executeEvents<OPENMSX_BREAK_EVENT>();
+		executeQueue(breakCmds);
 	} else if (event->getType() == OPENMSX_BOOT_EVENT) {
-		executeEvents<OPENMSX_BOOT_EVENT>();
+		executeQueue(bootCmds);
 	} else if (event->getType() == OPENMSX_QUIT_EVENT) {
-		executeEvents<OPENMSX_QUIT_EVENT>();
+		executeQueue(quitCmds);
 	} else if (event->getType() == OPENMSX_MACHINE_LOADED_EVENT) {
-		executeEvents<OPENMSX_MACHINE_LOADED_EVENT>();
+		executeQueue(machineSwitchCmds);
 	} else if (event->getType() == OPENMSX_AFTER_TIMED_EVENT) {
-		executeMatches(AfterEmuTimePred());
+		executeQueue(expiredCmds);
 	} else {
-		executeMatches(AfterInputEventPred(event));
-		for (auto& c : afterCmds) {
-			if (auto* cmd = dynamic_cast<AfterIdleCmd*>(c.get())) {
-				cmd->reschedule();
+		executeInputEvent(*event);
+		if (numIdle) {
+			for (auto& q : timedQueues) {
+				q->rescheduleIdle();
 			}
 		}
 	}
@@ -468,11 +588,8 @@ int AfterCommand::signalEvent(const std::shared_ptr<const Event>& event)
 unsigned AfterCmd::lastAfterId = 0;
 
 AfterCmd::AfterCmd(AfterCommand& afterCommand_, const TclObject& command_)
-	: afterCommand(afterCommand_), command(command_)
+	: afterCommand(afterCommand_), command(command_), id(++lastAfterId)
 {
-	ostringstream str;
-	str << "after#" << ++lastAfterId;
-	id = str.str();
 }
 
 string_view AfterCmd::getCommand() const
@@ -480,9 +597,9 @@ string_view AfterCmd::getCommand() const
 	return command.getString();
 }
 
-const string& AfterCmd::getId() const
+string AfterCmd::getIdString() const
 {
-	return id;
+	return strCat("after#", id);
 }
 
 void AfterCmd::execute()
@@ -495,27 +612,15 @@ void AfterCmd::execute()
 	}
 }
 
-unique_ptr<AfterCmd> AfterCmd::removeSelf()
-{
-	auto it = rfind_if_unguarded(afterCommand.afterCmds,
-		[&](std::unique_ptr<AfterCmd>& e) { return e.get() == this; });
-	auto result = move(*it);
-	afterCommand.afterCmds.erase(it);
-	return result;
-}
-
 
 // class  AfterTimedCmd
 
 AfterTimedCmd::AfterTimedCmd(
-		Scheduler& scheduler_,
 		AfterCommand& afterCommand_,
 		const TclObject& command_, double time_)
 	: AfterCmd(afterCommand_, command_)
-	, Schedulable(scheduler_)
 	, time(time_)
 {
-	reschedule();
 }
 
 double AfterTimedCmd::getTime() const
@@ -523,32 +628,13 @@ double AfterTimedCmd::getTime() const
 	return time;
 }
 
-void AfterTimedCmd::reschedule()
-{
-	removeSyncPoint();
-	setSyncPoint(getCurrentTime() + EmuDuration(time));
-}
-
-void AfterTimedCmd::executeUntil(EmuTime::param /*time*/)
-{
-	time = 0.0; // execute on next event
-	afterCommand.eventDistributor.distributeEvent(
-		std::make_shared<SimpleEvent>(OPENMSX_AFTER_TIMED_EVENT));
-}
-
-void AfterTimedCmd::schedulerDeleted()
-{
-	removeSelf();
-}
-
 
 // class AfterTimeCmd
 
 AfterTimeCmd::AfterTimeCmd(
-		Scheduler& scheduler_,
 		AfterCommand& afterCommand_,
 		const TclObject& command_, double time_)
-	: AfterTimedCmd(scheduler_, afterCommand_, command_, time_)
+	: AfterTimedCmd(afterCommand_, command_, time_)
 {
 }
 
@@ -561,11 +647,16 @@ string AfterTimeCmd::getType() const
 // class AfterIdleCmd
 
 AfterIdleCmd::AfterIdleCmd(
-		Scheduler& scheduler_,
 		AfterCommand& afterCommand_,
 		const TclObject& command_, double time_)
-	: AfterTimedCmd(scheduler_, afterCommand_, command_, time_)
+	: AfterTimedCmd(afterCommand_, command_, time_)
+{
+	++afterCommand.numIdle;
+}
+
+AfterIdleCmd::~AfterIdleCmd()
 {
+	--afterCommand.numIdle;
 }
 
 string AfterIdleCmd::getType() const
@@ -576,16 +667,14 @@ string AfterIdleCmd::getType() const
 
 // class AfterEventCmd
 
-template<EventType T>
-AfterEventCmd<T>::AfterEventCmd(
+AfterEventCmd::AfterEventCmd(
 		AfterCommand& afterCommand_, const TclObject& type_,
 		const TclObject& command_)
 	: AfterCmd(afterCommand_, command_), type(type_.getString().str())
 {
 }
 
-template<EventType T>
-string AfterEventCmd<T>::getType() const
+string AfterEventCmd::getType() const
 {
 	return type;
 }
@@ -607,15 +696,13 @@ string AfterInputEventCmd::getType() const
 	return event->toString();
 }
 
+
 // class AfterRealTimeCmd
 
 AfterRealTimeCmd::AfterRealTimeCmd(
-		RTScheduler& rtScheduler, AfterCommand& afterCommand_,
-		const TclObject& command_, double time)
+		AfterCommand& afterCommand_, const TclObject& command_)
 	: AfterCmd(afterCommand_, command_)
-	, RTSchedulable(rtScheduler)
 {
-	scheduleRT(uint64_t(time * 1e6)); // micro seconds
 }
 
 string AfterRealTimeCmd::getType() const
@@ -623,13 +710,156 @@ string AfterRealTimeCmd::getType() const
 	return "realtime";
 }
 
-void AfterRealTimeCmd::executeRT()
+
+// class AfterCommand::TimedQueue
+
+AfterCommand::TimedQueue::TimedQueue(
+		Scheduler& scheduler_, AfterCommand& afterCommand_)
+	: Schedulable(scheduler_)
+	, afterCommand(afterCommand_)
+{
+}
+
+void AfterCommand::TimedQueue::add(const AfterTimedCmd& cmd)
+{
+	heap.push_back({getCurrentTime() + EmuDuration(cmd.getTime()),
+	                cmd.getId()});
+	std::push_heap(begin(heap), end(heap), LaterSyncPoint());
+	if (heap.front().id == cmd.getId()) update();
+}
+
+void AfterCommand::TimedQueue::update()
+{
+	removeSyncPoint();
+	if (!heap.empty()) {
+		setSyncPoint(heap.front().time);
+	}
+}
+
+void AfterCommand::TimedQueue::rescheduleIdle()
+{
+	auto now = getCurrentTime();
+	bool changed = false;
+	for (auto& sp : heap) {
+		auto it = afterCommand.afterCmds.find(sp.id);
+		if (it == end(afterCommand.afterCmds)) continue; // canceled
+		if (auto* cmd = dynamic_cast<AfterIdleCmd*>(it->second.get())) {
+			sp.time = now + EmuDuration(cmd->getTime());
+			changed = true;
+		}
+	}
+	if (changed) {
+		std::make_heap(begin(heap), end(heap), LaterSyncPoint());
+		update();
+	}
+}
+
+bool AfterCommand::TimedQueue::compact()
+{
+	auto& cmds = afterCommand.afterCmds;
+	heap.erase(std::remove_if(begin(heap), end(heap),
+			[&](const AfterSyncPoint<EmuTime>& sp) {
+				return !cmds.contains(sp.id); }),
+	           end(heap));
+	std::make_heap(begin(heap), end(heap), LaterSyncPoint());
+	update();
+	return !heap.empty();
+}
+
+void AfterCommand::TimedQueue::executeUntil(EmuTime::param time)
+{
+	// Don't execute the commands from here (in the middle of the
+	// emulation), but on the next OPENMSX_AFTER_TIMED_EVENT.
+	bool expired = false;
+	while (!heap.empty() && (heap.front().time <= time)) {
+		auto id = heap.front().id;
+		std::pop_heap(begin(heap), end(heap), LaterSyncPoint());
+		heap.pop_back();
+		auto it = afterCommand.afterCmds.find(id);
+		if (it == end(afterCommand.afterCmds)) continue; // canceled
+		checked_cast<AfterTimedCmd&>(*it->second).expire();
+		afterCommand.expiredCmds.push_back(id);
+		expired = true;
+	}
+	if (expired) {
+		afterCommand.eventDistributor.distributeEvent(
+			std::make_shared<SimpleEvent>(OPENMSX_AFTER_TIMED_EVENT));
+	}
+	if (heap.empty()) {
+		// Deletes this object, so this must be the last statement.
+		afterCommand.removeTimedQueue(*this);
+	} else {
+		setSyncPoint(heap.front().time);
+	}
+}
+
+void AfterCommand::TimedQueue::schedulerDeleted()
+{
+	// The machine is deleted, drop its pending commands. Commands that
+	// already expired are still executed.
+	for (auto& sp : heap) {
+		afterCommand.afterCmds.erase(sp.id);
+	}
+	afterCommand.removeTimedQueue(*this);
+}
+
+
+// class AfterCommand::RealTimeQueue
+
+AfterCommand::RealTimeQueue::RealTimeQueue(
+		RTScheduler& rtScheduler, AfterCommand& afterCommand_)
+	: RTSchedulable(rtScheduler)
+	, afterCommand(afterCommand_)
+{
+}
+
+void AfterCommand::RealTimeQueue::add(const AfterRealTimeCmd& cmd, double time)
+{
+	heap.push_back({Timer::getTime() + uint64_t(time * 1e6), cmd.getId()});
+	std::push_heap(begin(heap), end(heap), LaterSyncPoint());
+	if (heap.front().id == cmd.getId()) update();
+}
+
+void AfterCommand::RealTimeQueue::update()
 {
-	// Remove self before executing, but keep self alive till the end of
-	// this method. Otherwise execute could execute 'after cancel ..' and
-	// removeSelf() asserts that it can't find itself anymore.
-	auto self = removeSelf();
-	execute();
+	if (heap.empty()) {
+		cancelRT();
+	} else {
+		auto now = Timer::getTime();
+		auto time = heap.front().time;
+		scheduleRT((time > now) ? (time - now) : 0);
+	}
+}
+
+void AfterCommand::RealTimeQueue::compact()
+{
+	auto& cmds = afterCommand.afterCmds;
+	heap.erase(std::remove_if(begin(heap), end(heap),
+			[&](const AfterSyncPoint<uint64_t>& sp) {
+				return !cmds.contains(sp.id); }),
+	           end(heap));
+	std::make_heap(begin(heap), end(heap), LaterSyncPoint());
+	update();
+}
+
+void AfterCommand::RealTimeQueue::executeRT()
+{
+	// Remove the commands before executing them. Otherwise a command
+	// could execute 'after cancel ..' for itself.
+	auto now = Timer::getTime();
+	vector<unique_ptr<AfterCmd>> cmds;
+	while (!heap.empty() && (heap.front().time <= now)) {
+		auto id = heap.front().id;
+		std::pop_heap(begin(heap), end(heap), LaterSyncPoint());
+		heap.pop_back();
+		if (auto cmd = afterCommand.remove(id)) { // skip canceled
+			cmds.push_back(move(cmd));
+		}
+	}
+	update();
+	for (auto& c : cmds) {
+		c->execute();
+	}
 }
 
 } // namespace openmsx
@@ -4,6 +4,7 @@
 #include "Command.hh"
 #include "EventListener.hh"
 #include "Event.hh"
+#include "hash_map.hh"
 #include <memory>
 #include <vector>
 
@@ -12,6 +13,7 @@ namespace openmsx {
 class Reactor;
 class EventDistributor;
 class CommandController;
+class Scheduler;
 class AfterCmd;
 
 class AfterCommand final : public Command, private EventListener
@@ -29,9 +31,23 @@ public:
 	void tabCompletion(std::vector<std::string>& tokens) const override;
 
 private:
-	template<typename PRED> void executeMatches(PRED pred);
-	template<EventType T> void executeEvents();
-	template<EventType T> void afterEvent(
+	// Ids of pending commands, in order of creation. Canceled commands
+	// are only removed from 'afterCmds', their ids are skipped (and
+	// dropped) when the queue is executed or compacted.
+	using Queue = std::vector<unsigned>;
+	class TimedQueue;
+	class RealTimeQueue;
+
+	void add(std::unique_ptr<AfterCmd> cmd, TclObject& result);
+	std::unique_ptr<AfterCmd> remove(unsigned id);
+	void canceled();
+	void compact();
+	void executeQueue(Queue& queue);
+	void executeInputEvent(const Event& event);
+	TimedQueue& getTimedQueue(Scheduler& scheduler);
+	void removeTimedQueue(TimedQueue& queue);
+
+	void afterEvent(Queue& queue,
 	                   array_ref<TclObject> tokens, TclObject& result);
 	void afterInputEvent(const EventPtr& event,
 	                   array_ref<TclObject> tokens, TclObject& result);
@@ -46,14 +62,29 @@ private:
 	// EventListener
 	int signalEvent(const std::shared_ptr<const Event>& event) override;
 
-	using AfterCmds = std::vector<std::unique_ptr<AfterCmd>>;
-	AfterCmds afterCmds;
+	// All pending commands, indexed on id.
+	hash_map<unsigned, std::unique_ptr<AfterCmd>> afterCmds;
+
+	Queue frameCmds;
+	Queue breakCmds;
+	Queue bootCmds;
+	Queue quitCmds;
+	Queue machineSwitchCmds;
+	Queue inputEventCmds;
+	Queue expiredCmds; // 'time' and 'idle' commands, executed on the
+	                   // next OPENMSX_AFTER_TIMED_EVENT
+
+	// 'time' and 'idle' commands, one queue per (MSX machine) Scheduler.
+	std::vector<std::unique_ptr<TimedQueue>> timedQueues;
+	std::unique_ptr<RealTimeQueue> realTimeQueue;
+
+	unsigned numIdle;  // number of pending 'idle' commands
+	unsigned numStale; // (upper bound for) number of canceled ids in queues
+
 	Reactor& reactor;
 	EventDistributor& eventDistributor;
 
-	friend class AfterCmd;
-	friend class AfterTimedCmd;
-	friend class AfterRealTimeCmd;
+	friend class AfterIdleCmd;
 };
 
 } // namespace openmsx
@@ -8,15 +8,23 @@
 #include "CliConnection.hh"
 #include "EventDistributor.hh"
 #include "Event.hh"
-#include "CommandController.hh"
+#include "FinishFrameEvent.hh"
+#include "GlobalCommandController.hh"
 #include "CommandException.hh"
+#include "Reactor.hh"
+#include "MSXMotherBoard.hh"
+#include "Debugger.hh"
+#include "Debuggable.hh"
+#include "Base64.hh"
 #include "TclObject.hh"
 #include "XMLElement.hh"
 #include "checked_cast.hh"
 #include "cstdiop.hh"
 #include "unistdp.hh"
 #include "openmsx.hh"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 #ifdef _WIN32
@@ -69,19 +77,98 @@ CliConnection::CliConnection(CommandController& commandController_,
 	: parser([this](const std::string& cmd) { execute(cmd); })
 	, commandController(commandController_)
 	, eventDistributor(eventDistributor_)
+	, lastSubscriptionId(0)
 {
 	for (auto& en : updateEnabled) {
 		en = false;
 	}
 
 	eventDistributor.registerEventListener(OPENMSX_CLICOMMAND_EVENT, *this);
+	eventDistributor.registerEventListener(OPENMSX_FINISH_FRAME_EVENT, *this);
 }
 
 CliConnection::~CliConnection()
 {
+	eventDistributor.unregisterEventListener(OPENMSX_FINISH_FRAME_EVENT, *this);
 	eventDistributor.unregisterEventListener(OPENMSX_CLICOMMAND_EVENT, *this);
 }
 
+unsigned CliConnection::subscribeDebuggable(
+	string debuggable, unsigned start, unsigned size, unsigned period,
+	bool onChange)
+{
+	assert(period > 0);
+	DebugSubscription sub;
+	sub.debuggable = std::move(debuggable);
+	sub.id = ++lastSubscriptionId;
+	sub.start = start;
+	sub.size = size;
+	sub.period = period;
+	sub.countdown = 1; // send (initial) data at the end of this frame
+	sub.onChange = onChange;
+	sub.valid = false;
+	subscriptions.push_back(std::move(sub));
+	return lastSubscriptionId;
+}
+
+bool CliConnection::unsubscribeDebuggable(unsigned id)
+{
+	auto it = std::find_if(std::begin(subscriptions), std::end(subscriptions),
+		[&](const DebugSubscription& s) { return s.id == id; });
+	if (it == std::end(subscriptions)) return false;
+	subscriptions.erase(it);
+	return true;
+}
+
+void CliConnection::sendDebugUpdates()
+{
+	auto& controller = checked_cast<GlobalCommandController&>(commandController);
+	auto* motherBoard = controller.getReactor().getMotherBoard();
+	if (!motherBoard) return;
+	auto& debugger = motherBoard->getDebugger();
+
+	for (auto& sub : subscriptions) {
+		if (--sub.countdown) continue;
+		sub.countdown = sub.period;
+
+		auto* device = debugger.findDebuggable(sub.debuggable);
+		if (!device || (device->getSize() < sub.start) ||
+		    ((device->getSize() - sub.start) < sub.size)) {
+			// Maybe it's back later (e.g. after inserting an
+			// extension), but then send everything again.
+			sub.valid = false;
+			continue;
+		}
+		debugBuf.resize(sub.size);
+		byte* data = debugBuf.data();
+		device->readBlock(sub.start, data, sub.size);
+
+		// By default send everything, in 'onchange' mode only send
+		// the range from the first till the last modified byte.
+		unsigned first = 0;
+		unsigned num = sub.size;
+		if (sub.onChange) {
+			if (sub.valid) {
+				const byte* last = sub.last.data();
+				while ((first < num) && (data[first] == last[first])) {
+					++first;
+				}
+				if (first == num) continue; // no change
+				while (data[num - 1] == last[num - 1]) --num;
+				num -= first;
+				memcpy(sub.last.data() + first, data + first, num);
+			} else {
+				sub.last.resize(sub.size);
+				memcpy(sub.last.data(), data, sub.size);
+				sub.valid = true;
+			}
+		}
+		output(strCat("<update type=\"debug\" name=\"", sub.id,
+		              "\" offset=\"", sub.start + first, "\">",
+		              Base64::encode(data + first, num), "</update>\n"));
+	}
+}
+
 void CliConnection::log(CliComm::LogLevel level, string_view message)
 {
 	auto levelStr = CliComm::getLevelStrings();
@@ -143,6 +230,15 @@ static string reply(const string& message, bool status)
 
 int CliConnection::signalEvent(const std::shared_ptr<const Event>& event)
 {
+	if (event->getType() == OPENMSX_FINISH_FRAME_EVENT) {
+		auto& ffe = checked_cast<const FinishFrameEvent&>(*event);
+		// Only once per frame, also when there are multiple VDPs.
+		if (!subscriptions.empty() &&
+		    (ffe.getSource() == ffe.getSelectedSource())) {
+			sendDebugUpdates();
+		}
+		return 0;
+	}
 	auto& commandEvent = checked_cast<const CliCommandEvent&>(*event);
 	if (commandEvent.getId() == this) {
 		try {
@@ -7,9 +7,12 @@
 #include "CliComm.hh"
 #include "AdhocCliCommParser.hh"
 #include "Poller.hh"
+#include "MemBuffer.hh"
+#include "openmsx.hh"
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace openmsx {
 
@@ -26,6 +29,21 @@ public:
 		return updateEnabled[type];
 	}
 
+	/** Push (part of) a debuggable to this connection at the end of a
+	  * frame, see 'debug subscribe'. The debuggable is looked up by name
+	  * (in the active machine) each time, so it's fine if it (temporarily)
+	  * doesn't exist.
+	  * @param period Only check every 'period' frames.
+	  * @param onChange Only send the bytes that changed since the last
+	  *                 update (and nothing when nothing changed).
+	  * @return The id of the new subscription.
+	  */
+	unsigned subscribeDebuggable(std::string debuggable, unsigned start,
+	                             unsigned size, unsigned period,
+	                             bool onChange);
+	/** Returns false when there's no subscription with the given id. */
+	bool unsubscribeDebuggable(unsigned id);
+
 	/** Starts the helper thread.
 	  * Called when this CliConnection is added to GlobalCliComm (and
 	  * after it's allowed to respond to external commands).
@@ -65,6 +83,7 @@ private:
 	virtual void run() = 0;
 
 	void execute(const std::string& command);
+	void sendDebugUpdates();
 
 	// CliListener
 	void log(CliComm::LogLevel level, string_view message) override;
@@ -80,6 +99,21 @@ private:
 	std::thread thread;
 
 	bool updateEnabled[CliComm::NUM_UPDATES];
+
+	struct DebugSubscription {
+		std::string debuggable;
+		unsigned id;
+		unsigned start;
+		unsigned size;
+		unsigned period;
+		unsigned countdown;
+		bool onChange;
+		bool valid; // 'last' contains the previously sent data
+		MemBuffer<byte> last;
+	};
+	std::vector<DebugSubscription> subscriptions; // only main thread
+	MemBuffer<byte> debugBuf;
+	unsigned lastSubscriptionId;
 };
 
 class StdioConnection final : public CliConnection
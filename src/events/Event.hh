@@ -68,6 +68,9 @@ enum EventType
 	OPENMSX_MIDI_IN_COREMIDI_VIRTUAL_EVENT,
 	OPENMSX_RS232_TESTER_EVENT,
 
+	/** A screenshot was written (by a ScreenShotSaver worker thread) */
+	OPENMSX_SCREENSHOT_DONE_EVENT,
+
 	NUM_EVENT_TYPES // must be last
 };
 
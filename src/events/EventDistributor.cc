@@ -6,25 +6,38 @@
 #include "InputEventGenerator.hh"
 #include "Thread.hh"
 #include "KeyRange.hh"
+#include "xrange.hh"
 #include "stl.hh"
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <iterator>
 
 using std::string;
 
 namespace openmsx {
 
+static const size_t QUEUE_SIZE = 1024; // must be a power of 2
+
 EventDistributor::EventDistributor(Reactor& reactor_)
 	: reactor(reactor_)
+	, listenerGeneration(0)
+	, scheduledEvents(QUEUE_SIZE)
+	, overflow(false)
+	, pushing(0)
 {
+	auto empty = std::make_shared<const PriorityMap>();
+	for (auto type : xrange(int(NUM_EVENT_TYPES))) {
+		listeners[type] = empty;
+		hasListeners[type] = false;
+	}
 }
 
 void EventDistributor::registerEventListener(
 		EventType type, EventListener& listener, Priority priority)
 {
 	std::lock_guard<std::mutex> lock(mutex);
-	auto& priorityMap = listeners[type];
+	auto priorityMap = *listeners[type];
 	for (auto* l : values(priorityMap)) {
 		// a listener may only be registered once for each type
 		assert(l != &listener); (void)l;
@@ -33,48 +46,88 @@ void EventDistributor::registerEventListener(
 	auto it = upper_bound(begin(priorityMap), end(priorityMap), priority,
 	                      LessTupleElement<0>());
 	priorityMap.insert(it, {priority, &listener});
+	listeners[type] = std::make_shared<const PriorityMap>(std::move(priorityMap));
+	hasListeners[type] = true;
+	++listenerGeneration;
 }
 
 void EventDistributor::unregisterEventListener(
 		EventType type, EventListener& listener)
 {
 	std::lock_guard<std::mutex> lock(mutex);
-	auto& priorityMap = listeners[type];
+	auto priorityMap = *listeners[type];
 	priorityMap.erase(rfind_if_unguarded(priorityMap,
 		[&](PriorityMap::value_type v) { return v.second == &listener; }));
+	hasListeners[type] = !priorityMap.empty();
+	listeners[type] = std::make_shared<const PriorityMap>(std::move(priorityMap));
+	++listenerGeneration;
 }
 
 void EventDistributor::distributeEvent(const EventPtr& event)
 {
-	// TODO: Implement a real solution against modifying data structure while
-	//       iterating through it.
-	//       For example, assign nullptr first and then iterate again after
-	//       delivering events to remove the nullptr values.
 	// TODO: Is it useful to test for 0 listeners or should we just always
 	//       queue the event?
 	assert(event);
-	std::unique_lock<std::mutex> lock(mutex);
-	if (!listeners[event->getType()].empty()) {
-		scheduledEvents.push_back(event);
-		// must release lock, otherwise there's a deadlock:
-		//   thread 1: Reactor::deleteMotherBoard()
-		//             EventDistributor::unregisterEventListener()
-		//   thread 2: EventDistributor::distributeEvent()
-		//             Reactor::enterMainLoop()
-		condition.notify_all();
-		lock.unlock();
-		reactor.enterMainLoop();
+	if (!hasListeners[event->getType()]) return;
+
+	++pushing;
+	if (!overflow && scheduledEvents.push(event)) {
+		--pushing;
+	} else {
+		--pushing;
+		std::lock_guard<std::mutex> lock(mutex);
+		overflowEvents.push_back(event);
+		overflow = true;
 	}
+	// Don't hold a lock here, otherwise there's a deadlock:
+	//   thread 1: Reactor::deleteMotherBoard()
+	//             EventDistributor::unregisterEventListener()
+	//   thread 2: EventDistributor::distributeEvent()
+	//             Reactor::enterMainLoop()
+	condition.notify_all();
+	reactor.enterMainLoop();
+}
+
+std::shared_ptr<const EventDistributor::PriorityMap> EventDistributor::getListeners(
+	EventType type)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return listeners[type];
 }
 
-bool EventDistributor::isRegistered(EventType type, EventListener* listener) const
+bool EventDistributor::isRegistered(EventType type, EventListener* listener)
 {
-	for (auto* l : values(listeners[type])) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto* l : values(*listeners[type])) {
 		if (l == listener) return true;
 	}
 	return false;
 }
 
+bool EventDistributor::fetchEvents(EventQueue& result)
+{
+	EventPtr event;
+	while (scheduledEvents.pop(event)) {
+		result.push_back(std::move(event));
+	}
+	if (overflow && (pushing == 0)) {
+		// No thread is still pushing to 'scheduledEvents' (new ones
+		// see 'overflow'), so everything in there is older than the
+		// events in 'overflowEvents'. If some thread is still busy,
+		// take the overflow events on the next call.
+		while (scheduledEvents.pop(event)) {
+			result.push_back(std::move(event));
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		result.insert(end(result),
+		              std::make_move_iterator(begin(overflowEvents)),
+		              std::make_move_iterator(end  (overflowEvents)));
+		overflowEvents.clear();
+		overflow = false;
+	}
+	return !result.empty();
+}
+
 void EventDistributor::deliverEvents()
 {
 	assert(Thread::isMainThread());
@@ -82,8 +135,13 @@ void EventDistributor::deliverEvents()
 	reactor.getInputEventGenerator().poll();
 	reactor.getInterpreter().poll();
 	reactor.getRTScheduler().execute();
+	deliverQueuedEvents();
+}
+
+void EventDistributor::deliverQueuedEvents()
+{
+	assert(Thread::isMainThread());
 
-	std::unique_lock<std::mutex> lock(mutex);
 	// It's possible that executing an event triggers scheduling of another
 	// event. We also want to execute those secondary events. That's why
 	// we have this while loop here.
@@ -91,19 +149,20 @@ void EventDistributor::deliverEvents()
 	// event and as reaction to the latter event, AfterCommand will
 	// unsubscribe from the ols MSXEventDistributor. This really should be
 	// done before we exit this method.
-	while (!scheduledEvents.empty()) {
-		EventQueue eventsCopy;
-		swap(eventsCopy, scheduledEvents);
-
-		for (auto& event : eventsCopy) {
+	EventQueue events;
+	while (fetchEvents(events)) {
+		for (auto& event : events) {
 			auto type = event->getType();
-			auto priorityMapCopy = listeners[type];
-			lock.unlock();
+			// Take the generation before the snapshot: a change in
+			// between must still be noticed below.
+			auto generation = listenerGeneration.load();
+			auto priorityMap = getListeners(type);
 			auto blockPriority = unsigned(-1); // allow all
-			for (auto& p : priorityMapCopy) {
+			for (auto& p : *priorityMap) {
 				// It's possible delivery to one of the previous
 				// Listeners unregistered the current Listener.
-				if (!isRegistered(type, p.second)) continue;
+				if ((listenerGeneration != generation) &&
+				    !isRegistered(type, p.second)) continue;
 
 				unsigned currentPriority = p.first;
 				if (currentPriority >= blockPriority) break;
@@ -113,8 +172,8 @@ void EventDistributor::deliverEvents()
 					blockPriority = block;
 				}
 			}
-			lock.lock();
 		}
+		events.clear();
 	}
 }
 
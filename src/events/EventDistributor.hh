@@ -2,6 +2,8 @@
 #define EVENTDISTRIBUTOR_HH
 
 #include "Event.hh"
+#include "MPSCQueue.hh"
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -50,6 +52,7 @@ public:
 	/** Schedule the given event for delivery. Actual delivery happens
 	  * when the deliverEvents() method is called. Events are always
 	  * in the main thread.
+	  * This can be called from any thread, normally without taking a lock.
 	  */
 	void distributeEvent(const EventPtr& event);
 
@@ -59,6 +62,11 @@ public:
 	  */
 	void deliverEvents();
 
+	/** Like deliverEvents(), but without first polling the host for new
+	  * (input) events. Used by the headless 'run for' loop.
+	  */
+	void deliverQueuedEvents();
+
 	/** Sleep for the specified amount of time, but return early when
 	  * (another thread) called the distributeEvent() method.
 	  * @param us Amount of time to sleep, in micro seconds.
@@ -68,15 +76,30 @@ public:
 	bool sleep(unsigned us);
 
 private:
-	bool isRegistered(EventType type, EventListener* listener) const;
+	using PriorityMap = std::vector<std::pair<Priority, EventListener*>>; // sorted on priority
+	using EventQueue = std::vector<EventPtr>;
+
+	std::shared_ptr<const PriorityMap> getListeners(EventType type);
+	bool isRegistered(EventType type, EventListener* listener);
+	bool fetchEvents(EventQueue& result);
 
 	Reactor& reactor;
 
-	using PriorityMap = std::vector<std::pair<Priority, EventListener*>>; // sorted on priority
-	PriorityMap listeners[NUM_EVENT_TYPES];
-	using EventQueue = std::vector<EventPtr>;
-	EventQueue scheduledEvents;
-	std::mutex mutex; // lock datastructures
+	// Copy-on-write: (un)registering a listener replaces the map, so that
+	// delivery can use a snapshot without copying the map for each event.
+	std::shared_ptr<const PriorityMap> listeners[NUM_EVENT_TYPES];
+	std::atomic<bool> hasListeners[NUM_EVENT_TYPES];
+	std::atomic<unsigned> listenerGeneration; // changes on each (un)register
+
+	MPSCQueue<EventPtr> scheduledEvents;
+	// Only used when 'scheduledEvents' is full. From then on all threads
+	// use this queue, till the main thread emptied both queues. This keeps
+	// the events from a single thread in order.
+	EventQueue overflowEvents;
+	std::atomic<bool> overflow;
+	std::atomic<unsigned> pushing; // nr of threads in scheduledEvents.push()
+
+	std::mutex mutex; // lock listeners and overflowEvents
 	std::mutex cvMutex; // lock condition_variable
 	std::condition_variable condition;
 };
@@ -135,6 +135,7 @@ void DMKDiskImage::writeTrackImpl(byte track, byte side, const RawTrack& input)
 		extendImageToTrack(track);
 	}
 	doWriteTrack(track, side, input);
+	flushCaches(); // e.g. sha1sum
 }
 
 void DMKDiskImage::doWriteTrack(byte track, byte side, const RawTrack& input)
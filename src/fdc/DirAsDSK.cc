@@ -11,7 +11,14 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <ctime>
 #include <vector>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
 
 using std::string;
 using std::vector;
@@ -265,6 +272,11 @@ DirAsDSK::DirAsDSK(DiskChanger& diskChanger_, CliComm& cliComm_,
 	, hostDir(hostDir_.getResolved() + '/')
 	, syncMode(syncMode_)
 	, lastAccess(EmuTime::zero)
+	, fullSync(true)
+	, checkAllFiles(true)
+	, diskChanged(false)
+	, notifyFd(-1)
+	, lastWriteCluster(0)
 	, nofSectors((diskChanger_.isDoubleSidedDrive() ? 2 : 1) * SECTORS_PER_TRACK * NUM_TRACKS)
 	, nofSectorsPerFat((((3 * nofSectors) / (2 * SECTORS_PER_CLUSTER)) + SECTOR_SIZE - 1) / SECTOR_SIZE)
 	, firstSector2ndFAT(FIRST_FAT_SECTOR + nofSectorsPerFat)
@@ -319,10 +331,27 @@ DirAsDSK::DirAsDSK(DiskChanger& diskChanger_, CliComm& cliComm_,
 	// No host files are mapped to this disk yet.
 	assert(mapDirs.empty());
 
+#ifdef __linux__
+	// If this fails (e.g. out of watches) we fall back to checking
+	// modification times.
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+	if (auto* scheduler = diskChanger.getScheduler()) {
+		syncIdleFlush = std::make_unique<SyncIdleFlush>(*scheduler, *this);
+	}
+
 	// Import the host filesystem.
 	syncWithHost();
 }
 
+DirAsDSK::~DirAsDSK()
+{
+#ifdef __linux__
+	if (notifyFd != -1) close(notifyFd);
+#endif
+}
+
 bool DirAsDSK::isWriteProtectedImpl() const
 {
 	return syncMode == SYNC_READONLY;
@@ -342,10 +371,18 @@ void DirAsDSK::checkCaches()
 		needSync = true;
 	}
 	if (needSync) {
+		flushHostWrites();
 		flushCaches();
 	}
 }
 
+void DirAsDSK::flushSectorCaches(size_t /*sector*/)
+{
+	// A write to a FAT or directory sector can (via the host files) change
+	// the content of other sectors as well.
+	flushCaches();
+}
+
 void DirAsDSK::readSectorImpl(size_t sector, SectorBuffer& buf)
 {
 	assert(sector < nofSectors);
@@ -365,8 +402,7 @@ void DirAsDSK::readSectorImpl(size_t sector, SectorBuffer& buf)
 			// Happens when dirasdisk is used in virtual_drive.
 			needSync = true;
 		}
-		if (needSync) {
-			syncWithHost();
+		if (needSync && syncWithHost()) {
 			flushCaches(); // e.g. sha1sum
 			// Let the diskdrive report the disk has been ejected.
 			// E.g. a turbor machine uses this to flush its
@@ -379,24 +415,194 @@ void DirAsDSK::readSectorImpl(size_t sector, SectorBuffer& buf)
 	memcpy(&buf, &sectors[sector], sizeof(buf));
 }
 
-void DirAsDSK::syncWithHost()
+// Returns true iff the virtual disk was changed.
+bool DirAsDSK::syncWithHost()
 {
+	// Make sure the host files are up-to-date before comparing them.
+	flushHostWrites();
+
+	// Only look at the host files/directories that (possibly) changed
+	// since the previous sync.
+	if (!collectHostChanges()) return false;
+	diskChanged = false;
+	lastWriteCluster = 0;
+
 	// Check for removed host files. This frees up space in the virtual
 	// disk. Do this first because otherwise later actions may fail (run
 	// out of virtual disk space) for no good reason.
-	checkDeletedHostFiles();
+	vector<DirIndex> modified;
+	checkDeletedHostFiles(modified);
 
 	// Next update existing files. This may enlarge or shrink virtual
 	// files. In case not all host files fit on the virtual disk it's
 	// better to update the existing files than to (partly) add a too big
 	// new file and have no space left to enlarge the existing files.
-	checkModifiedHostFiles();
+	checkModifiedHostFiles(modified);
 
 	// Last add new host files (this can only consume virtual disk space).
-	addNewHostFiles({}, firstDirSector);
+	// Only directories that changed are re-scanned. Parent directories
+	// sort before their subdirectories, so a subdirectory that's already
+	// handled recursively is no longer in the set when we get there.
+	if (fullSync) {
+		addNewHostFiles({}, firstDirSector);
+	} else {
+		while (!dirtyDirs.empty()) {
+			string hostSubDir = *begin(dirtyDirs);
+			dirtyDirs.erase(begin(dirtyDirs));
+			unsigned msxDirSector = firstDirSector;
+			if (!hostSubDir.empty()) {
+				DirIndex dirIndex = findHostFileInDSK(
+					hostSubDir.substr(0, hostSubDir.size() - 1));
+				if (dirIndex.sector == unsigned(-1)) {
+					// Not (or no longer) mapped. If needed
+					// it gets added via its parent.
+					hostDirMtimes.erase(hostSubDir);
+					continue;
+				}
+				unsigned cluster = msxDir(dirIndex).startCluster;
+				if (!(msxDir(dirIndex).attrib & MSXDirEntry::ATT_DIRECTORY) ||
+				    (cluster < FIRST_CLUSTER) || (cluster >= maxCluster)) {
+					continue;
+				}
+				msxDirSector = clusterToSector(cluster);
+			}
+			addNewHostFiles(hostSubDir, msxDirSector);
+		}
+	}
+
+	dirtyDirs.clear();
+	dirtyFiles.clear();
+	fullSync = false;
+	return diskChanged;
 }
 
-void DirAsDSK::checkDeletedHostFiles()
+// Fill in 'dirtyDirs' and 'dirtyFiles' (or set 'fullSync'/'checkAllFiles').
+// Returns false when certainly nothing changed on the host.
+bool DirAsDSK::collectHostChanges()
+{
+	if (notifyFd != -1) {
+		readHostEvents();
+		checkAllFiles = fullSync;
+		return fullSync || !dirtyDirs.empty() || !dirtyFiles.empty();
+	}
+
+	// No change notification available. File content changes don't
+	// change the directory mtime, so (cheaply) stat all mapped files.
+	// Only directories with a changed mtime need to be re-scanned.
+	checkAllFiles = true;
+	if (!fullSync) {
+		for (auto& p : hostDirMtimes) {
+			FileOperations::Stat fst;
+			if (!FileOperations::getStat(hostDir + p.first, fst) ||
+			    (fst.st_mtime != p.second)) {
+				dirtyDirs.insert(p.first);
+			}
+		}
+	}
+	return true;
+}
+
+void DirAsDSK::readHostEvents()
+{
+#ifdef __linux__
+	alignas(struct inotify_event) char buf[4096];
+	while (true) {
+		ssize_t len = read(notifyFd, buf, sizeof(buf));
+		if (len <= 0) {
+			if ((len < 0) && (errno == EINTR)) continue;
+			break; // EAGAIN: no more events
+		}
+		for (char* p = buf; p < (buf + len); ) {
+			auto* event = reinterpret_cast<struct inotify_event*>(p);
+			p += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				// Lost events, check everything.
+				fullSync = true;
+				continue;
+			}
+			auto it = watches.find(event->wd);
+			if (it == end(watches)) continue;
+			if (event->mask & IN_IGNORED) {
+				// Watch was removed (e.g. directory deleted).
+				watches.erase(it);
+				continue;
+			}
+			const string& hostSubDir = it->second;
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				// Handled via the event in the parent directory,
+				// except for the root directory.
+				if (hostSubDir.empty()) fullSync = true;
+				continue;
+			}
+			if (event->len == 0) continue;
+			dirtyFiles.insert(hostSubDir + event->name);
+			if (event->mask & (IN_CREATE | IN_DELETE |
+			                   IN_MOVED_FROM | IN_MOVED_TO)) {
+				// New files may appear in this directory (also
+				// on delete: previously clashing files may now
+				// fit).
+				dirtyDirs.insert(hostSubDir);
+			}
+		}
+	}
+#endif
+}
+
+// Called each time a host directory is scanned for new files.
+void DirAsDSK::watchHostDir(const string& hostSubDir)
+{
+#ifdef __linux__
+	if (notifyFd != -1) {
+		int wd = inotify_add_watch(notifyFd, (hostDir + hostSubDir).c_str(),
+			IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE |
+			IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+			IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+		if (wd != -1) {
+			// For a renamed directory we get the same watch
+			// descriptor, so this also updates the name.
+			watches[wd] = hostSubDir;
+			return;
+		}
+		if (hostSubDir.empty() || (errno == ENOSPC)) {
+			// Can't watch (e.g. out of inotify watches). Switch
+			// to checking modification times, starting with a
+			// full sync.
+			cliComm.printWarning(
+				"Couldn't watch host directory for changes, "
+				"falling back to polling: ", hostDir, hostSubDir);
+			close(notifyFd);
+			notifyFd = -1;
+			watches.clear();
+			fullSync = true;
+		}
+		return;
+	}
+#endif
+	// Remember the modification time from before the directory was read,
+	// so that changes made while reading are detected next time. Mtimes
+	// typically have a resolution of one second, so when the directory
+	// changed very recently, it must be scanned again next time.
+	FileOperations::Stat fst;
+	time_t mtime = time_t(-1);
+	if (FileOperations::getStat(hostDir + hostSubDir, fst) &&
+	    (fst.st_mtime < (time(nullptr) - 1))) {
+		mtime = fst.st_mtime;
+	}
+	hostDirMtimes[hostSubDir] = mtime;
+}
+
+bool DirAsDSK::isHostDirDirty(const string& hostSubDir) const
+{
+	return fullSync || (dirtyDirs.find(hostSubDir) != end(dirtyDirs));
+}
+
+bool DirAsDSK::isHostFileDirty(const string& hostName) const
+{
+	return checkAllFiles || (dirtyFiles.find(hostName) != end(dirtyFiles));
+}
+
+void DirAsDSK::checkDeletedHostFiles(vector<DirIndex>& modified)
 {
 	// This handles both host files and directories.
 	auto copy = mapDirs;
@@ -414,6 +620,7 @@ void DirAsDSK::checkDeletedHostFiles()
 		}
 		const DirIndex& dirIndex = p.first;
 		MapDir& mapDir = p.second;
+		if (!isHostFileDirty(mapDir.hostName)) continue;
 		string fullHostName = hostDir + mapDir.hostName;
 		bool isMSXDirectory = (msxDir(dirIndex).attrib &
 		                       MSXDirEntry::ATT_DIRECTORY) != 0;
@@ -427,6 +634,11 @@ void DirAsDSK::checkDeletedHostFiles()
 			// name has been created). In both cases delete the msx
 			// entry (if needed it will be recreated soon).
 			deleteMSXFile(dirIndex);
+		} else if (!isMSXDirectory &&
+		           ((mapDir.mtime    != fst.st_mtime) ||
+		            (mapDir.filesize != size_t(fst.st_size)))) {
+			// Handled in checkModifiedHostFiles().
+			modified.push_back(dirIndex);
 		}
 	}
 }
@@ -441,6 +653,7 @@ void DirAsDSK::deleteMSXFile(DirIndex dirIndex)
 		// Directory entry not in use, don't need to do anything.
 		return;
 	}
+	diskChanged = true;
 
 	if (msxDir(dirIndex).attrib & MSXDirEntry::ATT_DIRECTORY) {
 		// If we're deleting a directory then also (recursively)
@@ -494,16 +707,16 @@ void DirAsDSK::freeFATChain(unsigned cluster)
 	}
 }
 
-void DirAsDSK::checkModifiedHostFiles()
+// 'modified' are the candidates found by checkDeletedHostFiles().
+void DirAsDSK::checkModifiedHostFiles(const vector<DirIndex>& modified)
 {
-	auto copy = mapDirs;
-	for (auto& p : copy) {
-		if (mapDirs.find(p.first) == end(mapDirs)) {
+	for (auto& dirIndex : modified) {
+		auto it = mapDirs.find(dirIndex);
+		if (it == end(mapDirs)) {
 			// See comment in checkDeletedHostFiles().
 			continue;
 		}
-		const DirIndex& dirIndex = p.first;
-		MapDir& mapDir = p.second;
+		MapDir& mapDir = it->second;
 		string fullHostName = hostDir + mapDir.hostName;
 		bool isMSXDirectory = (msxDir(dirIndex).attrib &
 		                       MSXDirEntry::ATT_DIRECTORY) != 0;
@@ -536,6 +749,7 @@ void DirAsDSK::importHostFile(DirIndex dirIndex, FileOperations::Stat& fst)
 {
 	assert(!(msxDir(dirIndex).attrib & MSXDirEntry::ATT_DIRECTORY));
 	assert(mapDirs.find(dirIndex) != end(mapDirs));
+	diskChanged = true;
 
 	// Set _msx_ modification time.
 	setMSXTimeStamp(dirIndex, fst);
@@ -693,6 +907,9 @@ void DirAsDSK::addNewHostFiles(const string& hostSubDir, unsigned msxDirSector)
 	assert(!StringOp::startsWith(hostSubDir, '/'));
 	assert(hostSubDir.empty() || StringOp::endsWith(hostSubDir, '/'));
 
+	dirtyDirs.erase(hostSubDir); // handled now
+	watchHostDir(hostSubDir);
+
 	vector<string> hostNames;
 	{
 		ReadDir dir(hostDir + hostSubDir);
@@ -785,6 +1002,10 @@ void DirAsDSK::addNewDirectory(const string& hostSubDir, const string& hostName,
 			return;
 		}
 		newMsxDirSector = clusterToSector(cluster);
+		if (!isHostDirDirty(strCat(hostPath, '/'))) {
+			// Existing directory without changes.
+			return;
+		}
 	}
 
 	// Recursively process this directory.
@@ -831,6 +1052,7 @@ DirAsDSK::DirIndex DirAsDSK::fillMSXDirEntry(
 
 		// Fill in hostName / msx filename.
 		assert(!StringOp::endsWith(hostPath, '/'));
+		diskChanged = true;
 		mapDirs[dirIndex].hostName = hostPath;
 		memset(&msxDir(dirIndex), 0, sizeof(MSXDirEntry)); // clear entry
 		memcpy(msxDir(dirIndex).filename, msxFilename.data(), 8 + 3);
@@ -920,6 +1142,10 @@ void DirAsDSK::writeSectorImpl(size_t sector_, const SectorBuffer& buf)
 
 void DirAsDSK::writeFATSector(unsigned sector, const SectorBuffer& buf)
 {
+	// Host files may get rewritten below.
+	flushHostWrites();
+	lastWriteCluster = 0;
+
 	// Create copy of old FAT (to be able to detect changes).
 	vector<SectorBuffer> oldFAT(nofSectorsPerFat);
 	memcpy(&oldFAT[0], fat(), SECTOR_SIZE * nofSectorsPerFat);
@@ -1282,6 +1508,10 @@ void DirAsDSK::exportToHostFile(DirIndex dirIndex, const string& hostName)
 void DirAsDSK::writeDIRSector(unsigned sector, DirIndex dirDirIndex,
                               const SectorBuffer& buf)
 {
+	// Host files may get deleted or rewritten below.
+	flushHostWrites();
+	lastWriteCluster = 0;
+
 	// Look for changed directory entries.
 	for (unsigned idx = 0; idx < DIR_ENTRIES_PER_SECTOR; ++idx) {
 		auto& newEntry = buf.dirEntry[idx];
@@ -1337,14 +1567,27 @@ void DirAsDSK::writeDataSector(unsigned sector, const SectorBuffer& buf)
 	// Buffer the write, whether the sector is mapped to a file or not.
 	memcpy(&sectors[sector], &buf, sizeof(buf));
 
-	// Get first cluster in the FAT chain that contains this sector.
-	unsigned cluster, offset, chainLength;
+	// Get first cluster in the FAT chain that contains this sector, and
+	// the corresponding directory entry. Both searches are relatively
+	// expensive, but files are usually written sequentially, so try to
+	// continue from the previous write.
+	unsigned cluster, offset;
 	sectorToCluster(sector, cluster, offset);
-	unsigned startCluster = getChainStart(cluster, chainLength);
-	offset += (sizeof(buf) * SECTORS_PER_CLUSTER) * chainLength;
-
-	// Get corresponding directory entry.
-	DirIndex dirIndex = getDirEntryForCluster(startCluster);
+	if (lastWriteCluster && (cluster != lastWriteCluster)) {
+		if (readFAT(lastWriteCluster) == cluster) {
+			++lastWriteChainLength;
+			lastWriteCluster = cluster;
+		} else {
+			lastWriteCluster = 0;
+		}
+	}
+	if (!lastWriteCluster) {
+		lastWriteStartCluster = getChainStart(cluster, lastWriteChainLength);
+		lastWriteDirIndex = getDirEntryForCluster(lastWriteStartCluster);
+		lastWriteCluster = cluster;
+	}
+	offset += (sizeof(buf) * SECTORS_PER_CLUSTER) * lastWriteChainLength;
+	DirIndex dirIndex = lastWriteDirIndex;
 	// no need to check for 'dirIndex.sector == unsigned(-1)'
 	auto it = mapDirs.find(dirIndex);
 	if (it == end(mapDirs)) {
@@ -1353,19 +1596,49 @@ void DirAsDSK::writeDataSector(unsigned sector, const SectorBuffer& buf)
 	}
 
 	// Actually write data to host file.
+	unsigned msxSize = msxDir(dirIndex).size;
+	if (msxSize <= offset) return;
 	string fullHostName = hostDir + it->second.hostName;
 	try {
-		File file(fullHostName, "rb+"); // don't uncompress
-		file.seek(offset);
-		unsigned msxSize = msxDir(dirIndex).size;
-		if (msxSize > offset) {
-			auto writeSize = std::min<size_t>(msxSize - offset, sizeof(buf));
-			file.write(&buf, writeSize);
+		if (!hostWriteFile.is_open() || (hostWriteName != fullHostName)) {
+			flushHostWrites();
+			hostWriteFile = File(fullHostName, "rb+"); // don't uncompress
+			hostWriteName = fullHostName;
+		}
+		hostWriteFile.seek(offset);
+		auto writeSize = std::min<size_t>(msxSize - offset, sizeof(buf));
+		hostWriteFile.write(&buf, writeSize);
+		if (syncIdleFlush) {
+			syncIdleFlush->schedule(lastAccess + EmuDuration::sec(1));
 		}
 	} catch (FileException& e) {
+		hostWriteFile.close();
 		cliComm.printWarning("Couldn't write to file ", fullHostName,
 		                     ": ", e.getMessage());
 	}
 }
 
+void DirAsDSK::flushHostWrites()
+{
+	if (!hostWriteFile.is_open()) return;
+	try {
+		hostWriteFile.flush();
+	} catch (FileException& e) {
+		cliComm.printWarning("Couldn't write to file ", hostWriteName,
+		                     ": ", e.getMessage());
+	}
+	hostWriteFile.close();
+}
+
+void DirAsDSK::SyncIdleFlush::executeUntil(EmuTime::param time)
+{
+	// Every disk access postpones the flush.
+	auto flushTime = disk.lastAccess + EmuDuration::sec(1);
+	if (time < flushTime) {
+		setSyncPoint(flushTime);
+	} else {
+		disk.flushHostWrites();
+	}
+}
+
 } // namespace openmsx
@@ -5,7 +5,11 @@
 #include "DiskImageUtils.hh"
 #include "FileOperations.hh"
 #include "EmuTime.hh"
+#include "Schedulable.hh"
+#include "File.hh"
 #include <map>
+#include <memory>
+#include <set>
 
 namespace openmsx {
 
@@ -22,12 +26,14 @@ public:
 	DirAsDSK(DiskChanger& diskChanger, CliComm& cliComm,
 	         const Filename& hostDir, SyncMode syncMode,
 	         BootSectorType bootSectorType);
+	~DirAsDSK();
 
 	// SectorBasedDisk
 	void readSectorImpl (size_t sector,       SectorBuffer& buf) override;
 	void writeSectorImpl(size_t sector, const SectorBuffer& buf) override;
 	bool isWriteProtectedImpl() const override;
 	void checkCaches() override;
+	void flushSectorCaches(size_t sector) override;
 
 private:
 	struct DirIndex {
@@ -59,10 +65,16 @@ private:
 	void writeDIRSector (unsigned sector, DirIndex dirDirIndex,
 	                     const SectorBuffer& buf);
 	void writeDataSector(unsigned sector, const SectorBuffer& buf);
+	void flushHostWrites();
 	void writeDIREntry(DirIndex dirIndex, DirIndex dirDirIndex,
 	                   const MSXDirEntry& newEntry);
-	void syncWithHost();
-	void checkDeletedHostFiles();
+	bool syncWithHost();
+	bool collectHostChanges();
+	void readHostEvents();
+	void watchHostDir(const std::string& hostSubDir);
+	bool isHostDirDirty(const std::string& hostSubDir) const;
+	bool isHostFileDirty(const std::string& hostName) const;
+	void checkDeletedHostFiles(std::vector<DirIndex>& modified);
 	void deleteMSXFile(DirIndex dirIndex);
 	void deleteMSXFilesInDir(unsigned msxDirSector);
 	void freeFATChain(unsigned cluster);
@@ -80,7 +92,7 @@ private:
 	unsigned nextMsxDirSector(unsigned sector);
 	bool checkMSXFileExists(const std::string& msxfilename,
 	                        unsigned msxDirSector);
-	void checkModifiedHostFiles();
+	void checkModifiedHostFiles(const std::vector<DirIndex>& modified);
 	void setMSXTimeStamp(DirIndex dirIndex, FileOperations::Stat& fst);
 	void importHostFile(DirIndex dirIndex, FileOperations::Stat& fst);
 	void exportToHost(DirIndex dirIndex, DirIndex dirDirIndex);
@@ -127,6 +139,52 @@ private:
 	using MapDirs = std::map<DirIndex, MapDir>;
 	MapDirs mapDirs;
 
+	// Host changes since the last sync. Directories are relative to
+	// 'hostDir' and end with a '/' (the root directory is the empty
+	// string), files are relative to 'hostDir'. When 'fullSync' is set,
+	// everything is considered changed. When 'checkAllFiles' is set, all
+	// mapped host files are checked (with stat()) and 'dirtyFiles' is not
+	// used.
+	std::set<std::string> dirtyDirs;
+	std::set<std::string> dirtyFiles;
+	bool fullSync;
+	bool checkAllFiles;
+	bool diskChanged; // did the current sync change the virtual disk?
+
+	// Change notification from the host OS (inotify on linux), -1 if not
+	// available. In that case 'hostDirMtimes' is used instead: it holds
+	// the modification time of each scanned host directory. A directory
+	// only has to be re-scanned for new files when its mtime changed.
+	int notifyFd;
+	std::map<int, std::string> watches; // watch descriptor -> hostSubDir
+	std::map<std::string, time_t> hostDirMtimes;
+
+	// Consecutive data sector writes to the same host file are batched:
+	// the file stays open (and buffered) until a different file is
+	// written, the FAT or a directory changes, on the next sync, or when
+	// the disk wasn't accessed for one second.
+	File hostWriteFile;
+	std::string hostWriteName;
+	// Flushes 'hostWriteFile' once the disk is idle. Not available
+	// without a scheduler (virtual_drive), then the file stays open until
+	// the next flush trigger (at the latest on the next read).
+	struct SyncIdleFlush final : Schedulable {
+		SyncIdleFlush(Scheduler& s, DirAsDSK& disk_)
+			: Schedulable(s), disk(disk_) {}
+		void schedule(EmuTime::param time) {
+			if (!pendingSyncPoint()) setSyncPoint(time);
+		}
+		void executeUntil(EmuTime::param time) override;
+		DirAsDSK& disk;
+	};
+	std::unique_ptr<SyncIdleFlush> syncIdleFlush;
+	// Speeds up locating the file for consecutive data sector writes.
+	// Only valid until the next FAT or directory change.
+	unsigned lastWriteCluster; // 0 if invalid
+	unsigned lastWriteStartCluster;
+	unsigned lastWriteChainLength;
+	DirIndex lastWriteDirIndex;
+
 	// format parameters which depend on single/double sided
 	// varying root parameters
 	const unsigned nofSectors;
@@ -16,7 +16,8 @@ void Disk::writeTrack(byte track, byte side, const RawTrack& input)
 		throw WriteProtectedException();
 	}
 	writeTrackImpl(track, side, input);
-	flushCaches();
+	// writeTrackImpl() is responsible for flushing the caches, for
+	// SectorBasedDisk this (selectively) happens in writeSector().
 }
 
 bool Disk::isDoubleSided()
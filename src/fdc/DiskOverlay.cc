@@ -0,0 +1,99 @@
+#include "DiskOverlay.hh"
+#include "FileOperations.hh"
+#include "FileException.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace openmsx {
+
+// All overlays that are currently alive. There are only very few (at most
+// one per hard disk), a plain vector is fine.
+static std::vector<std::weak_ptr<DiskOverlay>>& getRegistry()
+{
+	static std::vector<std::weak_ptr<DiskOverlay>> registry;
+	return registry;
+}
+
+std::shared_ptr<DiskOverlay> DiskOverlay::create(size_t nbSectors)
+{
+	auto result = std::make_shared<DiskOverlay>(nbSectors);
+	auto& registry = getRegistry();
+	// also drop entries for overlays that no longer exist
+	registry.erase(std::remove_if(begin(registry), end(registry),
+	                              [](const std::weak_ptr<DiskOverlay>& w) {
+	                                      return w.expired(); }),
+	               end(registry));
+	registry.push_back(result);
+	return result;
+}
+
+std::shared_ptr<DiskOverlay> DiskOverlay::find(const std::string& deltaName)
+{
+	for (auto& w : getRegistry()) {
+		if (auto overlay = w.lock()) {
+			if (overlay->getDeltaName() == deltaName) return overlay;
+		}
+	}
+	return nullptr;
+}
+
+DiskOverlay::DiskOverlay(size_t nbSectors)
+	: modified(nbSectors, false)
+	, nbModified(0)
+{
+	std::string dir = FileOperations::join(
+		FileOperations::getTempDir(), "openmsx");
+	FileOperations::mkdirp(dir);
+	{
+		auto fp = FileOperations::openUniqueFile(dir, deltaName);
+		if (!fp) {
+			throw FileException("Couldn't create overlay file in ", dir);
+		}
+	}
+	try {
+		delta = File(deltaName, File::TRUNCATE);
+		// Only reserve the size, don't write anything: this keeps the
+		// file sparse.
+		delta.truncate(nbSectors * sizeof(SectorBuffer));
+	} catch (MSXException&) {
+		FileOperations::unlink(deltaName);
+		throw;
+	}
+}
+
+DiskOverlay::~DiskOverlay()
+{
+	delta.close();
+	FileOperations::unlink(deltaName);
+}
+
+std::vector<size_t> DiskOverlay::getModifiedSectors() const
+{
+	std::vector<size_t> result;
+	result.reserve(nbModified);
+	for (auto i : xrange(modified.size())) {
+		if (modified[i]) result.push_back(i);
+	}
+	return result;
+}
+
+void DiskOverlay::read(size_t sector, SectorBuffer& buf)
+{
+	assert(isModified(sector));
+	delta.seek(sector * sizeof(buf));
+	delta.read(&buf, sizeof(buf));
+}
+
+void DiskOverlay::write(size_t sector, const SectorBuffer& buf)
+{
+	assert(sector < modified.size());
+	delta.seek(sector * sizeof(buf));
+	delta.write(&buf, sizeof(buf));
+	if (!modified[sector]) {
+		modified[sector] = true;
+		++nbModified;
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,63 @@
+#ifndef DISKOVERLAY_HH
+#define DISKOVERLAY_HH
+
+#include "DiskImageUtils.hh"
+#include "File.hh"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openmsx {
+
+/** Copy-on-write layer on top of a SectorAccessibleDisk.
+  *
+  * Written sectors are stored in a temporary delta file, at the same offset
+  * as in the disk image. That file is created with the full size of the
+  * image, but (on filesystems that support it) only the written sectors
+  * take space. A bitmap in memory tracks which sectors are in the delta
+  * file, all other sectors are read from the (unmodified) disk image.
+  *
+  * The delta file is removed when the last reference to the overlay goes
+  * away. While it exists, the overlay can be found back by the name of
+  * the delta file, that's what makes it possible to store an overlay in a
+  * savestate (e.g. for reverse).
+  */
+class DiskOverlay
+{
+public:
+	/** Create a new, empty overlay for a disk with the given number of
+	  * sectors. Throws MSXException when the delta file can't be created.
+	  */
+	static std::shared_ptr<DiskOverlay> create(size_t nbSectors);
+
+	/** Lookup an existing overlay by the name of its delta file.
+	  * Returns nullptr if there is no such overlay (anymore).
+	  */
+	static std::shared_ptr<DiskOverlay> find(const std::string& deltaName);
+
+	explicit DiskOverlay(size_t nbSectors); // use create() instead
+	~DiskOverlay();
+
+	const std::string& getDeltaName() const { return deltaName; }
+	size_t getNbSectors() const { return modified.size(); }
+	size_t getNbModified() const { return nbModified; }
+	bool isModified(size_t sector) const {
+		return (sector < modified.size()) && modified[sector];
+	}
+	/** All modified sectors, in increasing order. */
+	std::vector<size_t> getModifiedSectors() const;
+
+	/** Read a modified sector, see isModified(). */
+	void read(size_t sector, SectorBuffer& buf);
+	void write(size_t sector, const SectorBuffer& buf);
+
+private:
+	std::string deltaName;
+	File delta;
+	std::vector<bool> modified;
+	size_t nbModified;
+};
+
+} // namespace openmsx
+
+#endif
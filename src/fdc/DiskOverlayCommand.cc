@@ -0,0 +1,66 @@
+#include "DiskOverlayCommand.hh"
+#include "SectorAccessibleDisk.hh"
+#include "CommandException.hh"
+#include "MSXException.hh"
+#include "TclObject.hh"
+#include "strCat.hh"
+
+using std::string;
+using std::vector;
+
+namespace openmsx {
+
+DiskOverlayCommand::DiskOverlayCommand(
+		CommandController& commandController_,
+		const string& diskName, SectorAccessibleDisk& disk_,
+		std::function<void()> discard_)
+	: Command(commandController_, strCat(diskName, "_overlay"))
+	, disk(disk_)
+	, discard(std::move(discard_))
+{
+}
+
+void DiskOverlayCommand::execute(array_ref<TclObject> tokens, TclObject& result)
+{
+	if (tokens.size() == 1) {
+		result.setBoolean(disk.hasOverlay());
+	} else if ((tokens.size() == 2) && (tokens[1] == "create")) {
+		try {
+			disk.createOverlay();
+		} catch (MSXException& e) {
+			throw CommandException("Can't create overlay: ",
+			                       e.getMessage());
+		}
+	} else if ((tokens.size() == 2) && (tokens[1] == "commit")) {
+		try {
+			disk.commitOverlay();
+		} catch (MSXException& e) {
+			throw CommandException("Can't commit overlay: ",
+			                       e.getMessage());
+		}
+	} else if ((tokens.size() == 2) && (tokens[1] == "discard")) {
+		discard();
+	} else {
+		throw SyntaxError();
+	}
+}
+
+string DiskOverlayCommand::help(const vector<string>& /*tokens*/) const
+{
+	const string& cmd = getName();
+	return strCat(
+		cmd, "         : is a copy-on-write overlay in use?\n",
+		cmd, " create  : from now on write to a copy-on-write overlay instead of to the image\n",
+		cmd, " commit  : write the overlay to the image and stop using the overlay\n",
+		cmd, " discard : undo all writes since the overlay was created\n");
+}
+
+void DiskOverlayCommand::tabCompletion(vector<string>& tokens) const
+{
+	static const char* const subCmds[] = { "create", "commit", "discard" };
+	if (tokens.size() == 2) {
+		completeString(tokens, subCmds);
+	}
+}
+
+} // namespace openmsx
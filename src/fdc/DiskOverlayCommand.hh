@@ -0,0 +1,46 @@
+#ifndef DISKOVERLAYCOMMAND_HH
+#define DISKOVERLAYCOMMAND_HH
+
+#include "Command.hh"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace openmsx {
+
+class CommandController;
+class SectorAccessibleDisk;
+
+/** The '<disk>_overlay' command, manages the copy-on-write overlay (see
+  * DiskOverlay) of a harddisk or LS-120 image.
+  *
+  * The overlay only lives on the host, just like the content of the image
+  * itself. So unlike e.g. the 'hda' command this is not a RecordedCommand:
+  * replaying a recording must never create an overlay or write one to the
+  * image.
+  */
+class DiskOverlayCommand final : public Command
+{
+public:
+	/** @param discard Called for the 'discard' subcommand. The device
+	  *        may have to do more than just removing the overlay (e.g.
+	  *        signal a media change), or it can refuse by throwing a
+	  *        CommandException.
+	  */
+	DiskOverlayCommand(CommandController& commandController,
+	                   const std::string& diskName,
+	                   SectorAccessibleDisk& disk,
+	                   std::function<void()> discard);
+
+	void execute(array_ref<TclObject> tokens, TclObject& result) override;
+	std::string help(const std::vector<std::string>& tokens) const override;
+	void tabCompletion(std::vector<std::string>& tokens) const override;
+
+private:
+	SectorAccessibleDisk& disk;
+	const std::function<void()> discard;
+};
+
+} // namespace openmsx
+
+#endif
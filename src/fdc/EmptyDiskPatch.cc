@@ -15,7 +15,7 @@ void EmptyDiskPatch::copyBlock(size_t src, byte* dst, size_t num) const
 	assert(num == SectorAccessibleDisk::SECTOR_SIZE);
 	assert((src % SectorAccessibleDisk::SECTOR_SIZE) == 0);
 	auto& buf = *aligned_cast<SectorBuffer*>(dst);
-	disk.readSectorImpl(src / SectorAccessibleDisk::SECTOR_SIZE, buf);
+	disk.readSectorNoPatch(src / SectorAccessibleDisk::SECTOR_SIZE, buf);
 }
 
 size_t EmptyDiskPatch::getSize() const
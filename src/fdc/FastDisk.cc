@@ -0,0 +1,56 @@
+#include "FastDisk.hh"
+#include "MSXMotherBoard.hh"
+#include "CommandException.hh"
+#include "TclObject.hh"
+
+namespace openmsx {
+
+FastDisk::FastDisk(MSXMotherBoard& motherBoard)
+	: RecordedCommand(motherBoard.getCommandController(),
+	                  motherBoard.getStateChangeDistributor(),
+	                  motherBoard.getScheduler(),
+	                  "fast_disk")
+	, enabled(false)
+{
+}
+
+void FastDisk::execute(array_ref<TclObject> tokens, TclObject& result,
+                       EmuTime::param /*time*/)
+{
+	if (tokens.size() == 2) {
+		if (tokens[1] == "on") {
+			enabled = true;
+		} else if (tokens[1] == "off") {
+			enabled = false;
+		} else {
+			throw SyntaxError();
+		}
+	} else if (tokens.size() != 1) {
+		throw SyntaxError();
+	}
+	result.setString(enabled ? "on" : "off");
+}
+
+std::string FastDisk::help(const std::vector<std::string>& /*tokens*/) const
+{
+	return "fast_disk        : show whether fast disk mode is enabled\n"
+	       "fast_disk on|off : enable or disable fast disk mode\n"
+	       "In fast disk mode the floppy disk controllers don't wait for "
+	       "the disk to rotate or for the head to move, sectors are "
+	       "transferred as fast as the MSX software can handle them.";
+}
+
+void FastDisk::tabCompletion(std::vector<std::string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static const char* const values[] = { "on", "off" };
+		completeString(tokens, values);
+	}
+}
+
+bool FastDisk::needRecord(array_ref<TclObject> tokens) const
+{
+	return tokens.size() > 1;
+}
+
+} // namespace openmsx
@@ -0,0 +1,43 @@
+#ifndef FASTDISK_HH
+#define FASTDISK_HH
+
+#include "RecordedCommand.hh"
+
+namespace openmsx {
+
+class MSXMotherBoard;
+
+/** The 'fast_disk' command: the (per machine) on/off switch for the fast
+  * disk mode of the floppy disk controllers.
+  *
+  * In fast mode WD2793 and TC8566AF don't wait for the disk to rotate to the
+  * requested sector, don't wait for head stepping or head settling, and make
+  * each data byte of a sector transfer available as soon as the CPU asks for
+  * it. The drive itself keeps rotating as usual, the controller only looks
+  * ahead on the track instead of waiting for the data to pass below the head.
+  *
+  * Switching the mode changes the emulated timing. That's why it's a
+  * recorded command (so that replays see the switch at the same moment) and
+  * why its value is part of the savestate (see MSXFDC).
+  */
+class FastDisk final : public RecordedCommand
+{
+public:
+	explicit FastDisk(MSXMotherBoard& motherBoard);
+
+	bool isEnabled() const { return enabled; }
+	void setEnabled(bool enabled_) { enabled = enabled_; }
+
+	void execute(array_ref<TclObject> tokens, TclObject& result,
+	             EmuTime::param time) override;
+	std::string help(const std::vector<std::string>& tokens) const override;
+	void tabCompletion(std::vector<std::string>& tokens) const override;
+	bool needRecord(array_ref<TclObject> tokens) const override;
+
+private:
+	bool enabled;
+};
+
+} // namespace openmsx
+
+#endif
@@ -1,5 +1,7 @@
 #include "MSXFDC.hh"
 #include "RealDrive.hh"
+#include "FastDisk.hh"
+#include "MSXMotherBoard.hh"
 #include "Rom.hh"
 #include "XMLElement.hh"
 #include "MSXException.hh"
@@ -13,6 +15,8 @@ MSXFDC::MSXFDC(const DeviceConfig& config, const std::string& romId, bool needRO
 	, rom(needROM
 		? std::make_unique<Rom>(getName() + " ROM", "rom", config, romId)
 		: nullptr) // e.g. Spectravideo_SVI-328 doesn't have a diskrom
+	, fastDisk(getMotherBoard().getSharedStuff<FastDisk>(
+		"fastDisk", getMotherBoard()))
 {
 	if (needROM && (rom->getSize() == 0)) {
 		throw MSXException(
@@ -63,8 +67,10 @@ const byte* MSXFDC::getReadCacheLine(word start) const
 }
 
 
+// version 1: initial version
+// version 2: added fastDisk
 template<typename Archive>
-void MSXFDC::serialize(Archive& ar, unsigned /*version*/)
+void MSXFDC::serialize(Archive& ar, unsigned version)
 {
 	ar.template serializeBase<MSXDevice>(*this);
 
@@ -79,6 +85,16 @@ void MSXFDC::serialize(Archive& ar, unsigned /*version*/)
 			ar.serialize(tag, *drive);
 		}
 	}
+
+	// All FDCs in a machine share the same value, so restoring it more
+	// than once is harmless.
+	bool fast = fastDisk->isEnabled();
+	if (ar.versionAtLeast(version, 2)) {
+		ar.serialize("fastDisk", fast);
+	} else {
+		fast = false;
+	}
+	if (ar.isLoader()) fastDisk->setEnabled(fast);
 }
 INSTANTIATE_SERIALIZE_METHODS(MSXFDC);
 
@@ -8,6 +8,7 @@
 namespace openmsx {
 
 class DiskDrive;
+class FastDisk;
 class Rom;
 
 class MSXFDC : public MSXDevice
@@ -28,7 +29,9 @@ protected:
 
 	std::unique_ptr<Rom> rom;
 	std::unique_ptr<DiskDrive> drives[4];
+	std::shared_ptr<FastDisk> fastDisk; // shared by all FDCs in a machine
 };
+SERIALIZE_CLASS_VERSION(MSXFDC, 2);
 
 REGISTER_BASE_NAME_HELPER(MSXFDC, "FDC");
 
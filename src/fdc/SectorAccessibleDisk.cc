@@ -1,4 +1,5 @@
 #include "SectorAccessibleDisk.hh"
+#include "DiskOverlay.hh"
 #include "EmptyDiskPatch.hh"
 #include "IPSPatch.hh"
 #include "DiskExceptions.hh"
@@ -51,11 +52,24 @@ void SectorAccessibleDisk::writeSector(size_t sector, const SectorBuffer& buf)
 		throw NoSuchSectorException("No such sector");
 	}
 	try {
-		writeSectorImpl(sector, buf);
+		if (overlay) {
+			overlay->write(sector, buf);
+		} else {
+			writeSectorImpl(sector, buf);
+		}
 	} catch (MSXException& e) {
 		throw DiskIOErrorException("Disk I/O error: ", e.getMessage());
 	}
-	flushCaches();
+	flushSectorCaches(sector);
+}
+
+void SectorAccessibleDisk::readSectorNoPatch(size_t sector, SectorBuffer& buf)
+{
+	if (overlay && overlay->isModified(sector)) {
+		overlay->read(sector, buf);
+	} else {
+		readSectorImpl(sector, buf);
+	}
 }
 
 size_t SectorAccessibleDisk::getNbSectors() const
@@ -78,6 +92,69 @@ bool SectorAccessibleDisk::hasPatches() const
 	return !patch->isEmptyPatch();
 }
 
+void SectorAccessibleDisk::createOverlay()
+{
+	if (overlay) {
+		throw MSXException("There already is an overlay");
+	}
+	size_t nbSectors = getNbSectors();
+	if (nbSectors == 0) {
+		throw MSXException("No disk image");
+	}
+	overlay = DiskOverlay::create(nbSectors);
+}
+
+void SectorAccessibleDisk::commitOverlay()
+{
+	if (!overlay) {
+		throw MSXException("There is no overlay");
+	}
+	if (forcedWriteProtect || isWriteProtectedImpl()) {
+		throw MSXException("Disk image is write protected");
+	}
+	// On error the overlay is kept: the sectors that were already
+	// written have the same content in the image and in the overlay, so
+	// the commit can simply be retried.
+	auto sectors = overlay->getModifiedSectors();
+	try {
+		SectorBuffer buf;
+		for (auto sector : sectors) {
+			overlay->read(sector, buf);
+			writeSectorImpl(sector, buf);
+		}
+	} catch (MSXException& e) {
+		throw DiskIOErrorException("Disk I/O error: ", e.getMessage());
+	}
+	overlay.reset();
+	for (auto sector : sectors) flushSectorCaches(sector);
+}
+
+void SectorAccessibleDisk::discardOverlay()
+{
+	if (!overlay) return;
+	auto sectors = overlay->getModifiedSectors();
+	overlay.reset();
+	for (auto sector : sectors) flushSectorCaches(sector);
+}
+
+bool SectorAccessibleDisk::restoreOverlay(const std::string& deltaName)
+{
+	auto existing = DiskOverlay::find(deltaName);
+	bool found = existing && (existing->getNbSectors() == getNbSectors());
+	overlay.reset();
+	if (found) {
+		overlay = std::move(existing);
+	} else {
+		try {
+			createOverlay();
+		} catch (MSXException&) {
+			forceWriteProtect();
+		}
+	}
+	flushCaches();
+	return found;
+}
+
 Sha1Sum SectorAccessibleDisk::getSha1Sum(FilePool& filePool)
 {
 	checkCaches();
@@ -133,7 +210,8 @@ int SectorAccessibleDisk::writeSectors(
 
 bool SectorAccessibleDisk::isWriteProtected() const
 {
-	return forcedWriteProtect || isWriteProtectedImpl();
+	// With an overlay, the image itself isn't written.
+	return forcedWriteProtect || (!overlay && isWriteProtectedImpl());
 }
 
 void SectorAccessibleDisk::forceWriteProtect()
@@ -157,4 +235,9 @@ void SectorAccessibleDisk::flushCaches()
 	sha1cache.clear();
 }
 
+void SectorAccessibleDisk::flushSectorCaches(size_t /*sector*/)
+{
+	flushCaches();
+}
+
 } // namespace openmsx
@@ -4,11 +4,13 @@
 #include "DiskImageUtils.hh"
 #include "Filename.hh"
 #include "sha1.hh"
-#include <vector>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace openmsx {
 
+class DiskOverlay;
 class FilePool;
 class PatchInterface;
 
@@ -33,6 +35,22 @@ public:
 	std::vector<Filename> getPatches() const;
 	bool hasPatches() const;
 
+	// copy-on-write overlay stuff
+	/** From now on store all writes in a (new, empty) copy-on-write
+	  * overlay, see DiskOverlay. The disk image itself is no longer
+	  * written, so the disk also accepts writes when the image is
+	  * read-only. Throws MSXException if there already is an overlay.
+	  */
+	void createOverlay();
+	/** Write all sectors from the overlay to the disk image and remove
+	  * the overlay. The content of the disk doesn't change.
+	  */
+	void commitOverlay();
+	/** Remove the overlay, all writes since it was created are lost. */
+	void discardOverlay();
+	bool hasOverlay() const { return overlay != nullptr; }
+	const DiskOverlay* getOverlay() const { return overlay.get(); }
+
 	/** Calculate SHA1 of the content of this disk.
 	 * This value is cached (and flushed on writes).
 	 */
@@ -57,8 +75,22 @@ protected:
 	void setPeekMode(bool peek) { peekMode = peek; }
 	bool isPeekMode() const { return peekMode; }
 
+	/** Re-attach the overlay with the given delta file, used when
+	  * loading a savestate. When that overlay no longer exists (e.g.
+	  * after a restart of openMSX), a new, empty overlay is used instead,
+	  * and when even that fails the disk is write-protected. Either way
+	  * writes never end up in the disk image itself.
+	  * @return False iff the original overlay wasn't found.
+	  */
+	bool restoreOverlay(const std::string& deltaName);
+
 	virtual void checkCaches();
 	virtual void flushCaches();
+	/** Called after the given sector was written. The default
+	  * implementation flushes all caches, subclasses can be more
+	  * selective.
+	  */
+	virtual void flushSectorCaches(size_t sector);
 	virtual Sha1Sum getSha1SumImpl(FilePool& filepool);
 
 private:
@@ -67,7 +99,11 @@ private:
 	virtual size_t getNbSectorsImpl() const = 0;
 	virtual bool isWriteProtectedImpl() const = 0;
 
+	// readSectorImpl(), or the sector from the overlay
+	void readSectorNoPatch(size_t sector, SectorBuffer& buf);
+
 	std::unique_ptr<const PatchInterface> patch;
+	std::shared_ptr<DiskOverlay> overlay;
 	Sha1Sum sha1cache;
 	bool forcedWriteProtect;
 	bool peekMode;
@@ -1,18 +1,35 @@
 #include "SectorBasedDisk.hh"
+#include "CRC16.hh"
 #include "MSXException.hh"
 #include <cassert>
+#include <cstring>
 
 namespace openmsx {
 
 SectorBasedDisk::SectorBasedDisk(DiskName name_)
 	: Disk(std::move(name_))
 	, nbSectors(size_t(-1)) // to detect misuse
-	, cachedTrackNum(-1)
+	, flushCount(0)
 {
 }
 
+// Offset of the data of the n-th sector (0-based) in a synthesized track,
+// see the layout in synthesizeTrack().
+static const unsigned SECTOR_DATA_OFFSET = 80 + 12 + 4 + 50 + 12 + 4 + 4 + 2 + 22 + 12 + 4;
+static const unsigned SECTOR_RAW_SIZE = 658;
+static const unsigned SECTORS_IN_TRACK = 9;
+
 void SectorBasedDisk::writeTrackImpl(byte track, byte side, const RawTrack& input)
 {
+	// The track that was written is very often the (modified) result of an
+	// earlier readTrack(), with only one or a few sectors changed. Compare
+	// with that earlier result and only write the sectors that changed.
+	checkCaches();
+	std::unique_ptr<CachedTrack> old;
+	unsigned num = 2 * track + side;
+	if (num < trackCache.size()) old = std::move(trackCache[num]);
+
+	bool changed = false;
 	for (auto& s : input.decodeAll()) {
 		// Ignore 'track' and 'head' information
 		// Always assume sectorsize = 512 (so also ignore sizeCode).
@@ -23,30 +40,65 @@ void SectorBasedDisk::writeTrackImpl(byte track, byte side, const RawTrack& inpu
 		SectorBuffer buf;
 		input.readBlock(s.dataIdx, 512, buf.raw);
 		auto logicalSector = physToLog(track, side, s.sector);
+		if (old && (s.sector <= SECTORS_IN_TRACK) &&
+		    (logicalSector == old->firstSector + s.sector - 1) &&
+		    (memcmp(buf.raw, old->data.getRawBuffer() + SECTOR_DATA_OFFSET +
+		                     (s.sector - 1) * SECTOR_RAW_SIZE, 512) == 0)) {
+			continue; // unchanged
+		}
 		writeSector(logicalSector, buf);
 		// it's important to use writeSector() and not writeSectorImpl()
 		// because only the former flushes SHA1 cache
+		changed = true;
+	}
+	if (old && !changed) {
+		// nothing written, so the cached track is still valid
+		if (num >= trackCache.size()) trackCache.resize(num + 1);
+		trackCache[num] = std::move(old);
 	}
 }
 
 void SectorBasedDisk::readTrack(byte track, byte side, RawTrack& output)
 {
-	// Try to cache the last result of this method (the cache will be
-	// flushed on any write to the disk). This very simple cache mechanism
-	// will typically already have a very high hit-rate. For example during
+	// Cache the synthesized tracks, per track and side (the cache is
+	// selectively flushed on writes to the disk). For example during
 	// emulation of a WD2793 read sector, we also emulate the search for
 	// the correct sector. So the disk rotates from sector to sector, and
 	// each time we re-read the track data (because emutime has passed).
-	// Typically the software will also read several sectors from the same
-	// track before moving to the next.
+	// And software that reads a file typically reads several sectors from
+	// the same track, and often jumps back and forth between the FAT,
+	// the directory and the data tracks.
 	checkCaches();
-	int num = track | (side << 8);
-	if (num == cachedTrackNum) {
-		output = cachedTrackData;
+	unsigned num = 2 * track + side;
+	if (num < trackCache.size() && trackCache[num]) {
+		output = trackCache[num]->data;
+		return;
+	}
+
+	// Reading the sectors may itself flush the caches (DirAsDSK syncs with
+	// the host directory), in that case don't cache the result.
+	unsigned oldFlushCount = flushCount;
+	try {
+		synthesizeTrack(track, side, output);
+	} catch (MSXException& /*e*/) {
+		// There was an error while reading the actual sector data.
+		// Most likely this is because we're reading the 81th track on
+		// a disk with only 80 tracks (or similar). If you do this on a
+		// real disk, you simply read an 'empty' track. So we do the
+		// same here. (Don't cache this result, retry on the next read.)
+		output.clear(RawTrack::STANDARD_SIZE);
 		return;
 	}
-	cachedTrackNum = num;
+	if (flushCount != oldFlushCount) return;
+
+	if (num >= trackCache.size()) trackCache.resize(num + 1);
+	trackCache[num] = std::make_unique<CachedTrack>();
+	trackCache[num]->data = output;
+	trackCache[num]->firstSector = physToLog(track, side, 1);
+}
 
+void SectorBasedDisk::synthesizeTrack(byte track, byte side, RawTrack& output)
+{
 	// This disk image only stores the actual sector data, not all the
 	// extra gap, sync and header information that is in reality stored
 	// in between the sectors. This function transforms the cooked sector
@@ -77,66 +129,81 @@ void SectorBasedDisk::readTrack(byte track, byte side, RawTrack& output)
 	// gap3          84 x 0x4e
 	//
 	// (*) Missing clock transitions in MFM encoding
-
-	try {
-		output.clear(RawTrack::STANDARD_SIZE); // clear idam positions
-
-		unsigned idx = 0;
-		for (int i = 0; i < 80; ++i) output.write(idx++, 0x4E); // gap4a
-		for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
-		for (int i = 0; i <  3; ++i) output.write(idx++, 0xC2); // index mark (1)
-		for (int i = 0; i <  1; ++i) output.write(idx++, 0xFC); //            (2)
-		for (int i = 0; i < 50; ++i) output.write(idx++, 0x4E); // gap1
-
-		for (int j = 0; j < 9; ++j) {
-			for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
-
-			for (int i = 0; i <  3; ++i) output.write(idx++, 0xA1); // addr mark (1)
-			for (int i = 0; i <  1; ++i) output.write(idx++, 0xFE, true); //     (2) add idam
-			output.write(idx++, track); // C: Cylinder number
-			output.write(idx++, side);  // H: Head Address
-			output.write(idx++, j + 1); // R: Record
-			output.write(idx++, 0x02);  // N: Number (length of sector: 512 = 128 << 2)
-			word addrCrc = output.calcCrc(idx - 8, 8);
-			output.write(idx++, addrCrc >> 8);   // CRC (high byte)
-			output.write(idx++, addrCrc & 0xff); //     (low  byte)
-
-			for (int i = 0; i < 22; ++i) output.write(idx++, 0x4E); // gap2
-			for (int i = 0; i < 12; ++i) output.write(idx++, 0x00); // sync
-
-			for (int i = 0; i <  3; ++i) output.write(idx++, 0xA1); // data mark (1)
-			for (int i = 0; i <  1; ++i) output.write(idx++, 0xFB); //           (2)
-
-			auto logicalSector = physToLog(track, side, j + 1);
-			SectorBuffer buf;
-			readSector(logicalSector, buf);
-			for (auto& r : buf.raw) output.write(idx++, r);
-
-			word dataCrc = output.calcCrc(idx - (512 + 4), 512 + 4);
-			output.write(idx++, dataCrc >> 8);   // CRC (high byte)
-			output.write(idx++, dataCrc & 0xff); //     (low  byte)
-
-			for (int i = 0; i < 84; ++i) output.write(idx++, 0x4E); // gap3
-		}
-
-		for (int i = 0; i < 182; ++i) output.write(idx++, 0x4E); // gap4b
-		assert(idx == RawTrack::STANDARD_SIZE);
-	} catch (MSXException& /*e*/) {
-		// There was an error while reading the actual sector data.
-		// Most likely this is because we're reading the 81th track on
-		// a disk with only 80 tracks (or similar). If you do this on a
-		// real disk, you simply read an 'empty' track. So we do the
-		// same here.
-		output.clear(RawTrack::STANDARD_SIZE);
-		cachedTrackNum = -1; // needed?
+	//
+	// The track is cleared to 0x4e, so the gaps don't need to be written
+	// explicitly. The CRCs of the address and data marks are computed at
+	// compile time, only the variable part needs to be added.
+
+	output.clear(RawTrack::STANDARD_SIZE); // clear idam positions
+	byte* raw = output.getRawBuffer();
+
+	unsigned idx = 80;                                  // gap4a
+	memset(&raw[idx], 0x00, 12); idx += 12;             // sync
+	memset(&raw[idx], 0xC2,  3); idx +=  3;             // index mark (1)
+	raw[idx++] = 0xFC;                                  //            (2)
+	idx += 50;                                          // gap1
+
+	for (unsigned j = 0; j < SECTORS_IN_TRACK; ++j) {
+		memset(&raw[idx], 0x00, 12); idx += 12;     // sync
+
+		memset(&raw[idx], 0xA1,  3); idx +=  3;     // addr mark (1)
+		output.addIdam(idx);
+		raw[idx++] = 0xFE;                          //           (2)
+		raw[idx++] = track; // C: Cylinder number
+		raw[idx++] = side;  // H: Head Address
+		raw[idx++] = j + 1; // R: Record
+		raw[idx++] = 0x02;  // N: Number (length of sector: 512 = 128 << 2)
+		CRC16 addrCrc;
+		addrCrc.init<0xA1, 0xA1, 0xA1, 0xFE>();
+		addrCrc.update(&raw[idx - 4], 4);
+		raw[idx++] = addrCrc.getValue() >> 8;       // CRC (high byte)
+		raw[idx++] = addrCrc.getValue() & 0xff;     //     (low  byte)
+
+		idx += 22;                                  // gap2
+		memset(&raw[idx], 0x00, 12); idx += 12;     // sync
+
+		memset(&raw[idx], 0xA1,  3); idx +=  3;     // data mark (1)
+		raw[idx++] = 0xFB;                          //           (2)
+
+		assert(idx == SECTOR_DATA_OFFSET + j * SECTOR_RAW_SIZE);
+		auto logicalSector = physToLog(track, side, j + 1);
+		SectorBuffer buf;
+		readSector(logicalSector, buf);
+		memcpy(&raw[idx], buf.raw, 512);
+		CRC16 dataCrc;
+		dataCrc.init<0xA1, 0xA1, 0xA1, 0xFB>();
+		dataCrc.update(&raw[idx], 512);
+		idx += 512;
+		raw[idx++] = dataCrc.getValue() >> 8;       // CRC (high byte)
+		raw[idx++] = dataCrc.getValue() & 0xff;     //     (low  byte)
+
+		idx += 84;                                  // gap3
 	}
-	cachedTrackData = output;
+
+	idx += 182;                                         // gap4b
+	assert(idx == RawTrack::STANDARD_SIZE); (void)idx;
 }
 
 void SectorBasedDisk::flushCaches()
 {
 	Disk::flushCaches();
-	cachedTrackNum = -1;
+	trackCache.clear();
+	++flushCount;
+}
+
+void SectorBasedDisk::flushSectorCaches(size_t sector)
+{
+	Disk::flushCaches(); // e.g. sha1sum
+
+	// Only drop the track(s) that contain this sector. (A synthesized
+	// track always has 9 sectors, so with less sectors per track a sector
+	// can be part of two cached tracks.)
+	for (auto& t : trackCache) {
+		if (t && (t->firstSector <= sector) &&
+		    (sector < t->firstSector + SECTORS_IN_TRACK)) {
+			t.reset();
+		}
+	}
 }
 
 size_t SectorBasedDisk::getNbSectorsImpl() const
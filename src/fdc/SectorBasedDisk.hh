@@ -3,6 +3,8 @@
 
 #include "Disk.hh"
 #include "RawTrack.hh"
+#include <memory>
+#include <vector>
 
 namespace openmsx {
 
@@ -16,6 +18,7 @@ protected:
 	explicit SectorBasedDisk(DiskName name);
 	void detectGeometry() override;
 	void flushCaches() override;
+	void flushSectorCaches(size_t sector) override;
 
 	void setNbSectors(size_t num);
 
@@ -28,10 +31,17 @@ private:
 	void readTrack(byte track, byte side, RawTrack& output) override;
 	void writeTrackImpl(byte track, byte side, const RawTrack& input) override;
 
+	void synthesizeTrack(byte track, byte side, RawTrack& output);
+
 	size_t nbSectors;
 
-	RawTrack cachedTrackData;
-	int cachedTrackNum;
+	// Synthesized tracks, indexed by 2 * track + side.
+	struct CachedTrack {
+		RawTrack data;
+		size_t firstSector; // logical sector number of the 1st sector
+	};
+	std::vector<std::unique_ptr<CachedTrack>> trackCache;
+	unsigned flushCount; // incremented on each flushCaches()
 };
 
 } // namespace openmsx
@@ -5,6 +5,7 @@
 
 #include "TC8566AF.hh"
 #include "DiskDrive.hh"
+#include "FastDisk.hh"
 #include "RawTrack.hh"
 #include "Clock.hh"
 #include "CliComm.hh"
@@ -60,9 +61,10 @@ static const byte ST3_FLT = 0x80; // Fault
 
 
 TC8566AF::TC8566AF(Scheduler& scheduler_, DiskDrive* drv[4], CliComm& cliComm_,
-                   EmuTime::param time)
+                   const FastDisk& fastDisk_, EmuTime::param time)
 	: Schedulable(scheduler_)
 	, cliComm(cliComm_)
+	, fastDisk(fastDisk_)
 	, delayTime(EmuTime::zero)
 	, headUnloadTime(EmuTime::zero) // head not loaded
 {
@@ -107,6 +109,7 @@ void TC8566AF::reset(EmuTime::param time)
 	specifyData[0] = 0; // TODO check
 	specifyData[1] = 0; // TODO check
 	seekValue = 0;
+	fastCmd = false;
 	headUnloadTime = EmuTime::zero; // head not loaded
 
 	mainStatus = STM_RQM;
@@ -208,9 +211,14 @@ byte TC8566AF::executionPhaseRead(EmuTime::param time)
 		byte result = drv->readTrackByte(dataCurrent++);
 		crc.update(result);
 		--dataAvailable;
-		delayTime += 1; // time when next byte will be available
+		if (fastCmd) {
+			// next byte is available right away
+			delayTime.reset(time);
+		} else {
+			delayTime += 1; // time when next byte will be available
+		}
 		mainStatus &= ~STM_RQM;
-		if (delayTime.before(time)) {
+		if (!fastCmd && delayTime.before(time)) {
 			// lost data
 			status0 |= ST0_IC0;
 			status1 |= ST1_OR;
@@ -381,6 +389,7 @@ void TC8566AF::idlePhaseWrite(byte value, EmuTime::param time)
 	phase       = PHASE_COMMAND;
 	phaseStep   = 0;
 	mainStatus |= STM_CB;
+	fastCmd     = fastDisk.isEnabled();
 
 	switch (command) {
 	case CMD_READ_DATA:
@@ -491,7 +500,7 @@ void TC8566AF::commandPhaseWrite(byte value, EmuTime::param time)
 			// load drive head, if not already loaded
 			EmuTime ready = time;
 			if (!isHeadLoaded(time)) {
-				ready += getHeadLoadDelay();
+				if (!fastCmd) ready += getHeadLoadDelay();
 				// set 'head is loaded'
 				headUnloadTime = EmuTime::infinity;
 			}
@@ -499,6 +508,11 @@ void TC8566AF::commandPhaseWrite(byte value, EmuTime::param time)
 			// actually read sector: fills in
 			//   dataAvailable and dataCurrent
 			ready = locateSector(ready);
+			if (fastCmd && (ready != EmuTime::infinity)) {
+				// Don't wait till the sector is rotated
+				// below the head.
+				ready = time;
+			}
 			if (ready == EmuTime::infinity) {
 				status0 |= ST0_IC0;
 				status1 |= ST1_ND;
@@ -686,7 +700,7 @@ void TC8566AF::doSeek(EmuTime::param time)
 
 	currentDrive.step(direction, time);
 
-	setSyncPoint(time + getSeekDelay());
+	setSyncPoint(fastCmd ? time : time + getSeekDelay());
 }
 
 void TC8566AF::executeUntil(EmuTime::param time)
@@ -714,9 +728,14 @@ void TC8566AF::executionPhaseWrite(byte value, EmuTime::param time)
 		drv->writeTrackByte(dataCurrent++, value);
 		crc.update(value);
 		--dataAvailable;
-		delayTime += 1; // time when next byte can be written
+		if (fastCmd) {
+			// next byte can be written right away
+			delayTime.reset(time);
+		} else {
+			delayTime += 1; // time when next byte can be written
+		}
 		mainStatus &= ~STM_RQM;
-		if (delayTime.before(time)) {
+		if (!fastCmd && delayTime.before(time)) {
 			// lost data
 			status0 |= ST0_IC0;
 			status1 |= ST1_OR;
@@ -856,6 +875,7 @@ SERIALIZE_ENUM(TC8566AF::Phase, phaseInfo);
 //            Added 'crc' and 'gapLength'.
 // version 4: changed type of delayTime from Clock to DynamicClock
 // version 5: removed trackData
+// version 6: added fastCmd
 template<typename Archive>
 void TC8566AF::serialize(Archive& ar, unsigned version)
 {
@@ -915,6 +935,11 @@ void TC8566AF::serialize(Archive& ar, unsigned version)
 				"wrong emulation behavior.");
 		}
 	}
+	if (ar.versionAtLeast(version, 6)) {
+		ar.serialize("fastCmd", fastCmd);
+	} else {
+		fastCmd = false;
+	}
 };
 INSTANTIATE_SERIALIZE_METHODS(TC8566AF);
 
@@ -12,12 +12,13 @@ namespace openmsx {
 class Scheduler;
 class DiskDrive;
 class CliComm;
+class FastDisk;
 
 class TC8566AF final : public Schedulable
 {
 public:
 	TC8566AF(Scheduler& scheduler, DiskDrive* drv[4], CliComm& cliComm,
-	         EmuTime::param time);
+	         const FastDisk& fastDisk, EmuTime::param time);
 
 	void reset(EmuTime::param time);
 	byte readReg(int reg, EmuTime::param time);
@@ -89,6 +90,7 @@ private:
 
 private:
 	CliComm& cliComm;
+	const FastDisk& fastDisk;
 	DiskDrive* drive[4];
 	DynamicClock delayTime;
 	EmuTime headUnloadTime; // Before this time head is loaded, after
@@ -123,8 +125,9 @@ private:
 	byte gapLength;
 	byte specifyData[2]; // filled in by SPECIFY command
 	byte seekValue;
+	bool fastCmd; // fast disk mode, sampled at the start of each command
 };
-SERIALIZE_CLASS_VERSION(TC8566AF, 5);
+SERIALIZE_CLASS_VERSION(TC8566AF, 6);
 
 } // namespace openmsx
 
@@ -40,7 +40,7 @@ static TurboRFDC::Type parseType(const DeviceConfig& config)
 TurboRFDC::TurboRFDC(const DeviceConfig& config)
 	: MSXFDC(config)
 	, controller(getScheduler(), reinterpret_cast<DiskDrive**>(drives),
-	             getCliComm(), getCurrentTime())
+	             getCliComm(), *fastDisk, getCurrentTime())
 	, romBlockDebug(*this, &bank, 0x4000, 0x4000, 14)
 	, blockMask((rom->getSize() / 0x4000) - 1)
 	, type(parseType(config))
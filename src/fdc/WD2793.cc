@@ -1,10 +1,12 @@
 #include "WD2793.hh"
 #include "DiskDrive.hh"
+#include "FastDisk.hh"
 #include "CliComm.hh"
 #include "Clock.hh"
 #include "MSXException.hh"
 #include "serialize.hh"
 #include "unreachable.hh"
+#include <algorithm>
 #include <iostream>
 
 namespace openmsx {
@@ -45,10 +47,11 @@ const EmuDuration WD2793::IDLE = EmuDuration::sec(3);
  * signal yet).
  */
 WD2793::WD2793(Scheduler& scheduler_, DiskDrive& drive_, CliComm& cliComm_,
-               EmuTime::param time, bool isWD1770_)
+               const FastDisk& fastDisk_, EmuTime::param time, bool isWD1770_)
 	: Schedulable(scheduler_)
 	, drive(drive_)
 	, cliComm(cliComm_)
+	, fastDisk(fastDisk_)
 	, drqTime(EmuTime::infinity)
 	, irqTime(EmuTime::infinity)
 	, pulse5(EmuTime::infinity)
@@ -62,6 +65,7 @@ WD2793::WD2793(Scheduler& scheduler_, DiskDrive& drive_, CliComm& cliComm_,
 	dataRegWritten = false;
 	lastWasA1 = false;
 	lastWasCRC = false;
+	fastCmd = false;
 	commandReg = 0;
 	setDrqRate(RawTrack::STANDARD_SIZE);
 
@@ -131,6 +135,7 @@ void WD2793::setCommandReg(byte value, EmuTime::param time)
 	removeSyncPoint();
 
 	commandReg = value;
+	fastCmd = fastDisk.isEnabled();
 	irqTime = EmuTime::infinity; // INTRQ = false;
 	switch (commandReg & 0xF0) {
 		case 0x00: // restore
@@ -246,6 +251,10 @@ void WD2793::setDataReg(byte value, EmuTime::param time)
 	if (!getDTRQ(time)) return;
 	assert(statusReg & BUSY);
 
+	if (fastCmd && ((commandReg & 0xE0) == 0xA0)) {
+		fastWriteSector(time);
+		return;
+	}
 	if (((commandReg & 0xE0) == 0xA0) || // write sector
 	    ((commandReg & 0xF0) == 0xF0)) { // write track
 		dataRegWritten = true;
@@ -264,15 +273,20 @@ byte WD2793::getDataReg(EmuTime::param time)
 		dataReg = drive.readTrackByte(dataCurrent++);
 		crc.update(dataReg);
 		dataAvailable--;
-		drqTime += 1; // time when the next byte will be available
-		while (dataAvailable && unlikely(getDTRQ(time))) {
-			statusReg |= LOST_DATA;
-			dataReg = drive.readTrackByte(dataCurrent++);
-			crc.update(dataReg);
-			dataAvailable--;
-			drqTime += 1;
+		if (fastCmd && ((commandReg & 0xE0) == 0x80)) {
+			// fast read sector: DRQ stays active, the next byte
+			// is available right away
+		} else {
+			drqTime += 1; // time when the next byte will be available
+			while (dataAvailable && unlikely(getDTRQ(time))) {
+				statusReg |= LOST_DATA;
+				dataReg = drive.readTrackByte(dataCurrent++);
+				crc.update(dataReg);
+				dataAvailable--;
+				drqTime += 1;
+			}
+			assert(!dataAvailable || !getDTRQ(time));
 		}
-		assert(!dataAvailable || !getDTRQ(time));
 		if (dataAvailable == 0) {
 			if ((commandReg & 0xE0) == 0x80) {
 				// read sector
@@ -497,8 +511,8 @@ void WD2793::step(EmuTime::param time)
 		endType1Cmd(time);
 	} else {
 		drive.step(directionIn, time);
-		schedule(FSM_SEEK,
-		         time + EmuDuration::msec(timePerStep[commandReg & STEP_SPEED]));
+		schedule(FSM_SEEK, fastCmd ? time
+		         : time + EmuDuration::msec(timePerStep[commandReg & STEP_SPEED]));
 	}
 }
 
@@ -535,7 +549,7 @@ void WD2793::startType2Cmd(EmuTime::param time)
 		// WD2795/WD2797 would now set SSO output
 		hldTime = time; // see comment in startType1Cmd
 
-		if (commandReg & E_FLAG) {
+		if ((commandReg & E_FLAG) && !fastCmd) {
 			schedule(FSM_TYPE2_LOADED,
 			         time + EmuDuration::msec(30)); // when 1MHz clock
 		} else {
@@ -564,7 +578,23 @@ void WD2793::type2Search(EmuTime::param time)
 	try {
 		setDrqRate(drive.getTrackLength());
 		EmuTime next = drive.getNextSector(time, sectorInfo);
-		if (next < pulse5) {
+		if (fastCmd && (pulse5 < EmuTime::infinity)) {
+			// Don't wait till the sector is rotated under the
+			// head, instead look ahead on the track. One
+			// revolution is enough: a sector that isn't there
+			// won't show up in later revolutions either.
+			EmuDuration revolution =
+				drive.getTimeTillIndexPulse(time, 2) -
+				drive.getTimeTillIndexPulse(time, 1);
+			EmuTime limit = std::min(pulse5, time + revolution);
+			while ((next < limit) && !type2Matches()) {
+				next = drive.getNextSector(next, sectorInfo);
+			}
+			if (next < limit) {
+				type2Rotated(time);
+				return;
+			}
+		} else if (next < pulse5) {
 			// Wait till sector is actually rotated under head
 			schedule(FSM_TYPE2_ROTATED, next);
 			return;
@@ -574,15 +604,16 @@ void WD2793::type2Search(EmuTime::param time)
 	}
 	// Sector not found in 5 revolutions (or read error),
 	// schedule to give a RECORD_NOT_FOUND error
-	if (pulse5 < EmuTime::infinity) {
+	if ((pulse5 < EmuTime::infinity) && !fastCmd) {
 		schedule(FSM_TYPE2_NOT_FOUND, pulse5);
 	} else {
 		// Drive not rotating. How does a real WD293 handle this?
+		// (Or fast disk mode: don't wait for 5 revolutions.)
 		type2NotFound(time);
 	}
 }
 
-void WD2793::type2Rotated(EmuTime::param time)
+bool WD2793::type2Matches()
 {
 	// The CRC status bit should only toggle after the disk has rotated
 	if (sectorInfo.addrCrcErr) {
@@ -594,14 +625,24 @@ void WD2793::type2Rotated(EmuTime::param time)
 	    (sectorInfo.track  != trackReg) ||
 	    (sectorInfo.sector != sectorReg)) {
 		// TODO implement (optional) head compare
-		// not the sector we were looking for, continue searching
-		type2Search(time);
-		return;
+		// not the sector we were looking for
+		return false;
 	}
 	if (sectorInfo.dataIdx == -1) {
 		// Sector header without accompanying data block.
 		// TODO we should actually wait for the disk to rotate before
 		// we can check this.
+		return false;
+	}
+	return true;
+}
+
+void WD2793::type2Rotated(EmuTime::param time)
+{
+	// (In fast disk mode the sector usually already matched, but not when
+	// the drive isn't rotating, see type2Search().)
+	if (!type2Matches()) {
+		// continue searching
 		type2Search(time);
 		return;
 	}
@@ -636,7 +677,9 @@ void WD2793::startReadSector(EmuTime::param time)
 	unsigned gapLength = (tmp >= 0) ? tmp : (tmp + trackLength);
 	assert(gapLength < trackLength);
 	drqTime.reset(time);
-	drqTime += gapLength + 1 + 1; // (first) byte can be read in a moment
+	if (!fastCmd) {
+		drqTime += gapLength + 1 + 1; // (first) byte can be read in a moment
+	}
 	dataCurrent = sectorInfo.dataIdx;
 
 	// Get sectorsize from disk: 128, 256, 512 or 1024 bytes
@@ -667,6 +710,14 @@ void WD2793::startWriteSector(EmuTime::param time)
 	// routine in Microsol_CDX-2 depends on this.
 
 	drqTime.reset(time);
+	if (fastCmd) {
+		// Activate DRQ immediately, see fastWriteSector(). Still
+		// abort the command when the CPU doesn't write the first
+		// byte in time.
+		dataAvailable = 0;
+		schedule(FSM_CHECK_WRITE, drqTime + (7 + 2 + 8));
+		return;
+	}
 	drqTime += 7 + 2; // activate DRQ 2 bytes after end of address header
 
 	// 8 bytes later, the WD2793 will check whether the CPU wrote the
@@ -810,6 +861,50 @@ void WD2793::postWriteSector(EmuTime::param time)
 	}
 }
 
+// Write sector in fast disk mode: instead of writing one byte per DRQ period
+// (see checkStartWrite() and the following states), each byte is written to
+// the track as soon as the CPU supplies it and DRQ stays active. The result
+// on disk is the same.
+void WD2793::fastWriteSector(EmuTime::param time)
+{
+	try {
+		if (dataAvailable == 0) {
+			// first byte: the CPU was in time, write the pre-data
+			// (12x 00, 3x A1, F8/FB)
+			removeSyncPoint();
+			fsmState = FSM_NONE;
+			dataCurrent = sectorInfo.addrIdx + 6 + 22; // see checkStartWrite()
+			for (int i = 0; i < 12; ++i) drive.writeTrackByte(dataCurrent++, 0x00);
+			for (int i = 0; i <  3; ++i) drive.writeTrackByte(dataCurrent++, 0xA1);
+			crc.init<0xA1, 0xA1, 0xA1>();
+			byte mark = (commandReg & A0_FLAG) ? 0xF8 : 0xFB;
+			drive.writeTrackByte(dataCurrent++, mark);
+			crc.update(mark);
+			dataAvailable = 128 << (sectorInfo.sizeCode & 3); // see comment in startReadSector()
+		}
+
+		drive.writeTrackByte(dataCurrent++, dataReg);
+		crc.update(dataReg);
+		--dataAvailable;
+
+		if (dataAvailable == 0) {
+			// 2 CRC bytes (big endian) and one byte of 0xFE
+			drive.writeTrackByte(dataCurrent++, crc.getValue() >> 8);
+			drive.writeTrackByte(dataCurrent++, crc.getValue() & 0xFF);
+			drive.writeTrackByte(dataCurrent++, 0xFE);
+			drive.flushTrack();
+			if (commandReg & M_FLAG) {
+				// TODO multi sector write
+				sectorReg++;
+			}
+			endCmd(time);
+		}
+	} catch (MSXException&) {
+		statusReg |= NOT_READY; // TODO which status bit should be set?
+		endCmd(time);
+	}
+}
+
 
 void WD2793::startType3Cmd(EmuTime::param time)
 {
@@ -827,7 +922,7 @@ void WD2793::startType3Cmd(EmuTime::param time)
 		hldTime = time; // see comment in startType1Cmd
 		// WD2795/WD2797 would now set SSO output
 
-		if (commandReg & E_FLAG) {
+		if ((commandReg & E_FLAG) && !fastCmd) {
 			schedule(FSM_TYPE3_LOADED,
 			         time + EmuDuration::msec(30)); // when 1MHz clock
 		} else {
@@ -1109,6 +1204,7 @@ SERIALIZE_ENUM(WD2793::FSMState, fsmStateInfo);
 // version 10: removed 'trackData' and 'trackDataValid' (moved to RealDrive)
 // version 11: added 'dataOutReg', 'dataRegWritten', 'lastWasCRC'
 // version 12: added 'hldTime'
+// version 13: added 'fastCmd'
 template<typename Archive>
 void WD2793::serialize(Archive& ar, unsigned version)
 {
@@ -1222,6 +1318,12 @@ void WD2793::serialize(Archive& ar, unsigned version)
 			hldTime = EmuTime::infinity;
 		}
 	}
+
+	if (ar.versionAtLeast(version, 13)) {
+		ar.serialize("fastCmd", fastCmd);
+	} else {
+		fastCmd = false;
+	}
 }
 INSTANTIATE_SERIALIZE_METHODS(WD2793);
 
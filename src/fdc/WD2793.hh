@@ -12,12 +12,13 @@ namespace openmsx {
 class Scheduler;
 class DiskDrive;
 class CliComm;
+class FastDisk;
 
 class WD2793 final : public Schedulable
 {
 public:
 	WD2793(Scheduler& scheduler, DiskDrive& drive, CliComm& cliComm,
-	       EmuTime::param time, bool isWD1770);
+	       const FastDisk& fastDisk, EmuTime::param time, bool isWD1770);
 
 	void reset(EmuTime::param time);
 
@@ -78,12 +79,14 @@ private:
 	void type2Search     (EmuTime::param time);
 	void type2NotFound   (EmuTime::param time);
 	void type2Rotated    (EmuTime::param time);
+	bool type2Matches    ();
 	void startReadSector (EmuTime::param time);
 	void startWriteSector(EmuTime::param time);
 	void checkStartWrite (EmuTime::param time);
 	void preWriteSector  (EmuTime::param time);
 	void writeSectorData (EmuTime::param time);
 	void postWriteSector (EmuTime::param time);
+	void fastWriteSector (EmuTime::param time);
 
 	void startType3Cmd   (EmuTime::param time);
 	void type3Loaded     (EmuTime::param time);
@@ -105,6 +108,7 @@ private:
 private:
 	DiskDrive& drive;
 	CliComm& cliComm;
+	const FastDisk& fastDisk;
 
 	// DRQ is high iff current time is past this time.
 	//  This clock ticks at the 'byte-rate' of the current track,
@@ -154,10 +158,11 @@ private:
 	bool lastWasA1;
 	bool dataRegWritten;
 	bool lastWasCRC;
+	bool fastCmd; // fast disk mode, sampled at the start of each command
 
 	const bool isWD1770;
 };
-SERIALIZE_CLASS_VERSION(WD2793, 12);
+SERIALIZE_CLASS_VERSION(WD2793, 13);
 
 } // namespace openmsx
 
@@ -9,7 +9,8 @@ WD2793BasedFDC::WD2793BasedFDC(const DeviceConfig& config, const std::string& ro
 	: MSXFDC(config, romId, needROM)
 	, multiplexer(reinterpret_cast<DiskDrive**>(drives))
 	, controller(
-		getScheduler(), multiplexer, getCliComm(), getCurrentTime(),
+		getScheduler(), multiplexer, getCliComm(), *fastDisk,
+		getCurrentTime(),
 		config.getXML()->getName() == "WD1770")
 {
 }
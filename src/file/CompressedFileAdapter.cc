@@ -2,7 +2,9 @@
 #include "FileException.hh"
 #include "hash_set.hh"
 #include "xxhash.hh"
+#include <algorithm>
 #include <cstring>
+#include <mutex>
 
 using std::string;
 
@@ -15,6 +17,14 @@ struct GetURLFromDecompressed {
 };
 static hash_set<std::shared_ptr<CompressedFileAdapter::Decompressed>,
                 GetURLFromDecompressed, XXHasher> decompressCache;
+// Files are also opened/closed/read outside the main thread (e.g. the harddisk
+// sector cache thread).
+static std::mutex decompressCacheMutex;
+
+// Files that (compressed or uncompressed) are at least this big are inflated
+// on demand. E.g. for a large harddisk image usually only a small part is
+// ever read, so there's no need to keep the whole image in memory.
+static const size_t STREAMING_THRESHOLD = 16 * 1024 * 1024;
 
 
 CompressedFileAdapter::CompressedFileAdapter(std::unique_ptr<FileBase> file_)
@@ -24,6 +34,7 @@ CompressedFileAdapter::CompressedFileAdapter(std::unique_ptr<FileBase> file_)
 
 CompressedFileAdapter::~CompressedFileAdapter()
 {
+	std::lock_guard<std::mutex> lock(decompressCacheMutex);
 	auto it = decompressCache.find(getURL());
 	decompressed.reset();
 	if (it != end(decompressCache) && it->unique()) {
@@ -36,6 +47,7 @@ void CompressedFileAdapter::decompress()
 {
 	if (decompressed) return;
 
+	std::lock_guard<std::mutex> lock(decompressCacheMutex);
 	string url = getURL();
 	auto it = decompressCache.find(url);
 	if (it != end(decompressCache)) {
@@ -46,15 +58,30 @@ void CompressedFileAdapter::decompress()
 		decompressed->cachedModificationDate = getModificationDate();
 		decompressed->cachedURL = std::move(url);
 		decompressCache.insert_noDuplicateCheck(decompressed);
+		if (decompressed->stream) {
+			// keep original file (mmap'ed) for on demand decompression
+			decompressed->compressedFile = std::move(file);
+		}
 	}
 
 	// close original file after succesful decompress
 	file.reset();
 }
 
+bool CompressedFileAdapter::useStreaming(
+	size_t compressedSize, size_t uncompressedSize)
+{
+	return std::max(compressedSize, uncompressedSize) >= STREAMING_THRESHOLD;
+}
+
 void CompressedFileAdapter::read(void* buffer, size_t num)
 {
 	decompress();
+	if (auto& stream = decompressed->stream) {
+		stream->read(pos, static_cast<byte*>(buffer), num);
+		pos += num;
+		return;
+	}
 	if (decompressed->size < (pos + num)) {
 		throw FileException("Read beyond end of file");
 	}
@@ -71,19 +98,30 @@ void CompressedFileAdapter::write(const void* /*buffer*/, size_t /*num*/)
 const byte* CompressedFileAdapter::mmap(size_t& size)
 {
 	decompress();
+	if (decompressed->stream) {
+		// Inflate the whole file after all, but only for this user,
+		// see header.
+		size_t oldPos = pos;
+		seek(0);
+		auto* result = FileBase::mmap(size);
+		size = getSize();
+		seek(oldPos);
+		return result;
+	}
 	size = decompressed->size;
 	return reinterpret_cast<const byte*>(decompressed->buf.data());
 }
 
 void CompressedFileAdapter::munmap()
 {
-	// nothing
+	FileBase::munmap(); // only does something in streaming mode
 }
 
 size_t CompressedFileAdapter::getSize()
 {
 	decompress();
-	return decompressed->size;
+	return decompressed->stream ? decompressed->stream->getSize()
+	                            : decompressed->size;
 }
 
 void CompressedFileAdapter::seek(size_t newpos)
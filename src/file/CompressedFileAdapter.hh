@@ -3,6 +3,7 @@
 
 #include "FileBase.hh"
 #include "MemBuffer.hh"
+#include "SeekableInflate.hh"
 #include <memory>
 
 namespace openmsx {
@@ -13,6 +14,12 @@ public:
 	struct Decompressed {
 		MemBuffer<byte> buf;
 		size_t size;
+		// Large files are not inflated upfront. Instead 'stream' inflates
+		// (and caches) the requested parts on demand. It reads from the
+		// mmap'ed 'compressedFile'. In this mode 'buf' and 'size' are
+		// not used.
+		std::unique_ptr<FileBase> compressedFile;
+		std::unique_ptr<SeekableInflate> stream;
 		std::string originalName;
 		std::string cachedURL;
 		time_t cachedModificationDate;
@@ -20,6 +27,10 @@ public:
 
 	void read(void* buffer, size_t num) final override;
 	void write(const void* buffer, size_t num) final override;
+	/** Note: for a file that's inflated on demand (see Decompressed)
+	  * this still inflates the whole file, into a buffer owned by this
+	  * object. So for large files prefer read().
+	  */
 	const byte* mmap(size_t& size) final override;
 	void munmap() final override;
 	size_t getSize() final override;
@@ -37,6 +48,11 @@ protected:
 	~CompressedFileAdapter();
 	virtual void decompress(FileBase& file, Decompressed& decompressed) = 0;
 
+	/** Should a file with the given (compressed and, when known,
+	  * uncompressed) size be inflated on demand instead of all at once?
+	  */
+	static bool useStreaming(size_t compressedSize, size_t uncompressedSize);
+
 private:
 	void decompress();
 
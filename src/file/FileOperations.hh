@@ -56,6 +56,13 @@ namespace FileOperations {
 	 */
 	int unlink(const std::string& path);
 
+	/**
+	 * Call rename() in a platform-independent manner. An existing file
+	 * with the new name is (atomically, where supported) replaced.
+	 * @result 0 on success, non-zero on error
+	 */
+	int rename(const std::string& oldPath, const std::string& newPath);
+
 	/**
 	 * Call rmdir() in a platform-independent manner
 	 */
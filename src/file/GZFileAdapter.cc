@@ -61,7 +61,19 @@ void GZFileAdapter::decompress(FileBase& f, Decompressed& d)
 	if (!skipHeader(zlib, d.originalName)) {
 		throw FileException("Not a gzip header");
 	}
-	d.size = zlib.inflate(d.buf);
+	// The trailer contains the uncompressed size (modulo 2^32), only
+	// use it as a hint.
+	size_t sizeHint = (size >= 4) ? (data[size - 4] <<  0) |
+	                                (data[size - 3] <<  8) |
+	                                (data[size - 2] << 16) |
+	                                (size_t(data[size - 1]) << 24)
+	                              : 0;
+	if (useStreaming(size, sizeHint)) {
+		d.stream = std::make_unique<SeekableInflate>(
+			zlib.getRemainingInput(), zlib.getRemainingInputSize());
+	} else {
+		d.size = zlib.inflate(d.buf);
+	}
 }
 
 } // namespace openmsx
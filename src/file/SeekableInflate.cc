@@ -0,0 +1,198 @@
+#include "SeekableInflate.hh"
+#include "FileException.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <zlib.h>
+
+namespace openmsx {
+
+static const size_t WINDOW_SIZE = 32768; // max deflate back-reference distance
+
+SeekableInflate::SeekableInflate(const byte* input_, size_t inputSize_,
+                                 size_t span_, unsigned maxCachedChunks_)
+	: input(input_)
+	, inputSize(inputSize_)
+	, span(span_)
+	, maxCachedChunks(std::max(1u, maxCachedChunks_))
+	, totalSize(0)
+	, sizeKnown(false)
+	, endReached(false)
+{
+	assert(span >= WINDOW_SIZE);
+	Checkpoint first;
+	first.in = 0;
+	first.out = 0;
+	first.bits = 0;
+	checkpoints.push_back(std::move(first));
+}
+
+void SeekableInflate::setSize(size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	totalSize = size;
+	sizeKnown = true;
+}
+
+size_t SeekableInflate::getSize()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!sizeKnown) {
+		// inflate (and mostly forget again) the remaining chunks
+		while (!endReached) {
+			getChunk(checkpoints.size() - 1);
+		}
+	}
+	return totalSize;
+}
+
+void SeekableInflate::read(size_t pos, byte* output, size_t num)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (sizeKnown && ((pos + num) > totalSize)) {
+		throw FileException("Read beyond end of file");
+	}
+	while (num) {
+		auto it = std::upper_bound(begin(checkpoints), end(checkpoints), pos,
+			[](size_t p, const Checkpoint& c) { return p < c.out; });
+		size_t index = (it - begin(checkpoints)) - 1;
+		const Chunk* chunk = &getChunk(index);
+		// 'pos' can lie beyond the last checkpoint that's known so far
+		while (pos >= (checkpoints[index].out + chunk->size)) {
+			if ((index + 1) == checkpoints.size()) {
+				throw FileException("Read beyond end of file");
+			}
+			chunk = &getChunk(++index);
+		}
+		size_t offset = pos - checkpoints[index].out;
+		size_t n = std::min(num, chunk->size - offset);
+		memcpy(output, chunk->data.data() + offset, n);
+		output += n;
+		pos    += n;
+		num    -= n;
+	}
+}
+
+const SeekableInflate::Chunk& SeekableInflate::getChunk(size_t index)
+{
+	auto it = std::find_if(begin(cache), end(cache),
+		[&](const Chunk& c) { return c.index == index; });
+	if (it != end(cache)) {
+		// move to front (most recently used)
+		std::rotate(begin(cache), it, it + 1);
+		return cache.front();
+	}
+
+	Chunk chunk;
+	chunk.index = index;
+	inflateChunk(index, chunk);
+	if (cache.size() == maxCachedChunks) cache.pop_back();
+	cache.insert(begin(cache), std::move(chunk));
+	return cache.front();
+}
+
+void SeekableInflate::inflateChunk(size_t index, Chunk& chunk)
+{
+	z_stream s;
+	s.zalloc = nullptr;
+	s.zfree  = nullptr;
+	s.opaque = nullptr;
+	s.next_in  = nullptr;
+	s.avail_in = 0;
+	int err = inflateInit2(&s, -MAX_WBITS);
+	if (err != Z_OK) {
+		throw FileException(
+			"Error initializing inflate struct: ", zError(err));
+	}
+	struct InflateEnd {
+		~InflateEnd() { inflateEnd(&s); }
+		z_stream& s;
+	} inflateEnd{s};
+
+	// Note: 'checkpoints' can grow below, so don't keep a reference.
+	size_t inPos    = checkpoints[index].in;
+	size_t outStart = checkpoints[index].out;
+	if (int bits = checkpoints[index].bits) {
+		err = inflatePrime(&s, bits, input[inPos - 1] >> (8 - bits));
+		if (err != Z_OK) {
+			throw FileException("Error decompressing: ", zError(err));
+		}
+	}
+	if (!checkpoints[index].window.empty()) {
+		err = inflateSetDictionary(
+			&s, checkpoints[index].window.data(), WINDOW_SIZE);
+		if (err != Z_OK) {
+			throw FileException("Error decompressing: ", zError(err));
+		}
+	}
+
+	// When the end of this chunk is known, inflate exactly up to there.
+	// Otherwise inflate block-by-block and stop at the first block
+	// boundary after 'span' bytes, that becomes the next checkpoint.
+	bool isLast = (index + 1) == checkpoints.size();
+	bool knownEnd = !isLast || endReached;
+	size_t wanted = !isLast ? (checkpoints[index + 1].out - outStart)
+	              : endReached ? (totalSize - outStart)
+	              : 0;
+	size_t capacity = knownEnd ? std::max<size_t>(wanted, 1)
+	                           : (span + span / 4);
+	chunk.data.resize(capacity);
+	size_t produced = 0;
+
+	while (!knownEnd || (produced < wanted)) {
+		if (s.avail_in == 0) {
+			auto n = std::min<size_t>(inputSize - inPos,
+			                          std::numeric_limits<uInt>::max());
+			s.next_in = const_cast<byte*>(input + inPos);
+			s.avail_in = uInt(n);
+			inPos += n;
+		}
+		if (produced == capacity) {
+			capacity *= 2;
+			chunk.data.resize(capacity);
+		}
+		auto room = std::min<size_t>(
+			(knownEnd ? wanted : capacity) - produced,
+			std::numeric_limits<uInt>::max());
+		s.next_out = chunk.data.data() + produced;
+		s.avail_out = uInt(room);
+
+		err = ::inflate(&s, knownEnd ? Z_NO_FLUSH : Z_BLOCK);
+		produced += room - s.avail_out;
+		if (err == Z_STREAM_END) {
+			if (!knownEnd) {
+				endReached = true;
+				totalSize = outStart + produced;
+				sizeKnown = true;
+			}
+			break;
+		}
+		if (err == Z_BUF_ERROR) {
+			if ((s.avail_in == 0) && (inPos == inputSize)) {
+				throw FileException(
+					"Error decompressing: unexpected end of file.");
+			}
+		} else if (err != Z_OK) {
+			throw FileException("Error decompressing: ", zError(err));
+		}
+
+		if (!knownEnd && (produced >= span) &&
+		    (s.data_type & 128) && !(s.data_type & 64)) {
+			// At the end of a (not the last) deflate block.
+			Checkpoint next;
+			next.in = inPos - s.avail_in;
+			next.out = outStart + produced;
+			next.bits = s.data_type & 7;
+			next.window.resize(WINDOW_SIZE);
+			memcpy(next.window.data(),
+			       chunk.data.data() + produced - WINDOW_SIZE,
+			       WINDOW_SIZE);
+			checkpoints.push_back(std::move(next));
+			break;
+		}
+	}
+	chunk.size = produced;
+}
+
+} // namespace openmsx
@@ -0,0 +1,92 @@
+#ifndef SEEKABLEINFLATE_HH
+#define SEEKABLEINFLATE_HH
+
+#include "MemBuffer.hh"
+#include "openmsx.hh"
+#include <mutex>
+#include <vector>
+
+namespace openmsx {
+
+/** Random access to a (raw) deflate stream, without inflating the whole
+  * stream in memory.
+  *
+  * The uncompressed data is split in chunks of (approximately) 'span' bytes.
+  * While inflating, a checkpoint is recorded at the start of each chunk
+  * (the position in the input, the bit offset and the preceding 32kB of
+  * output). From such a checkpoint inflating can be restarted. Only a small
+  * number of recently used chunks is kept in memory.
+  *
+  * This is the technique from the 'zran.c' example in the zlib sources.
+  *
+  * One object is shared by all users of the same compressed file (see
+  * CompressedFileAdapter), possibly from different threads (e.g. the
+  * harddisk sector cache). So all public methods are serialized.
+  */
+class SeekableInflate
+{
+public:
+	static const size_t DEFAULT_SPAN = 1024 * 1024;
+	static const unsigned DEFAULT_CACHED_CHUNKS = 8;
+
+	/** @param input Start of the raw deflate stream. This memory must
+	  *              remain valid during the lifetime of this object.
+	  * @param inputSize Size of the input.
+	  * @param span Approximate distance between checkpoints, must be at
+	  *             least 32kB.
+	  * @param maxCachedChunks Number of decompressed chunks to keep.
+	  */
+	SeekableInflate(const byte* input, size_t inputSize,
+	                size_t span = DEFAULT_SPAN,
+	                unsigned maxCachedChunks = DEFAULT_CACHED_CHUNKS);
+
+	/** Set the size of the uncompressed data, when it's known upfront
+	  * (e.g. from a zip header). Avoids inflating the whole stream in
+	  * getSize().
+	  */
+	void setSize(size_t size);
+
+	/** Return the size of the uncompressed data. If not yet known, this
+	  * (once) inflates the remainder of the stream (in bounded memory).
+	  * @throws FileException
+	  */
+	size_t getSize();
+
+	/** Copy 'num' bytes starting at uncompressed position 'pos'.
+	  * @throws FileException on corrupt data or when reading past the end.
+	  */
+	void read(size_t pos, byte* output, size_t num);
+
+private:
+	struct Checkpoint {
+		size_t in;   // position of the first (complete) input byte
+		size_t out;  // corresponding uncompressed position
+		int bits;    // number of bits (of input[in - 1]) still to use
+		MemBuffer<byte> window; // last (max) 32kB before 'out'
+	};
+	struct Chunk {
+		size_t index; // index in 'checkpoints'
+		MemBuffer<byte> data;
+		size_t size;
+	};
+
+	const Chunk& getChunk(size_t index);
+	void inflateChunk(size_t index, Chunk& chunk);
+
+	const byte* const input;
+	const size_t inputSize;
+	const size_t span;
+	const unsigned maxCachedChunks;
+
+	std::vector<Checkpoint> checkpoints; // sorted on 'out'
+	std::vector<Chunk> cache; // most recently used first
+	size_t totalSize; // only valid when 'sizeKnown'
+	bool sizeKnown;
+	bool endReached; // found the end while inflating, all checkpoints known
+
+	std::mutex mutex; // protects the (non-const) state above
+};
+
+} // namespace openmsx
+
+#endif
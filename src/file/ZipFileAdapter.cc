@@ -19,8 +19,9 @@ void ZipFileAdapter::decompress(FileBase& f, Decompressed& d)
 		throw FileException("Invalid ZIP file");
 	}
 
-	// skip "version needed to extract" and "general purpose bit flag"
-	zlib.skip(2 + 2);
+	// skip "version needed to extract"
+	zlib.skip(2);
+	unsigned flags = zlib.get16LE(); // general purpose bit flag
 
 	// compression method
 	if (zlib.get16LE() != 0x0008) {
@@ -37,7 +38,16 @@ void ZipFileAdapter::decompress(FileBase& f, Decompressed& d)
 	d.originalName = zlib.getString(filenameLen); // original filename
 	zlib.skip(extraFieldLen); // skip "extra field"
 
-	d.size = zlib.inflate(d.buf, origSize);
+	if (useStreaming(size, origSize)) {
+		d.stream = std::make_unique<SeekableInflate>(
+			zlib.getRemainingInput(), zlib.getRemainingInputSize());
+		if (!(flags & 0x0008)) {
+			// no data descriptor, so the size in the header is valid
+			d.stream->setSize(origSize);
+		}
+	} else {
+		d.size = zlib.inflate(d.buf, origSize);
+	}
 }
 
 } // namespace openmsx
@@ -21,6 +21,10 @@ public:
 	std::string getString(size_t len);
 	std::string getCString();
 
+	/** The not yet consumed part of the input. */
+	const byte* getRemainingInput() const { return s.next_in; }
+	size_t getRemainingInputSize() const { return s.avail_in; }
+
 	size_t inflate(MemBuffer<byte>& output, size_t sizeHint = 65536);
 
 private:
@@ -1,4 +1,8 @@
 #include "HD.hh"
+#include "DiskOverlay.hh"
+#include "DiskOverlayCommand.hh"
+#include "CommandException.hh"
+#include "HDSectorCache.hh"
 #include "FileContext.hh"
 #include "FileException.hh"
 #include "FilePool.hh"
@@ -11,11 +15,14 @@
 #include "GlobalSettings.hh"
 #include "MSXException.hh"
 #include "HDCommand.hh"
+#include "IntegerSetting.hh"
 #include "Timer.hh"
 #include "serialize.hh"
 #include "xrange.hh"
 #include <cassert>
+#include <cstring>
 #include <memory>
+#include <mutex>
 
 namespace openmsx {
 
@@ -24,6 +31,8 @@ using std::string;
 HD::HD(const DeviceConfig& config)
 	: motherBoard(config.getMotherBoard())
 	, name("hdX")
+	, mmapped(nullptr)
+	, mmapFailed(false)
 {
 	hdInUse = motherBoard.getSharedStuff<HDInUse>("hdInUse");
 
@@ -69,12 +78,34 @@ HD::HD(const DeviceConfig& config)
 		motherBoard.getScheduler(),
 		*this,
 		motherBoard.getReactor().getGlobalSettings().getPowerSetting());
+	overlayCommand = std::make_unique<DiskOverlayCommand>(
+		motherBoard.getCommandController(), name, *this,
+		[this]() {
+			if (motherBoard.getReactor().getGlobalSettings().
+			        getPowerSetting().getBoolean()) {
+				throw CommandException(
+					"Can only discard the overlay when MSX "
+					"is powered down.");
+			}
+			discardOverlay();
+		});
+
+	cacheSizeSetting = motherBoard.getSharedStuff<IntegerSetting>(
+		"hdCacheSize", motherBoard.getCommandController(),
+		"hd_cache_size",
+		"size (in MB) of the sector cache of each harddisk image, 0 "
+		"disables the cache (and also read-ahead and write-behind)",
+		4, 0, 1024);
+	cacheSizeSetting->attach(*this);
+	createCache();
 
 	motherBoard.getMSXCliComm().update(CliComm::HARDWARE, name, "add");
 }
 
 HD::~HD()
 {
+	cacheSizeSetting->detach(*this);
+	flushCache();
 	motherBoard.getMSXCliComm().update(CliComm::HARDWARE, name, "remove");
 
 	unsigned id = name[2] - 'a';
@@ -84,9 +115,20 @@ HD::~HD()
 
 void HD::switchImage(const Filename& newFilename)
 {
+	// Don't drop changes that are still waiting in the cache.
+	if (!flushCache()) {
+		throw FileException("Not all changes to the current image "
+		                    "could be written");
+	}
+	// The overlay belongs to the old image.
+	discardOverlay();
+	cache.reset();
+	mmapped = nullptr;
+	mmapFailed = false;
 	file = File(newFilename);
 	filename = newFilename;
 	filesize = file.getSize();
+	createCache();
 	tigerTree = std::make_unique<TigerTree>(*this, filesize,
 			filename.getResolved());
 	motherBoard.getMSXCliComm().update(CliComm::MEDIA, getName(),
@@ -100,15 +142,52 @@ size_t HD::getNbSectorsImpl() const
 
 void HD::readSectorImpl(size_t sector, SectorBuffer& buf)
 {
+	// The mapping must see all writes done before the overlay was
+	// created, so don't map the file while those can't be written.
+	if (hasOverlay() && !mmapped && !mmapFailed && flushCache()) {
+		try {
+			std::unique_lock<std::mutex> lock;
+			if (cache) lock = cache->lockFile();
+			size_t size;
+			mmapped = file.mmap(size);
+		} catch (FileException&) {
+			// e.g. not enough address space, use plain reads
+			mmapFailed = true;
+		}
+	}
+	if (mmapped) {
+		memcpy(&buf, mmapped + sector * sizeof(buf), sizeof(buf));
+		return;
+	}
+	if (cache) {
+		cache->read(sector, buf);
+		return;
+	}
 	file.seek(sector * sizeof(buf));
 	file.read(&buf, sizeof(buf));
 }
 
 void HD::writeSectorImpl(size_t sector, const SectorBuffer& buf)
 {
+	if (mmapped) {
+		// The mapping is private, it wouldn't see this write.
+		std::unique_lock<std::mutex> lock;
+		if (cache) lock = cache->lockFile();
+		file.munmap();
+		mmapped = nullptr;
+	}
+	if (cache) {
+		cache->write(sector, buf);
+		return;
+	}
 	file.seek(sector * sizeof(buf));
 	file.write(&buf, sizeof(buf));
-	tigerTree->notifyChange(sector * sizeof(buf), sizeof(buf),
+}
+
+void HD::flushSectorCaches(size_t sector)
+{
+	SectorAccessibleDisk::flushSectorCaches(sector);
+	tigerTree->notifyChange(sector * sizeof(SectorBuffer), sizeof(SectorBuffer),
 	                        file.getModificationDate());
 }
 
@@ -119,12 +198,52 @@ bool HD::isWriteProtectedImpl() const
 
 Sha1Sum HD::getSha1SumImpl(FilePool& filePool)
 {
-	if (hasPatches()) {
+	if (hasPatches() || hasOverlay()) {
 		return SectorAccessibleDisk::getSha1SumImpl(filePool);
 	}
+	flushCache();
+	std::unique_lock<std::mutex> lock;
+	if (cache) lock = cache->lockFile();
 	return filePool.getSha1Sum(file);
 }
 
+void HD::createCache()
+{
+	cache.reset();
+	size_t capacity = size_t(cacheSizeSetting->getInt()) *
+	                  (1024 * 1024 / sizeof(SectorBuffer));
+	if (capacity && file.is_open()) {
+		cache = std::make_unique<HDSectorCache>(
+			file, getNbSectorsImpl(), capacity);
+	}
+}
+
+bool HD::flushCache()
+{
+	if (!cache) return true;
+	try {
+		cache->flush();
+		// The modification time of the image changed after the
+		// writes were reported to the tiger tree.
+		tigerTree->notifyChange(0, 0, file.getModificationDate());
+		return true;
+	} catch (MSXException& e) {
+		motherBoard.getMSXCliComm().printWarning(
+			"Error writing harddisk ", getName(), ": ",
+			e.getMessage());
+		// Some sectors are not what the tiger tree thinks they are.
+		tigerTree->notifyChange(0, filesize, file.getModificationDate());
+		return false;
+	}
+}
+
+void HD::update(const Setting& /*setting*/)
+{
+	// On a write error keep the current cache (and the sectors it still
+	// has to write), the new size is used on the next change.
+	if (flushCache()) createCache();
+}
+
 void HD::showProgress(size_t position, size_t maxPosition)
 {
 	// only show progress iff:
@@ -208,11 +327,20 @@ int HD::insertDisk(string_view newFilename)
 
 // version 1: initial version
 // version 2: replaced 'checksum'(=sha1) with 'tthsum`
+// version 3: added 'overlay'
 template<typename Archive>
 void HD::serialize(Archive& ar, unsigned version)
 {
+	if (!ar.isLoader()) {
+		// Also makes sure the tiger tree hash below is up-to-date.
+		flushCache();
+	}
 	Filename tmp = file.is_open() ? filename : Filename();
 	ar.serialize("filename", tmp);
+	string overlayName = hasOverlay() ? getOverlay()->getDeltaName() : string{};
+	if (ar.versionAtLeast(version, 3)) {
+		ar.serialize("overlay", overlayName);
+	}
 	if (ar.isLoader()) {
 		if (tmp.empty()) {
 			// Lazily open file specified in config. And close if
@@ -231,12 +359,35 @@ void HD::serialize(Archive& ar, unsigned version)
 			//  - So to get in the same state as the initial
 			//    savestate we again close the file. Otherwise the
 			//    checksum-check code below goes wrong.
+			if (!flushCache()) {
+				throw FileException(
+					"Not all changes to harddisk image ",
+					filename.getResolved(),
+					" could be written");
+			}
+			cache.reset();
 			file.close();
 		} else {
 			tmp.updateAfterLoadState();
 			if (filename != tmp) switchImage(tmp);
 			assert(file.is_open());
 		}
+		if (!overlayName.empty()) {
+			// The overlay only still exists when e.g. going back
+			// in time with reverse. Otherwise the content check
+			// below will likely give a warning.
+			if (!restoreOverlay(overlayName)) {
+				motherBoard.getMSXCliComm().printWarning(
+					"The copy-on-write overlay of harddisk ",
+					getName(), " is no longer available. Its "
+					"changes are lost, writes now go to a new "
+					"overlay.");
+				// The cached hash may still include the
+				// content of the overlay.
+				tigerTree->notifyChange(0, filesize,
+				                        file.getModificationDate());
+			}
+		}
 	}
 
 	// store/check checksum
@@ -6,6 +6,7 @@
 #include "SectorAccessibleDisk.hh"
 #include "DiskContainer.hh"
 #include "TigerTree.hh"
+#include "Observer.hh"
 #include "serialize_meta.hh"
 #include <bitset>
 #include <string>
@@ -15,10 +16,14 @@ namespace openmsx {
 
 class MSXMotherBoard;
 class HDCommand;
+class DiskOverlayCommand;
+class HDSectorCache;
 class DeviceConfig;
+class IntegerSetting;
+class Setting;
 
 class HD : public SectorAccessibleDisk, public DiskContainer
-         , public TTData
+         , public TTData, private Observer<Setting>
 {
 public:
 	explicit HD(const DeviceConfig& config);
@@ -26,6 +31,9 @@ public:
 
 	const std::string& getName() const { return name; }
 	const Filename& getImageName() const { return filename; }
+	/** @throws FileException, also when not all changes to the current
+	  *         image could be written (then it stays inserted).
+	  */
 	void switchImage(const Filename& filename);
 
 	std::string getTigerTreeHash();
@@ -42,6 +50,7 @@ private:
 	size_t getNbSectorsImpl() const override;
 	bool isWriteProtectedImpl() const override;
 	Sha1Sum getSha1SumImpl(FilePool& filePool) override;
+	void flushSectorCaches(size_t sector) override;
 
 	// Diskcontainer:
 	SectorAccessibleDisk* getSectorAccessibleDisk() override;
@@ -53,16 +62,33 @@ private:
 	uint8_t* getData(size_t offset, size_t size) override;
 	bool isCacheStillValid(time_t& time) override;
 
+	// Observer<Setting>
+	void update(const Setting& setting) override;
+
 	void showProgress(size_t position, size_t maxPosition);
+	void createCache();
+	/** Returns false (after printing a warning) when not all sectors
+	  * could be written.
+	  */
+	bool flushCache();
 
 	MSXMotherBoard& motherBoard;
 	std::string name;
 	std::unique_ptr<HDCommand> hdCommand;
+	std::unique_ptr<DiskOverlayCommand> overlayCommand;
 	std::unique_ptr<TigerTree> tigerTree;
 
 	File file;
 	Filename filename;
 	size_t filesize;
+	// While there's an overlay the image isn't written, then unmodified
+	// sectors are read from this mapping (nullptr if not yet mapped or
+	// if mapping failed).
+	const byte* mmapped;
+	bool mmapFailed;
+	std::shared_ptr<IntegerSetting> cacheSizeSetting;
+	// nullptr if caching is disabled (or there's no file)
+	std::unique_ptr<HDSectorCache> cache;
 
 	static const unsigned MAX_HD = 26;
 	using HDInUse = std::bitset<MAX_HD>;
@@ -73,7 +99,7 @@ private:
 };
 
 REGISTER_BASE_CLASS(HD, "HD");
-SERIALIZE_CLASS_VERSION(HD, 2);
+SERIALIZE_CLASS_VERSION(HD, 3);
 
 } // namespace openmsx
 
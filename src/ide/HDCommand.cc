@@ -31,9 +31,14 @@ void HDCommand::execute(array_ref<TclObject> tokens, TclObject& result,
 		result.addListElement(hd.getName() + ':');
 		result.addListElement(hd.getImageName().getResolved());
 
+		TclObject options;
 		if (hd.isWriteProtected()) {
-			TclObject options;
 			options.addListElement("readonly");
+		}
+		if (hd.hasOverlay()) {
+			options.addListElement("overlay");
+		}
+		if (options.getListLength(getInterpreter()) != 0) {
 			result.addListElement(options);
 		}
 	} else if ((tokens.size() == 2) ||
@@ -0,0 +1,369 @@
+#include "HDSectorCache.hh"
+#include "File.hh"
+#include "FileException.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace openmsx {
+
+const size_t HDSectorCache::MAX_BATCH;
+const size_t HDSectorCache::MIN_READ_AHEAD;
+const size_t HDSectorCache::MAX_READ_AHEAD;
+
+HDSectorCache::HDSectorCache(File& file_, size_t nbSectors_, size_t capacity_)
+	: file(file_)
+	, nbSectors(nbSectors_)
+	, capacity(capacity_)
+	, lruFirst(NONE)
+	, lruLast(NONE)
+	, nbBusy(0)
+	, nextSequential(size_t(-1))
+	, readAheadSize(0)
+	, readAheadEnd(0)
+	, requestFirst(0)
+	, requestEnd(0)
+	, inFlightFirst(0)
+	, inFlightEnd(0)
+	, nbFileReads(0)
+	, exitThread(false)
+{
+	assert(capacity != 0);
+	missBuf.resize(MIN_READ_AHEAD);
+	ioBuf.resize(MAX_BATCH);
+	thread = std::thread([this]() { run(); });
+}
+
+HDSectorCache::~HDSectorCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		exitThread = true;
+	}
+	workAvailable.notify_one();
+	thread.join();
+}
+
+void HDSectorCache::read(size_t sector, SectorBuffer& buf)
+{
+	assert(sector < nbSectors);
+	std::unique_lock<std::mutex> lock(mutex);
+	bool sequential = sector == nextSequential;
+	nextSequential = sector + 1;
+	while (true) {
+		auto it = index.find(sector);
+		if (it != index.end()) {
+			unsigned idx = it->second;
+			buf = entries[idx].buf;
+			unlink(idx);
+			linkFront(idx);
+			break;
+		}
+		if ((inFlightFirst <= sector) && (sector < inFlightEnd)) {
+			// The background thread is reading it right now.
+			workDone.wait(lock);
+			continue;
+		}
+		readMiss(lock, sector, buf, sequential);
+		break;
+	}
+	if (sequential) {
+		requestReadAhead(sector);
+	} else {
+		readAheadSize = 0;
+	}
+}
+
+void HDSectorCache::readMiss(std::unique_lock<std::mutex>& lock, size_t sector,
+                             SectorBuffer& buf, bool sequential)
+{
+	// When reading sequentially, also read the following sectors (up to
+	// the first one that's already cached) in the same file operation.
+	size_t num = 1;
+	if (sequential) {
+		size_t maxNum = std::min(MIN_READ_AHEAD, nbSectors - sector);
+		while ((num < maxNum) &&
+		       !index.contains(sector + num) &&
+		       !((inFlightFirst <= (sector + num)) &&
+		         ((sector + num) < inFlightEnd))) {
+			++num;
+		}
+	}
+	// No need for the background thread to read these again.
+	if ((sector <= requestFirst) && (requestFirst < (sector + num))) {
+		requestFirst = std::min(sector + num, requestEnd);
+	}
+
+	lock.unlock();
+	fileRead(sector, num, missBuf.data()); // may throw (then lock stays unlocked)
+	lock.lock();
+
+	insertClean(sector, num, missBuf.data());
+	buf = missBuf[0];
+}
+
+void HDSectorCache::requestReadAhead(size_t sector)
+{
+	// Never let the read-ahead push out more than half of the cache.
+	size_t maxSize = std::min(MAX_READ_AHEAD, capacity / 2);
+	if (maxSize == 0) return;
+
+	if (readAheadSize == 0) {
+		// start of a sequential stream
+		readAheadSize = std::min(MIN_READ_AHEAD, maxSize);
+		readAheadEnd = sector + 1;
+	}
+	readAheadEnd = std::max(readAheadEnd, sector + 1);
+	if ((readAheadEnd - sector) > (readAheadSize / 2)) {
+		return; // still far enough ahead
+	}
+	size_t end = std::min(readAheadEnd + readAheadSize, nbSectors);
+	if (end <= readAheadEnd) return; // at the end of the image
+
+	if ((requestFirst < requestEnd) && (requestEnd == readAheadEnd)) {
+		requestEnd = end; // extend the pending request
+	} else {
+		requestFirst = readAheadEnd; // replace an older request
+		requestEnd = end;
+	}
+	readAheadEnd = end;
+	readAheadSize = std::min(2 * readAheadSize, maxSize);
+	workAvailable.notify_one();
+}
+
+void HDSectorCache::write(size_t sector, const SectorBuffer& buf)
+{
+	assert(sector < nbSectors);
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!writeError.empty()) throwWriteError();
+
+	unsigned idx;
+	auto it = index.find(sector);
+	if (it != index.end()) {
+		idx = it->second;
+		unlink(idx);
+		linkFront(idx);
+	} else {
+		// If all cached sectors still need to be written, wait till
+		// the background thread wrote some of them.
+		workDone.wait(lock, [&] {
+			return (entries.size() < capacity) ||
+			       (nbBusy < entries.size()) || !writeError.empty();
+		});
+		// Meanwhile the background thread may have read this sector.
+		it = index.find(sector);
+		if (it != index.end()) {
+			idx = it->second;
+			unlink(idx);
+			linkFront(idx);
+		} else {
+			idx = allocate(sector);
+			if (idx == NONE) {
+				// all entries are waiting to be written
+				// again, after a write error
+				throwWriteError();
+			}
+		}
+	}
+
+	auto& e = entries[idx];
+	e.buf = buf;
+	if (!e.dirty) {
+		if (!e.writing) ++nbBusy;
+		e.dirty = true;
+		dirtySectors.insert(sector);
+	}
+	workAvailable.notify_one();
+}
+
+void HDSectorCache::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [&] { return (nbBusy == 0) || !writeError.empty(); });
+	if (!writeError.empty()) throwWriteError();
+}
+
+void HDSectorCache::throwWriteError()
+{
+	// The failed sectors are still dirty, they're written again (as
+	// soon as the background thread sees the error is cleared).
+	std::string error = std::move(writeError);
+	writeError.clear();
+	workAvailable.notify_one();
+	throw FileException(error);
+}
+
+std::unique_lock<std::mutex> HDSectorCache::lockFile()
+{
+	return std::unique_lock<std::mutex>(fileMutex);
+}
+
+size_t HDSectorCache::getNbCached()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return index.size();
+}
+
+void HDSectorCache::unlink(unsigned idx)
+{
+	auto& e = entries[idx];
+	if (e.prev != NONE) entries[e.prev].next = e.next; else lruFirst = e.next;
+	if (e.next != NONE) entries[e.next].prev = e.prev; else lruLast  = e.prev;
+}
+
+void HDSectorCache::linkFront(unsigned idx)
+{
+	auto& e = entries[idx];
+	e.prev = NONE;
+	e.next = lruFirst;
+	if (lruFirst != NONE) entries[lruFirst].prev = idx; else lruLast = idx;
+	lruFirst = idx;
+}
+
+// Returns NONE if the cache is full and all entries are busy.
+unsigned HDSectorCache::allocate(size_t sector)
+{
+	unsigned idx;
+	if (entries.size() < capacity) {
+		idx = unsigned(entries.size());
+		entries.emplace_back();
+	} else {
+		// Evict the least recently used sector that's not (being)
+		// written.
+		idx = lruLast;
+		while ((idx != NONE) && isBusy(entries[idx])) {
+			idx = entries[idx].prev;
+		}
+		if (idx == NONE) return NONE;
+		index.erase(entries[idx].sector);
+		unlink(idx);
+	}
+	auto& e = entries[idx];
+	e.sector = sector;
+	e.dirty = false;
+	e.writing = false;
+	index.emplace(sector, idx);
+	linkFront(idx);
+	return idx;
+}
+
+void HDSectorCache::insertClean(size_t first, size_t num, const SectorBuffer* bufs)
+{
+	for (size_t i = 0; i < num; ++i) {
+		// Don't overwrite sectors that were written in the mean time.
+		if (index.contains(first + i)) continue;
+		unsigned idx = allocate(first + i);
+		if (idx == NONE) return;
+		entries[idx].buf = bufs[i];
+	}
+}
+
+void HDSectorCache::fileRead(size_t first, size_t num, SectorBuffer* bufs)
+{
+	std::lock_guard<std::mutex> fileLock(fileMutex);
+	file.seek(first * sizeof(SectorBuffer));
+	file.read(bufs, num * sizeof(SectorBuffer));
+	++nbFileReads;
+}
+
+void HDSectorCache::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		// After a write error, don't retry the writes until the error
+		// was reported, see throwWriteError().
+		auto mustWrite = [&] {
+			return !dirtySectors.empty() && writeError.empty();
+		};
+		workAvailable.wait(lock, [&] {
+			return exitThread || mustWrite() ||
+			       (requestFirst < requestEnd);
+		});
+		if (exitThread) return;
+		// Writes first, the main thread may be waiting for free entries.
+		if (mustWrite()) {
+			writeBack(lock);
+		} else {
+			readAhead(lock);
+		}
+	}
+}
+
+void HDSectorCache::writeBack(std::unique_lock<std::mutex>& lock)
+{
+	// Take the first run of consecutive dirty sectors.
+	auto it = dirtySectors.begin();
+	size_t first = *it;
+	size_t num = 0;
+	while ((it != dirtySectors.end()) && (*it == (first + num)) &&
+	       (num < MAX_BATCH)) {
+		auto& e = entries[index.find(*it)->second];
+		ioBuf[num] = e.buf;
+		e.dirty = false;
+		e.writing = true;
+		it = dirtySectors.erase(it);
+		++num;
+	}
+
+	lock.unlock();
+	std::string error;
+	{
+		std::lock_guard<std::mutex> fileLock(fileMutex);
+		try {
+			file.seek(first * sizeof(SectorBuffer));
+			file.write(ioBuf.data(), num * sizeof(SectorBuffer));
+		} catch (FileException& e) {
+			error = e.getMessage();
+		}
+	}
+	lock.lock();
+
+	bool failed = !error.empty();
+	if (failed && writeError.empty()) {
+		writeError = std::move(error);
+	}
+	for (size_t i = 0; i < num; ++i) {
+		// Busy entries are never evicted, so it's still there.
+		auto& e = entries[index.find(first + i)->second];
+		e.writing = false;
+		if (e.dirty) {
+			// changed again while writing, still in 'dirtySectors'
+		} else if (failed) {
+			// keep it, so it can be written again later
+			e.dirty = true;
+			dirtySectors.insert(first + i);
+		} else {
+			--nbBusy;
+		}
+	}
+	workDone.notify_all();
+}
+
+void HDSectorCache::readAhead(std::unique_lock<std::mutex>& lock)
+{
+	while ((requestFirst < requestEnd) && index.contains(requestFirst)) {
+		++requestFirst;
+	}
+	if (requestFirst == requestEnd) return;
+	size_t first = requestFirst;
+	size_t num = std::min(requestEnd - first, MAX_BATCH);
+	requestFirst += num;
+	inFlightFirst = first;
+	inFlightEnd = first + num;
+
+	lock.unlock();
+	bool ok = true;
+	try {
+		fileRead(first, num, ioBuf.data());
+	} catch (FileException&) {
+		// Ignore, the main thread gets the error when it reads these
+		// sectors itself.
+		ok = false;
+	}
+	lock.lock();
+
+	if (ok) insertClean(first, num, ioBuf.data());
+	inFlightFirst = inFlightEnd = 0;
+	workDone.notify_all();
+}
+
+} // namespace openmsx
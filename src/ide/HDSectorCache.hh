@@ -0,0 +1,145 @@
+#ifndef HDSECTORCACHE_HH
+#define HDSECTORCACHE_HH
+
+#include "DiskImageUtils.hh"
+#include "hash_map.hh"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace openmsx {
+
+class File;
+
+/** Sector I/O layer between a harddisk image file and the emulation.
+  *
+  * Without this, each sector access is a seek plus a 512-byte read or write
+  * on the emulation thread. That's fine for a local disk, but on slower
+  * (e.g. network) storage the emulation stalls on every sector of a long
+  * multi-sector command. This class adds:
+  *  - An LRU cache of sectors, with a fixed maximum size.
+  *  - Read-ahead: when sectors are read sequentially, a background thread
+  *    reads the following sectors (with a growing window) before they are
+  *    requested. A sequential miss is read in one batch.
+  *  - Write-behind: written sectors stay in the cache and are written to the
+  *    file by the background thread, consecutive sectors in a single write.
+  *    Call flush() to wait till everything is written (e.g. before saving a
+  *    state or before accessing the file directly).
+  *
+  * Write errors are only noticed later, they are reported (as a
+  * FileException) by the next write() or flush(). The sectors that failed
+  * stay in the cache, and are written again after the error was reported.
+  */
+class HDSectorCache
+{
+public:
+	/** @param file The image file, must remain open (and must not be
+	  *             used directly, see lockFile()) as long as this object
+	  *             exists.
+	  * @param nbSectors The size of the image.
+	  * @param capacity The maximum number of cached sectors, must be
+	  *                 non-zero.
+	  */
+	HDSectorCache(File& file, size_t nbSectors, size_t capacity);
+	/** Doesn't flush, sectors that are not yet written are lost. */
+	~HDSectorCache();
+
+	void read (size_t sector,       SectorBuffer& buf);
+	void write(size_t sector, const SectorBuffer& buf);
+
+	/** Wait till all written sectors are stored in the file. Throws
+	  * FileException when that failed (the sectors are retried later).
+	  */
+	void flush();
+
+	/** Exclusive access to the file (e.g. to calculate a hash). Usually
+	  * preceded by a flush(), otherwise the file may not be up-to-date.
+	  */
+	std::unique_lock<std::mutex> lockFile();
+
+	size_t getCapacity() const { return capacity; }
+	size_t getNbCached();
+	/** Number of read calls on the file, for the unittests. */
+	unsigned getNbFileReads() const { return nbFileReads; }
+
+	/** Maximum number of sectors read or written in one file operation. */
+	static const size_t MAX_BATCH = 64;
+	/** Initial and maximum size of the read-ahead window (in sectors). */
+	static const size_t MIN_READ_AHEAD = 8;
+	static const size_t MAX_READ_AHEAD = 256;
+
+private:
+	static const unsigned NONE = unsigned(-1);
+	struct Entry {
+		SectorBuffer buf;
+		size_t sector;
+		unsigned prev; // LRU list, most recently used first
+		unsigned next;
+		bool dirty;    // not yet written (or changed again while writing)
+		bool writing;  // being written by the background thread
+	};
+	bool isBusy(const Entry& e) const { return e.dirty || e.writing; }
+
+	void unlink(unsigned idx);
+	void linkFront(unsigned idx);
+	unsigned allocate(size_t sector);
+	void insertClean(size_t first, size_t num, const SectorBuffer* bufs);
+	void readMiss(std::unique_lock<std::mutex>& lock, size_t sector,
+	              SectorBuffer& buf, bool sequential);
+	void requestReadAhead(size_t sector);
+	void throwWriteError();
+	void fileRead(size_t first, size_t num, SectorBuffer* bufs);
+
+	// background thread
+	void run();
+	void writeBack(std::unique_lock<std::mutex>& lock);
+	void readAhead(std::unique_lock<std::mutex>& lock);
+
+	File& file;
+	const size_t nbSectors;
+	const size_t capacity;
+
+	// Protects all file access. When both are needed, this one must be
+	// locked first.
+	std::mutex fileMutex;
+	// Protects everything below.
+	std::mutex mutex;
+	std::condition_variable workAvailable; // for the background thread
+	std::condition_variable workDone;      // for the main thread
+
+	std::vector<Entry> entries;
+	hash_map<size_t, unsigned> index; // sector -> index in 'entries'
+	unsigned lruFirst;
+	unsigned lruLast;
+	std::set<size_t> dirtySectors; // sorted, to combine consecutive sectors
+	size_t nbBusy; // number of entries that are dirty or being written
+	std::string writeError;
+
+	// sequential read detection
+	size_t nextSequential;
+	size_t readAheadSize;  // 0 if the last read wasn't sequential
+	size_t readAheadEnd;   // sectors before this are cached or requested
+	// requested read-ahead, not yet started
+	size_t requestFirst;
+	size_t requestEnd;
+	// read-ahead in progress
+	size_t inFlightFirst;
+	size_t inFlightEnd;
+
+	std::atomic<unsigned> nbFileReads;
+	bool exitThread;
+	std::thread thread;
+
+	// only used by the main thread (readMiss)
+	std::vector<SectorBuffer> missBuf;
+	// only used by the background thread
+	std::vector<SectorBuffer> ioBuf;
+};
+
+} // namespace openmsx
+
+#endif
@@ -20,6 +20,8 @@
  */
 
 #include "SCSILS120.hh"
+#include "DiskOverlay.hh"
+#include "DiskOverlayCommand.hh"
 #include "FileOperations.hh"
 #include "FileException.hh"
 #include "FilePool.hh"
@@ -117,6 +119,17 @@ SCSILS120::SCSILS120(const DeviceConfig& targetconfig,
 		motherBoard.getCommandController(),
 		motherBoard.getStateChangeDistributor(),
 		motherBoard.getScheduler(), *this);
+	overlayCommand = std::make_unique<DiskOverlayCommand>(
+		motherBoard.getCommandController(), name, *this,
+		[this]() {
+			if (!hasOverlay()) return;
+			// the content of the disk changes
+			discardOverlay();
+			mediaChanged = true;
+			if (mode & SCSIDevice::MODE_UNITATTENTION) {
+				unitAttention = true;
+			}
+		});
 
 	reset();
 }
@@ -334,7 +347,7 @@ unsigned SCSILS120::requestSense()
 
 bool SCSILS120::checkReadOnly()
 {
-	if (file.isReadOnly()) {
+	if (isWriteProtected()) {
 		keycode = SCSI::SENSE_WRITE_PROTECT;
 		return true;
 	}
@@ -375,7 +388,7 @@ bool SCSILS120::checkAddress()
 }
 
 // Execute scsiDeviceCheckAddress previously.
-unsigned SCSILS120::readSector(unsigned& blocks)
+unsigned SCSILS120::readSectors(unsigned& blocks)
 {
 	motherBoard.getLedStatus().setLed(LedStatus::FDD, true);
 
@@ -383,14 +396,15 @@ unsigned SCSILS120::readSector(unsigned& blocks)
 	unsigned counter = currentLength * SECTOR_SIZE;
 
 	try {
-		// TODO: somehow map this to SectorAccessibleDisk::readSector?
-		file.seek(SECTOR_SIZE * currentSector);
-		file.read(buffer, SECTOR_SIZE * numSectors);
-		currentSector += numSectors;
-		currentLength -= numSectors;
+		for (unsigned i = 0; i < numSectors; ++i) {
+			auto* sbuf = aligned_cast<SectorBuffer*>(buffer);
+			readSector(currentSector, sbuf[i]);
+			++currentSector;
+			--currentLength;
+		}
 		blocks = currentLength;
 		return counter;
-	} catch (FileException&) {
+	} catch (MSXException&) {
 		blocks = 0;
 		keycode = SCSI::SENSE_UNRECOVERED_READ_ERROR;
 		return 0;
@@ -400,7 +414,7 @@ unsigned SCSILS120::readSector(unsigned& blocks)
 unsigned SCSILS120::dataIn(unsigned& blocks)
 {
 	if (cdb[0] == SCSI::OP_READ10) {
-		unsigned counter = readSector(blocks);
+		unsigned counter = readSectors(blocks);
 		if (counter) {
 			return counter;
 		}
@@ -411,24 +425,25 @@ unsigned SCSILS120::dataIn(unsigned& blocks)
 }
 
 // Execute scsiDeviceCheckAddress and scsiDeviceCheckReadOnly previously.
-unsigned SCSILS120::writeSector(unsigned& blocks)
+unsigned SCSILS120::writeSectors(unsigned& blocks)
 {
 	motherBoard.getLedStatus().setLed(LedStatus::FDD, true);
 
 	unsigned numSectors = std::min(currentLength, BUFFER_BLOCK_SIZE);
 
-	// TODO: somehow map this to SectorAccessibleDisk::writeSector?
 	try {
-		file.seek(SECTOR_SIZE * currentSector);
-		file.write(buffer, SECTOR_SIZE * numSectors);
-		currentSector += numSectors;
-		currentLength -= numSectors;
+		for (unsigned i = 0; i < numSectors; ++i) {
+			auto* sbuf = aligned_cast<const SectorBuffer*>(buffer);
+			writeSector(currentSector, sbuf[i]);
+			++currentSector;
+			--currentLength;
+		}
 
 		unsigned tmp = std::min(currentLength, BUFFER_BLOCK_SIZE);
 		blocks = currentLength - tmp;
 		unsigned counter = tmp * SECTOR_SIZE;
 		return counter;
-	} catch (FileException&) {
+	} catch (MSXException&) {
 		keycode = SCSI::SENSE_WRITE_FAULT;
 		blocks = 0;
 		return 0;
@@ -438,7 +453,7 @@ unsigned SCSILS120::writeSector(unsigned& blocks)
 unsigned SCSILS120::dataOut(unsigned& blocks)
 {
 	if (cdb[0] == SCSI::OP_WRITE10) {
-		return writeSector(blocks);
+		return writeSectors(blocks);
 	}
 	// error
 	blocks = 0;
@@ -449,13 +464,13 @@ unsigned SCSILS120::dataOut(unsigned& blocks)
 void SCSILS120::formatUnit()
 {
 	if (getReady() && !checkReadOnly()) {
-		memset(buffer, 0, SECTOR_SIZE);
+		auto& sbuf = *aligned_cast<SectorBuffer*>(buffer);
+		memset(&sbuf, 0, sizeof(sbuf));
 		try {
-			file.seek(0);
-			file.write(buffer, SECTOR_SIZE);
+			writeSector(0, sbuf);
 			unitAttention = true;
 			mediaChanged = true;
-		} catch (FileException&) {
+		} catch (MSXException&) {
 			keycode = SCSI::SENSE_WRITE_FAULT;
 		}
 	}
@@ -468,6 +483,8 @@ byte SCSILS120::getStatusCode()
 
 void SCSILS120::eject()
 {
+	// The overlay belongs to the old disk.
+	discardOverlay();
 	file.close();
 	mediaChanged = true;
 	if (mode & MODE_UNITATTENTION) {
@@ -478,7 +495,9 @@ void SCSILS120::eject()
 
 void SCSILS120::insert(string_view filename)
 {
-	file = File(filename);
+	File newFile(filename);
+	discardOverlay();
+	file = std::move(newFile);
 	mediaChanged = true;
 	if (mode & MODE_UNITATTENTION) {
 		unitAttention = true;
@@ -545,7 +564,7 @@ unsigned SCSILS120::executeCmd(const byte* cdb_, SCSI::Phase& phase, unsigned& b
 				currentLength = SECTOR_SIZE >> 1;
 			}
 			if (checkAddress()) {
-				unsigned counter = readSector(blocks);
+				unsigned counter = readSectors(blocks);
 				if (counter) {
 					cdb[0] = SCSI::OP_READ10;
 					phase = SCSI::DATA_IN;
@@ -605,7 +624,7 @@ unsigned SCSILS120::executeCmd(const byte* cdb_, SCSI::Phase& phase, unsigned& b
 		switch (cdb[0]) {
 		case SCSI::OP_READ10:
 			if (checkAddress()) {
-				unsigned counter = readSector(blocks);
+				unsigned counter = readSectors(blocks);
 				if (counter) {
 					phase = SCSI::DATA_IN;
 					return counter;
@@ -700,12 +719,12 @@ size_t SCSILS120::getNbSectorsImpl() const
 
 bool SCSILS120::isWriteProtectedImpl() const
 {
-	return false;
+	return file.is_open() && file.isReadOnly();
 }
 
 Sha1Sum SCSILS120::getSha1SumImpl(FilePool& filePool)
 {
-	if (hasPatches()) {
+	if (hasPatches() || hasOverlay()) {
 		return SectorAccessibleDisk::getSha1SumImpl(filePool);
 	}
 	return filePool.getSha1Sum(file);
@@ -767,7 +786,12 @@ void LSXCommand::execute(array_ref<TclObject> tokens, TclObject& result,
 		auto& file = ls.file;
 		result.addListElement(ls.name + ':');
 		result.addListElement(file.is_open() ? file.getURL() : string{});
-		if (!file.is_open()) result.addListElement("empty");
+		TclObject options;
+		if (!file.is_open()) options.addListElement("empty");
+		if (ls.hasOverlay()) options.addListElement("overlay");
+		if (options.getListLength(getInterpreter()) != 0) {
+			result.addListElement(options);
+		}
 	} else if ((tokens.size() == 2) &&
 	           ((tokens[1] == "eject") || (tokens[1] == "-eject"))) {
 		ls.eject();
@@ -818,17 +842,33 @@ void LSXCommand::tabCompletion(vector<string>& tokens) const
 }
 
 
+// version 1: initial version
+// version 2: added 'overlay'
 template<typename Archive>
-void SCSILS120::serialize(Archive& ar, unsigned /*version*/)
+void SCSILS120::serialize(Archive& ar, unsigned version)
 {
 	string filename = file.is_open() ? file.getURL() : string{};
 	ar.serialize("filename", filename);
+	string overlayName = hasOverlay() ? getOverlay()->getDeltaName() : string{};
+	if (ar.versionAtLeast(version, 2)) {
+		ar.serialize("overlay", overlayName);
+	}
 	if (ar.isLoader()) {
 		// re-insert disk before restoring 'mediaChanged'
 		if (filename.empty()) {
 			eject();
 		} else {
 			insert(filename);
+			if (!overlayName.empty()) {
+				// see HD::serialize()
+				if (!restoreOverlay(overlayName)) {
+					motherBoard.getMSXCliComm().printWarning(
+						"The copy-on-write overlay of ", name,
+						" is no longer available. Its changes "
+						"are lost, writes now go to a new "
+						"overlay.");
+				}
+			}
 		}
 	}
 
@@ -14,6 +14,7 @@
 #include "SectorAccessibleDisk.hh"
 #include "DiskContainer.hh"
 #include "File.hh"
+#include "serialize_meta.hh"
 #include <bitset>
 #include <memory>
 
@@ -22,6 +23,7 @@ namespace openmsx {
 class DeviceConfig;
 class MSXMotherBoard;
 class LSXCommand;
+class DiskOverlayCommand;
 
 class SCSILS120 final : public SCSIDevice, public SectorAccessibleDisk
                       , public DiskContainer
@@ -76,14 +78,15 @@ private:
 	bool checkReadOnly();
 	unsigned readCapacity();
 	bool checkAddress();
-	unsigned readSector(unsigned& blocks);
-	unsigned writeSector(unsigned& blocks);
+	unsigned readSectors(unsigned& blocks);
+	unsigned writeSectors(unsigned& blocks);
 	void formatUnit();
 
 	MSXMotherBoard& motherBoard;
 	AlignedBuffer& buffer;
 	File file;
 	std::unique_ptr<LSXCommand> lsxCommand;
+	std::unique_ptr<DiskOverlayCommand> overlayCommand;
 	std::string name;
 	const int mode;
 	unsigned keycode;      // Sense key, ASC, ASCQ
@@ -102,6 +105,7 @@ private:
 
 	friend class LSXCommand;
 };
+SERIALIZE_CLASS_VERSION(SCSILS120, 2);
 
 } // namespace openmsx
 
@@ -6,6 +6,9 @@
 #include "MSXEventDistributor.hh"
 #include "StateChangeDistributor.hh"
 #include "MSXMotherBoard.hh"
+#include "MSXCPU.hh"
+#include "MSXCPUInterface.hh"
+#include "CPURegs.hh"
 #include "ReverseManager.hh"
 #include "CommandController.hh"
 #include "CommandException.hh"
@@ -106,7 +109,13 @@ static const std::array<KeyMatrixPosition, UnicodeKeymap::KeyInfo::NUM_MODIFIERS
 	},
 };
 
-Keyboard::Keyboard(MSXMotherBoard& motherBoard,
+// Only for MATRIX_MSX and MATRIX_SVI, a ColecoVision has no such buffer.
+const Keyboard::KeyBufferInfo Keyboard::keyBufferForMatrix[] = {
+	{ 0xF3F8, 0xF3FA, 0xFBF0, 0xFC18, 0x4000, true  }, // MATRIX_MSX
+	{ 0xFA1A, 0xFA1C, 0xFD8B, 0xFDB3, 0x8000, false }, // MATRIX_SVI
+};
+
+Keyboard::Keyboard(MSXMotherBoard& motherBoard_,
                    Scheduler& scheduler_,
                    CommandController& commandController_,
                    EventDistributor& eventDistributor,
@@ -115,6 +124,7 @@ Keyboard::Keyboard(MSXMotherBoard& motherBoard,
                    MatrixType matrix,
                    const DeviceConfig& config)
 	: Schedulable(scheduler_)
+	, motherBoard(motherBoard_)
 	, commandController(commandController_)
 	, msxEventDistributor(msxEventDistributor_)
 	, stateChangeDistributor(stateChangeDistributor_)
@@ -140,6 +150,11 @@ Keyboard::Keyboard(MSXMotherBoard& motherBoard,
 		| (config.getChildDataAsBool("graph_locks", false) ? KeyInfo::GRAPH_MASK : 0))
 	, sdlReleasesCapslock(checkSDLReleasesCapslock())
 	, locksOn(0)
+	, keyBuffer(matrix != MATRIX_CVJOY ? &keyBufferForMatrix[matrix] : nullptr)
+	, keyBufferEnabled(false)
+	, keyBufferBusy(false)
+	, keyBufferProgress(EmuTime::zero)
+	, keyBufferGetPnt(0)
 {
 	// SDL version >= 1.2.14 releases caps-lock key when SDL_DISABLED_LOCK_KEYS
 	// environment variable is already set in main.cc (because here it
@@ -899,6 +914,109 @@ void Keyboard::debug(const char* format, ...)
 	}
 }
 
+/*
+ * Check whether the CPU is executing the main BIOS. When the keyboard buffer
+ * is empty, this means that the MSX is waiting for a key (e.g. in CHGET).
+ */
+bool Keyboard::inBiosInputLoop(EmuTime::param time)
+{
+	if (motherBoard.getCPU().getRegisters().getPC() >= keyBuffer->biosEnd) {
+		return false;
+	}
+	if (!keyBuffer->checkMainRomSlot) return true;
+
+	// EXPTBL contains the slot of the main ROM
+	auto& cpuInterface = motherBoard.getCPUInterface();
+	byte mainRom = cpuInterface.peekMem(0xFCC1, time);
+	if (cpuInterface.getPrimarySlot(0) != (mainRom & 3)) return false;
+	return !(mainRom & 0x80) ||
+	       (cpuInterface.getSecondarySlot(0) == ((mainRom >> 2) & 3));
+}
+
+/*
+ * Insert characters directly in the keyboard buffer of the BIOS. It is used
+ * by the 'type_via_keyboard -keybuf' command. This is a lot faster than
+ * pressing keys in the keyboard matrix, but it only works when the MSX reads
+ * its input via the BIOS.
+ *
+ * A line is only started when the buffer is empty and the MSX is waiting in
+ * the BIOS. The rest of the line (till and including the next CR) is then
+ * added as soon as there's room in the buffer. So whatever happens after a
+ * line (e.g. a BASIC program is started) doesn't get more than one line of
+ * type-ahead. When the MSX doesn't read from the buffer for a while, or for
+ * characters that aren't plain ASCII, we fall back to the keyboard matrix.
+ */
+int Keyboard::typeViaKeyBuffer(string_view text, EmuTime::param time)
+{
+	static const EmuDuration TIMEOUT = EmuDuration::sec(2);
+
+	if (!keyBuffer) return -1;
+	auto& cpuInterface = motherBoard.getCPUInterface();
+	auto peek16 = [&](word address) {
+		return word(cpuInterface.peekMem(address + 0, time) +
+		            cpuInterface.peekMem(address + 1, time) * 256);
+	};
+	auto isValid = [&](word pointer) {
+		return (keyBuffer->keyBuf <= pointer) && (pointer < keyBuffer->bufEnd);
+	};
+	auto canInsert = [&](byte c) {
+		// plain ASCII (the same in all MSX character sets), and also
+		// on this keyboard
+		return (c != 0) && (c < 0x80) && unicodeKeymap.get(c).isValid();
+	};
+	word putPnt = peek16(keyBuffer->putPnt);
+	word getPnt = peek16(keyBuffer->getPnt);
+	if (!isValid(putPnt) || !isValid(getPnt)) {
+		// not the BIOS keyboard buffer (anymore)
+		keyBufferBusy = false;
+		return -1;
+	}
+	if (getPnt != keyBufferGetPnt) {
+		// the MSX has read from the buffer
+		keyBufferGetPnt = getPnt;
+		keyBufferProgress = time;
+	}
+	bool waitedTooLong = (time - keyBufferProgress) >= TIMEOUT;
+
+	if (!keyBufferBusy) {
+		if ((putPnt != getPnt) || !inBiosInputLoop(time)) {
+			// Shortly after a line was typed, the MSX is typically
+			// still busy with it (e.g. a BASIC line is tokenized).
+			return waitedTooLong ? -1 : 0;
+		}
+		keyBufferBusy = true;
+	}
+
+	word pnt = putPnt;
+	size_t num = 0;
+	while (num < text.size()) {
+		auto c = byte(text[num]);
+		if (!canInsert(c)) break;
+		word next = (pnt + 1 == keyBuffer->bufEnd) ? keyBuffer->keyBuf : pnt + 1;
+		if (next == getPnt) break; // buffer full
+		cpuInterface.writeMem(pnt, c, time);
+		pnt = next;
+		++num;
+		if (c == '\r') {
+			keyBufferBusy = false;
+			break;
+		}
+	}
+	if (num == 0) {
+		if (!text.empty() && canInsert(text[0]) && !waitedTooLong) {
+			// buffer full, wait till the MSX reads from it
+			return 0;
+		}
+		keyBufferBusy = false;
+		return -1;
+	}
+	debug("Typed %u characters via the keyboard buffer\n", unsigned(num));
+	cpuInterface.writeMem(keyBuffer->putPnt + 0, pnt & 255, time);
+	cpuInterface.writeMem(keyBuffer->putPnt + 1, pnt >> 8,  time);
+	keyBufferProgress = time;
+	return int(num);
+}
+
 
 // class KeyMatrixUpCmd
 
@@ -1037,10 +1155,12 @@ void Keyboard::KeyInserter::execute(
 
 	// for full backwards compatibility: one option means type it...
 	if (tokens.size() == 2) {
-		type(tokens[1].getString());
+		type(tokens[1].getString(), false);
 		return;
 	}
 
+	bool viaKeyBuffer = false;
+
         vector<string_view> arguments;
 	for (unsigned i = 1; i < tokens.size(); ++i) {
 		string_view t = tokens[i].getString();
@@ -1055,6 +1175,8 @@ void Keyboard::KeyInserter::execute(
 				throw CommandException("Wrong argument for -freq (should be a positive number)");
 			}
 			typingFrequency = tmp;
+		} else if (t == "-keybuf") {
+			viaKeyBuffer = true;
 		} else {
 			arguments.push_back(t);
 		}
@@ -1062,14 +1184,15 @@ void Keyboard::KeyInserter::execute(
 
 	if (arguments.size() != 1) throw SyntaxError();
 
-	type(arguments[0]);
+	type(arguments[0], viaKeyBuffer);
 }
 
 string Keyboard::KeyInserter::help(const vector<string>& /*tokens*/) const
 {
 	static const string helpText = "Type a string in the emulated MSX.\n" \
 		"Use -release to make sure the keys are always released before typing new ones (necessary for some game input routines, but in general, this means typing is twice as slow).\n" \
-		"Use -freq to tweak how fast typing goes and how long the keys will be pressed (and released in case -release was used). Keys will be typed at the given frequency and will remain pressed/released for 1/freq seconds";
+		"Use -freq to tweak how fast typing goes and how long the keys will be pressed (and released in case -release was used). Keys will be typed at the given frequency and will remain pressed/released for 1/freq seconds.\n" \
+		"Use -keybuf to put the text directly in the keyboard buffer of the BIOS, one line at a time, when the MSX is waiting for input in the BIOS (e.g. in MSX-BASIC). This is a lot faster. Other characters than plain ASCII, and text for software that doesn't read its input via the BIOS, are still typed via the keyboard matrix.";
 	return helpText;
 }
 
@@ -1082,10 +1205,13 @@ void Keyboard::KeyInserter::tabCompletion(vector<string>& tokens) const
 	if (!contains(tokens, "-freq")) {
 		options.push_back("-freq");
 	}
+	if (!contains(tokens, "-keybuf")) {
+		options.push_back("-keybuf");
+	}
 	completeString(tokens, options);
 }
 
-void Keyboard::KeyInserter::type(string_view str)
+void Keyboard::KeyInserter::type(string_view str, bool viaKeyBuffer)
 {
 	if (str.empty()) {
 		return;
@@ -1093,7 +1219,13 @@ void Keyboard::KeyInserter::type(string_view str)
 	auto& keyboard = OUTER(Keyboard, keyTypeCmd);
 	oldLocksOn = keyboard.locksOn;
 	if (text_utf8.empty()) {
-		reschedule(getCurrentTime());
+		// Only (re)start bulk typing when nothing is pending, so
+		// text that is still being typed keeps its mode.
+		EmuTime time = getCurrentTime();
+		keyboard.keyBufferEnabled = viaKeyBuffer;
+		keyboard.keyBufferBusy = false;
+		keyboard.keyBufferProgress = time;
+		reschedule(time);
 	}
 	text_utf8.append(str.data(), str.size());
 }
@@ -1122,6 +1254,18 @@ void Keyboard::KeyInserter::executeUntil(EmuTime::param time)
 		return;
 	}
 
+	if (keyboard.keyBufferEnabled) {
+		int num = keyboard.typeViaKeyBuffer(text_utf8, time);
+		if (num >= 0) {
+			// Typed (a part of) the text, or waiting till the MSX
+			// is ready for more. Either way, check again soon.
+			releaseLast = false;
+			text_utf8.erase(0, num);
+			setSyncPoint(time + EmuDuration::hz(KEY_BUFFER_POLL_FREQ));
+			return;
+		}
+	}
+
 	try {
 		auto it = begin(text_utf8);
 		unsigned current = utf8::next(it, end(text_utf8));
@@ -1303,6 +1447,7 @@ void Keyboard::KeyInserter::serialize(Archive& ar, unsigned /*version*/)
 //            time the savestate was created are cleared.
 // version 2: For reverse-replay it is important that snapshots contain the
 //            full state of the MSX keyboard, so now we do serialize it.
+// version 3: Also serialize the state of 'type_via_keyboard -keybuf'.
 // TODO Is the assumption in version 1 correct (clear keyb state on load)?
 //      If it is still useful for 'regular' loadstate, then we could implement
 //      it by explicitly clearing the keyb state from the actual loadstate
@@ -1335,6 +1480,12 @@ void Keyboard::serialize(Archive& ar, unsigned version)
 		ar.serialize("msxmodifiers", msxmodifiers);
 		ar.serialize("msxKeyEventQueue", msxKeyEventQueue);
 	}
+	if (ar.versionAtLeast(version, 3)) {
+		ar.serialize("keyBufferEnabled", keyBufferEnabled);
+		ar.serialize("keyBufferBusy", keyBufferBusy);
+		ar.serialize("keyBufferProgress", keyBufferProgress);
+		ar.serialize("keyBufferGetPnt", keyBufferGetPnt);
+	}
 	// don't serialize hostKeyMatrix
 
 	if (ar.isLoader()) {
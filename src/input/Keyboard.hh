@@ -99,12 +99,25 @@ private:
 	bool commonKeys(unsigned unicode1, unsigned unicode2);
 	void debug(const char* format, ...);
 
+	/** Type (the start of) the given text by writing it directly in the
+	  * keyboard buffer of the BIOS. This only happens when the MSX is
+	  * known to read that buffer, and only for characters that are the
+	  * same in all MSX character sets (ASCII).
+	  * @return The number of bytes of 'text' that were typed; 0 when the
+	  *         caller should try again a bit later; -1 when the next
+	  *         character must be typed via the keyboard matrix instead.
+	  */
+	int typeViaKeyBuffer(string_view text, EmuTime::param time);
+	/** Is the MSX (most likely) waiting for input in the BIOS? */
+	bool inBiosInputLoop(EmuTime::param time);
+
 	/** Returns a bit vector in which the bit for a modifier is set iff that
 	  * modifier is a lock key and must be toggled before the given key input
 	  * can be produced.
 	  */
 	byte needsLockToggle(const UnicodeKeymap::KeyInfo& keyInfo) const;
 
+	MSXMotherBoard& motherBoard;
 	CommandController& commandController;
 	MSXEventDistributor& msxEventDistributor;
 	StateChangeDistributor& stateChangeDistributor;
@@ -142,9 +155,11 @@ private:
 		void serialize(Archive& ar, unsigned version);
 
 	private:
-		void type(string_view str);
+		void type(string_view str, bool viaKeyBuffer);
 		void reschedule(EmuTime::param time);
 
+		static const unsigned KEY_BUFFER_POLL_FREQ = 100;
+
 		// Command
 		void execute(array_ref<TclObject> tokens, TclObject& result,
 			     EmuTime::param time) override;
@@ -244,8 +259,29 @@ private:
 	  * the emulated machine.
 	  */
 	byte locksOn;
+
+	/** Location of the BIOS keyboard buffer, see typeViaKeyBuffer(). */
+	struct KeyBufferInfo {
+		word putPnt;  // address of the write pointer
+		word getPnt;  // address of the read pointer
+		word keyBuf;  // start of the (circular) buffer
+		word bufEnd;  // end of the buffer
+		word biosEnd; // the BIOS code is in [0, biosEnd)
+		bool checkMainRomSlot; // check the slot in page 0 (via EXPTBL)
+	};
+	static const KeyBufferInfo keyBufferForMatrix[];
+	/** Nullptr if this machine has no BIOS keyboard buffer. */
+	const KeyBufferInfo* keyBuffer;
+	/** Use the BIOS keyboard buffer for the type command (-keybuf). */
+	bool keyBufferEnabled;
+	/** True while a line is being typed via the keyboard buffer. */
+	bool keyBufferBusy;
+	/** The last time we wrote to the buffer or the MSX read from it. */
+	EmuTime keyBufferProgress;
+	/** Value of the read pointer at that time. */
+	word keyBufferGetPnt;
 };
-SERIALIZE_CLASS_VERSION(Keyboard, 2);
+SERIALIZE_CLASS_VERSION(Keyboard, 3);
 
 } // namespace openmsx
 
@@ -1,12 +1,15 @@
 #include "OggReader.hh"
 #include "MSXException.hh"
+#include "Filename.hh"
+#include "FileOperations.hh"
 #include "yuv2rgb.hh"
 #include "likely.hh"
-#include "CliComm.hh"
 #include "MemoryOps.hh"
+#include "sha1.hh"
 #include "stl.hh"
 #include "stringsp.hh" // for strncasecmp
 #include <algorithm>
+#include <cstdio>
 #include <cstring> // for memcpy, memcmp
 #include <cstdlib> // for atoi
 #include <cctype> // for isspace
@@ -18,6 +21,34 @@
 // - Clean up this mess!
 namespace openmsx {
 
+// The background thread decodes till this many frames after the last
+// requested frame and this many audio samples after the last requested
+// sample are available ...
+static const size_t FRAMES_AHEAD = 8;
+static const size_t SAMPLES_AHEAD = 8192;
+// ... but it never queues more than this.
+static const size_t MAX_QUEUED_FRAMES = 24;
+static const size_t MAX_QUEUED_AUDIO = 128;
+
+// After a seek the first (partial) vorbis packets don't produce audio.
+static const size_t AUDIO_MARGIN = 2 * AudioFragment::MAX_SAMPLES;
+
+// Layout of the keyframe index cache file: this header, the IndexState and
+// then the KeyFrameEntry's. It's only a cache, so it uses the native
+// endianness and struct layout.
+struct IndexHeader
+{
+	char magic[8];
+	uint32_t version;
+	int32_t granuleShift;
+	uint64_t fileSize;
+	int64_t modificationTime;
+	uint64_t numEntries;
+};
+static const char INDEX_MAGIC[8] = { 'O','G','G','I','D','X', 0, 0 };
+static const uint32_t INDEX_VERSION = 1;
+static const char* const INDEX_DIR = "/ogg-index";
+
 Frame::Frame(const th_ycbcr_buffer& yuv)
 {
 	unsigned y_size  = yuv[0].height * yuv[0].stride;
@@ -45,6 +76,17 @@ Frame::~Frame()
 OggReader::OggReader(const Filename& filename, CliComm& cli_)
 	: cli(cli_)
 	, file(filename)
+	, mainWaiting(0)
+	, wantedFrame(1)
+	, wantedSample(0)
+	, prefetch(false)
+	, endOfStream(false)
+	, exitThread(false)
+	, indexedSize(0)
+	, indexComplete(false)
+	, indexFile(filename)
+	, scanReadOffset(0)
+	, indexError(false)
 {
 	audioSerial = -1;
 	videoSerial = -1;
@@ -67,6 +109,7 @@ OggReader::OggReader(const Filename& filename, CliComm& cli_)
 	vorbis_comment_init(&vc);
 
 	ogg_sync_init(&sync);
+	ogg_sync_init(&indexSync);
 
 	state = PLAYING;
 	fileOffset = 0;
@@ -200,6 +243,15 @@ OggReader::OggReader(const Filename& filename, CliComm& cli_)
 	th_setup_free(tsi);
 	th_info_clear(&ti);
 	th_comment_clear(&tc);
+
+	auto key = SHA1::calc(
+		reinterpret_cast<const uint8_t*>(filename.getResolved().data()),
+		filename.getResolved().size());
+	indexCache = strCat(FileOperations::getUserDataDir(), INDEX_DIR,
+	                    '/', key.toString(), ".idx");
+	loadIndex();
+
+	thread = std::thread([this]() { run(); });
 }
 
 void OggReader::cleanup()
@@ -222,13 +274,39 @@ void OggReader::cleanup()
 	}
 
 	ogg_sync_clear(&sync);
+	ogg_sync_clear(&indexSync);
 }
 
 OggReader::~OggReader()
 {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		exitThread = true;
+	}
+	condition.notify_one();
+	thread.join();
 	cleanup();
 }
 
+std::unique_lock<std::mutex> OggReader::lockFromMain()
+{
+	// Let the background thread know we're waiting, so that it gives up
+	// the mutex after the current packet.
+	++mainWaiting;
+	std::unique_lock<std::mutex> lock(mutex);
+	--mainWaiting;
+	flushWarnings();
+	return lock;
+}
+
+void OggReader::flushWarnings()
+{
+	for (auto& w : warnings) {
+		cli.printWarning(w);
+	}
+	warnings.clear();
+}
+
 /** Vorbis only records the ogg position (in no. of samples) once per ogg
  * page. After seeking we have already decoded some audio before we encounter
  * the exact position we are at. Fixup the positions and discard any unwanted
@@ -244,7 +322,7 @@ void OggReader::vorbisFoundPosition()
 
 	// last is now the first vorbis audio decoded
 	if (last > currentSample) {
-		cli.printWarning("missing part of audio stream");
+		printWarning("missing part of audio stream");
 	}
 
 	if (vorbisPos > currentSample) {
@@ -407,7 +485,7 @@ void OggReader::readVorbis(ogg_packet* packet)
 			vorbisFoundPosition();
 		} else {
 			if (vorbisPos != size_t(packet->granulepos)) {
-				cli.printWarning(
+				printWarning(
                                         "vorbis audio out of sync, expected ",
 					vorbisPos, ", got ", packet->granulepos);
 				vorbisPos = packet->granulepos;
@@ -528,25 +606,25 @@ void OggReader::readTheora(ogg_packet* packet)
 	switch (rc) {
 	case TH_DUPFRAME:
 		if (frameList.empty()) {
-			cli.printWarning("Theora error: dup frame encountered "
+			printWarning("Theora error: dup frame encountered "
 					 "without preceding frame");
 		} else {
 			frameList.back()->length++;
 		}
 		break;
 	case TH_EIMPL:
-		cli.printWarning("Theora error: not capable of reading this");
+		printWarning("Theora error: not capable of reading this");
 		break;
 	case TH_EFAULT:
-		cli.printWarning("Theora error: API not used correctly");
+		printWarning("Theora error: API not used correctly");
 		break;
 	case TH_EBADPACKET:
-		cli.printWarning("Theora error: bad packet");
+		printWarning("Theora error: bad packet");
 		break;
 	case 0:
 		break;
 	default:
-		cli.printWarning("Theora error: unknown error ", rc);
+		printWarning("Theora error: unknown error ", rc);
 		break;
 	}
 
@@ -587,7 +665,7 @@ void OggReader::readTheora(ogg_packet* packet)
 	if (last && (last->no != size_t(-1))) {
 		if ((frameno != size_t(-1)) &&
 		    (frameno != last->no + last->length)) {
-			cli.printWarning("Theora frame sequence wrong");
+			printWarning("Theora frame sequence wrong");
 		} else {
 			frameno = last->no + last->length;
 		}
@@ -613,6 +691,10 @@ void OggReader::readTheora(ogg_packet* packet)
 
 void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 {
+	auto lock = lockFromMain();
+	wantedFrame = frameno;
+	condition.notify_one();
+
 	Frame* frame;
 	while (true) {
 		// If there are no frames or the frames we have read
@@ -635,7 +717,7 @@ void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 		if (!frameList.empty() && frameList[0]->no > frameno) {
 			// we're missing frames!
 			frame = frameList[0].get();
-			cli.printWarning(
+			printWarning(
                                 "Cannot find frame ", frameno, " using ",
 			        frame->no, " instead");
 			break;
@@ -659,7 +741,7 @@ void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 		if (frameList.size() > (size_t(2) << granuleShift)) {
 			// We've got more than twice as many frames
 			// as the maximum distance between key frames.
-			cli.printWarning("Cannot find frame ", frameno);
+			printWarning("Cannot find frame ", frameno);
 			return;
 		}
 
@@ -669,7 +751,10 @@ void OggReader::getFrameNo(RawFrame& rawFrame, size_t frameno)
 		}
 	}
 
-	yuv2rgb::convert(frame->buffer, rawFrame);
+	// Only this thread removes frames from frameList, so the frame stays
+	// valid while the background thread continues decoding.
+	lock.unlock();
+	yuv2rgb::convertLazy(frame->buffer, rawFrame);
 }
 
 void OggReader::recycleAudio(std::unique_ptr<AudioFragment> audio)
@@ -680,6 +765,10 @@ void OggReader::recycleAudio(std::unique_ptr<AudioFragment> audio)
 
 const AudioFragment* OggReader::getAudio(size_t sample)
 {
+	auto lock = lockFromMain();
+	wantedSample = sample;
+	condition.notify_one();
+
 	// Read while position is unknown
 	while (audioList.empty() ||
 	       audioList.front()->position == AudioFragment::UNKNOWN_POS) {
@@ -752,14 +841,14 @@ bool OggReader::nextPacket()
 		int serial = ogg_page_serialno(&page);
 		if (serial == audioSerial) {
 			if (ogg_stream_pagein(&vorbisStream, &page)) {
-				cli.printWarning("Failed to submit vorbis page");
+				printWarning("Failed to submit vorbis page");
 			}
 		} else if (serial == videoSerial) {
 			if (ogg_stream_pagein(&theoraStream, &page)) {
-				cli.printWarning("Failed to submit theora page");
+				printWarning("Failed to submit theora page");
 			}
 		} else if (serial != skeletonSerial) {
-			cli.printWarning("Unexpected stream with serial ",
+			printWarning("Unexpected stream with serial ",
 			                 serial, " in ogg file");
 		}
 	}
@@ -790,7 +879,7 @@ bool OggReader::nextPage(ogg_page* page)
 		fileOffset += chunk;
 
 		if (ogg_sync_wrote(&sync, long(chunk)) == -1) {
-			cli.printWarning("Internal error: ogg_sync_wrote failed");
+			printWarning("Internal error: ogg_sync_wrote failed");
 		}
 	}
 
@@ -863,9 +952,19 @@ size_t OggReader::findOffset(size_t frame, size_t sample)
 	// we assume that only data will be added to it and the ogg streams
 	// are exactly as before
 	fileSize = file.getSize();
+	if (indexComplete && (fileSize != indexedSize)) {
+		// also index the new part
+		indexComplete = false;
+	}
 	auto offset = fileSize - 1;
 
-	while (offset > 0) {
+	if (indexComplete) {
+		// no need to search for the totals
+		currentFrame = indexState.frames;
+		currentSample = indexState.sample;
+		offset = 0;
+	}
+	while (!indexComplete && (offset > 0)) {
 		if (offset > STEP) {
 			offset -= STEP;
 		} else {
@@ -909,6 +1008,12 @@ size_t OggReader::findOffset(size_t frame, size_t sample)
 		frame = maxFrames;
 	}
 
+	// Use the keyframe index when it's (already) available for this part
+	// of the file.
+	if (indexComplete || (frame < indexState.frames)) {
+		return indexOffset(frame, sample);
+	}
+
 	offset = bisection(frame, sample, maxOffset, maxSamples, maxFrames);
 
 	// Find key frame
@@ -933,8 +1038,28 @@ size_t OggReader::findOffset(size_t frame, size_t sample)
 	return bisection(keyFrame, sample, maxOffset, maxSamples, maxFrames);
 }
 
+size_t OggReader::indexOffset(size_t frame, size_t sample)
+{
+	// Last keyframe at or before 'frame' (a frame can only be decoded
+	// starting from its keyframe) that also includes the audio.
+	auto it = std::upper_bound(begin(keyFrameIndex), end(keyFrameIndex),
+		frame, [](size_t f, const KeyFrameEntry& e) {
+			return f < e.keyFrame; });
+	while (it != begin(keyFrameIndex)) {
+		--it;
+		if (it->sample + AUDIO_MARGIN <= sample) {
+			keyFrame = it->keyFrame;
+			return it->offset;
+		}
+	}
+	keyFrame = 1;
+	return 0;
+}
+
 bool OggReader::seek(size_t frame, size_t samples)
 {
+	auto lock = lockFromMain();
+
 	// Remove all queued frames
 	recycleFrameList.insert(end(recycleFrameList),
 		make_move_iterator(begin(frameList)),
@@ -961,9 +1086,209 @@ bool OggReader::seek(size_t frame, size_t samples)
 
 	vorbis_synthesis_restart(&vd);
 
+	// Start decoding at the new position right away, the emulated seek
+	// time gives the background thread a head start.
+	wantedFrame = frame;
+	wantedSample = samples;
+	prefetch = true;
+	endOfStream = false;
+	condition.notify_one();
+
 	return true;
 }
 
+void OggReader::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!exitThread) {
+		if (needDecode()) {
+			if (!nextPacket()) {
+				endOfStream = true;
+			}
+			if (mainWaiting) {
+				lock.unlock();
+				while (mainWaiting) std::this_thread::yield();
+				lock.lock();
+			}
+		} else if (!indexComplete && !indexError) {
+			lock.unlock();
+			scanIndex();
+			lock.lock();
+		} else {
+			condition.wait(lock);
+		}
+	}
+}
+
+bool OggReader::needDecode() const
+{
+	if (!prefetch || endOfStream ||
+	    (frameList.size() >= MAX_QUEUED_FRAMES) ||
+	    (audioList.size() >= MAX_QUEUED_AUDIO)) {
+		return false;
+	}
+	if (frameList.empty() || (frameList.back()->no == size_t(-1)) ||
+	    ((frameList.back()->no + frameList.back()->length) <
+	     (wantedFrame + FRAMES_AHEAD))) {
+		return true;
+	}
+	return audioList.empty() ||
+	       (audioList.back()->position == AudioFragment::UNKNOWN_POS) ||
+	       ((audioList.back()->position + audioList.back()->length) <
+	        (wantedSample + SAMPLES_AHEAD));
+}
+
+/** Scan the next part of the file for the keyframe index. A new keyframe
+ * is detected by the granulepos of a theora page, decoding from the start
+ * of the previous theora page includes all frames from that keyframe on.
+ */
+bool OggReader::scanIndex()
+{
+	static const size_t CHUNK = 256 * 1024;
+
+	uint64_t size;
+	int64_t time;
+	bool done = false;
+	try {
+		size = indexFile.getSize();
+		time = indexFile.getModificationDate();
+		if (scanReadOffset < size) {
+			auto chunk = std::min<uint64_t>(CHUNK, size - scanReadOffset);
+			char* buffer = ogg_sync_buffer(&indexSync, long(chunk));
+			indexFile.seek(scanReadOffset);
+			indexFile.read(buffer, chunk);
+			ogg_sync_wrote(&indexSync, long(chunk));
+			scanReadOffset += chunk;
+		} else {
+			done = true;
+		}
+	} catch (MSXException&) {
+		// Not fatal, we can still seek without the index.
+		indexError = true;
+		return false;
+	}
+
+	std::vector<KeyFrameEntry> entries;
+	ogg_page page;
+	int ret;
+	while ((ret = ogg_sync_pageseek(&indexSync, &page)) != 0) {
+		if (ret < 0) {
+			// skipped garbage
+			scanState.pageOffset += -ret;
+			continue;
+		}
+		auto offset = scanState.pageOffset;
+		scanState.pageOffset += ret;
+
+		auto granule = ogg_page_granulepos(&page);
+		if (granule == -1) continue;
+		int serial = ogg_page_serialno(&page);
+		if (serial == audioSerial) {
+			scanState.sample = std::max<uint64_t>(
+				scanState.sample, granule);
+		} else if (serial == videoSerial) {
+			uint64_t key = uint64_t(granule) >> granuleShift;
+			uint64_t intra = uint64_t(granule) &
+			                 ((uint64_t(1) << granuleShift) - 1);
+			if ((scanState.keyFrame != uint64_t(-1)) &&
+			    (key > scanState.keyFrame)) {
+				entries.push_back({key, scanState.theoraOffset,
+				                   scanState.theoraSample});
+			}
+			scanState.theoraOffset = offset;
+			scanState.theoraSample = scanState.sample;
+			scanState.keyFrame = key;
+			scanState.frames = std::max(scanState.frames, key + intra);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		keyFrameIndex.insert(end(keyFrameIndex),
+		                     begin(entries), end(entries));
+		indexState = scanState;
+		if (done) {
+			indexComplete = true;
+			indexedSize = size;
+		}
+	}
+	if (done) {
+		// Only this thread modifies keyFrameIndex.
+		saveIndex(size, time);
+	}
+	return !done;
+}
+
+void OggReader::loadIndex()
+{
+	try {
+		File cache(indexCache);
+		IndexHeader header;
+		if (cache.getSize() < sizeof(header)) return;
+		cache.read(&header, sizeof(header));
+		if ((memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) ||
+		    (header.version != INDEX_VERSION) ||
+		    (header.granuleShift != granuleShift) ||
+		    (header.fileSize != file.getSize()) ||
+		    (header.modificationTime != int64_t(file.getModificationDate())) ||
+		    (cache.getSize() != (sizeof(header) + sizeof(IndexState) +
+		                header.numEntries * sizeof(KeyFrameEntry)))) {
+			return; // the ogg file has changed
+		}
+		IndexState cached;
+		cache.read(&cached, sizeof(cached));
+		std::vector<KeyFrameEntry> entries(header.numEntries);
+		cache.read(entries.data(), entries.size() * sizeof(KeyFrameEntry));
+
+		keyFrameIndex = std::move(entries);
+		indexState = scanState = cached;
+		scanReadOffset = cached.pageOffset;
+		indexedSize = header.fileSize;
+		indexComplete = true;
+	} catch (MSXException&) {
+		// index doesn't exist yet or can't be read
+	}
+}
+
+void OggReader::saveIndex(uint64_t size, int64_t time) const
+{
+	IndexHeader header;
+	memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.granuleShift = granuleShift;
+	header.fileSize = size;
+	header.modificationTime = time;
+	header.numEntries = keyFrameIndex.size();
+
+	// Write to a temporary file and then rename it, see RomDatabase.
+	try {
+		string_view dir = string_view(indexCache).substr(
+			0, indexCache.rfind('/'));
+		FileOperations::mkdirp(dir);
+		std::string tmpName;
+		{
+			auto fp = FileOperations::openUniqueFile(dir.str(), tmpName);
+			if (!fp) return;
+			bool ok =
+				(fwrite(&header, sizeof(header), 1, fp.get()) == 1) &&
+				(fwrite(&scanState, sizeof(scanState), 1, fp.get()) == 1) &&
+				(fwrite(keyFrameIndex.data(), sizeof(KeyFrameEntry),
+				        keyFrameIndex.size(), fp.get()) == keyFrameIndex.size()) &&
+				(fflush(fp.get()) == 0);
+			if (!ok) {
+				fp.reset();
+				FileOperations::unlink(tmpName);
+				return;
+			}
+		}
+		if (FileOperations::rename(tmpName, indexCache) != 0) {
+			FileOperations::unlink(tmpName);
+		}
+	} catch (MSXException&) {
+		// Ignore, the index is only a cache.
+	}
+}
+
 bool OggReader::stopFrame(size_t frame) const
 {
 	return std::binary_search(begin(stopFrames), end(stopFrames), frame);
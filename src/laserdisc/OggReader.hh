@@ -2,18 +2,26 @@
 #define OGGREADER_HH
 
 #include "File.hh"
+#include "CliComm.hh"
+#include "Thread.hh"
 #include "circular_buffer.hh"
+#include "strCat.hh"
 #include <ogg/ogg.h>
 #include <vorbis/codec.h>
 #include <theora/theoradec.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <list>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 namespace openmsx {
 
-class CliComm;
 class RawFrame;
 class Filename;
 
@@ -36,6 +44,14 @@ struct Frame
 	int length;
 };
 
+/** Reads (laserdisc) video from an ogg file with a theora and a vorbis stream.
+  *
+  * A background thread decodes the frames and audio right after the current
+  * position (or after the target of the last seek), so that the emulation
+  * thread usually finds them already decoded. When idle that thread builds
+  * an index of the keyframes in the file, this turns a seek into a lookup.
+  * The index is cached in the user data directory.
+  */
 class OggReader
 {
 public:
@@ -57,6 +73,21 @@ public:
 	size_t getChapter(int chapterNo) const;
 
 private:
+	struct KeyFrameEntry {
+		uint64_t keyFrame; // (a) keyframe
+		uint64_t offset;   // all frames from 'keyFrame' on can be
+		                   // decoded when starting to read here
+		uint64_t sample;   // and all audio after this sample
+	};
+	struct IndexState {
+		uint64_t pageOffset   = 0; // start of the next page to scan
+		uint64_t theoraOffset = 0; // start of the last theora page
+		uint64_t theoraSample = 0; // last audio sample before that page
+		uint64_t keyFrame = uint64_t(-1); // keyframe of that page
+		uint64_t sample = 0;       // last (highest) audio sample
+		uint64_t frames = 0;       // highest frame number
+	};
+
 	void cleanup();
 	void readTheora(ogg_packet* packet);
 	void theoraHeaderPage(ogg_page* page, th_info& ti, th_comment& tc,
@@ -73,10 +104,57 @@ private:
 	size_t findOffset(size_t frame, size_t sample);
 	size_t bisection(size_t frame, size_t sample,
 	                 size_t maxOffset, size_t maxSamples, size_t maxFrames);
+	size_t indexOffset(size_t frame, size_t sample);
+
+	// background thread
+	void run();
+	std::unique_lock<std::mutex> lockFromMain();
+	bool needDecode() const;
+	bool scanIndex();
+	void loadIndex();
+	void saveIndex(uint64_t size, int64_t time) const;
+	void flushWarnings();
+
+	/** Warnings from the background thread are printed later by the
+	  * main thread. */
+	template<typename... Args> void printWarning(Args&&... args)
+	{
+		if (Thread::isMainThread()) {
+			cli.printWarning(std::forward<Args>(args)...);
+		} else {
+			warnings.push_back(strCat(std::forward<Args>(args)...));
+		}
+	}
 
 	CliComm& cli;
 	File file;
 
+	// Everything below (except the members only used by the background
+	// thread) is protected by this mutex.
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread thread;
+	std::atomic<int> mainWaiting; // main thread waits for the mutex
+	std::vector<std::string> warnings;
+	size_t wantedFrame;   // the next frame that will be requested
+	size_t wantedSample;  // the next audio sample that will be requested
+	bool prefetch;        // read ahead (only after the first seek)
+	bool endOfStream;
+	bool exitThread;
+
+	// keyframe index
+	std::vector<KeyFrameEntry> keyFrameIndex;
+	IndexState indexState;
+	uint64_t indexedSize; // file size when the index was completed
+	bool indexComplete;
+	std::string indexCache;
+	// only used by the background thread
+	File indexFile;
+	ogg_sync_state indexSync;
+	IndexState scanState;
+	uint64_t scanReadOffset;
+	bool indexError;
+
 	enum State {
 		PLAYING,
 		FIND_LAST,
@@ -1,13 +1,25 @@
 #include "yuv2rgb.hh"
 #include "RawFrame.hh"
+#include "MemBuffer.hh"
 #include "Math.hh"
 #include "cstd.hh"
+#include "build-info.hh"
+#include "unreachable.hh"
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <SDL.h>
 #ifdef __SSE2__
 #include <emmintrin.h>
 #endif
+#if ASM_X86 && defined(__GNUC__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define YUV2RGB_HAVE_AVX2 1
+#else
+#define YUV2RGB_HAVE_AVX2 0
+#endif
 
 namespace openmsx {
 namespace yuv2rgb {
@@ -218,42 +230,223 @@ static inline void yuv2rgb_sse2(
 	_mm_store_si128(out1 + 7, bgra11_cf);
 }
 
-static inline void convertHelperSSE2(
-	const th_ycbcr_buffer& buffer, RawFrame& output)
+// Convert lines 'y' and 'y + 1' (so 'y' must be even).
+static inline void convertLinesSSE2(
+	const th_ycbcr_buffer& buffer, int y, uint32_t* out0, uint32_t* out1)
 {
 	const int width      = buffer[0].width;
 	const int y_stride   = buffer[0].stride;
 	const int uv_stride2 = buffer[1].stride / 2;
 
 	assert((width % 32) == 0);
-	assert((buffer[0].height % 2) == 0);
-
-	for (int y = 0; y < buffer[0].height; y += 2) {
-		const uint8_t* pY1 = buffer[0].data + y * y_stride;
-		const uint8_t* pY2 = buffer[0].data + (y + 1) * y_stride;
-		const uint8_t* pCb = buffer[1].data + y * uv_stride2;
-		const uint8_t* pCr = buffer[2].data + y * uv_stride2;
-		auto* out0 = output.getLinePtrDirect<uint32_t>(y + 0);
-		auto* out1 = output.getLinePtrDirect<uint32_t>(y + 1);
-
-		for (int x = 0; x < width; x += 32) {
-			// convert a block of (32 x 2) pixels
-			yuv2rgb_sse2(pCb, pCr, pY1, pY2, out0, out1);
-			pCb += 16;
-			pCr += 16;
-			pY1 += 32;
-			pY2 += 32;
-			out0 += 32;
-			out1 += 32;
-		}
-
-		output.setLineWidth(y + 0, width);
-		output.setLineWidth(y + 1, width);
+	assert((y % 2) == 0);
+
+	const uint8_t* pY1 = buffer[0].data + y * y_stride;
+	const uint8_t* pY2 = buffer[0].data + (y + 1) * y_stride;
+	const uint8_t* pCb = buffer[1].data + y * uv_stride2;
+	const uint8_t* pCr = buffer[2].data + y * uv_stride2;
+
+	for (int x = 0; x < width; x += 32) {
+		// convert a block of (32 x 2) pixels
+		yuv2rgb_sse2(pCb, pCr, pY1, pY2, out0, out1);
+		pCb += 16;
+		pCr += 16;
+		pY1 += 32;
+		pY2 += 32;
+		out0 += 32;
+		out1 += 32;
 	}
 }
 
 #endif // __SSE2__
 
+#if YUV2RGB_HAVE_AVX2
+
+// The same calculation as in yuv2rgb_sse2() (with identical results), but
+// on 256-bit registers. Each loop iteration converts a block of (32 x 2)
+// pixels. The AVX2 pack/unpack instructions work per 128-bit lane, the
+// comments show which pixels end up in the low | high lane.
+
+static bool hasAvx2()
+{
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+	bool osxsave = (ecx & (1 << 27)) != 0;
+	bool avx     = (ecx & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	// Does the OS save the ymm registers?
+	unsigned xcr0Lo, xcr0Hi;
+	__asm__ ("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+	if ((xcr0Lo & 6) != 6) return false;
+	if (__get_cpuid_max(0, nullptr) < 7) return false;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1 << 5)) != 0; // AVX2
+}
+static const bool avx2 = hasAvx2();
+
+// Chroma contribution of 16 U and V values (for 32 pixels) to R, G and B.
+__attribute__((target("avx2")))
+static inline void chroma_avx2(const uint8_t* u_, const uint8_t* v_,
+                               __m256i& dr, __m256i& dg, __m256i& db)
+{
+	__m256i u = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u_)));
+	__m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v_)));
+	__m256i mr = _mm256_srai_epi16(_mm256_mullo_epi16(v, _mm256_set1_epi16(102)), 6);
+	__m256i sg = _mm256_mullo_epi16(v, _mm256_set1_epi16(-52));
+	__m256i tg = _mm256_mullo_epi16(u, _mm256_set1_epi16(-25));
+	__m256i mg = _mm256_srai_epi16(_mm256_adds_epi16(sg, tg), 6);
+	__m256i mb = _mm256_srli_epi16(_mm256_mullo_epi16(u, _mm256_set1_epi16(129)), 6); // logical shift
+	dr = _mm256_adds_epi16(mr, _mm256_set1_epi16(-223));
+	dg = _mm256_adds_epi16(mg, _mm256_set1_epi16( 136));
+	db = _mm256_adds_epi16(mb, _mm256_set1_epi16(-277));
+}
+
+// Luma contribution of 32 Y values, split in even and odd pixels.
+__attribute__((target("avx2")))
+static inline void luma_avx2(const uint8_t* y_, __m256i& even, __m256i& odd)
+{
+	__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y_));
+	__m256i yEven = _mm256_and_si256(y, _mm256_set1_epi16(0x00FF));
+	__m256i yOdd  = _mm256_srli_epi16(y, 8);
+	even = _mm256_srai_epi16(_mm256_mullo_epi16(yEven, _mm256_set1_epi16(74)), 6);
+	odd  = _mm256_srai_epi16(_mm256_mullo_epi16(yOdd,  _mm256_set1_epi16(74)), 6);
+}
+
+// Saturate to bytes and interleave even and odd pixels: 0-15 | 16-31
+__attribute__((target("avx2")))
+static inline __m256i interleave8_avx2(__m256i even, __m256i odd)
+{
+	const __m256i SHUF = _mm256_setr_epi8(
+		0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15,
+		0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
+	return _mm256_shuffle_epi8(_mm256_packus_epi16(even, odd), SHUF);
+}
+
+__attribute__((target("avx2")))
+static inline void store32_avx2(
+	__m256i dr, __m256i dg, __m256i db, __m256i dyEven, __m256i dyOdd,
+	uint32_t* out_)
+{
+	const __m256i ALPHA = _mm256_set1_epi8(-1);
+	__m256i r = interleave8_avx2(_mm256_adds_epi16(dr, dyEven), _mm256_adds_epi16(dr, dyOdd));
+	__m256i g = interleave8_avx2(_mm256_adds_epi16(dg, dyEven), _mm256_adds_epi16(dg, dyOdd));
+	__m256i b = interleave8_avx2(_mm256_adds_epi16(db, dyEven), _mm256_adds_epi16(db, dyOdd));
+	__m256i bgLo = _mm256_unpacklo_epi8(b, g);        //  0- 7 | 16-23
+	__m256i bgHi = _mm256_unpackhi_epi8(b, g);        //  8-15 | 24-31
+	__m256i raLo = _mm256_unpacklo_epi8(r, ALPHA);
+	__m256i raHi = _mm256_unpackhi_epi8(r, ALPHA);
+	__m256i p0 = _mm256_unpacklo_epi16(bgLo, raLo);   //  0- 3 | 16-19
+	__m256i p1 = _mm256_unpackhi_epi16(bgLo, raLo);   //  4- 7 | 20-23
+	__m256i p2 = _mm256_unpacklo_epi16(bgHi, raHi);   //  8-11 | 24-27
+	__m256i p3 = _mm256_unpackhi_epi16(bgHi, raHi);   // 12-15 | 28-31
+	auto* out = reinterpret_cast<__m256i*>(out_);
+	_mm256_store_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+	_mm256_store_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+	_mm256_store_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+	_mm256_store_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+// Generic 16bpp pixel, like SDL_MapRGB() does it. The colors themselves have
+// the same (lower) precision as in the 32bpp case, see yuv2rgb.hh.
+struct Format16
+{
+	explicit Format16(const SDL_PixelFormat& format)
+		: rLoss(_mm_cvtsi32_si128(format.Rloss))
+		, gLoss(_mm_cvtsi32_si128(format.Gloss))
+		, bLoss(_mm_cvtsi32_si128(format.Bloss))
+		, rShift(_mm_cvtsi32_si128(format.Rshift))
+		, gShift(_mm_cvtsi32_si128(format.Gshift))
+		, bShift(_mm_cvtsi32_si128(format.Bshift))
+		, aMask(int16_t(format.Amask)) {}
+	__m128i rLoss, gLoss, bLoss, rShift, gShift, bShift;
+	int16_t aMask;
+};
+
+__attribute__((target("avx2")))
+static inline __m256i map16_avx2(__m256i r, __m256i g, __m256i b,
+                                 const Format16& f)
+{
+	const __m256i ZERO = _mm256_setzero_si256();
+	const __m256i MAX  = _mm256_set1_epi16(255);
+	r = _mm256_max_epi16(_mm256_min_epi16(r, MAX), ZERO);
+	g = _mm256_max_epi16(_mm256_min_epi16(g, MAX), ZERO);
+	b = _mm256_max_epi16(_mm256_min_epi16(b, MAX), ZERO);
+	__m256i p = _mm256_or_si256(
+		_mm256_sll_epi16(_mm256_srl_epi16(r, f.rLoss), f.rShift),
+		_mm256_sll_epi16(_mm256_srl_epi16(g, f.gLoss), f.gShift));
+	p = _mm256_or_si256(p,
+		_mm256_sll_epi16(_mm256_srl_epi16(b, f.bLoss), f.bShift));
+	return _mm256_or_si256(p, _mm256_set1_epi16(f.aMask));
+}
+
+__attribute__((target("avx2")))
+static inline void store16_avx2(
+	__m256i dr, __m256i dg, __m256i db, __m256i dyEven, __m256i dyOdd,
+	const Format16& format, uint16_t* out_)
+{
+	__m256i even = map16_avx2(_mm256_adds_epi16(dr, dyEven),
+	                          _mm256_adds_epi16(dg, dyEven),
+	                          _mm256_adds_epi16(db, dyEven), format);
+	__m256i odd  = map16_avx2(_mm256_adds_epi16(dr, dyOdd),
+	                          _mm256_adds_epi16(dg, dyOdd),
+	                          _mm256_adds_epi16(db, dyOdd), format);
+	__m256i lo = _mm256_unpacklo_epi16(even, odd); //  0- 7 | 16-23
+	__m256i hi = _mm256_unpackhi_epi16(even, odd); //  8-15 | 24-31
+	auto* out = reinterpret_cast<__m256i*>(out_);
+	_mm256_store_si256(out + 0, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_store_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+// Convert lines 'y' and 'y + 1' (so 'y' must be even).
+template<typename Pixel>
+__attribute__((target("avx2")))
+static void convertLinesAVX2(const th_ycbcr_buffer& buffer, int y,
+                             Pixel* out0, Pixel* out1,
+                             const SDL_PixelFormat& pixelFormat)
+{
+	const int width      = buffer[0].width;
+	const int y_stride   = buffer[0].stride;
+	const int uv_stride2 = buffer[1].stride / 2;
+
+	assert((width % 32) == 0);
+	assert((y % 2) == 0);
+
+	const uint8_t* pY1 = buffer[0].data + y * y_stride;
+	const uint8_t* pY2 = buffer[0].data + (y + 1) * y_stride;
+	const uint8_t* pCb = buffer[1].data + y * uv_stride2;
+	const uint8_t* pCr = buffer[2].data + y * uv_stride2;
+	Format16 format(pixelFormat);
+
+	for (int x = 0; x < width; x += 32) {
+		__m256i dr, dg, db, dyEven, dyOdd;
+		chroma_avx2(pCb, pCr, dr, dg, db);
+		luma_avx2(pY1, dyEven, dyOdd);
+		if (sizeof(Pixel) == 4) {
+			store32_avx2(dr, dg, db, dyEven, dyOdd,
+			             reinterpret_cast<uint32_t*>(out0));
+		} else {
+			store16_avx2(dr, dg, db, dyEven, dyOdd, format,
+			             reinterpret_cast<uint16_t*>(out0));
+		}
+		luma_avx2(pY2, dyEven, dyOdd);
+		if (sizeof(Pixel) == 4) {
+			store32_avx2(dr, dg, db, dyEven, dyOdd,
+			             reinterpret_cast<uint32_t*>(out1));
+		} else {
+			store16_avx2(dr, dg, db, dyEven, dyOdd, format,
+			             reinterpret_cast<uint16_t*>(out1));
+		}
+		pCb += 16;
+		pCr += 16;
+		pY1 += 32;
+		pY2 += 32;
+		out0 += 32;
+		out1 += 32;
+	}
+}
+
+#endif // YUV2RGB_HAVE_AVX2
+
 static constexpr int PREC = 15;
 static constexpr int COEF_Y  = int(1.164 * (1 << PREC) + 0.5); // prefer to use lrint() to round
 static constexpr int COEF_RV = int(1.596 * (1 << PREC) + 0.5); // but that's not (yet) constexpr
@@ -296,12 +489,15 @@ static inline Pixel calc(const SDL_PixelFormat& format,
 	}
 }
 
+// Convert lines 'y' and 'y + 1' (so 'y' must be even).
 template<typename Pixel>
-static void convertHelper(const th_ycbcr_buffer& buffer, RawFrame& output,
-                          const SDL_PixelFormat& format)
+static void convertLines(const th_ycbcr_buffer& buffer, int y,
+                         Pixel* out0, Pixel* out1,
+                         const SDL_PixelFormat& format)
 {
 	assert(buffer[1].width  * 2 == buffer[0].width);
 	assert(buffer[1].height * 2 == buffer[0].height);
+	assert((y % 2) == 0);
 
 	static CONSTEXPR Coefs coefs = getCoefs();
 
@@ -309,50 +505,173 @@ static void convertHelper(const th_ycbcr_buffer& buffer, RawFrame& output,
 	const int y_stride   = buffer[0].stride;
 	const int uv_stride2 = buffer[1].stride / 2;
 
-	for (int y = 0; y < buffer[0].height; y += 2) {
-		const uint8_t* pY  = buffer[0].data + y * y_stride;
-		const uint8_t* pCb = buffer[1].data + y * uv_stride2;
-		const uint8_t* pCr = buffer[2].data + y * uv_stride2;
-		auto* out0 = output.getLinePtrDirect<Pixel>(y + 0);
-		auto* out1 = output.getLinePtrDirect<Pixel>(y + 1);
+	const uint8_t* pY  = buffer[0].data + y * y_stride;
+	const uint8_t* pCb = buffer[1].data + y * uv_stride2;
+	const uint8_t* pCr = buffer[2].data + y * uv_stride2;
 
-		for (int x = 0; x < width;
-		     x += 2, pY += 2, ++pCr, ++pCb, out0 += 2, out1 += 2) {
-			int ruv = coefs.rv[*pCr];
-			int guv = coefs.gu[*pCb] + coefs.gv[*pCr];
-			int buv = coefs.bu[*pCb];
+	for (int x = 0; x < width;
+	     x += 2, pY += 2, ++pCr, ++pCb, out0 += 2, out1 += 2) {
+		int ruv = coefs.rv[*pCr];
+		int guv = coefs.gu[*pCb] + coefs.gv[*pCr];
+		int buv = coefs.bu[*pCb];
 
-			int Y00 = coefs.y[pY[0]];
-			out0[0] = calc<Pixel>(format, Y00, ruv, guv, buv);
+		int Y00 = coefs.y[pY[0]];
+		out0[0] = calc<Pixel>(format, Y00, ruv, guv, buv);
 
-			int Y01 = coefs.y[pY[1]];
-			out0[1] = calc<Pixel>(format, Y01, ruv, guv, buv);
+		int Y01 = coefs.y[pY[1]];
+		out0[1] = calc<Pixel>(format, Y01, ruv, guv, buv);
 
-			int Y10 = coefs.y[pY[y_stride + 0]];
-			out1[0] = calc<Pixel>(format, Y10, ruv, guv, buv);
+		int Y10 = coefs.y[pY[y_stride + 0]];
+		out1[0] = calc<Pixel>(format, Y10, ruv, guv, buv);
 
-			int Y11 = coefs.y[pY[y_stride + 1]];
-			out1[1] = calc<Pixel>(format, Y11, ruv, guv, buv);
-		}
+		int Y11 = coefs.y[pY[y_stride + 1]];
+		out1[1] = calc<Pixel>(format, Y11, ruv, guv, buv);
+	}
+}
 
-		output.setLineWidth(y + 0, width);
-		output.setLineWidth(y + 1, width);
+bool isAvailable(Impl impl)
+{
+	switch (impl) {
+	case Impl::SCALAR:
+		return true;
+	case Impl::SSE2:
+#ifdef __SSE2__
+		return true;
+#else
+		return false;
+#endif
+	case Impl::AVX2:
+#if YUV2RGB_HAVE_AVX2
+		return avx2;
+#else
+		return false;
+#endif
+	default:
+		UNREACHABLE; return false;
 	}
 }
 
-void convert(const th_ycbcr_buffer& input, RawFrame& output)
+void convertLinePair(Impl impl, const th_ycbcr_buffer& input, int y,
+                     void* out0, void* out1, const SDL_PixelFormat& format)
 {
-	const SDL_PixelFormat& format = output.getSDLPixelFormat();
+	assert(isAvailable(impl));
 	if (format.BytesPerPixel == 4) {
+		auto* o0 = static_cast<uint32_t*>(out0);
+		auto* o1 = static_cast<uint32_t*>(out1);
+		switch (impl) {
+#if YUV2RGB_HAVE_AVX2
+		case Impl::AVX2:
+			convertLinesAVX2(input, y, o0, o1, format);
+			break;
+#endif
 #ifdef __SSE2__
-		convertHelperSSE2(input, output);
-#else
-		convertHelper<uint32_t>(input, output, format);
+		case Impl::SSE2:
+			convertLinesSSE2(input, y, o0, o1);
+			break;
 #endif
+		default:
+			convertLines(input, y, o0, o1, format);
+		}
 	} else {
 		assert(format.BytesPerPixel == 2);
-		convertHelper<uint16_t>(input, output, format);
+		assert(impl != Impl::SSE2);
+		auto* o0 = static_cast<uint16_t*>(out0);
+		auto* o1 = static_cast<uint16_t*>(out1);
+#if YUV2RGB_HAVE_AVX2
+		if (impl == Impl::AVX2) {
+			convertLinesAVX2(input, y, o0, o1, format);
+			return;
+		}
+#endif
+		convertLines(input, y, o0, o1, format);
+	}
+}
+
+// Convert lines 'y' and 'y + 1' with the fastest implementation for the
+// pixel format and the host CPU.
+static void convertLinePair(const th_ycbcr_buffer& input, int y,
+                            void* out0, void* out1,
+                            const SDL_PixelFormat& format)
+{
+	Impl impl = isAvailable(Impl::AVX2) ? Impl::AVX2
+	          : ((format.BytesPerPixel == 4) && isAvailable(Impl::SSE2))
+	          ? Impl::SSE2 : Impl::SCALAR;
+	convertLinePair(impl, input, y, out0, out1, format);
+}
+
+void convert(const th_ycbcr_buffer& input, RawFrame& output)
+{
+	const int width  = input[0].width;
+	const int height = input[0].height;
+	assert((height % 2) == 0);
+	for (int y = 0; y < height; y += 2) {
+		convertLinePair(input, y,
+		                output.getLinePtrDirect<void>(y + 0),
+		                output.getLinePtrDirect<void>(y + 1),
+		                output.getSDLPixelFormat());
+		output.setLineWidth(y + 0, width);
+		output.setLineWidth(y + 1, width);
+	}
+}
+
+// Keeps a copy of the yuv planes and converts (pairs of) lines when they're
+// read from the RawFrame.
+class LazyConverter final : public RawFrame::LineGenerator
+{
+public:
+	void set(const th_ycbcr_buffer& input)
+	{
+		size_t ySize  = input[0].height * input[0].stride;
+		size_t uvSize = input[1].height * input[1].stride;
+		size_t scratchOffset = (ySize + 2 * uvSize + 63) & ~63;
+		size_t size = scratchOffset + 4 * input[0].width;
+		if (size > allocated) {
+			data.resize(size);
+			allocated = size;
+		}
+		uint8_t* p = data.data();
+		for (int i = 0; i < 3; ++i) {
+			size_t planeSize = i ? uvSize : ySize;
+			buffer[i] = input[i];
+			buffer[i].data = p;
+			memcpy(p, input[i].data, planeSize);
+			p += planeSize;
+		}
+		scratch = data.data() + scratchOffset;
+	}
+
+	void generate(RawFrame& frame, unsigned line) override
+	{
+		// Both lines of a pair are converted at once, but don't
+		// overwrite a line that was written in the mean time.
+		unsigned y = line & ~1;
+		bool pending0 = frame.isLinePending(y + 0);
+		bool pending1 = frame.isLinePending(y + 1);
+		convertLinePair(buffer, y,
+		                pending0 ? frame.getLinePtrDirect<void>(y + 0) : scratch,
+		                pending1 ? frame.getLinePtrDirect<void>(y + 1) : scratch,
+		                frame.getSDLPixelFormat());
+		if (pending0) frame.setLineWidth(y + 0, buffer[0].width);
+		if (pending1) frame.setLineWidth(y + 1, buffer[0].width);
+	}
+
+private:
+	th_ycbcr_buffer buffer;
+	MemBuffer<uint8_t, 32> data;
+	uint8_t* scratch; // for a line that's not needed
+	size_t allocated = 0;
+};
+
+void convertLazy(const th_ycbcr_buffer& input, RawFrame& output)
+{
+	auto* converter = dynamic_cast<LazyConverter*>(output.getLineGenerator());
+	if (!converter) {
+		auto newConverter = std::make_unique<LazyConverter>();
+		converter = newConverter.get();
+		output.setLineGenerator(std::move(newConverter));
 	}
+	converter->set(input);
+	output.setLazyLines(input[0].width);
 }
 
 } // namespace yuv2rgb
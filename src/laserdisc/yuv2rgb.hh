@@ -3,14 +3,43 @@
 
 #include <theora/theoradec.h>
 
+struct SDL_PixelFormat;
+
 namespace openmsx {
 
 class RawFrame;
 
 namespace yuv2rgb {
 
+/** The available implementations of the conversion. convert() and
+  * convertLazy() automatically select the fastest one for the host CPU and
+  * the pixel format.
+  *
+  * The SIMD versions calculate with 6 fractional bits, the scalar version
+  * with 15. So their results differ by a few steps per color component.
+  * The AVX2 version produces exactly the same colors as the SSE2 version,
+  * also for 16bpp (where SSE2 isn't used). So on hosts with AVX2 the 16bpp
+  * output has the same precision as the 32bpp output on all x86 hosts.
+  */
+enum class Impl { SCALAR, SSE2, AVX2 };
+
+/** Can the given implementation be used on this host? */
+bool isAvailable(Impl impl);
+
+/** Convert lines 'y' and 'y + 1' (so 'y' must be even) with the given
+  * implementation. The SSE2 version only supports 32bpp. Normally only
+  * used (directly) to test the implementations against each other.
+  */
+void convertLinePair(Impl impl, const th_ycbcr_buffer& input, int y,
+                     void* out0, void* out1, const SDL_PixelFormat& format);
+
+/** Convert the complete frame. */
 void convert(const th_ycbcr_buffer& input, RawFrame& output);
 
+/** Only copy the input, the lines are converted when they're read from the
+  * output frame (if they're read at all, e.g. not for skipped frames). */
+void convertLazy(const th_ycbcr_buffer& input, RawFrame& output);
+
 } // namespace yuv2rgb
 } // namespace openmsx
 
@@ -22,6 +22,7 @@ public:
 	              const string& description, Ram& ram);
 	byte read(unsigned address) override;
 	void write(unsigned address, byte value) override;
+	void readBlock(unsigned address, byte* output, unsigned num) override;
 private:
 	Ram& ram;
 };
@@ -115,6 +116,11 @@ void RamDebuggable::write(unsigned address, byte value)
 	ram[address] = value;
 }
 
+void RamDebuggable::readBlock(unsigned address, byte* output, unsigned num)
+{
+	memcpy(output, &ram[address], num);
+}
+
 
 template<typename Archive>
 void Ram::serialize(Archive& ar, unsigned /*version*/)
@@ -4,6 +4,7 @@
 #include "RomInfo.hh"
 #include "RomDatabase.hh"
 #include "FileContext.hh"
+#include "File.hh"
 #include "Filename.hh"
 #include "FileException.hh"
 #include "PanasonicMemory.hh"
@@ -18,9 +19,12 @@
 #include "IPSPatch.hh"
 #include "StringOp.hh"
 #include "sha1.hh"
+#include "Thread.hh"
+#include <algorithm>
 #include <cstring>
 #include <limits>
 #include <memory>
+#include <vector>
 
 using std::string;
 using std::unique_ptr;
@@ -36,6 +40,7 @@ public:
 	const std::string& getDescription() const override;
 	byte read(unsigned address) override;
 	void write(unsigned address, byte value) override;
+	void readBlock(unsigned address, byte* output, unsigned num) override;
 	void moved(Rom& r);
 private:
 	Debugger& debugger;
@@ -43,6 +48,43 @@ private:
 };
 
 
+struct Rom::Image
+{
+	File file; // owns the (mmap'ed) data
+	const byte* data;
+	size_t size;
+	Sha1Sum sha1;
+};
+
+// Process-wide cache of unpatched rom images, indexed by the sha1sum of the
+// file content (not a sum from the config, that may be wrong). When
+// several motherboards (e.g. 'machine' switching, reverse, multiple machines)
+// use the same system roms, they share a single copy. For uncompressed files
+// that copy is a read-only mmap of the file itself.
+// Typically this contains only a few dozen elements, so a linear search is
+// fine. Expired entries are cleaned up on the next lookup. Roms are only
+// created on the main thread, so no locking is needed.
+static std::vector<std::weak_ptr<const Rom::Image>> imageCache;
+
+static std::shared_ptr<const Rom::Image> getImage(File& file, const Sha1Sum& sha1)
+{
+	assert(Thread::isMainThread());
+	imageCache.erase(std::remove_if(begin(imageCache), end(imageCache),
+		[](const std::weak_ptr<const Rom::Image>& w) { return w.expired(); }),
+		end(imageCache));
+	for (auto& w : imageCache) {
+		auto img = w.lock();
+		if (img->sha1 == sha1) return img;
+	}
+
+	auto img = std::make_shared<Rom::Image>();
+	img->data = file.mmap(img->size);
+	img->sha1 = sha1;
+	img->file = std::move(file);
+	imageCache.push_back(img);
+	return img;
+}
+
 Rom::Rom(string name_, string description_,
          const DeviceConfig& config, const string& id /*= {}*/)
 	: name(std::move(name_)), description(std::move(description_))
@@ -85,6 +127,7 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 	// time the savestate was created with the one from the loaded
 	// savestate. External state can be a .rom file or a patch file.
 	bool checkResolvedSha1 = false;
+	string originalName;
 
 	auto sums      = config.getChildren("sha1");
 	auto filenames = config.getChildren("filename");
@@ -112,6 +155,7 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 	} else if (resolvedFilenameElem || resolvedSha1Elem ||
 	           !sums.empty() || !filenames.empty()) {
 		auto& filepool = motherBoard.getReactor().getFilePool();
+		File file;
 		// first try already resolved filename ..
 		if (resolvedFilenameElem) {
 			try {
@@ -178,21 +222,28 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 				"inside a <rom> section are no longer "
 				"supported.");
 		}
+		fileURL = file.getURL();
 		try {
-			size_t size2;
-			rom = file.mmap(size2);
-			if (size2 > std::numeric_limits<decltype(size)>::max()) {
-				throw MSXException("Rom file too big: ", file.getURL());
+			// For file-based roms, calc sha1 via File::getSha1Sum(). It can
+			// possibly use the FilePool cache to avoid the calculation.
+			Sha1Sum fileSha1 = filepool.getSha1Sum(file);
+			if (originalSha1.empty()) {
+				originalSha1 = fileSha1;
 			}
-			size = unsigned(size2);
+			if (StringOp::startsWith(name, "MSXRom")) {
+				// only needed to name unknown roms, see below
+				originalName = file.getOriginalName();
+			}
+			// Share the content with other roms with the same sha1,
+			// possibly this closes 'file'.
+			image = getImage(file, fileSha1);
+			if (image->size > std::numeric_limits<decltype(size)>::max()) {
+				throw MSXException("Rom file too big: ", fileURL);
+			}
+			rom = image->data;
+			size = unsigned(image->size);
 		} catch (FileException&) {
-			throw MSXException("Error reading ROM image: ", file.getURL());
-		}
-
-		// For file-based roms, calc sha1 via File::getSha1Sum(). It can
-		// possibly use the FilePool cache to avoid the calculation.
-		if (originalSha1.empty()) {
-			originalSha1 = filepool.getSha1Sum(file);
+			throw MSXException("Error reading ROM image: ", fileURL);
 		}
 
 		// verify SHA1
@@ -200,7 +251,7 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 			motherBoard.getMSXCliComm().printWarning(
 				"SHA1 sum for '", name,
 				"' does not match with sum of '",
-				file.getURL(), "'.");
+				fileURL, "'.");
 		}
 
 		// We loaded an external file, so check.
@@ -234,15 +285,15 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 					Filename(p->getData(), context),
 					std::move(patch));
 			}
+			// The original content can be shared with other roms,
+			// so always apply the patch in a private copy.
 			auto patchSize = unsigned(patch->getSize());
-			if (patchSize <= size) {
-				patch->copyBlock(0, const_cast<byte*>(rom), size);
-			} else {
-				size = patchSize;
-				extendedRom.resize(size);
-				patch->copyBlock(0, extendedRom.data(), size);
-				rom = extendedRom.data();
-			}
+			size = std::max(size, patchSize);
+			MemBuffer<byte> patched(size);
+			patch->copyBlock(0, patched.data(), size);
+			extendedRom = std::move(patched);
+			rom = extendedRom.data();
+			image.reset();
 
 			// calculated because it's different from original
 			patchedSha1 = SHA1::calc(rom, size);
@@ -264,7 +315,7 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 			name = title.str();
 		} else {
 			// unknown ROM, use file name
-			name = file.getOriginalName();
+			name = originalName;
 		}
 	}
 
@@ -288,7 +339,7 @@ void Rom::init(MSXMotherBoard& motherBoard, const XMLElement& config,
 		const auto& actualSha1Elem = mutableConfig.getCreateChild(
 			"resolvedSha1", patchedSha1Str);
 		if (actualSha1Elem.getData() != patchedSha1Str) {
-			string tmp = file.is_open() ? file.getURL() : name;
+			string tmp = fileURL.empty() ? name : fileURL;
 			// can only happen in case of loadstate
 			motherBoard.getMSXCliComm().printWarning(
 				"The content of the rom ", tmp, " has "
@@ -337,7 +388,8 @@ bool Rom::checkSHA1(const XMLElement& config)
 Rom::Rom(Rom&& r) noexcept
 	: rom          (std::move(r.rom))
 	, extendedRom  (std::move(r.extendedRom))
-	, file         (std::move(r.file))
+	, image        (std::move(r.image))
+	, fileURL      (std::move(r.fileURL))
 	, originalSha1 (std::move(r.originalSha1))
 	, name         (std::move(r.name))
 	, description  (std::move(r.description))
@@ -351,7 +403,7 @@ Rom::~Rom() = default;
 
 string Rom::getFilename() const
 {
-	return file.is_open() ? file.getURL() : string{};
+	return fileURL;
 }
 
 const Sha1Sum& Rom::getOriginalSHA1() const
@@ -409,6 +461,12 @@ void RomDebuggable::write(unsigned /*address*/, byte /*value*/)
 	// ignore
 }
 
+void RomDebuggable::readBlock(unsigned address, byte* output, unsigned num)
+{
+	assert((address + num) <= getSize());
+	memcpy(output, &(*rom)[address], num);
+}
+
 void RomDebuggable::moved(Rom& r)
 {
 	rom = &r;
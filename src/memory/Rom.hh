@@ -1,7 +1,6 @@
 #ifndef ROM_HH
 #define ROM_HH
 
-#include "File.hh"
 #include "MemBuffer.hh"
 #include "sha1.hh"
 #include "openmsx.hh"
@@ -38,6 +37,10 @@ public:
 
 	void addPadding(unsigned newSize, byte filler = 0xff);
 
+	/** Immutable rom image, shared (process-wide) between all Rom
+	  * objects that load a file with the same sha1sum. */
+	struct Image;
+
 private:
 	void init(MSXMotherBoard& motherBoard, const XMLElement& config,
 	          const FileContext& context);
@@ -48,7 +51,8 @@ private:
 	const byte* rom;
 	MemBuffer<byte> extendedRom;
 
-	File file; // can be a closed file
+	std::shared_ptr<const Image> image; // can be nullptr
+	std::string fileURL; // URL of the loaded file, can be empty
 
 	mutable Sha1Sum originalSha1;
 	std::string name;
@@ -6,14 +6,19 @@
 #include "MSXException.hh"
 #include "StringOp.hh"
 #include "String32.hh"
+#include "Version.hh"
 #include "hash_map.hh"
 #include "outer.hh"
 #include "rapidsax.hh"
 #include "unreachable.hh"
 #include "stl.hh"
 #include "xxhash.hh"
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <stdexcept>
+#include <type_traits>
 
 using std::string;
 using std::vector;
@@ -558,23 +563,108 @@ static void parseDB(CliComm& cliComm, char* buf, char* bufStart,
 	}
 }
 
+// Binary index, see comment in RomDatabase.hh. Layout of the file:
+//   IndexHeader
+//   'sources' description   (openMSX build and files + size + mtime this
+//                            index was built from)
+//   warnings                (printed when parsing the xml file(s))
+//   padding                 (up to 8-byte alignment)
+//   RomDatabase::Entry[numEntries]   sorted on sha1sum
+//   string arena            (zero-terminated strings, offset 0 is "")
+// This file is only a cache: it uses the native endianness and struct
+// layout, and it's simply rebuilt when anything doesn't match.
+static const char* const INDEX_FILE = "/.softwaredb.idx";
+static const uint32_t INDEX_VERSION = 2;
+
+struct IndexHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t entrySize;
+	uint32_t sourcesSize;
+	uint32_t warningsSize;
+	uint32_t numEntries;
+	uint32_t entriesOffset;
+	uint32_t stringsOffset;
+	uint32_t stringsSize;
+};
+static const char INDEX_MAGIC[8] = { 'S','W','D','B','I','D','X', 0 };
+
+// The index stores String32 values, that only works when those are offsets
+// (and not pointers, as on 32-bit systems).
+static const bool INDEX_SUPPORTED = std::is_same<String32, uint32_t>::value;
+
+static size_t alignUp8(size_t n)
+{
+	return (n + 7) & ~size_t(7);
+}
+
+// The index stores RomType values. Another openMSX build can number those
+// differently, so the index also records the build and the numbering.
+static string indexFingerprint()
+{
+	string result = strCat(Version::full(), '\n');
+	auto types = RomInfo::getAllRomTypes();
+	sort(begin(types), end(types));
+	for (auto& t : types) {
+		strAppend(result, t, '=', int(RomInfo::nameToRomType(t)), ' ');
+	}
+	result += '\n';
+	return result;
+}
+
 RomDatabase::RomDatabase(CliComm& cliComm)
+	: entries(nullptr)
+	, numEntries(0)
+	, bufStart("")
+{
+	// first user- then system-directory
+	vector<string> xmlFiles;
+	string sources = indexFingerprint();
+	for (auto& p : systemFileContext().getPaths()) {
+		string filename = FileOperations::join(p, "softwaredb.xml");
+		FileOperations::Stat st;
+		if (!FileOperations::getStat(filename, st) ||
+		    !FileOperations::isRegularFile(st)) {
+			// Ignore. It's not unusual the DB in the user
+			// directory is not found. In case there's an error
+			// with both user and system DB, we must give a
+			// warning, but that's done below.
+			continue;
+		}
+		strAppend(sources, filename, ' ', uint64_t(st.st_size), ' ',
+		          int64_t(FileOperations::getModificationDate(st)), '\n');
+		xmlFiles.push_back(std::move(filename));
+	}
+
+	string warnings;
+	if (!INDEX_SUPPORTED || xmlFiles.empty() || !loadIndex(sources, warnings)) {
+		warnings = parseXml(cliComm, xmlFiles);
+		if (INDEX_SUPPORTED && !db.empty()) writeIndex(sources, warnings);
+	}
+	if (!warnings.empty()) {
+		cliComm.printWarning(warnings);
+	}
+
+	if (numEntries == 0) {
+		cliComm.printWarning(
+			"Couldn't load software database.\n"
+			"This may cause incorrect ROM mapper types to be used.");
+	}
+}
+
+string RomDatabase::parseXml(CliComm& cliComm, const vector<string>& xmlFiles)
 {
 	db.reserve(3500);
 	UnknownTypes unknownTypes;
-	// first user- then system-directory
-	vector<string> paths = systemFileContext().getPaths();
 	vector<File> files;
 	size_t bufferSize = 0;
-	for (auto& p : paths) {
+	for (auto& f : xmlFiles) {
 		try {
-			files.emplace_back(FileOperations::join(p, "softwaredb.xml"));
+			files.emplace_back(f);
 			bufferSize += files.back().getSize() + rapidsax::EXTRA_BUFFER_SPACE;
 		} catch (MSXException& /*e*/) {
-			// Ignore. It's not unusual the DB in the user
-			// directory is not found. In case there's an error
-			// with both user and system DB, we must give a
-			// warning, but that's done below.
+			// Ignore, see constructor.
 		}
 	}
 	buffer.resize(bufferSize);
@@ -592,29 +682,179 @@ RomDatabase::RomDatabase(CliComm& cliComm)
 			cliComm.printWarning(
 				"Rom database parsing failed: ", e.what());
 		} catch (MSXException& /*e*/) {
-			// Ignore, see above
+			// Ignore, see constructor
 		}
 	}
-	if (bufferSize) buffer[0] = 0;
-	if (db.empty()) {
-		cliComm.printWarning(
-			"Couldn't load software database.\n"
-			"This may cause incorrect ROM mapper types to be used.");
+	if (bufferSize) {
+		buffer[0] = 0;
+		bufStart = buffer.data();
 	}
+	entries = db.data();
+	numEntries = db.size();
+	string output;
 	if (!unknownTypes.empty()) {
-		string output = "Unknown mapper types in software database: ";
+		output = "Unknown mapper types in software database: ";
 		for (auto& p : unknownTypes) {
 			strAppend(output, p.first, " (", p.second, "x); ");
 		}
-		cliComm.printWarning(output);
+	}
+	return output;
+}
+
+bool RomDatabase::loadIndex(const string& sources, string& warnings)
+{
+	try {
+		File file(FileOperations::getUserDataDir() + INDEX_FILE);
+		size_t size;
+		const byte* data = file.mmap(size);
+		if (size < sizeof(IndexHeader)) return false;
+
+		IndexHeader header;
+		memcpy(&header, data, sizeof(header));
+		if ((memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) ||
+		    (header.version != INDEX_VERSION) ||
+		    (header.entrySize != sizeof(Entry)) ||
+		    (header.numEntries == 0) ||
+		    ((sizeof(IndexHeader) + size_t(header.sourcesSize) +
+		      header.warningsSize) > size) ||
+		    (header.entriesOffset % alignof(Entry)) ||
+		    ((header.entriesOffset + size_t(header.numEntries) * sizeof(Entry)) > size) ||
+		    (header.stringsSize == 0) ||
+		    ((header.stringsOffset + size_t(header.stringsSize)) > size) ||
+		    (data[header.stringsOffset + header.stringsSize - 1] != 0)) {
+			return false;
+		}
+		string_view storedSources(
+			reinterpret_cast<const char*>(data + sizeof(IndexHeader)),
+			header.sourcesSize);
+		if (storedSources != sources) return false; // xml has changed
+
+		// The file can be truncated or corrupt, check that all strings
+		// are inside the string arena (and so zero-terminated).
+		auto* indexEntries = reinterpret_cast<const Entry*>(data + header.entriesOffset);
+		for (uint32_t i = 0; i < header.numEntries; ++i) {
+			if (!indexEntries[i].second.checkStrings(header.stringsSize)) {
+				return false;
+			}
+		}
+
+		warnings.assign(
+			reinterpret_cast<const char*>(data + sizeof(IndexHeader) + header.sourcesSize),
+			header.warningsSize);
+		entries = indexEntries;
+		numEntries = header.numEntries;
+		bufStart = reinterpret_cast<const char*>(data + header.stringsOffset);
+		indexFile = std::move(file);
+		return true;
+	} catch (MSXException&) {
+		// index doesn't exist yet or can't be read
+		return false;
+	}
+}
+
+void RomDatabase::writeIndex(const string& sources, const string& warnings) const
+{
+	// Collect all strings that are referenced from the entries (most of
+	// the xml buffer is markup) and remove duplicates (e.g. company names).
+	string strings(1, '\0');
+	hash_map<string_view, uint32_t, XXHasher> stringMap;
+	auto intern = [&](string_view str) -> uint32_t {
+		if (str.empty()) return 0;
+		auto it = stringMap.find(str);
+		if (it != stringMap.end()) return it->second;
+		auto result = uint32_t(strings.size());
+		strings.append(str.data(), str.size());
+		strings += '\0';
+		stringMap.emplace(str, result);
+		return result;
+	};
+	struct Offsets {
+		uint32_t title, year, company, country, origType, remark;
+	};
+	vector<Offsets> offsets;
+	offsets.reserve(numEntries);
+	for (size_t i = 0; i < numEntries; ++i) {
+		const auto& info = entries[i].second;
+		Offsets o;
+		o.title    = intern(info.getTitle   (bufStart));
+		o.year     = intern(info.getYear    (bufStart));
+		o.company  = intern(info.getCompany (bufStart));
+		o.country  = intern(info.getCountry (bufStart));
+		o.origType = intern(info.getOrigType(bufStart));
+		o.remark   = intern(info.getRemark  (bufStart));
+		offsets.push_back(o);
+	}
+	// Only now 'strings' has its final address.
+	const char* s = strings.data();
+	auto str32 = [&](uint32_t offset) {
+		String32 result;
+		toString32(s, s + offset, result);
+		return result;
+	};
+	RomDB indexDb;
+	indexDb.reserve(numEntries);
+	for (size_t i = 0; i < numEntries; ++i) {
+		const auto& info = entries[i].second;
+		const auto& o = offsets[i];
+		indexDb.emplace_back(entries[i].first, RomInfo(
+			str32(o.title), str32(o.year),
+			str32(o.company), str32(o.country),
+			info.getOriginal(), str32(o.origType),
+			str32(o.remark), info.getRomType(),
+			info.getGenMSXid()));
+	}
+
+	IndexHeader header;
+	memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.entrySize = sizeof(Entry);
+	header.sourcesSize = uint32_t(sources.size());
+	header.warningsSize = uint32_t(warnings.size());
+	header.numEntries = uint32_t(indexDb.size());
+	size_t textEnd = sizeof(IndexHeader) + sources.size() + warnings.size();
+	header.entriesOffset = uint32_t(alignUp8(textEnd));
+	header.stringsOffset = uint32_t(header.entriesOffset + indexDb.size() * sizeof(Entry));
+	header.stringsSize = uint32_t(strings.size());
+	static const char padding[8] = {};
+	size_t paddingSize = header.entriesOffset - textEnd;
+
+	// Write to a temporary file and then rename it. This way concurrently
+	// starting openMSX instances never see a partially written index.
+	try {
+		string dir = FileOperations::getUserDataDir();
+		FileOperations::mkdirp(dir);
+		string tmpName;
+		{
+			auto fp = FileOperations::openUniqueFile(dir, tmpName);
+			if (!fp) return;
+			bool ok =
+				(fwrite(&header, sizeof(header), 1, fp.get()) == 1) &&
+				(fwrite(sources.data(), 1, sources.size(), fp.get()) == sources.size()) &&
+				(fwrite(warnings.data(), 1, warnings.size(), fp.get()) == warnings.size()) &&
+				(fwrite(padding, 1, paddingSize, fp.get()) == paddingSize) &&
+				(fwrite(indexDb.data(), sizeof(Entry), indexDb.size(), fp.get()) == indexDb.size()) &&
+				(fwrite(strings.data(), 1, strings.size(), fp.get()) == strings.size()) &&
+				(fflush(fp.get()) == 0);
+			if (!ok) {
+				fp.reset();
+				FileOperations::unlink(tmpName);
+				return;
+			}
+		}
+		if (FileOperations::rename(tmpName, dir + INDEX_FILE) != 0) {
+			FileOperations::unlink(tmpName);
+		}
+	} catch (MSXException&) {
+		// Ignore, the index is only a cache. We'll retry next time.
 	}
 }
 
 const RomInfo* RomDatabase::fetchRomInfo(const Sha1Sum& sha1sum) const
 {
-	auto it = lower_bound(begin(db), end(db), sha1sum,
-	                      LessTupleElement<0>());
-	return ((it != end(db)) && (it->first == sha1sum))
+	auto first = entries;
+	auto last  = entries + numEntries;
+	auto it = lower_bound(first, last, sha1sum, LessTupleElement<0>());
+	return ((it != last) && (it->first == sha1sum))
 		? &it->second : nullptr;
 }
 
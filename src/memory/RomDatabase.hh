@@ -2,8 +2,10 @@
 #define ROMDATABASE_HH
 
 #include "RomInfo.hh"
+#include "File.hh"
 #include "MemBuffer.hh"
 #include "sha1.hh"
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -11,10 +13,22 @@ namespace openmsx {
 
 class CliComm;
 
+/** The software database (softwaredb.xml) maps sha1sums to information
+  * about the corresponding (rom) dump.
+  *
+  * Parsing the full xml file takes a noticeable amount of time, while a
+  * typical session only does a handful of lookups. So after parsing, a
+  * compact binary index (sorted entries plus one string arena) is written
+  * to the user data directory. On later runs that index is mmap'ed and
+  * lookups are a binary search in it. The xml file(s) are only parsed again
+  * when their size or modification time changes, when the index was written
+  * by a different openMSX build, or when it's corrupt.
+  */
 class RomDatabase
 {
 public:
-	using RomDB = std::vector<std::pair<Sha1Sum, RomInfo>>;
+	using Entry = std::pair<Sha1Sum, RomInfo>;
+	using RomDB = std::vector<Entry>;
 
 	RomDatabase(CliComm& cliComm);
 
@@ -23,11 +37,23 @@ public:
 	 */
 	const RomInfo* fetchRomInfo(const Sha1Sum& sha1sum) const;
 
-	const char* getBufferStart() const { return buffer.data(); }
+	const char* getBufferStart() const { return bufStart; }
 
 private:
+	// These return/store the warnings from parsing the xml file(s).
+	std::string parseXml(CliComm& cliComm, const std::vector<std::string>& xmlFiles);
+	bool loadIndex(const std::string& sources, std::string& warnings);
+	void writeIndex(const std::string& sources, const std::string& warnings) const;
+
+	// Either points into 'db'/'buffer' (after parsing the xml file) or
+	// into the mmap'ed 'indexFile'.
+	const Entry* entries;
+	size_t numEntries;
+	const char* bufStart;
+
 	RomDB db;
 	MemBuffer<char> buffer;
+	File indexFile;
 };
 
 } // namespace openmsx
@@ -210,6 +210,21 @@ vector<string_view> RomInfo::getAllRomTypes()
 	return result;
 }
 
+static bool inBuffer(uint32_t str32, size_t bufSize)
+{
+	return str32 < bufSize;
+}
+static bool inBuffer(const char* /*str32*/, size_t /*bufSize*/)
+{
+	return true;
+}
+bool RomInfo::checkStrings(size_t bufSize) const
+{
+	return inBuffer(title,    bufSize) && inBuffer(year,   bufSize) &&
+	       inBuffer(company,  bufSize) && inBuffer(country, bufSize) &&
+	       inBuffer(origType, bufSize) && inBuffer(remark, bufSize);
+}
+
 string_view RomInfo::getDescription(RomType type)
 {
 	auto& m = getRomTypeInfoMap();
@@ -51,6 +51,12 @@ public:
 	bool             getOriginal()  const { return original; }
 	int              getGenMSXid()  const { return genMSXid; }
 
+	/** Do all strings start inside a buffer of the given size? E.g. to
+	  * verify data read from a file. Only String32 offsets can be checked,
+	  * for pointers this always returns true.
+	  */
+	bool checkStrings(size_t bufSize) const;
+
 	static RomType nameToRomType(string_view name);
 	static string_view romTypeToName(RomType type);
 	static std::vector<string_view> getAllRomTypes();
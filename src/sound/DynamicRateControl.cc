@@ -0,0 +1,95 @@
+#include "DynamicRateControl.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace openmsx {
+
+constexpr double DynamicRateControl::MAX_DEVIATION;
+
+// Ratio correction per fragment of difference between fill level and target.
+static const double GAIN = 0.002;
+// Weight of a new measurement in the (moving) average fill level. The fill
+// level measured right before an upload jumps with the driver callbacks,
+// we only want to follow the trend.
+static const double FILL_ALPHA = 0.05;
+// Lower the target after this many seconds without underruns.
+static const unsigned QUIET_PERIOD = 10;
+
+DynamicRateControl::DynamicRateControl()
+{
+	reset(512, 44100);
+}
+
+void DynamicRateControl::reset(unsigned fragment_, unsigned frequency_)
+{
+	fragment = std::max(fragment_, 1u);
+	frequency = frequency_;
+	target = fragment + fragment / 2;
+	ratio = 1.0;
+	pos = 0.0;
+	prev[0] = prev[1] = 0;
+	fillAvg = 0.0;
+	underrunCount = 0;
+	lastUnderruns = 0;
+	quietSamples = 0;
+	first = true;
+}
+
+void DynamicRateControl::update(int fill, unsigned underruns)
+{
+	if (first) {
+		first = false;
+		fillAvg = fill;
+		lastUnderruns = underruns;
+	}
+	fillAvg = fillAvg * (1.0 - FILL_ALPHA) + fill * FILL_ALPHA;
+
+	if (underruns != lastUnderruns) {
+		// Buffering too little, go up fast (but at most 2 fragments,
+		// the driver itself can't buffer much more than that).
+		underrunCount += underruns - lastUnderruns;
+		lastUnderruns = underruns;
+		target = std::min(target + fragment / 2, 2 * fragment);
+		quietSamples = 0;
+	} else if (quietSamples > uint64_t(QUIET_PERIOD) * frequency) {
+		// Go down slowly, but keep at least one fragment.
+		target = std::max(target - std::min(target, fragment / 8),
+		                  fragment);
+		quietSamples = 0;
+	}
+
+	// Too much buffered -> produce fewer samples, and vice versa.
+	double error = (fillAvg - target) / fragment;
+	double maxDev = MAX_DEVIATION;
+	ratio = 1.0 - std::min(std::max(error * GAIN, -maxDev), maxDev);
+}
+
+unsigned DynamicRateControl::process(const int16_t* in, unsigned inNum, int16_t* out)
+{
+	if (inNum == 0) return 0;
+	quietSamples += inNum;
+
+	double step = 1.0 / ratio;
+	double last = double(inNum - 1);
+	unsigned num = 0;
+	while (pos < last) {
+		int i = int(pos + 1.0) - 1; // floor(), also for pos in [-1, 0)
+		double frac = pos - i;
+		const int16_t* s0 = (i < 0) ? prev : &in[2 * i];
+		const int16_t* s1 = &in[2 * (i + 1)];
+		for (int ch = 0; ch < 2; ++ch) {
+			out[2 * num + ch] = int16_t(
+				s0[ch] + int(frac * (s1[ch] - s0[ch])));
+		}
+		++num;
+		pos += step;
+	}
+	assert(num <= getMaxOutput(inNum));
+	pos -= inNum;
+	assert(pos >= -1.0);
+	prev[0] = in[2 * (inNum - 1) + 0];
+	prev[1] = in[2 * (inNum - 1) + 1];
+	return num;
+}
+
+} // namespace openmsx
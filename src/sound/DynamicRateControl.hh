@@ -0,0 +1,73 @@
+#ifndef DYNAMICRATECONTROL_HH
+#define DYNAMICRATECONTROL_HH
+
+#include <cstdint>
+
+namespace openmsx {
+
+/** Keeps the amount of sound data that is buffered in the sound driver (and
+  * thus the sound latency) small and constant.
+  *
+  * The emulation is synchronized to the host clock, the sound card plays at
+  * its own rate. These never exactly match, so without correction the
+  * driver buffer slowly fills up (more latency) or drains (underruns). This
+  * class compares the buffer fill level with a target level and stretches
+  * or shrinks the generated sound by a small ratio (at most MAX_DEVIATION)
+  * to steer the fill level towards that target.
+  *
+  * The target level itself adapts: it goes up after a buffer underrun and
+  * slowly goes down again when there were no underruns for a while.
+  *
+  * All levels are expressed in (stereo) samples.
+  */
+class DynamicRateControl
+{
+public:
+	static constexpr double MAX_DEVIATION = 0.005;
+
+	DynamicRateControl();
+
+	/** (Re)start with the given driver fragment size and sample rate. */
+	void reset(unsigned fragment, unsigned frequency);
+
+	/** Update the ratio, called before each upload to the driver.
+	  * @param fill Number of samples currently buffered in the driver.
+	  * @param underruns Total number of underruns reported by the driver.
+	  */
+	void update(int fill, unsigned underruns);
+
+	/** Resample a block of stereo samples with the current ratio (linear
+	  * interpolation, continues seamlessly from the previous block).
+	  * @param in Input, 'inNum' stereo samples.
+	  * @param out Output, must have space for getMaxOutput(inNum) samples.
+	  * @return The number of produced (stereo) samples.
+	  */
+	unsigned process(const int16_t* in, unsigned inNum, int16_t* out);
+	static unsigned getMaxOutput(unsigned inNum) {
+		return unsigned(inNum * (1.0 + MAX_DEVIATION)) + 2;
+	}
+
+	double getRatio() const { return ratio; }
+	double getAverageFill() const { return fillAvg; }
+	unsigned getTarget() const { return target; }
+	unsigned getUnderruns() const { return underrunCount; }
+
+private:
+	double ratio; // number of output samples per input sample
+	double pos;   // position of the next output sample in the input,
+	              // -1 refers to 'prev'
+	int16_t prev[2];
+
+	double fillAvg;
+	unsigned fragment;
+	unsigned frequency;
+	unsigned target;
+	unsigned underrunCount;  // underruns seen since reset()
+	unsigned lastUnderruns;  // last value reported by the driver
+	uint64_t quietSamples;   // samples since the last underrun
+	bool first;
+};
+
+} // namespace openmsx
+
+#endif
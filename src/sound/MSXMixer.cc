@@ -13,6 +13,7 @@
 #include "AviRecorder.hh"
 #include "Filename.hh"
 #include "CliComm.hh"
+#include "Profiler.hh"
 #include "Math.hh"
 #include "stl.hh"
 #include "aligned.hh"
@@ -440,6 +441,7 @@ void MSXMixer::generate(int16_t* output, EmuTime::param time, unsigned samples)
 	// devices are handled first
 	for (auto& info : infos) {
 		SoundDevice& device = *info.device;
+		ProfileScope scope("sound: ", device.getName());
 		int l1 = info.left1;
 		int r1 = info.right1;
 		if (!device.isStereo()) {
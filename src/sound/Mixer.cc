@@ -5,13 +5,20 @@
 #include "CommandController.hh"
 #include "CliComm.hh"
 #include "MSXException.hh"
+#include "Reactor.hh"
+#include "TclObject.hh"
+#include "outer.hh"
 #include "stl.hh"
 #include "unreachable.hh"
 #include "components.hh"
 #include "build-info.hh"
+#include <algorithm>
 #include <cassert>
 #include <memory>
 
+using std::string;
+using std::vector;
+
 namespace openmsx {
 
 #if defined(_WIN32)
@@ -30,9 +37,11 @@ static EnumSetting<Mixer::SoundDriverType>::Map getSoundDriverMap()
 	return soundDriverMap;
 }
 
-Mixer::Mixer(Reactor& reactor_, CommandController& commandController_)
+Mixer::Mixer(Reactor& reactor_, CommandController& commandController_,
+             bool forceNullDriver_)
 	: reactor(reactor_)
 	, commandController(commandController_)
+	, forceNullDriver(forceNullDriver_)
 	, soundDriverSetting(
 		commandController, "sound_driver",
 		"select the sound output driver",
@@ -49,12 +58,22 @@ Mixer::Mixer(Reactor& reactor_, CommandController& commandController_)
 	, samplesSetting(
 		commandController, "samples",
 		"mixer samples", defaultsamples, 64, 8192)
+	, syncToAudioSetting(
+		commandController, "sync_to_audio",
+		"synchronize the emulation speed to the sound card clock "
+		"instead of to the host clock", false)
+	, rateControlSetting(
+		commandController, "audio_rate_control",
+		"keep the sound latency low and constant by slightly (max 0.5%) "
+		"adjusting the sound output rate", false)
+	, audioLatencyInfo(reactor.getOpenMSXInfoCommand())
 	, muteCount(0)
 {
 	muteSetting       .attach(*this);
 	frequencySetting  .attach(*this);
 	samplesSetting    .attach(*this);
 	soundDriverSetting.attach(*this);
+	rateControlSetting.attach(*this);
 
 	// Set correct initial mute state.
 	if (muteSetting.getBoolean()) ++muteCount;
@@ -67,6 +86,7 @@ Mixer::~Mixer()
 	assert(msxMixers.empty());
 	driver.reset();
 
+	rateControlSetting.detach(*this);
 	soundDriverSetting.detach(*this);
 	samplesSetting    .detach(*this);
 	frequencySetting  .detach(*this);
@@ -82,7 +102,7 @@ void Mixer::reloadDriver()
 	driver = std::make_unique<NullSoundDriver>();
 
 	try {
-		switch (soundDriverSetting.getEnum()) {
+		switch (forceNullDriver ? SND_NULL : soundDriverSetting.getEnum()) {
 		case SND_NULL:
 			driver = std::make_unique<NullSoundDriver>();
 			break;
@@ -143,6 +163,7 @@ void Mixer::muteHelper()
 	if (isMuted) {
 		driver->mute();
 	} else {
+		rateControl.reset(driver->getSamples(), frequency);
 		driver->unmute();
 	}
 }
@@ -152,9 +173,35 @@ void Mixer::uploadBuffer(MSXMixer& /*msxMixer*/, int16_t* buffer, unsigned len)
 	// can only handle one MSXMixer ATM
 	assert(!msxMixers.empty());
 
+	if (rateControlSetting.getBoolean()) {
+		int fill = driver->getBufferedSamples();
+		if (fill >= 0) {
+			rateControl.update(fill, driver->getUnderruns());
+			rateControlBuffer.resize(
+				2 * DynamicRateControl::getMaxOutput(len));
+			len = rateControl.process(
+				buffer, len, rateControlBuffer.data());
+			buffer = rateControlBuffer.data();
+		}
+	}
 	driver->uploadBuffer(buffer, len);
 }
 
+int Mixer::getBufferedSamples() const
+{
+	if (!syncToAudioSetting.getBoolean() ||
+	    rateControlSetting.getBoolean() || muteCount ||
+	    msxMixers.empty()) {
+		return -1;
+	}
+	return driver->getBufferedSamples();
+}
+
+unsigned Mixer::getFrequency() const
+{
+	return driver->getFrequency();
+}
+
 void Mixer::update(const Setting& setting)
 {
 	if (&setting == &muteSetting) {
@@ -167,9 +214,63 @@ void Mixer::update(const Setting& setting)
 	           (&setting == &soundDriverSetting) ||
 	           (&setting == &frequencySetting)) {
 		reloadDriver();
+	} else if (&setting == &rateControlSetting) {
+		rateControl.reset(driver->getSamples(), driver->getFrequency());
 	} else {
 		UNREACHABLE;
 	}
 }
 
+
+// class AudioLatencyInfo
+
+Mixer::AudioLatencyInfo::AudioLatencyInfo(InfoCommand& openMSXInfoCommand)
+	: InfoTopic(openMSXInfoCommand, "audio_latency")
+{
+}
+
+void Mixer::AudioLatencyInfo::execute(
+	array_ref<TclObject> /*tokens*/, TclObject& result) const
+{
+	auto& mixer = OUTER(Mixer, audioLatencyInfo);
+	auto& driver = *mixer.driver;
+	bool control = mixer.rateControlSetting.getBoolean();
+	unsigned frequency = driver.getFrequency();
+	unsigned fragment = driver.getSamples();
+	int fill = driver.getBufferedSamples();
+	// Buffered samples plus the fragment that's being played.
+	double buffered = control ? mixer.rateControl.getAverageFill()
+	                          : std::max(fill, 0);
+	double latency = (buffered + fragment) * 1000.0 / frequency;
+
+	result.addListElement("rate_control");
+	result.addListElement(int(control));
+	result.addListElement("frequency");
+	result.addListElement(int(frequency));
+	result.addListElement("fragment");
+	result.addListElement(int(fragment));
+	result.addListElement("buffered");
+	result.addListElement(fill);
+	result.addListElement("target");
+	result.addListElement(control ? int(mixer.rateControl.getTarget())
+	                              : -1);
+	result.addListElement("latency_ms");
+	result.addListElement(fill >= 0 ? latency : -1.0);
+	result.addListElement("underruns");
+	result.addListElement(int(driver.getUnderruns()));
+	result.addListElement("ratio");
+	result.addListElement(control ? mixer.rateControl.getRatio() : 1.0);
+}
+
+string Mixer::AudioLatencyInfo::help(const vector<string>& /*tokens*/) const
+{
+	return "Returns a dictionary with the current state of the sound "
+	       "output: whether the 'audio_rate_control' setting is enabled, "
+	       "the sample frequency, the fragment size, the number of "
+	       "buffered samples, the target for that number (only with "
+	       "rate control), the resulting latency in milliseconds, the "
+	       "total number of buffer underruns and the current output "
+	       "rate ratio.";
+}
+
 } // namespace openmsx
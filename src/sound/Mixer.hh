@@ -2,6 +2,8 @@
 #define MIXER_HH
 
 #include "Observer.hh"
+#include "DynamicRateControl.hh"
+#include "InfoTopic.hh"
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
 #include "IntegerSetting.hh"
@@ -20,7 +22,11 @@ class Mixer final : private Observer<Setting>
 public:
 	enum SoundDriverType { SND_NULL, SND_SDL, SND_DIRECTX };
 
-	Mixer(Reactor& reactor, CommandController& commandController);
+	/** @param forceNullDriver Never open a real sound device, whatever
+	  *        the 'sound_driver' setting says (see Reactor::runFor()).
+	  */
+	Mixer(Reactor& reactor, CommandController& commandController,
+	      bool forceNullDriver);
 	~Mixer();
 
 	/** Register per-machine mixer
@@ -47,6 +53,14 @@ public:
 
 	IntegerSetting& getMasterVolume() { return masterVolume; }
 
+	/** Number of samples that are uploaded to the sound driver but not
+	  * yet played. Returns -1 when that's unknown or when the emulation
+	  * should not follow the sound card clock ('sync_to_audio' setting,
+	  * ignored when 'audio_rate_control' is enabled), see RealTime.
+	  */
+	int getBufferedSamples() const;
+	unsigned getFrequency() const;
+
 private:
 	void reloadDriver();
 	void muteHelper();
@@ -59,12 +73,25 @@ private:
 	std::unique_ptr<SoundDriver> driver;
 	Reactor& reactor;
 	CommandController& commandController;
+	const bool forceNullDriver;
 
 	EnumSetting<SoundDriverType> soundDriverSetting;
 	BooleanSetting muteSetting;
 	IntegerSetting masterVolume;
 	IntegerSetting frequencySetting;
 	IntegerSetting samplesSetting;
+	BooleanSetting syncToAudioSetting;
+	BooleanSetting rateControlSetting;
+
+	DynamicRateControl rateControl;
+	std::vector<int16_t> rateControlBuffer;
+
+	struct AudioLatencyInfo final : InfoTopic {
+		explicit AudioLatencyInfo(InfoCommand& openMSXInfoCommand);
+		void execute(array_ref<TclObject> tokens,
+		             TclObject& result) const override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+	} audioLatencyInfo;
 
 	int muteCount;
 };
@@ -24,4 +24,14 @@ void NullSoundDriver::uploadBuffer(int16_t* /*buffer*/, unsigned /*len*/)
 {
 }
 
+int NullSoundDriver::getBufferedSamples() const
+{
+	return -1;
+}
+
+unsigned NullSoundDriver::getUnderruns() const
+{
+	return 0;
+}
+
 } // namespace openmsx
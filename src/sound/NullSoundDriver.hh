@@ -15,6 +15,8 @@ public:
 	unsigned getSamples() const override;
 
 	void uploadBuffer(int16_t* buffer, unsigned len) override;
+	int getBufferedSamples() const override;
+	unsigned getUnderruns() const override;
 };
 
 } // namespace openmsx
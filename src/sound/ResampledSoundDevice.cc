@@ -7,6 +7,7 @@
 #include "Reactor.hh"
 #include "GlobalSettings.hh"
 #include "EnumSetting.hh"
+#include "Profiler.hh"
 #include "unreachable.hh"
 #include <cassert>
 #include <memory>
@@ -42,6 +43,8 @@ bool ResampledSoundDevice::updateBuffer(unsigned length, int* buffer,
 
 bool ResampledSoundDevice::generateInput(int* buffer, unsigned num)
 {
+	// Measured separately from the resampling, see MSXMixer::generate().
+	ProfileScope scope("sound chip: ", getName());
 	return mixChannels(buffer, num);
 }
 
@@ -18,6 +18,7 @@ namespace openmsx {
 SDLSoundDriver::SDLSoundDriver(Reactor& reactor_,
                                unsigned wantedFreq, unsigned wantedSamples)
 	: reactor(reactor_)
+	, underruns(0)
 	, muted(true)
 {
 	SDL_AudioSpec desired;
@@ -58,6 +59,7 @@ void SDLSoundDriver::reInit()
 	SDL_LockAudio();
 	readIdx  = 0;
 	writeIdx = 0;
+	filled = false;
 	SDL_UnlockAudio();
 }
 
@@ -131,7 +133,8 @@ void SDLSoundDriver::audioCallback(int16_t* stream, unsigned len)
 	}
 	int missing = len - available;
 	if (missing > 0) {
-		// buffer underrun
+		// buffer underrun (not counted before the first upload)
+		if (filled) ++underruns;
 		memset(&stream[available], 0, missing * sizeof(int16_t));
 	}
 }
@@ -158,6 +161,7 @@ void SDLSoundDriver::uploadBuffer(int16_t* buffer, unsigned len)
 		}
 	}
 	assert(len <= free);
+	filled = true;
 	if ((writeIdx + len) < mixBufferSize) {
 		memcpy(&mixBuffer[writeIdx], buffer, len * sizeof(int16_t));
 		writeIdx += len;
@@ -172,4 +176,21 @@ void SDLSoundDriver::uploadBuffer(int16_t* buffer, unsigned len)
 	SDL_UnlockAudio();
 }
 
+int SDLSoundDriver::getBufferedSamples() const
+{
+	if (muted) return -1;
+	SDL_LockAudio();
+	unsigned num = getBufferFilled();
+	SDL_UnlockAudio();
+	return num / 2; // stereo
+}
+
+unsigned SDLSoundDriver::getUnderruns() const
+{
+	SDL_LockAudio();
+	unsigned result = underruns;
+	SDL_UnlockAudio();
+	return result;
+}
+
 } // namespace openmsx
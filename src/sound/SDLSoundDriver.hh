@@ -25,6 +25,8 @@ public:
 	unsigned getSamples() const override;
 
 	void uploadBuffer(int16_t* buffer, unsigned len) override;
+	int getBufferedSamples() const override;
+	unsigned getUnderruns() const override;
 
 private:
 	void reInit();
@@ -39,6 +41,8 @@ private:
 	unsigned frequency;
 	unsigned fragmentSize;
 	unsigned readIdx, writeIdx;
+	unsigned underruns;
+	bool filled; // anything uploaded since reInit()?
 	bool muted;
 };
 
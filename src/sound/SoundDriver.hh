@@ -30,6 +30,16 @@ public:
 
 	virtual void uploadBuffer(int16_t* buffer, unsigned len) = 0;
 
+	/** Returns the number of (stereo) samples that are uploaded but not
+	  * yet played, or -1 when that's unknown (e.g. while muted).
+	  */
+	virtual int getBufferedSamples() const = 0;
+
+	/** Returns the number of times the sound card wanted to play more
+	  * samples than were available, since this driver was created.
+	  */
+	virtual unsigned getUnderruns() const = 0;
+
 protected:
 	SoundDriver() {}
 };
@@ -38,6 +38,7 @@
 #include "Math.hh"
 #include "outer.hh"
 #include <algorithm>
+#include <cstring>
 
 namespace openmsx {
 
@@ -1162,4 +1163,17 @@ void YMF278::DebugMemory::write(unsigned address, byte value)
 	ymf278.writeMem(address, value);
 }
 
+void YMF278::DebugMemory::readBlock(unsigned address, byte* output, unsigned num)
+{
+	auto& ymf278 = OUTER(YMF278, debugMemory);
+	if ((address + num) <= 0x200000) {
+		// only ROM
+		memcpy(output, &ymf278.rom[address], num);
+	} else {
+		for (unsigned i = 0; i < num; ++i) {
+			output[i] = ymf278.readMem(address + i);
+		}
+	}
+}
+
 } // namespace openmsx
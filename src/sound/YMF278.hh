@@ -109,6 +109,7 @@ private:
 		DebugMemory(MSXMotherBoard& motherBoard, const std::string& name);
 		byte read(unsigned address) override;
 		void write(unsigned address, byte value) override;
+		void readBlock(unsigned address, byte* output, unsigned num) override;
 	} debugMemory;
 
 	Slot slots[24];
@@ -1,6 +1,10 @@
 #include "Timer.hh"
 #include <chrono>
 #include <thread>
+#if defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#endif
 
 namespace openmsx {
 namespace Timer {
@@ -31,5 +35,23 @@ void sleep(uint64_t us)
 	std::this_thread::sleep_for(std::chrono::microseconds(us));
 }
 
+void sleepUntil(uint64_t deadline)
+{
+#if defined(__linux__)
+	// steady_clock is CLOCK_MONOTONIC, use it directly: sleep_until()
+	// is not guaranteed to use an absolute timeout.
+	timespec ts;
+	ts.tv_sec  = deadline / 1000000;
+	ts.tv_nsec = (deadline % 1000000) * 1000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+		// interrupted by a signal, sleep again (till the same deadline)
+	}
+#else
+	using namespace std::chrono;
+	std::this_thread::sleep_until(
+		steady_clock::time_point(microseconds(deadline)));
+#endif
+}
+
 } // namespace Timer
 } // namespace openmsx
@@ -15,6 +15,13 @@ namespace Timer {
 	  */
 	void sleep(uint64_t us);
 
+	/** Sleep till the given point in time (in the same time base as
+	  * getTime()). Compared to sleep(), this doesn't drift when the thread
+	  * gets preempted between calculating and requesting the duration. It
+	  * can still wake up (a bit) too late.
+	  */
+	void sleepUntil(uint64_t deadline);
+
 } // namespace Timer
 } // namespace openmsx
 
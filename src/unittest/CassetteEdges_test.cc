@@ -0,0 +1,91 @@
+#include "catch.hpp"
+#include "CassetteEdges.hh"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// The level as seen by the MSX, calculated directly from the samples.
+static bool levelAt(const std::vector<int16_t>& samples, uint64_t pos)
+{
+	auto i = size_t(pos >> CassetteEdges::SUB_BITS);
+	auto frac = unsigned(pos & (CassetteEdges::SUB_SAMPLES - 1));
+	int s0 = (i       < samples.size()) ? samples[i    ] : 0;
+	int s1 = ((i + 1) < samples.size()) ? samples[i + 1] : 0;
+	return CassetteEdges::getLevel(s0, s1, frac);
+}
+
+TEST_CASE("CassetteEdges: addEdge")
+{
+	CassetteEdges edges(false);
+	edges.addEdge(5);
+	edges.addEdge(5 + 0xFFFF);     // a run that needs exactly one CONTINUE
+	edges.addEdge(1000000);        // several CONTINUE runs
+	edges.addEdge(1000001);
+	CHECK(edges.getNbEdges() == 4);
+
+	CHECK(!edges.getLevel(0));
+	CHECK(!edges.getLevel(4));
+	CHECK( edges.getLevel(5));
+	CHECK( edges.getLevel(5 + 0xFFFE));
+	CHECK(!edges.getLevel(5 + 0xFFFF));
+	CHECK(!edges.getLevel(999999));
+	CHECK( edges.getLevel(1000000));
+	CHECK(!edges.getLevel(1000001));
+	CHECK(!edges.getLevel(5000000));
+	// backwards
+	CHECK( edges.getLevel(60000));
+	CHECK(!edges.getLevel(3));
+}
+
+TEST_CASE("CassetteEdges: fromSamples")
+{
+	// A noisy square wave with varying period, and a long silence (that
+	// needs CONTINUE runs) just below zero.
+	std::mt19937 rng(12345);
+	std::vector<int16_t> samples;
+	int period = 9;
+	for (int i = 0; i < 200000; ++i) {
+		if ((i % 1000) == 0) period = 5 + (rng() % 20);
+		int v = ((i / period) & 1) ? 8000 : -8000;
+		v += int(rng() % 20001) - 10000;
+		if ((100000 <= i) && (i < 110000)) v = -3;
+		samples.push_back(int16_t(v));
+	}
+	std::atomic<bool> abort(false);
+	auto edges = CassetteEdges::fromSamples(samples.data(), samples.size(), abort);
+	CHECK(edges.getNbEdges() > 10000);
+	CHECK(edges.getMemoryUsage() < (samples.size() * sizeof(int16_t) / 4));
+
+	// sequential, till beyond the end
+	uint64_t end = uint64_t(samples.size() + 4) << CassetteEdges::SUB_BITS;
+	bool ok = true;
+	for (uint64_t pos = 0; pos < end; ++pos) {
+		ok &= edges.getLevel(pos) == levelAt(samples, pos);
+	}
+	CHECK(ok);
+
+	// random access
+	for (int i = 0; i < 100000; ++i) {
+		uint64_t pos = rng() % end;
+		ok &= edges.getLevel(pos) == levelAt(samples, pos);
+	}
+	CHECK(ok);
+
+	// the same when the samples are passed in parts
+	CassetteEdges::Builder builder;
+	for (size_t i = 0; i < samples.size(); i += 777) {
+		builder.addSamples(&samples[i], std::min<size_t>(777, samples.size() - i));
+	}
+	auto edges2 = builder.finish();
+	CHECK(edges2.getNbEdges() == edges.getNbEdges());
+	for (uint64_t pos = 0; pos < end; pos += 3) {
+		ok &= edges2.getLevel(pos) == levelAt(samples, pos);
+	}
+	CHECK(ok);
+
+	// an edge in between two samples
+	CHECK(CassetteEdges::getLevel(-100, 300, 4));
+	CHECK(!CassetteEdges::getLevel(-100, 300, 3));
+}
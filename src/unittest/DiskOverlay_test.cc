@@ -0,0 +1,76 @@
+#include "catch.hpp"
+#include "DiskOverlay.hh"
+#include "RamDSKDiskImage.hh"
+#include "FileOperations.hh"
+#include "MSXException.hh"
+#include "TestUtils.hh"
+#include <cstring>
+
+using namespace openmsx;
+
+static SectorBuffer readSector(SectorAccessibleDisk& disk, size_t sector)
+{
+	SectorBuffer buf;
+	disk.readSector(sector, buf);
+	return buf;
+}
+
+static bool equal(const SectorBuffer& buf1, const SectorBuffer& buf2)
+{
+	return memcmp(buf1.raw, buf2.raw, sizeof(buf1.raw)) == 0;
+}
+
+TEST_CASE("DiskOverlay: copy-on-write")
+{
+	RamDSKDiskImage disk;
+	SectorBuffer buf;
+	fillSector(buf, 10, 1);
+	disk.writeSector(10, buf);
+	auto orig11 = readSector(disk, 11);
+	auto orig20 = readSector(disk, 20);
+
+	disk.createOverlay();
+	CHECK(disk.hasOverlay());
+	CHECK_THROWS_AS(disk.createOverlay(), MSXException);
+	std::string deltaName = disk.getOverlay()->getDeltaName();
+	CHECK(FileOperations::isRegularFile(deltaName));
+	CHECK(DiskOverlay::find(deltaName).get() == disk.getOverlay());
+
+	fillSector(buf, 10, 2);
+	disk.writeSector(10, buf);
+	fillSector(buf, 20, 2);
+	disk.writeSector(20, buf);
+	CHECK(disk.getOverlay()->getNbModified() == 2);
+	CHECK(checkSector(readSector(disk, 10), 10, 2));
+	CHECK(equal(readSector(disk, 11), orig11));
+	CHECK(checkSector(readSector(disk, 20), 20, 2));
+
+	SECTION("discard") {
+		disk.discardOverlay();
+		CHECK(!disk.hasOverlay());
+		CHECK(checkSector(readSector(disk, 10), 10, 1));
+		CHECK(equal(readSector(disk, 20), orig20));
+	}
+	SECTION("commit") {
+		disk.commitOverlay();
+		CHECK(!disk.hasOverlay());
+		CHECK(checkSector(readSector(disk, 10), 10, 2));
+		CHECK(checkSector(readSector(disk, 20), 20, 2));
+		CHECK_THROWS_AS(disk.commitOverlay(), MSXException);
+	}
+	// The delta file is removed together with the overlay.
+	CHECK(!FileOperations::isRegularFile(deltaName));
+	CHECK(DiskOverlay::find(deltaName) == nullptr);
+}
+
+TEST_CASE("DiskOverlay: write protected image")
+{
+	RamDSKDiskImage disk;
+	disk.forceWriteProtect();
+	SectorBuffer buf;
+	fillSector(buf, 5, 3);
+	CHECK_THROWS(disk.writeSector(5, buf));
+	// forceWriteProtect() can't be bypassed with an overlay
+	disk.createOverlay();
+	CHECK(disk.isWriteProtected());
+}
@@ -0,0 +1,90 @@
+#include "catch.hpp"
+#include "DynamicRateControl.hh"
+#include <vector>
+
+using namespace openmsx;
+
+static unsigned run(DynamicRateControl& drc, unsigned blocks, unsigned size)
+{
+	std::vector<int16_t> in(2 * size);
+	std::vector<int16_t> out(2 * DynamicRateControl::getMaxOutput(size));
+	for (unsigned i = 0; i < size; ++i) {
+		in[2 * i + 0] = 1000;
+		in[2 * i + 1] = -1000;
+	}
+	unsigned total = 0;
+	bool constant = true;
+	for (unsigned b = 0; b < blocks; ++b) {
+		unsigned n = drc.process(in.data(), size, out.data());
+		for (unsigned i = 1; i < n; ++i) { // [0] interpolates with 'prev'
+			if ((out[2 * i + 0] !=  1000) ||
+			    (out[2 * i + 1] != -1000)) constant = false;
+		}
+		total += n;
+	}
+	CHECK(constant);
+	return total;
+}
+
+TEST_CASE("DynamicRateControl: pass through")
+{
+	DynamicRateControl drc;
+	drc.reset(512, 44100);
+	CHECK(drc.getRatio() == 1.0);
+
+	// One sample delay, otherwise the same samples.
+	int16_t in[2 * 4] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	int16_t out[2 * 8];
+	CHECK(drc.process(in, 4, out) == 3);
+	CHECK(out[0] == 1); CHECK(out[1] == 2);
+	CHECK(out[4] == 5); CHECK(out[5] == 6);
+	CHECK(drc.process(in, 4, out) == 4);
+	CHECK(out[0] == 7); CHECK(out[1] == 8);
+	CHECK(out[2] == 1); CHECK(out[3] == 2);
+}
+
+TEST_CASE("DynamicRateControl: steer fill level")
+{
+	DynamicRateControl drc;
+	drc.reset(512, 44100);
+	CHECK(drc.getTarget() == 768);
+
+	// too much buffered -> fewer samples
+	for (int i = 0; i < 100; ++i) drc.update(1400, 0);
+	CHECK(drc.getRatio() < 1.0);
+	CHECK(drc.getRatio() >= 1.0 - DynamicRateControl::MAX_DEVIATION);
+	unsigned n = run(drc, 100, 512);
+	CHECK(n < 100 * 512);
+	CHECK(n >= 100 * 512 * (1.0 - DynamicRateControl::MAX_DEVIATION) - 1);
+
+	// too little -> more samples
+	for (int i = 0; i < 200; ++i) drc.update(0, 0);
+	CHECK(drc.getRatio() > 1.0);
+	CHECK(drc.getRatio() <= 1.0 + DynamicRateControl::MAX_DEVIATION);
+	n = run(drc, 100, 512);
+	CHECK(n > 100 * 512);
+	CHECK(n <= 100 * 512 * (1.0 + DynamicRateControl::MAX_DEVIATION) + 1);
+}
+
+TEST_CASE("DynamicRateControl: adapt target to underruns")
+{
+	DynamicRateControl drc;
+	drc.reset(512, 44100);
+	drc.update(768, 5); // initial driver count is not an underrun
+	CHECK(drc.getUnderruns() == 0);
+	CHECK(drc.getTarget() == 768);
+
+	drc.update(768, 6);
+	CHECK(drc.getUnderruns() == 1);
+	CHECK(drc.getTarget() == 1024);
+	drc.update(768, 8);
+	CHECK(drc.getUnderruns() == 3);
+	CHECK(drc.getTarget() == 1024); // at most 2 fragments
+
+	// Slowly goes down after a quiet period, but not below 1 fragment.
+	for (int i = 0; i < 100; ++i) {
+		run(drc, 11 * 44100 / 512, 512);
+		drc.update(768, 8);
+	}
+	CHECK(drc.getTarget() == 512);
+}
@@ -0,0 +1,78 @@
+#include "catch.hpp"
+#include "GlyphAtlas.hh"
+#include "MSXException.hh"
+#include <vector>
+
+using namespace openmsx;
+
+// Fake font: each glyph is a 'width' x 4 block with coverage 'codePoint'
+// (truncated to 8 bits). 'j' extends one pixel left of the pen, 'W' extends
+// one pixel past the next pen position.
+static unsigned rasterizeCount = 0;
+static void rasterize(uint32_t cp, GlyphAtlas::Bitmap& bitmap)
+{
+	++rasterizeCount;
+	bitmap.width = (cp == 'W') ? 5 : 3;
+	bitmap.height = 4;
+	bitmap.coverage.assign(bitmap.width * bitmap.height, uint8_t(cp));
+	bitmap.left = (cp == 'j') ? -1 : 0;
+	bitmap.advance = (cp == 'W') ? 4 : 3;
+}
+
+TEST_CASE("GlyphAtlas: rasterize once")
+{
+	rasterizeCount = 0;
+	GlyphAtlas atlas(4, rasterize);
+	unsigned w, h;
+	atlas.getSize("abcabc", w, h);
+	CHECK(w == 18);
+	CHECK(h == 4);
+	CHECK(rasterizeCount == 3);
+	atlas.getSize("cab", w, h);
+	CHECK(w == 9);
+	CHECK(rasterizeCount == 3);
+	atlas.getSize("\xc3\xa9\xc3\xa9", w, h); // 2x U+00E9
+	CHECK(w == 6);
+	CHECK(rasterizeCount == 4);
+	CHECK(atlas.getNumGlyphs() == 4);
+	CHECK(atlas.getGlyph(0xE9).width == 3);
+
+	atlas.getSize("", w, h);
+	CHECK(w == 0);
+	CHECK(h == 4);
+
+	CHECK_THROWS_AS(atlas.getSize("a\xc3", w, h), MSXException);
+}
+
+TEST_CASE("GlyphAtlas: render")
+{
+	GlyphAtlas atlas(4, rasterize);
+	unsigned w, h;
+	atlas.getSize("jWa", w, h);
+	CHECK(w == 11); // 1 pixel left of the pen for 'j'
+	std::vector<uint32_t> pixels(w * h, 0xDEADBEEF);
+	atlas.render("jWa", 0x123456, pixels.data(), w);
+	for (unsigned y = 0; y < h; ++y) {
+		auto* line = &pixels[y * w];
+		for (unsigned x = 0; x < 3; ++x) CHECK(line[x] == 0x6A123456);
+		CHECK(line[3] == 0x00123456); // gap, transparent
+		for (unsigned x = 4; x < 8; ++x) CHECK(line[x] == 0x57123456);
+		// overlap between 'W' and 'a' keeps the max coverage
+		for (unsigned x = 8; x < 11; ++x) CHECK(line[x] == 0x61123456);
+	}
+}
+
+TEST_CASE("GlyphAtlas: shelves")
+{
+	GlyphAtlas atlas(4, rasterize);
+	// 3 pixels per glyph, so 170 glyphs fit on one shelf.
+	for (uint32_t cp = 0x100; cp < 0x100 + 171; ++cp) atlas.getGlyph(cp);
+	CHECK(atlas.getAtlasHeight() == 8);
+	auto& g = atlas.getGlyph(0x100 + 170);
+	CHECK(g.x == 0);
+	CHECK(g.y == 4);
+	CHECK(atlas.getAtlasPixels()[4 * GlyphAtlas::ATLAS_WIDTH] == uint8_t(0x100 + 170));
+	auto& g2 = atlas.getGlyph(0x100 + 169);
+	CHECK(g2.x == 169 * 3);
+	CHECK(g2.y == 0);
+}
@@ -0,0 +1,117 @@
+#include "catch.hpp"
+#include "HDSectorCache.hh"
+#include "File.hh"
+#include "MSXException.hh"
+#include "TestUtils.hh"
+
+using namespace openmsx;
+
+static const size_t NB_SECTORS = 1024;
+
+// A temporary image of NB_SECTORS sectors.
+struct TempImage
+{
+	TempImage()
+		: file(tmp.getName(), File::TRUNCATE)
+	{
+		SectorBuffer buf;
+		for (size_t s = 0; s < NB_SECTORS; ++s) {
+			fillSector(buf, s, 0);
+			file.write(&buf, sizeof(buf));
+		}
+	}
+
+	TempFile tmp;
+	File file;
+};
+
+TEST_CASE("HDSectorCache: LRU")
+{
+	TempImage image;
+	HDSectorCache cache(image.file, NB_SECTORS, 16);
+	SectorBuffer buf;
+	// Non-sequential, so no read-ahead.
+	for (size_t i = 0; i < 20; ++i) {
+		size_t sector = (i * 37) % NB_SECTORS;
+		cache.read(sector, buf);
+		CHECK(checkSector(buf, sector, 0));
+	}
+	CHECK(cache.getNbCached() == 16);
+	CHECK(cache.getNbFileReads() == 20);
+
+	// The most recent ones are still cached, the oldest are not.
+	cache.read(19 * 37, buf);
+	cache.read(10 * 37, buf);
+	CHECK(cache.getNbFileReads() == 20);
+	cache.read(0, buf);
+	CHECK(checkSector(buf, 0, 0));
+	CHECK(cache.getNbFileReads() == 21);
+}
+
+TEST_CASE("HDSectorCache: read-ahead")
+{
+	TempImage image;
+	HDSectorCache cache(image.file, NB_SECTORS, 1024);
+	SectorBuffer buf;
+	bool ok = true;
+	for (size_t s = 100; s < 612; ++s) {
+		cache.read(s, buf);
+		ok &= checkSector(buf, s, 0);
+	}
+	CHECK(ok);
+	// Without batching this would be 512 reads.
+	CHECK(cache.getNbFileReads() < 100);
+
+	// Reading till the end of the image doesn't read beyond it.
+	for (size_t s = NB_SECTORS - 20; s < NB_SECTORS; ++s) {
+		cache.read(s, buf);
+		ok &= checkSector(buf, s, 0);
+	}
+	CHECK(ok);
+}
+
+TEST_CASE("HDSectorCache: write-behind")
+{
+	TempImage image;
+	SectorBuffer buf;
+	{
+		// Much smaller than the number of written sectors, so writes
+		// have to wait for the background thread.
+		HDSectorCache cache(image.file, NB_SECTORS, 8);
+		for (size_t s = 10; s < 110; ++s) {
+			fillSector(buf, s, 1);
+			cache.write(s, buf);
+		}
+		fillSector(buf, 500, 1);
+		cache.write(500, buf);
+		CHECK(cache.getNbCached() <= 8);
+
+		bool ok = true;
+		for (size_t s = 0; s < 120; ++s) {
+			cache.read(s, buf);
+			ok &= checkSector(buf, s, ((10 <= s) && (s < 110)) ? 1 : 0);
+		}
+		CHECK(ok);
+		cache.read(500, buf);
+		CHECK(checkSector(buf, 500, 1));
+
+		// Rewrite a sector that's possibly still being written.
+		fillSector(buf, 20, 2);
+		cache.write(20, buf);
+		cache.flush();
+		auto lock = cache.lockFile();
+		image.file.seek(20 * sizeof(buf));
+		image.file.read(&buf, sizeof(buf));
+		CHECK(checkSector(buf, 20, 2));
+	}
+
+	bool ok = true;
+	image.file.seek(0);
+	for (size_t s = 0; s < NB_SECTORS; ++s) {
+		image.file.read(&buf, sizeof(buf));
+		byte v = (s == 20) ? 2
+		       : (((10 <= s) && (s < 110)) || (s == 500)) ? 1 : 0;
+		ok &= checkSector(buf, s, v);
+	}
+	CHECK(ok);
+}
@@ -0,0 +1,65 @@
+#include "catch.hpp"
+#include "MPSCQueue.hh"
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE("MPSCQueue: single thread")
+{
+	MPSCQueue<std::shared_ptr<int>> queue(4);
+	std::shared_ptr<int> p;
+	CHECK(!queue.pop(p));
+
+	for (int round = 0; round < 3; ++round) {
+		for (int i = 0; i < 4; ++i) {
+			CHECK(queue.push(std::make_shared<int>(i)));
+		}
+		CHECK(!queue.push(std::make_shared<int>(99))); // full
+		for (int i = 0; i < 4; ++i) {
+			REQUIRE(queue.pop(p));
+			CHECK(*p == i);
+		}
+		CHECK(!queue.pop(p));
+	}
+}
+
+TEST_CASE("MPSCQueue: multiple producers")
+{
+	static const int PRODUCERS = 4;
+	static const int COUNT = 100000;
+	MPSCQueue<int> queue(256);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < PRODUCERS; ++t) {
+		threads.emplace_back([&queue, t]() {
+			for (int i = 0; i < COUNT; ++i) {
+				while (!queue.push(t * COUNT + i)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	// Per producer, the values must arrive in order.
+	std::vector<int> next(PRODUCERS, 0);
+	bool inOrder = true;
+	for (int n = 0; n < PRODUCERS * COUNT; /**/) {
+		int v;
+		if (!queue.pop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+		int t = v / COUNT;
+		if ((v % COUNT) != next[t]) inOrder = false;
+		next[t] = (v % COUNT) + 1;
+		++n;
+	}
+	for (auto& th : threads) th.join();
+
+	CHECK(inOrder);
+	for (int t = 0; t < PRODUCERS; ++t) {
+		CHECK(next[t] == COUNT);
+	}
+	int v;
+	CHECK(!queue.pop(v));
+}
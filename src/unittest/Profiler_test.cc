@@ -0,0 +1,87 @@
+#include "catch.hpp"
+#include "Profiler.hh"
+
+using namespace openmsx;
+
+// Time only advances when the test says so.
+static uint64_t fakeTime = 0;
+static uint64_t fakeClock() { return fakeTime; }
+static void advance(uint64_t ns) { fakeTime += ns; }
+
+struct FakeClock {
+	FakeClock()  { Profiler::setClock(fakeClock); }
+	~FakeClock() { Profiler::setClock(Profiler::steadyClock); }
+};
+
+static const Profiler::Section& getSection(string_view name)
+{
+	auto& profiler = Profiler::instance();
+	return profiler.getSections()[profiler.getSection(name)];
+}
+
+TEST_CASE("Profiler: disabled")
+{
+	auto& profiler = Profiler::instance();
+	profiler.stop();
+	profiler.reset();
+	{
+		ProfileScope scope("test-disabled");
+	}
+	for (auto& s : profiler.getSections()) {
+		CHECK(s.calls == 0);
+	}
+}
+
+TEST_CASE("Profiler: nested scopes")
+{
+	FakeClock fake;
+	auto& profiler = Profiler::instance();
+	profiler.start(true);
+	for (int i = 0; i < 3; ++i) {
+		ProfileScope outer("test-outer");
+		advance(200000);
+		{
+			ProfileScope inner("test-", "inner");
+			advance(400000);
+		}
+	}
+	profiler.stop();
+
+	auto& outer = getSection("test-outer");
+	auto& inner = getSection("test-inner");
+	CHECK(outer.calls == 3);
+	CHECK(inner.calls == 3);
+	CHECK(inner.totalNs == 3 * 400000);
+	CHECK(inner.selfNs  == 3 * 400000);
+	CHECK(outer.totalNs == 3 * 600000);
+	CHECK(outer.selfNs  == 3 * 200000);
+	CHECK(profiler.getNumTraceEvents() == 6);
+}
+
+TEST_CASE("Profiler: per frame histogram")
+{
+	FakeClock fake;
+	auto& profiler = Profiler::instance();
+	profiler.start(false);
+	for (int frame = 0; frame < 4; ++frame) {
+		if (frame != 2) {
+			ProfileScope scope("test-frame");
+			advance(100000); // 100us -> bucket 7: [64us, 128us)
+		}
+		profiler.endFrame();
+	}
+	profiler.stop();
+
+	auto& s = getSection("test-frame");
+	CHECK(profiler.getNumFrames() == 4);
+	CHECK(s.calls == 3);
+	CHECK(s.frameNs == 0);
+	CHECK(s.maxFrameNs == 100000);
+	CHECK(s.histogram[0] == 1); // the frame without a call
+	CHECK(s.histogram[7] == 3);
+	CHECK(profiler.getNumTraceEvents() == 0);
+
+	profiler.reset();
+	CHECK(getSection("test-frame").calls == 0);
+	CHECK(profiler.getNumFrames() == 0);
+}
@@ -0,0 +1,74 @@
+#include "catch.hpp"
+#include "QOI.hh"
+#include <vector>
+
+using namespace openmsx;
+
+static void roundTrip(const std::vector<uint8_t>& rgb, unsigned width, unsigned height)
+{
+	auto encoded = QOI::encode(rgb.data(), width, height);
+	unsigned w2 = 0, h2 = 0;
+	auto decoded = QOI::decode(encoded.data(), encoded.size(), w2, h2);
+	CHECK(w2 == width);
+	CHECK(h2 == height);
+	CHECK(decoded == rgb);
+}
+
+TEST_CASE("QOI: header and end marker")
+{
+	uint8_t rgb[3] = { 0, 0, 0 };
+	auto encoded = QOI::encode(rgb, 1, 1);
+	// 14 byte header, 1 run op, 8 byte end marker
+	REQUIRE(encoded.size() == 14 + 1 + 8);
+	CHECK(encoded[0] == 'q'); CHECK(encoded[3] == 'f');
+	CHECK(encoded[7] == 1);  // width
+	CHECK(encoded[11] == 1); // height
+	CHECK(encoded[12] == 3); // RGB
+	CHECK(encoded[14] == 0xc0); // run of 1 (same as initial black)
+	CHECK(encoded[22] == 1);
+}
+
+TEST_CASE("QOI: round trip")
+{
+	// flat areas (runs), small gradients (diff/luma), repeated colors
+	// (index) and noise (full rgb)
+	unsigned width = 320, height = 240;
+	std::vector<uint8_t> rgb(3 * width * height);
+	uint32_t seed = 12345;
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			uint8_t* p = &rgb[3 * (y * width + x)];
+			if (y < 60) {
+				p[0] = 10; p[1] = 20; p[2] = 30;
+			} else if (y < 120) {
+				p[0] = x; p[1] = x + y; p[2] = y;
+			} else if (y < 180) {
+				static const uint8_t pal[4][3] = {
+					{255, 0, 0}, {0, 255, 0}, {0, 0, 255}, {9, 9, 9}
+				};
+				auto& c = pal[(x / 3 + y) % 4];
+				p[0] = c[0]; p[1] = c[1]; p[2] = c[2];
+			} else {
+				seed = seed * 1103515245 + 12345;
+				p[0] = seed >> 24; p[1] = seed >> 16; p[2] = seed >> 8;
+			}
+		}
+	}
+	roundTrip(rgb, width, height);
+
+	// long run crossing the 62 pixel limit, also at the very end
+	std::vector<uint8_t> gray(3 * 200, 128);
+	roundTrip(gray, 100, 2);
+}
+
+TEST_CASE("QOI: invalid data")
+{
+	unsigned w, h;
+	uint8_t junk[30] = { 'P', 'N', 'G' };
+	CHECK_THROWS(QOI::decode(junk, sizeof(junk), w, h));
+
+	uint8_t rgb[3 * 16] = {};
+	rgb[5] = 200;
+	auto encoded = QOI::encode(rgb, 4, 4);
+	CHECK_THROWS(QOI::decode(encoded.data(), 20, w, h));
+}
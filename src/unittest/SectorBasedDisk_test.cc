@@ -0,0 +1,125 @@
+#include "catch.hpp"
+#include "RamDSKDiskImage.hh"
+#include "RawTrack.hh"
+#include "TestUtils.hh"
+#include <chrono>
+#include <cstring>
+
+using namespace openmsx;
+
+static void fillDisk(Disk& disk)
+{
+	SectorBuffer buf;
+	for (size_t s = 0; s < disk.getNbSectors(); ++s) {
+		fillSector(buf, s, 0);
+		disk.writeSector(s, buf);
+	}
+}
+
+static void checkTrack(const RawTrack& track, Disk& disk,
+                       size_t firstSector)
+{
+	auto sectors = track.decodeAll();
+	REQUIRE(sectors.size() == 9);
+	for (unsigned i = 0; i < 9; ++i) {
+		auto& s = sectors[i];
+		CHECK(s.sector == i + 1);
+		CHECK(!s.addrCrcErr);
+		CHECK(!s.dataCrcErr);
+		SectorBuffer expected, actual;
+		disk.readSector(firstSector + i, expected);
+		track.readBlock(s.dataIdx, 512, actual.raw);
+		CHECK(memcmp(expected.raw, actual.raw, 512) == 0);
+	}
+}
+
+TEST_CASE("SectorBasedDisk: track cache")
+{
+	RamDSKDiskImage image; // 720kB: 80 tracks, 2 sides, 9 sectors
+	Disk& disk = image;
+	fillDisk(disk);
+
+	RawTrack track0, track1;
+	disk.readTrack(0, 0, track0);
+	disk.readTrack(0, 1, track1);
+	checkTrack(track0, disk, 0);
+	checkTrack(track1, disk, 9);
+	CHECK(track0.getIdamBuffer().size() == 9);
+
+	// Writing a sector only changes the track it's on.
+	SectorBuffer buf;
+	fillSector(buf, 12, 1);
+	disk.writeSector(12, buf);
+	RawTrack track0b, track1b;
+	disk.readTrack(0, 0, track0b);
+	disk.readTrack(0, 1, track1b);
+	CHECK(memcmp(track0.getRawBuffer(), track0b.getRawBuffer(),
+	             RawTrack::STANDARD_SIZE) == 0);
+	CHECK(memcmp(track1.getRawBuffer(), track1b.getRawBuffer(),
+	             RawTrack::STANDARD_SIZE) != 0);
+	checkTrack(track1b, disk, 9);
+
+	// Tracks beyond the end of the disk are empty.
+	RawTrack track80;
+	disk.readTrack(80, 0, track80);
+	CHECK(track80.decodeAll().empty());
+}
+
+TEST_CASE("SectorBasedDisk: write track")
+{
+	RamDSKDiskImage image;
+	Disk& disk = image;
+	fillDisk(disk);
+
+	// Modify the 4th sector (logical sector 2 * 9 + 3) of track 1, side 0.
+	RawTrack track;
+	disk.readTrack(1, 0, track);
+	auto sectors = track.decodeAll();
+	REQUIRE(sectors.size() == 9);
+	SectorBuffer buf;
+	fillSector(buf, 21, 5);
+	memcpy(track.getRawBuffer() + sectors[3].dataIdx, buf.raw, 512);
+	disk.writeTrack(1, 0, track);
+
+	SectorBuffer actual;
+	disk.readSector(21, actual);
+	CHECK(checkSector(actual, 21, 5));
+	disk.readSector(22, actual);
+	CHECK(checkSector(actual, 22, 0));
+
+	// The re-synthesized track has a correct CRC again.
+	RawTrack track2;
+	disk.readTrack(1, 0, track2);
+	checkTrack(track2, disk, 18);
+}
+
+// Not run by default, select it explicitly with the "[benchmark]" tag.
+TEST_CASE("SectorBasedDisk: read/write track benchmark", "[.][benchmark]")
+{
+	RamDSKDiskImage image;
+	Disk& disk = image;
+	fillDisk(disk);
+
+	// Like a RealDrive: read all tracks (a few times each), and write one
+	// sector every other track.
+	RawTrack track;
+	SectorBuffer buf;
+	const int ROUNDS = 100;
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (byte t = 0; t < 80; ++t) {
+			for (byte side = 0; side < 2; ++side) {
+				for (int i = 0; i < 4; ++i) disk.readTrack(t, side, track);
+				if (t & 1) {
+					track.write(track.getIdamBuffer()[2] + 100, byte(round));
+					disk.writeTrack(t, side, track);
+				}
+			}
+		}
+		fillSector(buf, round, 0);
+		disk.writeSector(round, buf);
+	}
+	auto stop = std::chrono::steady_clock::now();
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+	WARN("read/write cycle: " << double(us) / (ROUNDS * 160) << "us per track");
+}
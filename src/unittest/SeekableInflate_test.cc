@@ -0,0 +1,113 @@
+#include "catch.hpp"
+#include "SeekableInflate.hh"
+#include "FileException.hh"
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+using namespace openmsx;
+
+// Compressible, but not trivially so.
+static std::vector<byte> makeData(size_t size)
+{
+	std::vector<byte> result(size);
+	unsigned x = 12345;
+	for (size_t i = 0; i < size; ++i) {
+		x = x * 1103515245 + 12345;
+		result[i] = byte((x >> 16) & 0x0f) + byte(i >> 12);
+	}
+	return result;
+}
+
+static std::vector<byte> rawDeflate(const std::vector<byte>& input)
+{
+	z_stream s;
+	memset(&s, 0, sizeof(s));
+	deflateInit2(&s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+	             Z_DEFAULT_STRATEGY);
+	std::vector<byte> result(deflateBound(&s, uLong(input.size())));
+	s.next_in = const_cast<byte*>(input.data());
+	s.avail_in = uInt(input.size());
+	s.next_out = result.data();
+	s.avail_out = uInt(result.size());
+	int err = deflate(&s, Z_FINISH);
+	CHECK(err == Z_STREAM_END);
+	result.resize(s.total_out);
+	deflateEnd(&s);
+	return result;
+}
+
+static void checkRead(SeekableInflate& inflate, const std::vector<byte>& orig,
+                      size_t pos, size_t num)
+{
+	std::vector<byte> buf(num);
+	inflate.read(pos, buf.data(), num);
+	CHECK(memcmp(buf.data(), orig.data() + pos, num) == 0);
+}
+
+TEST_CASE("SeekableInflate")
+{
+	auto orig = makeData(1000000);
+	auto compressed = rawDeflate(orig);
+	static const size_t SPAN = 65536;
+
+	SECTION("sequential") {
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		for (size_t pos = 0; pos < orig.size(); pos += 10000) {
+			checkRead(inflate, orig, pos, 10000);
+		}
+		CHECK(inflate.getSize() == orig.size());
+	}
+	SECTION("random access") {
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		checkRead(inflate, orig, 900000, 1000);   // far ahead first
+		checkRead(inflate, orig, 10, 20);         // back to the start
+		checkRead(inflate, orig, 500000, 200000); // spans several chunks
+		checkRead(inflate, orig, 999999, 1);      // last byte
+		checkRead(inflate, orig, 123456, 7);
+		checkRead(inflate, orig, 0, orig.size()); // everything
+	}
+	SECTION("size") {
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		CHECK(inflate.getSize() == orig.size());
+		checkRead(inflate, orig, 654321, 4321);
+	}
+	SECTION("size set upfront") {
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		inflate.setSize(orig.size());
+		CHECK(inflate.getSize() == orig.size());
+		checkRead(inflate, orig, 777777, 22222);
+	}
+	SECTION("read beyond end") {
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		byte buf[16];
+		CHECK_THROWS_AS(inflate.read(orig.size() - 8, buf, 16), FileException);
+		inflate.getSize();
+		CHECK_THROWS_AS(inflate.read(orig.size(), buf, 1), FileException);
+	}
+	SECTION("concurrent readers") {
+		// E.g. the main thread and the harddisk sector cache thread.
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		auto reader = [&](size_t start, bool& ok) {
+			std::vector<byte> buf(5000);
+			ok = true;
+			for (size_t pos = start; pos < orig.size(); pos += 50000) {
+				size_t num = std::min(buf.size(), orig.size() - pos);
+				inflate.read(pos, buf.data(), num);
+				ok &= memcmp(buf.data(), orig.data() + pos, num) == 0;
+			}
+		};
+		bool ok1, ok2;
+		std::thread t([&]() { reader(0, ok1); });
+		reader(25000, ok2);
+		t.join();
+		CHECK(ok1);
+		CHECK(ok2);
+	}
+	SECTION("corrupt input") {
+		compressed.resize(compressed.size() / 2);
+		SeekableInflate inflate(compressed.data(), compressed.size(), SPAN, 2);
+		CHECK_THROWS_AS(inflate.getSize(), FileException);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef TESTUTILS_HH
+#define TESTUTILS_HH
+
+// Helpers shared by several unittests.
+
+#include "catch.hpp"
+#include "DiskImageUtils.hh"
+#include "FileOperations.hh"
+#include <cstring>
+#include <string>
+
+namespace openmsx {
+
+/** Fill a sector with a pattern that depends on the sector number, so that
+  * data that ends up in the wrong sector is detected as well. 'v' allows to
+  * distinguish different versions of the same sector.
+  */
+inline void fillSector(SectorBuffer& buf, size_t sector, byte v)
+{
+	for (unsigned i = 0; i < sizeof(buf.raw); ++i) {
+		buf.raw[i] = byte(sector * 7 + i + v);
+	}
+}
+
+/** Does 'buf' contain the pattern written by fillSector()? */
+inline bool checkSector(const SectorBuffer& buf, size_t sector, byte v)
+{
+	SectorBuffer expected;
+	fillSector(expected, sector, v);
+	return memcmp(buf.raw, expected.raw, sizeof(buf.raw)) == 0;
+}
+
+/** A new (empty) file in the temp directory, removed again when this
+  * object is destroyed. Close the file before that.
+  */
+class TempFile
+{
+public:
+	TempFile()
+	{
+		auto fp = FileOperations::openUniqueFile(
+			FileOperations::getTempDir(), name);
+		REQUIRE(fp);
+	}
+	~TempFile()
+	{
+		FileOperations::unlink(name);
+	}
+	TempFile(const TempFile&) = delete;
+	TempFile& operator=(const TempFile&) = delete;
+
+	const std::string& getName() const { return name; }
+
+private:
+	std::string name;
+};
+
+} // namespace openmsx
+
+#endif
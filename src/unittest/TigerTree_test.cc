@@ -1,6 +1,8 @@
 #include "catch.hpp"
 #include "TigerTree.hh"
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
 using namespace openmsx;
 
@@ -77,4 +79,42 @@ TEST_CASE("TigerTree")
 		CHECK(tt.calcHash(dummyCallback).toString() ==
 		       "SJUYB3QVIJXNKZMSQZGIMHA7GA2MYU2UECDA26A");
 	}
+	SECTION("many blocks (batched leaf calculation)") {
+		size_t size = 3 * 1024 * 1024 + 300;
+		std::vector<uint8_t> big(size + 1);
+		for (size_t i = 0; i < size; ++i) {
+			big[i + 1] = uint8_t(i * 7 + (i >> 10));
+		}
+		TTTestData bigData;
+		bigData.buffer = big.data() + 1;
+		TigerTree tt(bigData, size, dummyName);
+		std::string expected = "K2U4YVA63XB5UO5GVOPT7SM4KQ4RHANOJF7DX4A";
+		CHECK(tt.calcHash(dummyCallback).toString() == expected);
+		// a small change goes through the non-batched path
+		big[1 + 5000] ^= 0xff;
+		tt.notifyChange(5000, 1, dummyTime);
+		CHECK(tt.calcHash(dummyCallback).toString() != expected);
+		big[1 + 5000] ^= 0xff;
+		tt.notifyChange(5000, 1, dummyTime);
+		CHECK(tt.calcHash(dummyCallback).toString() == expected);
+	}
+	SECTION("several batches") {
+		size_t size = 9 * 1024 * 1024 + 300;
+		std::vector<uint8_t> big(size + 1);
+		for (size_t i = 0; i < size; ++i) {
+			big[i + 1] = uint8_t(i * 13 + (i >> 10));
+		}
+		TTTestData bigData;
+		bigData.buffer = big.data() + 1;
+		TigerTree tt(bigData, size, dummyName);
+		std::string batched = tt.calcHash(dummyCallback).toString();
+		// Recalculate all leaves again, but in parts that are small
+		// enough to go through the non-batched path.
+		size_t part = 256 * 1024;
+		for (size_t offset = 0; offset < size; offset += part) {
+			tt.notifyChange(offset, std::min(part, size - offset), dummyTime);
+			tt.calcHash(dummyCallback);
+		}
+		CHECK(tt.calcHash(dummyCallback).toString() == batched);
+	}
 }
@@ -0,0 +1,152 @@
+#include "catch.hpp"
+#include "WavStream.hh"
+#include "File.hh"
+#include "Filename.hh"
+#include "Math.hh"
+#include "TestUtils.hh"
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+
+static void put16(std::vector<uint8_t>& v, unsigned x)
+{
+	v.push_back(x & 0xFF);
+	v.push_back((x >> 8) & 0xFF);
+}
+static void put32(std::vector<uint8_t>& v, unsigned x)
+{
+	put16(v, x & 0xFFFF);
+	put16(v, x >> 16);
+}
+
+// Write a .wav file, returns its name.
+static Filename writeWav(const TempFile& tmp, unsigned tag, unsigned channels,
+                         unsigned bits, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> wav;
+	for (char c : std::string("RIFF")) wav.push_back(c);
+	put32(wav, unsigned(4 + 8 + 16 + 8 + 4 + 8 + data.size()));
+	for (char c : std::string("WAVEfmt ")) wav.push_back(c);
+	put32(wav, 16);
+	put16(wav, tag);
+	put16(wav, channels);
+	put32(wav, 22050);
+	put32(wav, 22050 * channels * bits / 8);
+	put16(wav, channels * bits / 8);
+	put16(wav, bits);
+	// an unknown chunk, with odd size (so with a padding byte)
+	for (char c : std::string("junk")) wav.push_back(c);
+	put32(wav, 3);
+	wav.insert(wav.end(), { 1, 2, 3, 0 });
+	for (char c : std::string("data")) wav.push_back(c);
+	put32(wav, unsigned(data.size()));
+	wav.insert(wav.end(), data.begin(), data.end());
+
+	File file(tmp.getName(), File::TRUNCATE);
+	file.write(wav.data(), wav.size());
+	return Filename(tmp.getName());
+}
+
+// Like WavImage used to do: DC-removal over the whole signal at once.
+static std::vector<int> filterAll(const std::vector<int>& in)
+{
+	float R = 1.0f - ((float(2 * M_PI) * 800.0f) / 22050);
+	std::vector<int> out;
+	float t0 = 0.0f;
+	for (int x : in) {
+		float t1 = R * t0 + x;
+		out.push_back(Math::clipIntToShort(t1 - t0));
+		t0 = t1;
+	}
+	return out;
+}
+
+TEST_CASE("WavStream: 16-bit stereo")
+{
+	const size_t NUM = 50000;
+	std::vector<uint8_t> data;
+	std::vector<int> mono;
+	for (size_t i = 0; i < NUM; ++i) {
+		int l = int(10000 * sin(i * 0.05)) + 3000;  // with DC offset
+		int r = int( 6000 * sin(i * 0.11)) + 3000;
+		put16(data, unsigned(l) & 0xFFFF);
+		put16(data, unsigned(r) & 0xFFFF);
+		mono.push_back((l + r) / 2);
+	}
+	TempFile tmp;
+	{
+		WavStream stream{writeWav(tmp, 1, 2, 16, data)};
+		CHECK(stream.isStreaming());
+		CHECK(stream.getFreq() == 22050);
+		CHECK(stream.getSize() == NUM);
+		CHECK(stream.getNbBlocks() == 7);
+
+		// (Practically) the same as filtering everything in one go.
+		auto expected = filterAll(mono);
+		int maxDiff = 0;
+		for (size_t i = 0; i < NUM; ++i) {
+			maxDiff = std::max(maxDiff, std::abs(stream.getSample(i) - expected[i]));
+		}
+		CHECK(maxDiff <= 1);
+		CHECK(stream.getSample(0) == expected[0]);
+
+		// The same result for any access order.
+		std::vector<int16_t> block(WavStream::BLOCK_SIZE);
+		CHECK(stream.convertBlock(6, block.data()) == (NUM - 6 * WavStream::BLOCK_SIZE));
+		bool ok = true;
+		for (size_t i = 0; i < (NUM - 6 * WavStream::BLOCK_SIZE); i += 7) {
+			ok &= stream.getSample(6 * WavStream::BLOCK_SIZE + i) == block[i];
+		}
+		stream.convertBlock(2, block.data());
+		std::vector<int> samples(WavStream::BLOCK_SIZE + 10);
+		stream.getSamples(2 * WavStream::BLOCK_SIZE, samples.size(), samples.data());
+		for (size_t i = 0; i < WavStream::BLOCK_SIZE; ++i) {
+			ok &= samples[i] == block[i];
+		}
+		CHECK(ok);
+
+		// beyond the end
+		CHECK(stream.getSample(NUM) == 0);
+		stream.getSamples(NUM - 2, 4, samples.data());
+		CHECK(samples[2] == 0);
+		CHECK(samples[3] == 0);
+	}
+}
+
+TEST_CASE("WavStream: other formats")
+{
+	std::vector<uint8_t> u8, f32, nan;
+	for (int i = 0; i < 100; ++i) {
+		u8.push_back(uint8_t(128 + ((i & 1) ? 100 : -100)));
+		float f = (i & 1) ? 0.5f : -0.5f;
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		put32(f32, u);
+		f = std::nanf("");
+		memcpy(&u, &f, sizeof(u));
+		put32(nan, u);
+	}
+	TempFile tmp8, tmpF, tmpN;
+	{
+		WavStream s8{writeWav(tmp8, 1, 1, 8, u8)};
+		WavStream sF{writeWav(tmpF, 3, 1, 32, f32)};
+		WavStream sN{writeWav(tmpN, 3, 1, 32, nan)};
+		CHECK(s8.isStreaming());
+		CHECK(sF.isStreaming());
+		CHECK(s8.getSize() == 100);
+		CHECK(sF.getSize() == 100);
+		CHECK(s8.getSample(0) == (-100 * 256));
+		CHECK(sF.getSample(0) == -16384);
+		for (size_t i = 1; i < 100; ++i) {
+			CHECK((s8.getSample(i) > 0) == bool(i & 1));
+			CHECK((sF.getSample(i) > 0) == bool(i & 1));
+		}
+		// NaN is treated as silence
+		for (size_t i = 0; i < 100; ++i) {
+			CHECK(sN.getSample(i) == 0);
+		}
+	}
+}
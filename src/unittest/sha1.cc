@@ -1,6 +1,7 @@
 #include "catch.hpp"
 #include "sha1.hh"
 #include <sstream>
+#include <string>
 
 using namespace openmsx;
 
@@ -130,4 +131,11 @@ TEST_CASE("sha1: update,digest")
 		Sha1Sum sum = sha1.digest();
 		CHECK(sum.toString() == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
 	}
+	SECTION("many blocks at once") {
+		std::string in(1000000, 'a');
+		sha1.update(reinterpret_cast<const uint8_t*>(in.data()), 1);
+		sha1.update(reinterpret_cast<const uint8_t*>(in.data()), in.size() - 1);
+		Sha1Sum sum = sha1.digest();
+		CHECK(sum.toString() == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+	}
 }
@@ -0,0 +1,123 @@
+#include "catch.hpp"
+#include "components.hh"
+
+#if COMPONENT_LASERDISC
+
+#include "yuv2rgb.hh"
+#include "MemBuffer.hh"
+#include <SDL.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace openmsx;
+using namespace openmsx::yuv2rgb;
+
+static const int WIDTH = 64;
+static const int HEIGHT = 8;
+
+// A fixed frame that covers the full range of the inputs, including values
+// outside the nominal [16, 235] and [16, 240] ranges.
+struct TestFrame
+{
+	TestFrame()
+		: y(WIDTH * HEIGHT), u(WIDTH * HEIGHT / 4), v(WIDTH * HEIGHT / 4)
+	{
+		for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+			y[i] = uint8_t(i * 37 + (i >> 6));
+		}
+		for (int i = 0; i < WIDTH * HEIGHT / 4; ++i) {
+			u[i] = uint8_t(i * 11);
+			v[i] = uint8_t(255 - i * 7);
+		}
+		buffer[0] = {WIDTH,     HEIGHT,     WIDTH,     y.data()};
+		buffer[1] = {WIDTH / 2, HEIGHT / 2, WIDTH / 2, u.data()};
+		buffer[2] = {WIDTH / 2, HEIGHT / 2, WIDTH / 2, v.data()};
+	}
+
+	MemBuffer<uint8_t, 32> y, u, v;
+	th_ycbcr_buffer buffer;
+};
+
+static SDL_PixelFormat getFormat(int bpp)
+{
+	SDL_PixelFormat format = {};
+	format.BitsPerPixel = bpp;
+	format.BytesPerPixel = bpp / 8;
+	if (bpp == 32) {
+		format.Rshift = 16; format.Gshift = 8; format.Bshift = 0;
+		format.Rmask = 0xFF0000; format.Gmask = 0x00FF00; format.Bmask = 0x0000FF;
+	} else {
+		// RGB565
+		format.Rloss = 3; format.Gloss = 2; format.Bloss = 3;
+		format.Rshift = 11; format.Gshift = 5; format.Bshift = 0;
+		format.Rmask = 0xF800; format.Gmask = 0x07E0; format.Bmask = 0x001F;
+	}
+	return format;
+}
+
+template<typename Pixel>
+static void convertFrame(Impl impl, const TestFrame& frame, int bpp,
+                         MemBuffer<Pixel, 32>& out)
+{
+	auto format = getFormat(bpp);
+	out.resize(WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; y += 2) {
+		convertLinePair(impl, frame.buffer, y,
+		                &out[(y + 0) * WIDTH], &out[(y + 1) * WIDTH],
+		                format);
+	}
+}
+
+static int component(uint32_t p, int shift) { return (p >> shift) & 0xFF; }
+
+TEST_CASE("yuv2rgb")
+{
+	TestFrame frame;
+
+	MemBuffer<uint32_t, 32> scalar32;
+	MemBuffer<uint16_t, 32> scalar16;
+	convertFrame(Impl::SCALAR, frame, 32, scalar32);
+	convertFrame(Impl::SCALAR, frame, 16, scalar16);
+
+	// scalar 16bpp is scalar 32bpp with the lower bits dropped
+	for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+		uint32_t p = scalar32[i];
+		uint16_t expected = ((component(p, 16) >> 3) << 11) |
+		                    ((component(p,  8) >> 2) <<  5) |
+		                    ((component(p,  0) >> 3) <<  0);
+		CHECK(scalar16[i] == expected);
+	}
+
+	if (!isAvailable(Impl::SSE2)) return;
+	MemBuffer<uint32_t, 32> sse32;
+	convertFrame(Impl::SSE2, frame, 32, sse32);
+	// SSE2 has a lower precision, see yuv2rgb.hh
+	int maxDiff = 0;
+	for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+		for (int shift : {16, 8, 0}) {
+			int diff = std::abs(component(sse32[i], shift) -
+			                    component(scalar32[i], shift));
+			maxDiff = std::max(maxDiff, diff);
+		}
+	}
+	CHECK(maxDiff <= 3);
+
+	if (!isAvailable(Impl::AVX2)) return;
+	MemBuffer<uint32_t, 32> avx32;
+	MemBuffer<uint16_t, 32> avx16;
+	convertFrame(Impl::AVX2, frame, 32, avx32);
+	convertFrame(Impl::AVX2, frame, 16, avx16);
+	for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+		// exactly the same as SSE2 ...
+		CHECK(avx32[i] == sse32[i]);
+		// ... also when packed to 16bpp
+		uint32_t p = sse32[i];
+		uint16_t expected = ((component(p, 16) >> 3) << 11) |
+		                    ((component(p,  8) >> 2) <<  5) |
+		                    ((component(p,  0) >> 3) <<  0);
+		CHECK(avx16[i] == expected);
+	}
+}
+
+#endif // COMPONENT_LASERDISC
@@ -0,0 +1,91 @@
+#ifndef MPSCQUEUE_HH
+#define MPSCQUEUE_HH
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/** Bounded lock-free queue for multiple producers and a single consumer.
+  *
+  * This is Dmitry Vyukov's bounded queue: each cell has a sequence number
+  * that tells whether it's ready to be written (for a certain round of the
+  * ring) or to be read. Producers claim a cell with a compare-and-swap on
+  * the tail index, the single consumer doesn't need atomic read-modify-write
+  * operations at all.
+  *
+  * push() fails (instead of blocking) when the queue is full.
+  */
+template<typename T> class MPSCQueue
+{
+public:
+	/** @param capacity Must be a power of 2. */
+	explicit MPSCQueue(size_t capacity)
+		: cells(new Cell[capacity])
+		, mask(capacity - 1)
+		, tail(0)
+		, head(0)
+	{
+		assert(capacity && ((capacity & mask) == 0));
+		for (size_t i = 0; i < capacity; ++i) {
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	/** Can be called from any thread.
+	  * @return false when the queue is full. */
+	template<typename U> bool push(U&& value)
+	{
+		auto pos = tail.load(std::memory_order_relaxed);
+		while (true) {
+			auto& cell = cells[pos & mask];
+			auto seq = cell.seq.load(std::memory_order_acquire);
+			auto diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+			if (diff == 0) {
+				if (tail.compare_exchange_weak(
+						pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = std::forward<U>(value);
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+				// 'pos' was updated, retry
+			} else if (diff < 0) {
+				return false; // full
+			} else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/** May only be called from the (single) consumer thread.
+	  * @return false when the queue is empty (or the oldest element is
+	  *         still being written). */
+	bool pop(T& result)
+	{
+		auto& cell = cells[head & mask];
+		auto seq = cell.seq.load(std::memory_order_acquire);
+		if (ptrdiff_t(seq) - ptrdiff_t(head + 1) < 0) return false;
+		result = std::move(cell.value);
+		cell.value = T();
+		cell.seq.store(head + mask + 1, std::memory_order_release);
+		++head;
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> seq;
+		T value;
+	};
+	std::unique_ptr<Cell[]> cells;
+	const size_t mask;
+	// Keep producer and consumer data on different cache lines. (Padding
+	// instead of alignas(), because this class is allocated with 'new'.)
+	char pad1[64];
+	std::atomic<size_t> tail; // next position to write
+	char pad2[64];
+	size_t head;              // next position to read
+};
+
+#endif
@@ -1,6 +1,11 @@
 #include "TigerTree.hh"
 #include "Math.hh"
+#include <algorithm>
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <cstring>
 #include <cassert>
 
@@ -8,6 +13,16 @@ namespace openmsx {
 
 static const size_t BLOCK_SIZE = 1024;
 
+// Hashing the leaf nodes is by far the most expensive part of a (first-time)
+// tiger-tree calculation. When many leaves need to be (re)calculated, their
+// data is fetched in batches and each batch is hashed on all available cores.
+static const size_t BATCH_LEAVES = 4096; // 4MB per batch
+static const size_t MIN_PARALLEL_NODES = 1024;
+// tiger_leaf() starts hashing at the (scratch) byte right before the block.
+// So each block starts at offset 1 in its slot in the batch buffer. The
+// slots are a multiple of 8 bytes, so the hashed data is 8-byte aligned.
+static const size_t BATCH_STRIDE = BLOCK_SIZE + 8;
+
 struct TTCacheEntry
 {
 	MemBuffer<TigerHash> hash;
@@ -42,6 +57,74 @@ static TTCacheEntry& getCacheEntry(
 	return result;
 }
 
+// Runs the same job on a fixed set of helper threads (and on the calling
+// thread), as often as needed. The threads are only created once, not for
+// each batch of leaves.
+class WorkerPool
+{
+public:
+	/** job(0) runs on the thread that calls run(), job(1)..job(numWorkers)
+	  * each run on their own helper thread. */
+	WorkerPool(unsigned numWorkers, std::function<void(unsigned)> job_)
+		: job(std::move(job_))
+	{
+		for (unsigned i = 1; i <= numWorkers; ++i) {
+			threads.emplace_back([this, i] { work(i); });
+		}
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		startCond.notify_all();
+		for (auto& t : threads) t.join();
+	}
+
+	/** Run the job once on all threads, returns when all are finished. */
+	void run()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy = unsigned(threads.size());
+			++generation;
+		}
+		startCond.notify_all();
+		job(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCond.wait(lock, [&] { return busy == 0; });
+	}
+
+private:
+	void work(unsigned id)
+	{
+		unsigned done = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				startCond.wait(lock, [&] {
+					return stop || (generation != done); });
+				if (stop) return;
+				done = generation;
+			}
+			job(id);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy == 0) doneCond.notify_one();
+		}
+	}
+
+	const std::function<void(unsigned)> job;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startCond;
+	std::condition_variable doneCond;
+	unsigned generation = 0;
+	unsigned busy = 0;
+	bool stop = false;
+};
+
 TigerTree::TigerTree(TTData& data_, size_t dataSize_, const std::string& name)
 	: data(data_)
 	, dataSize(dataSize_)
@@ -51,9 +134,61 @@ TigerTree::TigerTree(TTData& data_, size_t dataSize_, const std::string& name)
 
 const TigerHash& TigerTree::calcHash(const std::function<void(size_t, size_t)>& progressCallback)
 {
+	if ((entry.numNodes - entry.numNodesValid) >= MIN_PARALLEL_NODES) {
+		calcLeavesParallel(progressCallback);
+	}
 	return calcHash(getTop(), progressCallback);
 }
 
+void TigerTree::calcLeavesParallel(const std::function<void(size_t, size_t)>& progressCallback)
+{
+	// Only full blocks, a partial last block (if any) and the interior
+	// nodes are handled by the regular (recursive) calculation.
+	size_t numFullBlocks = dataSize / BLOCK_SIZE;
+	unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	MemBuffer<uint8_t> buf(BATCH_LEAVES * BATCH_STRIDE);
+	std::vector<size_t> todo;
+	todo.reserve(BATCH_LEAVES);
+
+	// Thread 'i' hashes the i-th slice of the current batch.
+	size_t num = 0;
+	size_t perThread = 0;
+	WorkerPool pool(numThreads - 1, [&](unsigned i) {
+		size_t first = i * perThread;
+		size_t last = std::min(first + perThread, num);
+		for (size_t j = first; j < last; ++j) {
+			tiger_leaf(&buf[j * BATCH_STRIDE + 1], entry.hash[todo[j]]);
+		}
+	});
+
+	size_t block = 0;
+	while (block < numFullBlocks) {
+		// Fetching the data is done on this thread, TTData is not
+		// required to be thread-safe.
+		todo.clear();
+		for (/**/; (block < numFullBlocks) && (todo.size() < BATCH_LEAVES); ++block) {
+			auto n = getLeaf(block).n;
+			if (entry.valid[n]) continue;
+			memcpy(&buf[todo.size() * BATCH_STRIDE + 1],
+			       data.getData(block * BLOCK_SIZE, BLOCK_SIZE),
+			       BLOCK_SIZE);
+			todo.push_back(n);
+		}
+		if (todo.empty()) continue;
+
+		num = todo.size();
+		perThread = (num + numThreads - 1) / numThreads;
+		pool.run();
+
+		for (auto n : todo) entry.valid[n] = true;
+		entry.numNodesValid += num;
+		if (progressCallback) {
+			progressCallback(entry.numNodesValid, entry.numNodes);
+		}
+	}
+}
+
 void TigerTree::notifyChange(size_t offset, size_t len, time_t time)
 {
 	entry.time = time;
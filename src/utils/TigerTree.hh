@@ -102,6 +102,7 @@ private:
 	Node getRightChild(Node node) const;
 
 	const TigerHash& calcHash(Node node, const std::function<void(size_t, size_t)>& progressCallback);
+	void calcLeavesParallel(const std::function<void(size_t, size_t)>& progressCallback);
 
 	TTData& data;
 	const size_t dataSize;
@@ -22,11 +22,19 @@ A million repetitions of "a"
 #include "MSXException.hh"
 #include "endian.hh"
 #include "likely.hh"
+#include "build-info.hh"
 #include <cassert>
 #include <cstring>
 #ifdef __SSE2__
 #include <emmintrin.h> // SSE2
 #endif
+#if ASM_X86 && defined(__GNUC__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA1_HAVE_SHANI 1
+#else
+#define SHA1_HAVE_SHANI 0
+#endif
 
 using std::string;
 
@@ -268,16 +276,16 @@ SHA1::SHA1()
 	m_finalized = false;
 }
 
-void SHA1::transform(const uint8_t buffer[64])
+static void transformBlockScalar(uint32_t state[5], const uint8_t buffer[64])
 {
 	WorkspaceBlock block(buffer);
 
-	// Copy m_state[] to working vars
-	uint32_t a = m_state.a[0];
-	uint32_t b = m_state.a[1];
-	uint32_t c = m_state.a[2];
-	uint32_t d = m_state.a[3];
-	uint32_t e = m_state.a[4];
+	// Copy state[] to working vars
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
 
 	// 4 rounds of 20 operations each. Loop unrolled
 	block.r0(a,b,c,d,e, 0); block.r0(e,a,b,c,d, 1); block.r0(d,e,a,b,c, 2);
@@ -308,12 +316,131 @@ void SHA1::transform(const uint8_t buffer[64])
 	block.r4(a,b,c,d,e,75); block.r4(e,a,b,c,d,76); block.r4(d,e,a,b,c,77);
 	block.r4(c,d,e,a,b,78); block.r4(b,c,d,e,a,79);
 
-	// Add the working vars back into m_state[]
-	m_state.a[0] += a;
-	m_state.a[1] += b;
-	m_state.a[2] += c;
-	m_state.a[3] += d;
-	m_state.a[4] += e;
+	// Add the working vars back into state[]
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+static void transformScalar(uint32_t state[5], const uint8_t* data, size_t numBlocks)
+{
+	for (size_t i = 0; i < numBlocks; ++i) {
+		transformBlockScalar(state, data + 64 * i);
+	}
+}
+
+#if SHA1_HAVE_SHANI
+// Implementation using the Intel SHA extensions. Based on the (public domain)
+// description in the Intel whitepaper "New Instructions Supporting the Secure
+// Hash Algorithm on Intel Architecture Processors".
+//
+// Each step performs 4 of the 80 SHA-1 rounds. The message schedule for the
+// next steps is calculated interleaved with the rounds. The 'S' template
+// parameter is the step number (0-19), the conditions on it are evaluated at
+// compile time.
+template<int S>
+__attribute__((target("sha,sse4.1"))) static inline void shaNiStep(
+	__m128i& abcd, __m128i& e0, __m128i& e1,
+	__m128i& m0, __m128i& m1, __m128i& m2, __m128i& m3)
+{
+	// rotate roles: in step S, 'msg[S % 4]' is the current message
+	// block and 'e0' resp. 'e1' alternate
+	__m128i* msg[4] = { &m0, &m1, &m2, &m3 };
+	__m128i& cur  = *msg[(S + 0) % 4];
+	__m128i& next = *msg[(S + 1) % 4];
+	__m128i& nxt2 = *msg[(S + 2) % 4];
+	__m128i& prev = *msg[(S + 3) % 4];
+	__m128i& e    = (S & 1) ? e1 : e0;
+	__m128i& eo   = (S & 1) ? e0 : e1;
+
+	e = (S == 0) ? _mm_add_epi32(e, cur) : _mm_sha1nexte_epu32(e, cur);
+	eo = abcd;
+	if ((3 <= S) && (S <= 18)) next = _mm_sha1msg2_epu32(next, cur);
+	abcd = _mm_sha1rnds4_epu32(abcd, e, S / 5);
+	if ((1 <= S) && (S <= 16)) prev = _mm_sha1msg1_epu32(prev, cur);
+	if ((2 <= S) && (S <= 17)) nxt2 = _mm_xor_si128(nxt2, cur);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void transformShaNi(uint32_t state[5], const uint8_t* data, size_t numBlocks)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	__m128i abcd = _mm_shuffle_epi32(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+	__m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+	__m128i e1;
+
+	for (size_t i = 0; i < numBlocks; ++i, data += 64) {
+		__m128i abcdSave = abcd;
+		__m128i e0Save = e0;
+
+		auto* p = reinterpret_cast<const __m128i*>(data);
+		__m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(p + 0), MASK);
+		__m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(p + 1), MASK);
+		__m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(p + 2), MASK);
+		__m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(p + 3), MASK);
+
+		shaNiStep< 0>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 1>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 2>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 3>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 4>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 5>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 6>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 7>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 8>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep< 9>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<10>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<11>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<12>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<13>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<14>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<15>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<16>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<17>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<18>(abcd, e0, e1, m0, m1, m2, m3);
+		shaNiStep<19>(abcd, e0, e1, m0, m1, m2, m3);
+
+		// the last step left its result in 'e0'
+		e0 = _mm_sha1nexte_epu32(e0, e0Save);
+		abcd = _mm_add_epi32(abcd, abcdSave);
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+	                 _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+static bool hasShaNi()
+{
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+	bool ssse3  = (ecx & (1 <<  9)) != 0;
+	bool sse4_1 = (ecx & (1 << 19)) != 0;
+	if (!ssse3 || !sse4_1) return false;
+	if (__get_cpuid_max(0, nullptr) < 7) return false;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1 << 29)) != 0; // SHA extensions
+}
+#endif
+
+// Select the fastest implementation supported by the host CPU (once).
+using TransformFunc = void (*)(uint32_t state[5], const uint8_t* data, size_t numBlocks);
+static TransformFunc selectTransform()
+{
+#if SHA1_HAVE_SHANI
+	if (hasShaNi()) return transformShaNi;
+#endif
+	return transformScalar;
+}
+static const TransformFunc transformFunc = selectTransform();
+
+void SHA1::transform(const uint8_t* data, size_t numBlocks)
+{
+	transformFunc(m_state.a, data, numBlocks);
 }
 
 // Use this function to hash in binary data and strings
@@ -327,10 +454,10 @@ void SHA1::update(const uint8_t* data, size_t len)
 	size_t i;
 	if ((j + len) > 63) {
 		memcpy(&m_buffer[j], data, (i = 64 - j));
-		transform(m_buffer);
-		for (; i + 63 < len; i += 64) {
-			transform(&data[i]);
-		}
+		transform(m_buffer, 1);
+		size_t numBlocks = (len - i) / 64;
+		transform(&data[i], numBlocks);
+		i += 64 * numBlocks;
 		j = 0;
 	} else {
 		i = 0;
@@ -91,7 +91,9 @@ public:
 	static Sha1Sum calc(const uint8_t* data, size_t len);
 
 private:
-	void transform(const uint8_t buffer[64]);
+	/** Process 'numBlocks' consecutive 64-byte blocks. Dispatches at
+	  * runtime to a scalar or a SHA-extensions based implementation. */
+	void transform(const uint8_t* data, size_t numBlocks);
 	void finalize();
 
 	uint64_t m_count;
@@ -95,6 +95,9 @@ template<typename Pixel>
 const void* DeflickerImpl<Pixel>::getLineInfo(
 	unsigned line, unsigned& width, void* buf_, unsigned bufWidth) const
 {
+	for (int i = 0; i < 4; ++i) {
+		lastFrames[i]->generateLine(line);
+	}
 	unsigned width0 = lastFrames[0]->getLineWidthDirect(line);
 	unsigned width1 = lastFrames[1]->getLineWidthDirect(line);
 	unsigned width2 = lastFrames[2]->getLineWidthDirect(line);
@@ -14,11 +14,13 @@
 #include "IntegerSetting.hh"
 #include "EnumSetting.hh"
 #include "Reactor.hh"
+#include "GlobalSettings.hh"
 #include "MSXMotherBoard.hh"
 #include "HardwareConfig.hh"
 #include "XMLElement.hh"
 #include "VideoSystemChangeListener.hh"
 #include "CommandException.hh"
+#include "Profiler.hh"
 #include "StringOp.hh"
 #include "Version.hh"
 #include "build-info.hh"
@@ -36,6 +38,8 @@ namespace openmsx {
 
 Display::Display(Reactor& reactor_)
 	: RTSchedulable(reactor_.getRTScheduler())
+	, screenShotSaver(reactor_.getCommandController(),
+	                  reactor_.getEventDistributor())
 	, screenShotCmd(reactor_.getCommandController())
 	, fpsInfo(reactor_.getOpenMSXInfoCommand())
 	, osdGui(reactor_.getCommandController(), *this)
@@ -45,6 +49,7 @@ Display::Display(Reactor& reactor_)
 	                 reactor.getEventDistributor(), *this)
 	, currentRenderer(RenderSettings::UNINITIALIZED)
 	, resolution(-1, -1)
+	, frameRequests(0)
 	, switchInProgress(false)
 {
 	frameDurationSum = 0;
@@ -178,6 +183,7 @@ int Display::signalEvent(const std::shared_ptr<const Event>& event)
 		auto& ffe = checked_cast<const FinishFrameEvent&>(*event);
 		if (ffe.needRender()) {
 			repaint();
+			takePendingScreenShots();
 			reactor.getEventDistributor().distributeEvent(
 				std::make_shared<SimpleEvent>(
 					OPENMSX_FRAME_DRAWN_EVENT));
@@ -353,6 +359,7 @@ void Display::repaint(OutputSurface& surface)
 {
 	for (auto it = baseLayer(); it != end(layers); ++it) {
 		if ((*it)->getCoverage() != Layer::COVER_NONE) {
+			ProfileScope scope(typeid(**it));
 			(*it)->paint(surface);
 		}
 	}
@@ -390,6 +397,56 @@ void Display::updateZ(Layer& layer)
 }
 
 
+void Display::takeScreenShot(const string& filename, bool raw,
+                             bool doubleSize, bool withOsd)
+{
+	if (!raw) {
+		// include all layers (OSD stuff, console)
+		try {
+			getVideoSystem().takeScreenShot(filename, withOsd);
+		} catch (MSXException& e) {
+			throw CommandException(
+				"Failed to take screenshot: ", e.getMessage());
+		}
+	} else {
+		auto videoLayer = dynamic_cast<VideoLayer*>(findActiveLayer());
+		if (!videoLayer) {
+			throw CommandException(
+				"Current renderer doesn't support taking screenshots.");
+		}
+		unsigned height = doubleSize ? 480 : 240;
+		try {
+			videoLayer->takeRawScreenShot(height, filename);
+		} catch (MSXException& e) {
+			throw CommandException(
+				"Failed to take screenshot: ", e.getMessage());
+		}
+	}
+}
+
+bool Display::willRenderNextFrame()
+{
+	// There's no next frame when the emulation doesn't run, and the
+	// 'none' renderer never renders.
+	return (currentRenderer != RenderSettings::DUMMY) &&
+	       reactor.getMotherBoard() &&
+	       !reactor.getGlobalSettings().getPauseSetting().getBoolean();
+}
+
+void Display::takePendingScreenShots()
+{
+	auto pending = std::move(pendingScreenShots);
+	pendingScreenShots.clear();
+	for (auto& p : pending) {
+		try {
+			takeScreenShot(p.filename, p.raw, p.doubleSize, p.withOsd);
+		} catch (MSXException& e) {
+			getCliComm().printWarning(e.getMessage());
+		}
+	}
+}
+
+
 // ScreenShotCmd
 
 Display::ScreenShotCmd::ScreenShotCmd(CommandController& commandController_)
@@ -404,6 +461,7 @@ void Display::ScreenShotCmd::execute(array_ref<TclObject> tokens, TclObject& res
 	bool withOsd = false;
 	bool doubleSize = false;
 	string_view prefix = "openmsx";
+	string_view format;
 	vector<TclObject> arguments;
 	for (unsigned i = 1; i < tokens.size(); ++i) {
 		string_view tok = tokens[i].getString();
@@ -418,6 +476,16 @@ void Display::ScreenShotCmd::execute(array_ref<TclObject> tokens, TclObject& res
 					throw CommandException("Missing argument");
 				}
 				prefix = tokens[i].getString();
+			} else if (tok == "-format") {
+				if (++i == tokens.size()) {
+					throw CommandException("Missing argument");
+				}
+				format = tokens[i].getString();
+				if ((format != "png") && (format != "ppm") &&
+				    (format != "qoi")) {
+					throw CommandException(
+						"Unknown format: ", format);
+				}
 			} else if (tok == "-raw") {
 				rawShot = true;
 			} else if (tok == "-msxonly") {
@@ -457,34 +525,24 @@ void Display::ScreenShotCmd::execute(array_ref<TclObject> tokens, TclObject& res
 	default:
 		throw SyntaxError();
 	}
+	// Without -format, the extension of the given filename selects it.
+	auto extension = ScreenShotSaver::getExtension(format.empty()
+		? ScreenShotSaver::getFormat(fname)
+		: ScreenShotSaver::getFormat(strCat('.', format)));
 	string filename = FileOperations::parseCommandFileArgument(
-		fname, "screenshots", prefix, ".png");
-
-	if (!rawShot) {
-		// include all layers (OSD stuff, console)
-		try {
-			display.getVideoSystem().takeScreenShot(filename, withOsd);
-		} catch (MSXException& e) {
-			throw CommandException(
-				"Failed to take screenshot: ", e.getMessage());
-		}
+		fname, "screenshots", prefix, extension);
+
+	if (display.renderSettings.getLazyRender() &&
+	    display.willRenderNextFrame()) {
+		// The current frame (probably) wasn't rendered, take the
+		// screenshot once the requested frame is. (Otherwise, e.g.
+		// when paused, take the frame that's currently displayed.)
+		display.pendingScreenShots.push_back(
+			{filename, rawShot, doubleSize, withOsd});
+		display.requestFrame();
 	} else {
-		auto videoLayer = dynamic_cast<VideoLayer*>(
-			display.findActiveLayer());
-		if (!videoLayer) {
-			throw CommandException(
-				"Current renderer doesn't support taking screenshots.");
-		}
-		unsigned height = doubleSize ? 480 : 240;
-		try {
-			videoLayer->takeRawScreenShot(height, filename);
-		} catch (MSXException& e) {
-			throw CommandException(
-				"Failed to take screenshot: ", e.getMessage());
-		}
+		display.takeScreenShot(filename, rawShot, doubleSize, withOsd);
 	}
-
-	display.getCliComm().printInfo("Screen saved to ", filename);
 	result.setString(filename);
 }
 
@@ -497,13 +555,18 @@ string Display::ScreenShotCmd::help(const vector<string>& /*tokens*/) const
 	       "screenshot -raw              320x240 raw screenshot (of MSX screen only)\n"
 	       "screenshot -raw -doublesize  640x480 raw screenshot (of MSX screen only)\n"
 	       "screenshot -with-osd         Include OSD elements in the screenshot\n"
-	       "screenshot -no-sprites       Don't include sprites in the screenshot\n";
+	       "screenshot -format <fmt>     Write a png (default), ppm or qoi file\n"
+	       "screenshot -no-sprites       Don't include sprites in the screenshot\n"
+	       "The file is written in the background, see 'screenshot_compression'\n"
+	       "and 'screenshot_callback'. When the 'lazy_render' setting is\n"
+	       "enabled, that starts once the next frame has been rendered.\n";
 }
 
 void Display::ScreenShotCmd::tabCompletion(vector<string>& tokens) const
 {
 	static const char* const extra[] = {
 		"-prefix", "-raw", "-doublesize", "-with-osd", "-no-sprites",
+		"-format",
 	};
 	completeFileName(tokens, userFileContext(), extra);
 }
@@ -2,6 +2,7 @@
 #define DISPLAY_HH
 
 #include "RenderSettings.hh"
+#include "ScreenShotSaver.hh"
 #include "Command.hh"
 #include "CommandConsole.hh"
 #include "InfoTopic.hh"
@@ -44,6 +45,7 @@ public:
 	CliComm& getCliComm() const;
 	RenderSettings& getRenderSettings() { return renderSettings; }
 	OSDGUI& getOSDGUI() { return osdGui; }
+	ScreenShotSaver& getScreenShotSaver() { return screenShotSaver; }
 	CommandConsole& getCommandConsole() { return commandConsole; }
 
 	/** Redraw the display.
@@ -66,6 +68,13 @@ public:
 
 	std::string getWindowTitle();
 
+	/** Request that (at least) the next frame gets rendered, also when
+	  * the 'lazy_render' setting is enabled. Renderers compare the
+	  * request counter with the value they've seen before.
+	  */
+	void requestFrame() { ++frameRequests; }
+	unsigned getFrameRequests() const { return frameRequests; }
+
 private:
 	void resetVideoSystem();
 
@@ -78,6 +87,11 @@ private:
 	// Observer<Setting> interface
 	void update(const Setting& setting) override;
 
+	void takeScreenShot(const std::string& filename, bool raw,
+	                    bool doubleSize, bool withOsd);
+	void takePendingScreenShots();
+	bool willRenderNextFrame();
+
 	void checkRendererSwitch();
 	void doRendererSwitch();
 	void doRendererSwitch2();
@@ -100,6 +114,8 @@ private:
 	uint64_t frameDurationSum;
 	uint64_t prevTimeStamp;
 
+	ScreenShotSaver screenShotSaver;
+
 	struct ScreenShotCmd final : Command {
 		explicit ScreenShotCmd(CommandController& commandController);
 		void execute(array_ref<TclObject> tokens, TclObject& result) override;
@@ -125,6 +141,17 @@ private:
 
 	gl::ivec2 resolution;
 
+	// Screenshots taken in 'lazy_render' mode, these are written once
+	// the requested frame is rendered.
+	struct PendingScreenShot {
+		std::string filename;
+		bool raw;
+		bool doubleSize;
+		bool withOsd;
+	};
+	std::vector<PendingScreenShot> pendingScreenShots;
+	unsigned frameRequests;
+
 	bool renderFrozen;
 	bool switchInProgress;
 };
@@ -10,6 +10,7 @@
 #include "FloatSetting.hh"
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
+#include "Profiler.hh"
 #include "Math.hh"
 #include "aligned.hh"
 #include "random.hh"
@@ -282,6 +283,7 @@ void FBPostProcessor<Pixel>::paint(OutputSurface& output)
 	}
 
 	// Scale image.
+	ProfileScope scope("scaler");
 	const unsigned srcHeight = paintFrame->getHeight();
 	const unsigned dstHeight = output.getHeight();
 
@@ -280,6 +280,7 @@ void GLPostProcessor::uploadFrame()
 			superImposeTex.setInterpolation(true);
 		}
 		superImposeTex.bind();
+		superImposeVideoFrame->generateAllLines();
 		glTexSubImage2D(
 			GL_TEXTURE_2D,     // target
 			0,                 // level
@@ -9,6 +9,8 @@
 
 namespace openmsx {
 
+class ScreenShotSaver;
+
 /** A frame buffer where pixels can be written to.
   * It could be an in-memory buffer or a video buffer visible to the user
   * (see VisibleSurface subclass).
@@ -121,10 +123,12 @@ public:
 	  */
 	virtual void flushFrameBuffer();
 
-	/** Save the content of this OutputSurface to a PNG file.
-	  * @throws MSXException If creating the PNG file fails.
+	/** Save the content of this OutputSurface to an image file. Only
+	  * copies the pixels, the file is written in the background.
+	  * @throws MSXException If creating the file fails.
 	  */
-	virtual void saveScreenshot(const std::string& filename) = 0;
+	virtual void saveScreenshot(ScreenShotSaver& saver,
+	                            const std::string& filename) = 0;
 
 	/** Clear screen (paint it black).
 	 */
@@ -11,7 +11,9 @@
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <mutex>
 #include <png.h>
+#include <zlib.h>
 #include <SDL.h>
 
 namespace openmsx {
@@ -293,69 +295,95 @@ static void flushData(png_structp ctx)
 	file->flush();
 }
 
-static void IMG_SavePNG_RW(int width, int height, const void** row_pointers,
-                           const std::string& filename, bool color)
+static void IMG_SavePNG_RW(File& file, int width, int height,
+                           const void** row_pointers, bool color,
+                           int compression)
 {
-	try {
-		File file(filename, File::TRUNCATE);
+	PNGWriteHandle png;
+	png.ptr = png_create_write_struct(
+		PNG_LIBPNG_VER_STRING,
+		const_cast<char*>("encoding"), handleError, handleWarning);
+	if (!png.ptr) {
+		throw MSXException("Failed to allocate main struct");
+	}
 
-		PNGWriteHandle png;
-		png.ptr = png_create_write_struct(
-			PNG_LIBPNG_VER_STRING,
-			const_cast<char*>("encoding"), handleError, handleWarning);
-		if (!png.ptr) {
-			throw MSXException("Failed to allocate main struct");
-		}
+	// Allocate/initialize the image information data.  REQUIRED
+	png.info = png_create_info_struct(png.ptr);
+	if (!png.info) {
+		// Couldn't create image information for PNG file
+		throw MSXException("Failed to allocate image info struct");
+	}
 
-		// Allocate/initialize the image information data.  REQUIRED
-		png.info = png_create_info_struct(png.ptr);
-		if (!png.info) {
-			// Couldn't create image information for PNG file
-			throw MSXException("Failed to allocate image info struct");
-		}
+	// Set up the output control.
+	png_set_write_fn(png.ptr, &file, writeData, flushData);
+
+	if (compression == 0) {
+		// no compression at all
+		png_set_filter(png.ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+		png_set_compression_level(png.ptr, 0);
+	} else if (compression == 1) {
+		// fast: only the 'sub' filter, followed by run-length encoding
+		png_set_filter(png.ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+		png_set_compression_strategy(png.ptr, Z_RLE);
+		png_set_compression_level(png.ptr, 1);
+	} else {
+		png_set_compression_level(png.ptr, compression);
+	}
 
-		// Set up the output control.
-		png_set_write_fn(png.ptr, &file, writeData, flushData);
-
-		// Mark this image as being generated by openMSX and add creation time.
-		std::string version = Version::full();
-		png_text text[2];
-		text[0].compression = PNG_TEXT_COMPRESSION_NONE;
-		text[0].key  = const_cast<char*>("Software");
-		text[0].text = const_cast<char*>(version.c_str());
-		text[1].compression = PNG_TEXT_COMPRESSION_NONE;
-		text[1].key  = const_cast<char*>("Creation Time");
-
-		// A buffer size of 20 characters is large enough till the year
-		// 9999. But the compiler doesn't understand calendars and
-		// warns that the snprintf output could be truncated (e.g.
-		// because the year is -2147483647). To silence this warning
-		// (and also to work around the windows _snprintf stuff) we add
-		// some extra buffer space.
-		static constexpr size_t size = (10 + 1 + 8 + 1) + 44;
+	// Mark this image as being generated by openMSX and add creation time.
+	std::string version = Version::full();
+	png_text text[2];
+	text[0].compression = PNG_TEXT_COMPRESSION_NONE;
+	text[0].key  = const_cast<char*>("Software");
+	text[0].text = const_cast<char*>(version.c_str());
+	text[1].compression = PNG_TEXT_COMPRESSION_NONE;
+	text[1].key  = const_cast<char*>("Creation Time");
+
+	// A buffer size of 20 characters is large enough till the year
+	// 9999. But the compiler doesn't understand calendars and
+	// warns that the snprintf output could be truncated (e.g.
+	// because the year is -2147483647). To silence this warning
+	// (and also to work around the windows _snprintf stuff) we add
+	// some extra buffer space.
+	static constexpr size_t size = (10 + 1 + 8 + 1) + 44;
+	char timeStr[size];
+	{
+		// localtime() is not thread-safe, screenshots are saved
+		// from multiple threads.
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
 		time_t now = time(nullptr);
 		struct tm* tm = localtime(&now);
-		char timeStr[size];
 		snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
 				1900 + tm->tm_year, tm->tm_mon + 1, tm->tm_mday,
 				tm->tm_hour, tm->tm_min, tm->tm_sec);
-		text[1].text = timeStr;
+	}
+	text[1].text = timeStr;
+
+	png_set_text(png.ptr, png.info, text, 2);
 
-		png_set_text(png.ptr, png.info, text, 2);
+	png_set_IHDR(png.ptr, png.info, width, height, 8,
+				color ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
+				PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+				PNG_FILTER_TYPE_BASE);
 
-		png_set_IHDR(png.ptr, png.info, width, height, 8,
-					color ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
-					PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
-					PNG_FILTER_TYPE_BASE);
+	// Write the file header information.  REQUIRED
+	png_write_info(png.ptr, png.info);
 
-		// Write the file header information.  REQUIRED
-		png_write_info(png.ptr, png.info);
+	// Write out the entire image data in one call.
+	png_write_image(
+		png.ptr,
+		reinterpret_cast<png_bytep*>(const_cast<void**>(row_pointers)));
+	png_write_end(png.ptr, png.info);
+}
 
-		// Write out the entire image data in one call.
-		png_write_image(
-			png.ptr,
-			reinterpret_cast<png_bytep*>(const_cast<void**>(row_pointers)));
-		png_write_end(png.ptr, png.info);
+static void IMG_SavePNG_RW(int width, int height, const void** row_pointers,
+                           const std::string& filename, bool color)
+{
+	try {
+		File file(filename, File::TRUNCATE);
+		IMG_SavePNG_RW(file, width, height, row_pointers, color,
+		               Z_DEFAULT_COMPRESSION);
 	} catch (MSXException& e) {
 		throw MSXException(
 			"Error while writing PNG file \"", filename, "\": ",
@@ -363,57 +391,18 @@ static void IMG_SavePNG_RW(int width, int height, const void** row_pointers,
 	}
 }
 
-void save(SDL_Surface* image, const std::string& filename)
-{
-	SDL_PixelFormat frmt24;
-	frmt24.palette = nullptr;
-	frmt24.BitsPerPixel = 24;
-	frmt24.BytesPerPixel = 3;
-	frmt24.Rmask = OPENMSX_BIGENDIAN ? 0xFF0000 : 0x0000FF;
-	frmt24.Gmask = 0x00FF00;
-	frmt24.Bmask = OPENMSX_BIGENDIAN ? 0x0000FF : 0xFF0000;
-	frmt24.Amask = 0;
-	frmt24.Rshift = 0;
-	frmt24.Gshift = 8;
-	frmt24.Bshift = 16;
-	frmt24.Ashift = 0;
-	frmt24.Rloss = 0;
-	frmt24.Gloss = 0;
-	frmt24.Bloss = 0;
-	frmt24.Aloss = 8;
-	frmt24.colorkey = 0;
-	frmt24.alpha = 0;
-	SDLSurfacePtr surf24(SDL_ConvertSurface(image, &frmt24, 0));
-
-	// Create the array of pointers to image data
-	VLA(const void*, row_pointers, image->h);
-	for (int i = 0; i < image->h; ++i) {
-		row_pointers[i] = surf24.getLinePtr(i);
-	}
-
-	IMG_SavePNG_RW(image->w, image->h, row_pointers, filename, true);
-}
-
-void save(unsigned width, unsigned height, const void** rowPointers,
-          const SDL_PixelFormat& format, const std::string& filename)
-{
-	// this implementation creates 1 extra copy, can be optimized if required
-	SDLSurfacePtr surface(
-		width, height, format.BitsPerPixel,
-		format.Rmask, format.Gmask, format.Bmask, format.Amask);
-	for (unsigned y = 0; y < height; ++y) {
-		memcpy(surface.getLinePtr(y),
-		       rowPointers[y], width * format.BytesPerPixel);
-	}
-	save(surface.get(), filename);
-}
-
 void save(unsigned width, unsigned height,
           const void** rowPointers, const std::string& filename)
 {
 	IMG_SavePNG_RW(width, height, rowPointers, filename, true);
 }
 
+void save(File& file, unsigned width, unsigned height,
+          const void** rowPointers, int compression)
+{
+	IMG_SavePNG_RW(file, width, height, rowPointers, true, compression);
+}
+
 void saveGrayscale(unsigned width, unsigned height,
                    const void** rowPointers, const std::string& filename)
 {
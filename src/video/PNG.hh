@@ -4,11 +4,10 @@
 #include "SDLSurfacePtr.hh"
 #include <string>
 
-struct SDL_Surface;
-struct SDL_PixelFormat;
-
 namespace openmsx {
 
+class File;
+
 /** Utility functions to hide the complexity of saving to a PNG file.
   */
 namespace PNG {
@@ -20,11 +19,19 @@ namespace PNG {
 	 */
 	SDLSurfacePtr load(const std::string& filename, bool want32bpp);
 
-	void save(SDL_Surface* image, const std::string& filename);
-	void save(unsigned width, unsigned height, const void** rowPointers,
-	          const SDL_PixelFormat& format, const std::string& filename);
+	/** Save a 24bpp RGB image (3 bytes per pixel).
+	  */
 	void save(unsigned width, unsigned height, const void** rowPointers,
 	          const std::string& filename);
+
+	/** Same, but write to an already opened file with the given
+	  * compression level: 0 means no compression, 1 is a fast mode
+	  * (only the 'sub' filter and run-length encoding) and 2-9 are the
+	  * zlib compression levels (with adaptive filtering).
+	  */
+	void save(File& file, unsigned width, unsigned height,
+	          const void** rowPointers, int compression);
+
 	void saveGrayscale(unsigned width, unsigned height,
 	                   const void** rowPointers, const std::string& filename);
 
@@ -104,10 +104,11 @@ void PixelRenderer::subdivide(
 	if (drawLast) draw(clipL, endY, endX, endY + 1, drawType, false);
 }
 
-PixelRenderer::PixelRenderer(VDP& vdp_, Display& display)
+PixelRenderer::PixelRenderer(VDP& vdp_, Display& display_)
 	: vdp(vdp_), vram(vdp.getVRAM())
 	, eventDistributor(vdp.getReactor().getEventDistributor())
 	, realTime(vdp.getMotherBoard().getRealTime())
+	, display(display_)
 	, renderSettings(display.getRenderSettings())
 	, videoSourceSetting(vdp.getMotherBoard().getVideoSource())
 	, spriteChecker(vdp.getSpriteChecker())
@@ -121,6 +122,7 @@ PixelRenderer::PixelRenderer(VDP& vdp_, Display& display)
 
 	finishFrameDuration = 0;
 	frameSkipCounter = 999; // force drawing of frame
+	frameRequests = display.getFrameRequests();
 	prevRenderFrame = false;
 
 	renderSettings.getMaxFrameSkipSetting().attach(*this);
@@ -167,6 +169,13 @@ void PixelRenderer::frameStart(EmuTime::param time)
 	if (vdp.isInterlaced() && renderSettings.getDeinterlace() &&
 	    vdp.getEvenOdd() && vdp.isEvenOddEnabled()) {
 		// deinterlaced odd frame, do same as even frame
+	} else if (renderSettings.getLazyRender()) {
+		// Only render when requested (e.g. for a screenshot) or when
+		// recording a video, skipped frames only cost the VDP state
+		// updates.
+		renderFrame = rasterizer->isRecording() ||
+		              (frameRequests != display.getFrameRequests());
+		frameRequests = display.getFrameRequests();
 	} else {
 		if (frameSkipCounter < renderSettings.getMinFrameSkip()) {
 			++frameSkipCounter;
@@ -109,6 +109,7 @@ private:
 
 	EventDistributor& eventDistributor;
 	RealTime& realTime;
+	Display& display;
 	RenderSettings& renderSettings;
 	VideoSourceSetting& videoSourceSetting;
 
@@ -120,6 +121,7 @@ private:
 
 	float finishFrameDuration;
 	int frameSkipCounter;
+	unsigned frameRequests; // see Display::requestFrame()
 
 	/** Number of the next position within a line to render.
 	  * Expressed in VDP clock ticks since start of line.
@@ -5,7 +5,7 @@
 #include "DoubledFrame.hh"
 #include "Deflicker.hh"
 #include "SuperImposedFrame.hh"
-#include "PNG.hh"
+#include "ScreenShotSaver.hh"
 #include "RenderSettings.hh"
 #include "RawFrame.hh"
 #include "AviRecorder.hh"
@@ -265,7 +265,8 @@ void PostProcessor::takeRawScreenShot(unsigned height2, const std::string& filen
 	WorkBuffer workBuffer;
 	getScaledFrame(*paintFrame, getBpp(), height2, lines, workBuffer);
 	unsigned width = (height2 == 240) ? 320 : 640;
-	PNG::save(width, height2, lines, paintFrame->getSDLPixelFormat(), filename);
+	display.getScreenShotSaver().save(
+		width, height2, lines, paintFrame->getSDLPixelFormat(), filename);
 }
 
 unsigned PostProcessor::getBpp() const
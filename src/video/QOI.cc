@@ -0,0 +1,181 @@
+#include "QOI.hh"
+#include "MSXException.hh"
+#include <cstring>
+
+namespace openmsx {
+namespace QOI {
+
+static const uint8_t OP_INDEX = 0x00; // 00xxxxxx
+static const uint8_t OP_DIFF  = 0x40; // 01xxxxxx
+static const uint8_t OP_LUMA  = 0x80; // 10xxxxxx
+static const uint8_t OP_RUN   = 0xc0; // 11xxxxxx
+static const uint8_t OP_RGB   = 0xfe; // 11111110
+static const uint8_t OP_RGBA  = 0xff; // 11111111
+static const uint8_t MASK_2   = 0xc0;
+
+static const unsigned HEADER_SIZE = 14;
+static const uint8_t PADDING[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+struct Pixel {
+	uint8_t r, g, b, a;
+	bool operator==(const Pixel& o) const {
+		return (r == o.r) && (g == o.g) && (b == o.b) && (a == o.a);
+	}
+	bool operator!=(const Pixel& o) const { return !(*this == o); }
+};
+
+static inline unsigned hash(const Pixel& p)
+{
+	return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+}
+
+static void write32(std::vector<uint8_t>& out, uint32_t v)
+{
+	out.push_back(v >> 24);
+	out.push_back(v >> 16);
+	out.push_back(v >>  8);
+	out.push_back(v >>  0);
+}
+
+static uint32_t read32(const uint8_t* p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] << 0);
+}
+
+std::vector<uint8_t> encode(const uint8_t* rgb, unsigned width, unsigned height)
+{
+	size_t numPixels = size_t(width) * height;
+	std::vector<uint8_t> out;
+	// worst case is one OP_RGB per pixel
+	out.reserve(HEADER_SIZE + 4 * numPixels + sizeof(PADDING));
+
+	out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+	write32(out, width);
+	write32(out, height);
+	out.push_back(3); // channels: RGB
+	out.push_back(0); // colorspace: sRGB with linear alpha
+
+	Pixel index[64];
+	memset(index, 0, sizeof(index));
+	Pixel prev = { 0, 0, 0, 255 };
+	unsigned run = 0;
+	for (size_t i = 0; i < numPixels; ++i) {
+		Pixel px = { rgb[3 * i + 0], rgb[3 * i + 1], rgb[3 * i + 2], 255 };
+		if (px == prev) {
+			++run;
+			if ((run == 62) || (i == (numPixels - 1))) {
+				out.push_back(OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		if (run) {
+			out.push_back(OP_RUN | (run - 1));
+			run = 0;
+		}
+		unsigned idx = hash(px);
+		if (index[idx] == px) {
+			out.push_back(OP_INDEX | idx);
+		} else {
+			index[idx] = px;
+			// alpha is always 255, so OP_RGBA is never needed
+			auto vr = int8_t(px.r - prev.r);
+			auto vg = int8_t(px.g - prev.g);
+			auto vb = int8_t(px.b - prev.b);
+			int vgr = vr - vg;
+			int vgb = vb - vg;
+			if ((-2 <= vr) && (vr <= 1) &&
+			    (-2 <= vg) && (vg <= 1) &&
+			    (-2 <= vb) && (vb <= 1)) {
+				out.push_back(OP_DIFF | ((vr + 2) << 4) |
+				              ((vg + 2) << 2) | (vb + 2));
+			} else if ((-8 <= vgr) && (vgr <= 7) &&
+			           (-32 <= vg) && (vg <= 31) &&
+			           (-8 <= vgb) && (vgb <= 7)) {
+				out.push_back(OP_LUMA | (vg + 32));
+				out.push_back(((vgr + 8) << 4) | (vgb + 8));
+			} else {
+				out.push_back(OP_RGB);
+				out.push_back(px.r);
+				out.push_back(px.g);
+				out.push_back(px.b);
+			}
+		}
+		prev = px;
+	}
+	out.insert(out.end(), std::begin(PADDING), std::end(PADDING));
+	return out;
+}
+
+std::vector<uint8_t> decode(const uint8_t* data, size_t size,
+                            unsigned& width, unsigned& height)
+{
+	if ((size < (HEADER_SIZE + sizeof(PADDING))) ||
+	    (memcmp(data, "qoif", 4) != 0)) {
+		throw MSXException("Not a QOI image");
+	}
+	width  = read32(data + 4);
+	height = read32(data + 8);
+	unsigned channels = data[12];
+	if ((channels != 3) && (channels != 4)) {
+		throw MSXException("Invalid number of channels in QOI image");
+	}
+	size_t numPixels = size_t(width) * height;
+	// each pixel takes at least 1/62 byte
+	if (numPixels / 62 > size) {
+		throw MSXException("Invalid QOI image size");
+	}
+
+	std::vector<uint8_t> rgb(3 * numPixels);
+	Pixel index[64];
+	memset(index, 0, sizeof(index));
+	Pixel px = { 0, 0, 0, 255 };
+	size_t pos = HEADER_SIZE;
+	size_t end = size - sizeof(PADDING);
+	unsigned run = 0;
+	for (size_t i = 0; i < numPixels; ++i) {
+		if (run) {
+			--run;
+		} else {
+			if (pos >= end) {
+				throw MSXException("Truncated QOI image");
+			}
+			uint8_t b1 = data[pos++];
+			if (b1 == OP_RGB) {
+				if ((end - pos) < 3) throw MSXException("Truncated QOI image");
+				px.r = data[pos++];
+				px.g = data[pos++];
+				px.b = data[pos++];
+			} else if (b1 == OP_RGBA) {
+				if ((end - pos) < 4) throw MSXException("Truncated QOI image");
+				px.r = data[pos++];
+				px.g = data[pos++];
+				px.b = data[pos++];
+				px.a = data[pos++];
+			} else if ((b1 & MASK_2) == OP_INDEX) {
+				px = index[b1];
+			} else if ((b1 & MASK_2) == OP_DIFF) {
+				px.r += ((b1 >> 4) & 3) - 2;
+				px.g += ((b1 >> 2) & 3) - 2;
+				px.b += ((b1 >> 0) & 3) - 2;
+			} else if ((b1 & MASK_2) == OP_LUMA) {
+				if (pos >= end) throw MSXException("Truncated QOI image");
+				uint8_t b2 = data[pos++];
+				int vg = (b1 & 0x3f) - 32;
+				px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+				px.g += vg;
+				px.b += vg - 8 + ((b2 >> 0) & 0x0f);
+			} else { // OP_RUN
+				run = b1 & 0x3f;
+			}
+			index[hash(px)] = px;
+		}
+		rgb[3 * i + 0] = px.r;
+		rgb[3 * i + 1] = px.g;
+		rgb[3 * i + 2] = px.b;
+	}
+	return rgb;
+}
+
+} // namespace QOI
+} // namespace openmsx
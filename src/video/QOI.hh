@@ -0,0 +1,27 @@
+#ifndef QOI_HH
+#define QOI_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace openmsx {
+
+/** Encoder and decoder for the "Quite OK Image" format (qoiformat.org).
+  * It compresses a lot faster than PNG (and it's lossless as well), so
+  * it's a good fit to store many screenshots for automated comparison.
+  * Only 24bpp RGB images are supported (3 bytes per pixel, no padding
+  * between the lines).
+  */
+namespace QOI {
+	std::vector<uint8_t> encode(const uint8_t* rgb,
+	                            unsigned width, unsigned height);
+
+	/** @throws MSXException when the data is not a valid (RGB) QOI image. */
+	std::vector<uint8_t> decode(const uint8_t* data, size_t size,
+	                            unsigned& width, unsigned& height);
+
+} // namespace QOI
+} // namespace openmsx
+
+#endif
@@ -8,6 +8,7 @@ RawFrame::RawFrame(
 		const SDL_PixelFormat& format, unsigned maxWidth_, unsigned height_)
 	: FrameSource(format)
 	, lineWidths(height_)
+	, numPending(0)
 	, maxWidth(maxWidth_)
 {
 	setHeight(height_);
@@ -24,6 +25,7 @@ RawFrame::RawFrame(
 	// Start with a black frame.
 	init(FIELD_NONINTERLACED);
 	for (unsigned line = 0; line < height_; line++) {
+		lineWidths[line] = 0;
 		if (bytesPerPixel == 2) {
 			setBlank(line, static_cast<uint16_t>(0));
 		} else {
@@ -32,10 +34,29 @@ RawFrame::RawFrame(
 	}
 }
 
+RawFrame::~RawFrame() = default;
+
+void RawFrame::setLazyLines(unsigned width)
+{
+	assert(generator);
+	assert(width <= maxWidth);
+	for (unsigned line = 0; line < getHeight(); ++line) {
+		lineWidths[line] = width | PENDING;
+	}
+	numPending = getHeight();
+}
+
+void RawFrame::generateAllLines() const
+{
+	for (unsigned line = 0; numPending && (line < getHeight()); ++line) {
+		generateLine(line);
+	}
+}
+
 unsigned RawFrame::getLineWidth(unsigned line) const
 {
 	assert(line < getHeight());
-	return lineWidths[line];
+	return lineWidths[line] & ~PENDING;
 }
 
 const void* RawFrame::getLineInfo(
@@ -43,6 +64,7 @@ const void* RawFrame::getLineInfo(
 	void* /*buf*/, unsigned /*bufWidth*/) const
 {
 	assert(line < getHeight());
+	generateLine(line);
 	width = lineWidths[line];
 	return data.data() + line * pitch;
 }
@@ -54,7 +76,8 @@ unsigned RawFrame::getRowLength() const
 
 bool RawFrame::hasContiguousStorage() const
 {
-	return true;
+	// The next lines might not be generated yet.
+	return numPending == 0;
 }
 
 } // namespace openmsx
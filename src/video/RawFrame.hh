@@ -3,8 +3,10 @@
 
 #include "FrameSource.hh"
 #include "MemBuffer.hh"
+#include "likely.hh"
 #include "openmsx.hh"
 #include <cassert>
+#include <memory>
 
 namespace openmsx {
 
@@ -25,7 +27,20 @@ struct V9958RasterizerBorderInfo
 class RawFrame final : public FrameSource
 {
 public:
+	/** Produces the lines of a frame on demand, see setLazyLines().
+	  */
+	class LineGenerator
+	{
+	public:
+		virtual ~LineGenerator() = default;
+		/** Fill in (at least) the given line. This must call
+		  * setLineWidth() for every line that it fills in.
+		  */
+		virtual void generate(RawFrame& frame, unsigned line) = 0;
+	};
+
 	RawFrame(const SDL_PixelFormat& format, unsigned maxWidth, unsigned height);
+	~RawFrame();
 
 	template<typename Pixel>
 	Pixel* getLinePtrDirect(unsigned y) {
@@ -33,12 +48,13 @@ public:
 	}
 
 	unsigned getLineWidthDirect(unsigned y) const {
-		return lineWidths[y];
+		return lineWidths[y] & ~PENDING;
 	}
 
 	inline void setLineWidth(unsigned line, unsigned width) {
 		assert(line < getHeight());
 		assert(width <= maxWidth);
+		if (unlikely(lineWidths[line] & PENDING)) --numPending;
 		lineWidths[line] = width;
 	}
 
@@ -47,9 +63,35 @@ public:
 		assert(line < getHeight());
 		Pixel* pixels = getLinePtrDirect<Pixel>(line);
 		pixels[0] = color;
-		lineWidths[line] = 1;
+		setLineWidth(line, 1);
+	}
+
+	/** Let the line generator produce the content of all lines, but only
+	  * when (and if) they are actually read via the FrameSource interface.
+	  * All lines get the given width. Writing a line (setLineWidth() or
+	  * setBlank()) cancels its pending generation.
+	  */
+	void setLazyLines(unsigned width);
+	void setLineGenerator(std::unique_ptr<LineGenerator> generator_) {
+		generator = std::move(generator_);
+	}
+	LineGenerator* getLineGenerator() const { return generator.get(); }
+	bool isLinePending(unsigned line) const {
+		return (lineWidths[line] & PENDING) != 0;
 	}
 
+	/** Make sure the given line (or all lines) is available for direct
+	  * access via getLinePtrDirect(), that's already the case unless
+	  * setLazyLines() was used.
+	  */
+	void generateLine(unsigned line) const {
+		if (unlikely(lineWidths[line] & PENDING)) {
+			generator->generate(const_cast<RawFrame&>(*this), line);
+			assert(!(lineWidths[line] & PENDING));
+		}
+	}
+	void generateAllLines() const;
+
 	unsigned getRowLength() const override;
 
 	// RawFrame is mostly agnostic of the border info struct. The only
@@ -64,8 +106,14 @@ protected:
 	bool hasContiguousStorage() const override;
 
 private:
+	// Flag in 'lineWidths': the content of this line still has to be
+	// produced by the generator.
+	static const unsigned PENDING = 0x80000000;
+
 	MemBuffer<char, 64> data;
 	MemBuffer<unsigned> lineWidths;
+	std::unique_ptr<LineGenerator> generator;
+	unsigned numPending;
 	unsigned maxWidth;
 	unsigned pitch;
 
@@ -76,6 +76,11 @@ RenderSettings::RenderSettings(CommandController& commandController)
 	, minFrameSkipSetting(commandController,
 		"minframeskip", "set the min amount of frameskip", 0, 0, 100)
 
+	, lazyRenderSetting(commandController,
+		"lazy_render", "only render frames that are explicitly "
+		"requested, e.g. by the screenshot command", false,
+		Setting::DONT_SAVE)
+
 	, fullScreenSetting(commandController,
 		"fullscreen", "full screen display on/off", false)
 
@@ -64,6 +64,10 @@ public:
 	IntegerSetting& getMinFrameSkipSetting() { return minFrameSkipSetting; }
 	int getMinFrameSkip() const { return minFrameSkipSetting.getInt(); }
 
+	/** Lazy rendering: only render explicitly requested frames. */
+	BooleanSetting& getLazyRenderSetting() { return lazyRenderSetting; }
+	bool getLazyRender() const { return lazyRenderSetting.getBoolean(); }
+
 	/** Full screen [on, off]. */
 	BooleanSetting& getFullScreenSetting() { return fullScreenSetting; }
 	bool getFullScreen() const { return fullScreenSetting.getBoolean(); }
@@ -205,6 +209,7 @@ private:
 	BooleanSetting deflickerSetting;
 	IntegerSetting maxFrameSkipSetting;
 	IntegerSetting minFrameSkipSetting;
+	BooleanSetting lazyRenderSetting;
 	BooleanSetting fullScreenSetting;
 	FloatSetting gammaSetting;
 	FloatSetting brightnessSetting;
@@ -37,9 +37,11 @@ void SDLGLOffScreenSurface::clearScreen()
 	SDLGLOutputSurface::clearScreen();
 }
 
-void SDLGLOffScreenSurface::saveScreenshot(const std::string& filename)
+void SDLGLOffScreenSurface::saveScreenshot(
+	ScreenShotSaver& saver, const std::string& filename)
 {
-	SDLGLOutputSurface::saveScreenshot(filename, getWidth(), getHeight());
+	SDLGLOutputSurface::saveScreenshot(
+		saver, filename, getWidth(), getHeight());
 }
 
 } // namespace openmsx
@@ -1,7 +1,7 @@
 #include "SDLGLOutputSurface.hh"
 #include "GLContext.hh"
 #include "OutputSurface.hh"
-#include "PNG.hh"
+#include "ScreenShotSaver.hh"
 #include "build-info.hh"
 #include "Math.hh"
 #include "MemBuffer.hh"
@@ -146,7 +146,7 @@ void SDLGLOutputSurface::clearScreen()
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void SDLGLOutputSurface::saveScreenshot(
+void SDLGLOutputSurface::saveScreenshot(ScreenShotSaver& saver,
 	const std::string& filename, unsigned width, unsigned height)
 {
 	VLA(const void*, rowPointers, height);
@@ -155,7 +155,7 @@ void SDLGLOutputSurface::saveScreenshot(
 		rowPointers[height - 1 - i] = &buffer[width * 3 * i];
 	}
 	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
-	PNG::save(width, height, rowPointers, filename);
+	saver.save(width, height, rowPointers, filename);
 }
 
 } // namespace openmsx
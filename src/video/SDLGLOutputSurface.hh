@@ -8,6 +8,7 @@
 namespace openmsx {
 
 class OutputSurface;
+class ScreenShotSaver;
 
 /** This is a common base class for SDLGLVisibleSurface and
   * SDLGLOffScreenSurface. It's only purpose is to have a place to put common
@@ -30,7 +31,7 @@ protected:
 	void init(OutputSurface& output);
 	void flushFrameBuffer(unsigned width, unsigned height);
 	void clearScreen();
-	void saveScreenshot(const std::string& filename,
+	void saveScreenshot(ScreenShotSaver& saver, const std::string& filename,
 	                    unsigned width, unsigned height);
 
 private:
@@ -95,9 +95,11 @@ void SDLGLVisibleSurface::clearScreen()
 	SDLGLOutputSurface::clearScreen();
 }
 
-void SDLGLVisibleSurface::saveScreenshot(const std::string& filename)
+void SDLGLVisibleSurface::saveScreenshot(
+	ScreenShotSaver& saver, const std::string& filename)
 {
-	SDLGLOutputSurface::saveScreenshot(filename, getWidth(), getHeight());
+	SDLGLOutputSurface::saveScreenshot(
+		saver, filename, getWidth(), getHeight());
 }
 
 void SDLGLVisibleSurface::finish()
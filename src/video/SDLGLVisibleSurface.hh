@@ -24,7 +24,8 @@ public:
 private:
 	// OutputSurface
 	void flushFrameBuffer() override;
-	void saveScreenshot(const std::string& filename) override;
+	void saveScreenshot(ScreenShotSaver& saver,
+	                    const std::string& filename) override;
 	void clearScreen() override;
 
 	// VisibleSurface
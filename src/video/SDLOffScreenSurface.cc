@@ -1,5 +1,5 @@
 #include "SDLOffScreenSurface.hh"
-#include "PNG.hh"
+#include "ScreenShotSaver.hh"
 #include <cstring>
 
 namespace openmsx {
@@ -30,10 +30,11 @@ SDLOffScreenSurface::SDLOffScreenSurface(const SDL_Surface& proto)
 	setBufferPtr(static_cast<char*>(surface->pixels), surface->pitch);
 }
 
-void SDLOffScreenSurface::saveScreenshot(const std::string& filename)
+void SDLOffScreenSurface::saveScreenshot(
+	ScreenShotSaver& saver, const std::string& filename)
 {
 	lock();
-	PNG::save(getSDLSurface(), filename);
+	saver.save(getSDLSurface(), filename);
 }
 
 void SDLOffScreenSurface::clearScreen()
@@ -14,7 +14,8 @@ public:
 
 private:
 	// OutputSurface
-	void saveScreenshot(const std::string& filename) override;
+	void saveScreenshot(ScreenShotSaver& saver,
+	                    const std::string& filename) override;
 	void clearScreen() override;
 
 	SDLSurfacePtr surface;
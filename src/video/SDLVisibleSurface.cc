@@ -1,6 +1,6 @@
 #include "SDLVisibleSurface.hh"
 #include "SDLOffScreenSurface.hh"
-#include "PNG.hh"
+#include "ScreenShotSaver.hh"
 #include "SDLSnow.hh"
 #include "OSDConsoleRenderer.hh"
 #include "OSDGUILayer.hh"
@@ -91,10 +91,11 @@ std::unique_ptr<OutputSurface> SDLVisibleSurface::createOffScreenSurface()
 	return std::make_unique<SDLOffScreenSurface>(*getSDLSurface());
 }
 
-void SDLVisibleSurface::saveScreenshot(const std::string& filename)
+void SDLVisibleSurface::saveScreenshot(
+	ScreenShotSaver& saver, const std::string& filename)
 {
 	lock();
-	PNG::save(getSDLSurface(), filename);
+	saver.save(getSDLSurface(), filename);
 }
 
 void SDLVisibleSurface::clearScreen()
@@ -17,7 +17,8 @@ public:
 
 private:
 	// OutputSurface
-	void saveScreenshot(const std::string& filename) override;
+	void saveScreenshot(ScreenShotSaver& saver,
+	                    const std::string& filename) override;
 	void clearScreen() override;
 
 	// VisibleSurface
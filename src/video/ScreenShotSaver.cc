@@ -0,0 +1,230 @@
+#include "ScreenShotSaver.hh"
+#include "PNG.hh"
+#include "QOI.hh"
+#include "SDLSurfacePtr.hh"
+#include "EventDistributor.hh"
+#include "InputEvents.hh"
+#include "CommandController.hh"
+#include "CliComm.hh"
+#include "FileOperations.hh"
+#include "MSXException.hh"
+#include "StringOp.hh"
+#include "build-info.hh"
+#include "strCat.hh"
+#include "vla.hh"
+#include <algorithm>
+#include <cstring>
+#include <SDL.h>
+
+namespace openmsx {
+
+// Encoding is mostly CPU bound, a few threads is plenty to keep up with
+// a screenshot every frame.
+static const unsigned MAX_THREADS = 4;
+
+ScreenShotSaver::ScreenShotSaver(CommandController& commandController,
+                                 EventDistributor& eventDistributor_)
+	: eventDistributor(eventDistributor_)
+	, cliComm(commandController.getCliComm())
+	, compressionSetting(commandController, "screenshot_compression",
+		"PNG compression level of screenshots: 0 is no compression, "
+		"1 is fast (filter and run-length encoding only), 2-9 are the "
+		"zlib levels", 6, 0, 9)
+	, callback(commandController, "screenshot_callback",
+		"Tcl proc called when a screenshot has been written, it gets "
+		"the filename and an error message (empty on success) as "
+		"arguments", true, false)
+	, busy(0)
+	, exitLoop(false)
+{
+	eventDistributor.registerEventListener(
+		OPENMSX_SCREENSHOT_DONE_EVENT, *this);
+}
+
+ScreenShotSaver::~ScreenShotSaver()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		exitLoop = true;
+	}
+	condition.notify_all();
+	for (auto& t : threads) t.join();
+
+	eventDistributor.unregisterEventListener(
+		OPENMSX_SCREENSHOT_DONE_EVENT, *this);
+}
+
+ScreenShotSaver::Format ScreenShotSaver::getFormat(string_view filename)
+{
+	auto ext = FileOperations::getExtension(filename);
+	StringOp::casecmp cmp;
+	if (cmp(ext, "ppm")) return FORMAT_PPM;
+	if (cmp(ext, "qoi")) return FORMAT_QOI;
+	return FORMAT_PNG;
+}
+
+string_view ScreenShotSaver::getExtension(Format format)
+{
+	switch (format) {
+		case FORMAT_PPM: return ".ppm";
+		case FORMAT_QOI: return ".qoi";
+		default:         return ".png";
+	}
+}
+
+void ScreenShotSaver::save(SDL_Surface* image, const std::string& filename)
+{
+	SDL_PixelFormat frmt24;
+	frmt24.palette = nullptr;
+	frmt24.BitsPerPixel = 24;
+	frmt24.BytesPerPixel = 3;
+	frmt24.Rmask = OPENMSX_BIGENDIAN ? 0xFF0000 : 0x0000FF;
+	frmt24.Gmask = 0x00FF00;
+	frmt24.Bmask = OPENMSX_BIGENDIAN ? 0x0000FF : 0xFF0000;
+	frmt24.Amask = 0;
+	frmt24.Rshift = 0;
+	frmt24.Gshift = 8;
+	frmt24.Bshift = 16;
+	frmt24.Ashift = 0;
+	frmt24.Rloss = 0;
+	frmt24.Gloss = 0;
+	frmt24.Bloss = 0;
+	frmt24.Aloss = 8;
+	frmt24.colorkey = 0;
+	frmt24.alpha = 0;
+	SDLSurfacePtr surf24(SDL_ConvertSurface(image, &frmt24, 0));
+
+	// Create the array of pointers to image data
+	VLA(const void*, rowPointers, image->h);
+	for (int i = 0; i < image->h; ++i) {
+		rowPointers[i] = surf24.getLinePtr(i);
+	}
+	save(image->w, image->h, rowPointers, filename);
+}
+
+void ScreenShotSaver::save(unsigned width, unsigned height, const void** rowPointers,
+                           const SDL_PixelFormat& format, const std::string& filename)
+{
+	// this implementation creates 1 extra copy, can be optimized if required
+	SDLSurfacePtr surface(
+		width, height, format.BitsPerPixel,
+		format.Rmask, format.Gmask, format.Bmask, format.Amask);
+	for (unsigned y = 0; y < height; ++y) {
+		memcpy(surface.getLinePtr(y),
+		       rowPointers[y], width * format.BytesPerPixel);
+	}
+	save(surface.get(), filename);
+}
+
+void ScreenShotSaver::save(unsigned width, unsigned height,
+                           const void** rowPointers, const std::string& filename)
+{
+	Job job;
+	try {
+		job.file = File(filename, File::TRUNCATE);
+	} catch (MSXException& e) {
+		throw MSXException("Error while writing \"", filename, "\": ",
+		                   e.getMessage());
+	}
+	job.filename = filename;
+	job.width = width;
+	job.height = height;
+	job.pixels.resize(3 * width * height);
+	for (unsigned y = 0; y < height; ++y) {
+		memcpy(&job.pixels[3 * width * y], rowPointers[y], 3 * width);
+	}
+	job.format = getFormat(filename);
+	job.compression = compressionSetting.getInt();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.push_back(std::move(job));
+	// Start an extra thread when all existing ones are busy.
+	if ((busy + jobs.size() > threads.size()) &&
+	    (threads.size() < std::min(MAX_THREADS,
+	                               std::max(1u, std::thread::hardware_concurrency())))) {
+		threads.emplace_back([this]() { run(); });
+	}
+	condition.notify_one();
+}
+
+unsigned ScreenShotSaver::getNumPending() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return unsigned(jobs.size() + busy + results.size());
+}
+
+void ScreenShotSaver::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [&] { return exitLoop || !jobs.empty(); });
+		if (jobs.empty()) break; // exitLoop, but only when all done
+		Job job = std::move(jobs.front());
+		jobs.pop_front();
+		++busy;
+		lock.unlock();
+
+		Result result;
+		result.filename = job.filename;
+		try {
+			encode(job);
+		} catch (MSXException& e) {
+			result.error = strCat("Error while writing \"",
+			                      job.filename, "\": ", e.getMessage());
+		}
+
+		lock.lock();
+		--busy;
+		results.push_back(std::move(result));
+		eventDistributor.distributeEvent(
+			std::make_shared<SimpleEvent>(OPENMSX_SCREENSHOT_DONE_EVENT));
+	}
+}
+
+void ScreenShotSaver::encode(Job& job)
+{
+	unsigned width = job.width;
+	unsigned height = job.height;
+	switch (job.format) {
+	case FORMAT_PPM: {
+		auto header = strCat("P6\n", width, ' ', height, "\n255\n");
+		job.file.write(header.data(), header.size());
+		job.file.write(job.pixels.data(), 3 * width * height);
+		break;
+	}
+	case FORMAT_QOI: {
+		auto data = QOI::encode(job.pixels.data(), width, height);
+		job.file.write(data.data(), data.size());
+		break;
+	}
+	default: {
+		VLA(const void*, rowPointers, height);
+		for (unsigned y = 0; y < height; ++y) {
+			rowPointers[y] = &job.pixels[3 * width * y];
+		}
+		PNG::save(job.file, width, height, rowPointers, job.compression);
+		break;
+	}
+	}
+	job.file.close();
+}
+
+int ScreenShotSaver::signalEvent(const std::shared_ptr<const Event>& /*event*/)
+{
+	std::vector<Result> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::swap(done, results);
+	}
+	for (auto& r : done) {
+		if (r.error.empty()) {
+			cliComm.printInfo("Screen saved to ", r.filename);
+		} else {
+			cliComm.printWarning(r.error);
+		}
+		callback.execute(r.filename, r.error);
+	}
+	return 0;
+}
+
+} // namespace openmsx
@@ -0,0 +1,102 @@
+#ifndef SCREENSHOTSAVER_HH
+#define SCREENSHOTSAVER_HH
+
+#include "EventListener.hh"
+#include "IntegerSetting.hh"
+#include "TclCallback.hh"
+#include "File.hh"
+#include "MemBuffer.hh"
+#include "string_view.hh"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SDL_Surface;
+struct SDL_PixelFormat;
+
+namespace openmsx {
+
+class CommandController;
+class EventDistributor;
+class CliComm;
+
+/** Saves screenshots in the background.
+  *
+  * Taking a screenshot only copies the pixels (in the main thread). The
+  * encoding and writing to disk is done by a small pool of worker threads,
+  * so that the emulation doesn't stall. The file itself is already created
+  * (empty) in the main thread, so that errors like an invalid path are
+  * reported immediately and so that the next automatically generated
+  * filename is different.
+  *
+  * The file format depends on the filename extension: '.ppm' (binary
+  * portable pixmap), '.qoi' (see QOI.hh), anything else is PNG. When the
+  * file is written this is reported on CliComm and the Tcl proc in the
+  * 'screenshot_callback' setting is called.
+  */
+class ScreenShotSaver final : private EventListener
+{
+public:
+	enum Format { FORMAT_PNG, FORMAT_PPM, FORMAT_QOI };
+
+	ScreenShotSaver(CommandController& commandController,
+	                EventDistributor& eventDistributor);
+	/** Finishes all pending screenshots. */
+	~ScreenShotSaver();
+
+	/** Save an image with arbitrary pixel format. */
+	void save(SDL_Surface* image, const std::string& filename);
+	void save(unsigned width, unsigned height, const void** rowPointers,
+	          const SDL_PixelFormat& format, const std::string& filename);
+	/** Save a 24bpp RGB image (3 bytes per pixel). */
+	void save(unsigned width, unsigned height, const void** rowPointers,
+	          const std::string& filename);
+
+	/** Number of screenshots that are not yet completely written. */
+	unsigned getNumPending() const;
+
+	static Format getFormat(string_view filename);
+	static string_view getExtension(Format format);
+
+private:
+	struct Job {
+		File file;
+		std::string filename;
+		unsigned width;
+		unsigned height;
+		MemBuffer<uint8_t> pixels; // RGB, no padding
+		Format format;
+		int compression;
+	};
+	struct Result {
+		std::string filename;
+		std::string error; // empty on success
+	};
+
+	void run();
+	static void encode(Job& job);
+
+	// EventListener
+	int signalEvent(const std::shared_ptr<const Event>& event) override;
+
+	EventDistributor& eventDistributor;
+	CliComm& cliComm;
+	IntegerSetting compressionSetting;
+	TclCallback callback;
+
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Job> jobs;          // not yet started
+	std::vector<Result> results;   // finished, not yet reported
+	std::vector<std::thread> threads;
+	unsigned busy;                 // number of jobs being encoded
+	bool exitLoop;
+};
+
+} // namespace openmsx
+
+#endif
@@ -48,12 +48,16 @@ VDPVRAM::LogicalVRAMDebuggable::LogicalVRAMDebuggable(VDP& vdp_)
 {
 }
 
+static unsigned transformPlanar(bool planar, unsigned address)
+{
+	return planar ? ((address << 16) | (address >> 1)) & 0x1FFFF
+	              : address;
+}
+
 unsigned VDPVRAM::LogicalVRAMDebuggable::transform(unsigned address)
 {
 	auto& vram = OUTER(VDPVRAM, logicalVRAMDebug);
-	return vram.vdp.getDisplayMode().isPlanar()
-	     ? ((address << 16) | (address >> 1)) & 0x1FFFF
-	     : address;
+	return transformPlanar(vram.vdp.getDisplayMode().isPlanar(), address);
 }
 
 byte VDPVRAM::LogicalVRAMDebuggable::read(unsigned address, EmuTime::param time)
@@ -69,6 +73,15 @@ void VDPVRAM::LogicalVRAMDebuggable::write(
 	vram.cpuWrite(transform(address), value, time);
 }
 
+void VDPVRAM::LogicalVRAMDebuggable::readBlock(
+	unsigned address, byte* output, unsigned num)
+{
+	auto& vram = OUTER(VDPVRAM, logicalVRAMDebug);
+	bool planar = vram.vdp.getDisplayMode().isPlanar();
+	vram.cpuReadBlock(address, output, num, getMotherBoard().getCurrentTime(),
+		[&](unsigned addr) { return transformPlanar(planar, addr); });
+}
+
 
 // class PhysicalVRAMDebuggable
 
@@ -94,6 +107,14 @@ void VDPVRAM::PhysicalVRAMDebuggable::write(
 	vram.cpuWrite(address, value, time);
 }
 
+void VDPVRAM::PhysicalVRAMDebuggable::readBlock(
+	unsigned address, byte* output, unsigned num)
+{
+	auto& vram = OUTER(VDPVRAM, physicalVRAMDebug);
+	vram.cpuReadBlock(address, output, num, getMotherBoard().getCurrentTime(),
+	                  [](unsigned addr) { return addr; });
+}
+
 
 // class VDPVRAM
 
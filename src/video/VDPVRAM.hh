@@ -597,6 +597,21 @@ private:
 
 	void setSizeMask(EmuTime::param time);
 
+	/** Read a block of VRAM like a sequence of cpuRead() calls at the
+	  * same time would, but only sync with the command engine once.
+	  * @param transform Maps an address in the block to a VRAM address.
+	  */
+	template<typename Transform>
+	void cpuReadBlock(unsigned address, byte* output, unsigned num,
+	                  EmuTime::param time, Transform transform) {
+		assert(vdp.isInsideFrame(time));
+		cmdEngine->sync(time);
+		cmdEngine->stealAccessSlot(time);
+		for (unsigned i = 0; i < num; ++i) {
+			output[i] = data[transform(address + i) & sizeMask];
+		}
+	}
+
 	/** VDP this VRAM belongs to.
 	  */
 	VDP& vdp;
@@ -615,6 +630,7 @@ private:
 		explicit LogicalVRAMDebuggable(VDP& vdp);
 		byte read(unsigned address, EmuTime::param time) override;
 		void write(unsigned address, byte value, EmuTime::param time) override;
+		void readBlock(unsigned address, byte* output, unsigned num) override;
 	private:
 		unsigned transform(unsigned address);
 	} logicalVRAMDebug;
@@ -627,6 +643,7 @@ private:
 		PhysicalVRAMDebuggable(VDP& vdp, unsigned actualSize);
 		byte read(unsigned address, EmuTime::param time) override;
 		void write(unsigned address, byte value, EmuTime::param time) override;
+		void readBlock(unsigned address, byte* output, unsigned num) override;
 	} physicalVRAMDebug;
 
 	// TODO: Renderer field can be removed, if updateDisplayMode
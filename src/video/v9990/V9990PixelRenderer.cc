@@ -23,12 +23,13 @@ V9990PixelRenderer::V9990PixelRenderer(V9990& vdp_)
 	: vdp(vdp_)
 	, eventDistributor(vdp.getReactor().getEventDistributor())
 	, realTime(vdp.getMotherBoard().getRealTime())
-	, renderSettings(vdp.getReactor().getDisplay().getRenderSettings())
+	, display(vdp.getReactor().getDisplay())
+	, renderSettings(display.getRenderSettings())
 	, videoSourceSetting(vdp.getMotherBoard().getVideoSource())
-	, rasterizer(vdp.getReactor().getDisplay().
-	                getVideoSystem().createV9990Rasterizer(vdp))
+	, rasterizer(display.getVideoSystem().createV9990Rasterizer(vdp))
 {
 	frameSkipCounter = 999; // force drawing of frame;
+	frameRequests = display.getFrameRequests();
 	finishFrameDuration = 0;
 	drawFrame = false; // don't draw before frameStart is called
 	prevDrawFrame = false;
@@ -71,6 +72,11 @@ void V9990PixelRenderer::frameStart(EmuTime::param time)
 	if (vdp.isInterlaced() && renderSettings.getDeinterlace() &&
 	    vdp.getEvenOdd() && vdp.isEvenOddEnabled()) {
 		// deinterlaced odd frame, do same as even frame
+	} else if (renderSettings.getLazyRender()) {
+		// Only draw when requested, see PixelRenderer.
+		drawFrame = rasterizer->isRecording() ||
+		            (frameRequests != display.getFrameRequests());
+		frameRequests = display.getFrameRequests();
 	} else {
 		if (frameSkipCounter < renderSettings.getMinFrameSkip()) {
 			++frameSkipCounter;
@@ -14,6 +14,7 @@ class V9990Rasterizer;
 class Setting;
 class EventDistributor;
 class RealTime;
+class Display;
 class VideoSourceSetting;
 
 /** Generic pixel based renderer for the V9990.
@@ -62,6 +63,7 @@ private:
 
 	EventDistributor& eventDistributor;
 	RealTime& realTime;
+	Display& display;
 
 	/** Settings shared between all renderers
 	  */
@@ -76,6 +78,7 @@ private:
 	  */
 	float finishFrameDuration;
 	int frameSkipCounter;
+	unsigned frameRequests; // see Display::requestFrame()
 
 	/** Accuracy setting for current frame.
 	 */